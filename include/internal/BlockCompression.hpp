@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_BLOCKCOMPRESSION_HPP
+#define WENDY_BLOCKCOMPRESSION_HPP
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+/*! Encodes a 4x4 block of RGBA8 pixels, stored row by row, into the specified
+ *  block-compressed format.  BC4 encodes the red channel and BC5 the red and
+ *  green channels.
+ */
+void encodeBlock(uint8* target,
+                 const uint8* pixels,
+                 const PixelFormat& format,
+                 CompressionQuality quality);
+
+/*! Decodes a block in the specified block-compressed format into 4x4 RGBA8
+ *  pixels, stored row by row.
+ */
+void decodeBlock(uint8* pixels, const uint8* source, const PixelFormat& format);
+
+/*! Reverses the order of the first @c rows rows of a block in the specified
+ *  block-compressed format.
+ */
+void flipBlock(uint8* block, const PixelFormat& format, uint rows);
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_BLOCKCOMPRESSION_HPP*/
+///////////////////////////////////////////////////////////////////////
@@ -26,6 +26,13 @@
 #define WENDY_GLHELPER_HPP
 ///////////////////////////////////////////////////////////////////////
 
+// ARB_buffer_storage is newer than the bundled GLEW
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
 namespace wendy
 {
   namespace GL
@@ -33,9 +40,27 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+typedef void (GLAPIENTRY* BufferStorageProc)(GLenum, GLsizeiptr, const GLvoid*, GLbitfield);
+
+/*! The glBufferStorage entry point, or @c nullptr if ARB_buffer_storage is not
+ *  supported.  Loaded by the context.
+ */
+extern BufferStorageProc bufferStorage;
+
+typedef void (GLAPIENTRY* MultiDrawElementsIndirectProc)(GLenum, GLenum, const GLvoid*, GLsizei, GLsizei);
+
+/*! The glMultiDrawElementsIndirect entry point, or @c nullptr if
+ *  ARB_multi_draw_indirect or ARB_base_instance is not supported.  Loaded by
+ *  the context.
+ */
+extern MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+
+///////////////////////////////////////////////////////////////////////
+
 WENDY_CHECKFORMAT(1, bool checkGL(const char* format, ...));
 
 GLenum convertToGL(IndexBufferType type);
+GLenum convertToGL(VertexComponentType type);
 GLenum convertToGL(PixelFormat::Type type);
 GLenum convertToGL(const PixelFormat& format, bool sRGB);
 GLenum convertToGL(PixelFormat::Type type);
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_IMAGEFILTER_HPP
+#define WENDY_IMAGEFILTER_HPP
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+/*! Converts the specified number of 8-bit or 32-bit floating point pixels
+ *  to floating point.  If @c sRGB is set, the color channels of 8-bit pixels
+ *  are converted to linear light.
+ */
+void convertToFloat(float* target,
+                    const void* source,
+                    const PixelFormat& format,
+                    size_t count,
+                    bool sRGB);
+
+/*! Converts the specified number of floating point pixels to 8-bit or 32-bit
+ *  floating point pixels, scaling the alpha channel, if any, by the specified
+ *  factor.  If @c sRGB is set, the color channels of 8-bit pixels are
+ *  converted from linear light.
+ */
+void convertFromFloat(void* target,
+                      const float* source,
+                      const PixelFormat& format,
+                      size_t count,
+                      bool sRGB,
+                      float alphaScale = 1.f);
+
+/*! Resamples floating point pixels with the specified number of interleaved
+ *  channels to a smaller size with the specified filter.  Edge pixels are
+ *  repeated.
+ */
+void downsample(float* target,
+                uint targetWidth,
+                uint targetHeight,
+                const float* source,
+                uint width,
+                uint height,
+                uint channels,
+                MipmapFilter filter,
+                ThreadPool* pool);
+
+/*! @return The fraction of the specified floating point pixels whose alpha
+ *  channel, the last of the specified number, is above the reference value.
+ */
+float alphaCoverage(const float* pixels,
+                    size_t count,
+                    uint channels,
+                    float reference);
+
+/*! @return The factor to scale the alpha channel of the specified floating
+ *  point pixels by for them to have the specified alpha coverage.
+ */
+float alphaCoverageScale(const float* pixels,
+                         size_t count,
+                         uint channels,
+                         float reference,
+                         float coverage);
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_IMAGEFILTER_HPP*/
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_MAPPEDFILE_HPP
+#define WENDY_MAPPEDFILE_HPP
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Read-only view of a whole file.
+ *
+ *  The file is memory-mapped where supported and otherwise read into memory.
+ */
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+  bool open(const Path& path);
+  const char* data() const { return m_data; }
+  size_t size() const { return m_size; }
+private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator = (const MappedFile&) = delete;
+  const char* m_data;
+  size_t m_size;
+  bool m_mapped;
+  std::vector<char> m_buffer;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_MAPPEDFILE_HPP*/
+///////////////////////////////////////////////////////////////////////
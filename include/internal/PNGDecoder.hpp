@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_PNGDECODER_HPP
+#define WENDY_PNGDECODER_HPP
+///////////////////////////////////////////////////////////////////////
+
+struct png_struct_def;
+struct png_info_def;
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief PNG decoder reading from memory.
+ *
+ *  The header is read by open, after which the size and format of the decoded
+ *  image are known, so that the caller can allocate the target before the
+ *  pixel data is decoded.  Rows are written bottom row first, straight into
+ *  the target, so no intermediate copy is made.  The source data must remain
+ *  valid until the decoder is destroyed.  A decoder may be used on any thread,
+ *  but only by one at a time.
+ */
+class PNGDecoder
+{
+public:
+  PNGDecoder();
+  ~PNGDecoder();
+  /*! Reads the header of the PNG file in the specified memory.
+   *  @param[in] data The contents of the file.
+   *  @param[in] size The size, in bytes, of the file.
+   *  @param[in] name The name to use in error messages.
+   */
+  bool open(const void* data, size_t size, const String& name);
+  /*! Decodes the image into the specified target, which must have room for
+   *  @c size bytes.
+   */
+  bool decode(void* target);
+  const PixelFormat& format() const { return m_format; }
+  uint width() const { return m_width; }
+  uint height() const { return m_height; }
+  /*! @return The size, in bytes, of the decoded image.
+   */
+  size_t size() const { return m_width * m_height * m_format.size(); }
+private:
+  PNGDecoder(const PNGDecoder&) = delete;
+  void close();
+  static void readData(png_struct_def* context, uint8* data, size_t size);
+  PNGDecoder& operator = (const PNGDecoder&) = delete;
+  png_struct_def* m_context;
+  png_info_def* m_info;
+  const uint8* m_data;
+  size_t m_size;
+  size_t m_offset;
+  String m_name;
+  PixelFormat m_format;
+  uint m_width;
+  uint m_height;
+  int m_passes;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_PNGDECODER_HPP*/
+///////////////////////////////////////////////////////////////////////
@@ -83,6 +83,14 @@ typedef std::string String;
  */
 typedef uint32 StringHash;
 
+/*! Interned name ID type.
+ */
+typedef uint32 NameID;
+
+/*! The ID of no interned name.
+ */
+const NameID INVALID_NAME_ID = 0;
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Converts the specified value to a string.
@@ -156,6 +164,26 @@ StringHash hashString(const String& string);
  */
 StringHash hashString(const char* string);
 
+/*! Returns the interned ID of the specified name, adding it to the name
+ *  table if necessary.  IDs are small, dense and stable for the lifetime of
+ *  the program.
+ */
+NameID internName(const char* name);
+
+/*! Returns the interned ID of the specified name, adding it to the name
+ *  table if necessary.
+ */
+NameID internName(const String& name);
+
+/*! Returns the interned ID of the specified name, or INVALID_NAME_ID if it
+ *  has never been interned.  Unlike internName, this never adds a name.
+ */
+NameID findName(const char* name);
+
+/*! Returns the name with the specified interned ID.
+ */
+const String& nameString(NameID ID);
+
 /*! Writes an error message log entry to the log consumers,
  *  or to stderr if there are no log consumers.
  *  @param[in] format The formatting string for the log entry.
@@ -54,11 +54,15 @@ private:
   {
     ITEM_FRAMERATE,
     ITEM_STATECHANGES,
+    ITEM_SAMESTATES,
     ITEM_OPERATIONS,
     ITEM_VERTICES,
     ITEM_POINTS,
     ITEM_LINES,
     ITEM_TRIANGLES,
+    ITEM_OCCLUDED,
+    ITEM_UNIFORMS,
+    ITEM_SKIPPED,
     ITEM_TEXTURES,
     ITEM_VERTEXBUFFERS,
     ITEM_INDEXBUFFERS,
@@ -30,6 +30,7 @@
 #include <wendy/RenderSystem.hpp>
 #include <wendy/RenderState.hpp>
 #include <wendy/RenderScene.hpp>
+#include <wendy/RenderCommand.hpp>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -71,6 +72,14 @@ public:
 
 /*! @brief Forward renderer.
  *  @ingroup renderer
+ *
+ *  Passes whose program has a @c vModel0 attribute are rendered with hardware
+ *  instancing.  Runs of operations using the same pass and vertex and index
+ *  buffers are drawn in a single call, with the model matrix of each
+ *  instance supplied through the @c vModel0 to @c vModel3 attributes, as
+ *  described by InstanceTransform.  Runs of identical primitive ranges are
+ *  drawn as instances, other runs as a multi-draw.  Such programs should use
+ *  @c wyVP rather than the shared uniforms derived from the model matrix.
  */
 class Renderer : public render::System
 {
@@ -79,6 +88,16 @@ public:
    *  specified camera.
    */
   void render(const render::Scene& scene, const Camera& camera);
+  /*! Renders the specified recorded commands to the current framebuffer
+   *  using the specified camera.
+   */
+  void render(const render::CommandBuffer& commands, const Camera& camera);
+  /*! Records the commands needed to render the specified scene into the
+   *  specified command buffer.  This makes no GL calls and may be called from
+   *  any thread, as long as each thread records into its own buffer.
+   */
+  void record(render::CommandBuffer& commands,
+              const render::Scene& scene) const;
   /*! @return The shared program state object used by this renderer.
    */
   SharedProgramState& sharedProgramState() { return *m_state; }
@@ -91,8 +110,12 @@ public:
 private:
   Renderer(render::VertexPool& pool);
   bool init(const Config& config);
-  void renderOperations(const render::Queue& queue);
+  void recordOperations(render::CommandBuffer& commands,
+                        const render::Scene& scene,
+                        const render::Queue& queue) const;
+  static bool isInstanced(const render::Pass& pass);
   Ref<SharedProgramState> m_state;
+  render::CommandBuffer m_commands;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -88,7 +88,12 @@ enum BufferUsage
   USAGE_STREAM,
   /*! Data will be repeatedly respecified and re-used.
    */
-  USAGE_DYNAMIC
+  USAGE_DYNAMIC,
+  /*! Data will be written by the client directly into persistently mapped
+   *  storage.  Only supported for vertex buffers, and only if the context
+   *  supports persistent buffers.
+   */
+  USAGE_PERSISTENT
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -104,6 +109,8 @@ public:
    */
   ~VertexBuffer();
   /*! Discards the current data.
+   *
+   *  @remarks Persistently mapped buffers cannot be discarded.
    */
   void discard();
   /*! Copies the specified data into this vertex buffer, starting at the
@@ -113,6 +120,15 @@ public:
    *  @param[in] start The index of the first vertex to be written to.
    */
   void copyFrom(const void* source, size_t count, size_t start = 0);
+  /*! Makes client writes to the specified range of the mapped storage of this
+   *  vertex buffer visible to the GL.
+   *  @param[in] count The number of vertices to flush.
+   *  @param[in] start The index of the first vertex to flush.
+   *
+   *  @remarks The caller must ensure that the GL is no longer using a range
+   *  before writing to it.
+   */
+  void flush(size_t count, size_t start = 0);
   /*! Copies the specified number of bytes from this vertex buffer, starting
    *  at the specified offset.
    *  @param[in,out] target The base address of the destination buffer.
@@ -132,6 +148,10 @@ public:
   /*! @return The size, in bytes, of the data in this vertex buffer.
    */
   size_t size() const { return m_count * m_format.size(); }
+  /*! @return The persistently mapped storage of this vertex buffer, or @c
+   *  nullptr if it does not have the usage USAGE_PERSISTENT.
+   */
+  void* mapping() const { return m_mapping; }
   /*! Creates a vertex buffer with the specified properties.
    *  @param count The desired number of vertices.
    *  @param format The desired format of the vertices.
@@ -142,6 +162,26 @@ public:
                                   size_t count,
                                   const VertexFormat& format,
                                   BufferUsage usage);
+  /*! Creates a vertex buffer object without any storage.  Unlike create, this
+   *  makes no OpenGL calls and so may be called from any thread.  The buffer
+   *  must not be used until its storage has been created with realize.
+   *  @param count The desired number of vertices.
+   *  @param format The desired format of the vertices.
+   *  @param usage The desired usage hint.
+   *  @return The newly created vertex buffer.
+   */
+  static Ref<VertexBuffer> createDeferred(Context& context,
+                                          size_t count,
+                                          const VertexFormat& format,
+                                          BufferUsage usage);
+  /*! Creates the storage of a vertex buffer created with createDeferred.  This
+   *  must be called on the context thread.
+   *  @return @c true if successful, or @c false otherwise.
+   */
+  bool realize();
+  /*! @return @c true if this vertex buffer has storage, otherwise @c false.
+   */
+  bool isRealized() const { return m_bufferID != 0; }
 private:
   VertexBuffer(Context& context);
   VertexBuffer(const VertexBuffer&) = delete;
@@ -152,6 +192,7 @@ private:
   uint m_bufferID;
   size_t m_count;
   BufferUsage m_usage;
+  void* m_mapping;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -366,6 +407,25 @@ public:
    *  otherwise @c false.
    */
   bool isEmpty() const;
+  /*! @return @c true if this primitive range is identical to the specified
+   *  one, or @c false otherwise.
+   */
+  bool operator == (const PrimitiveRange& other) const
+  {
+    return m_type == other.m_type &&
+           m_vertexBuffer == other.m_vertexBuffer &&
+           m_indexBuffer == other.m_indexBuffer &&
+           m_start == other.m_start &&
+           m_count == other.m_count &&
+           m_base == other.m_base;
+  }
+  /*! @return @c true if this primitive range differs from the specified one,
+   *  or @c false otherwise.
+   */
+  bool operator != (const PrimitiveRange& other) const
+  {
+    return !(*this == other);
+  }
   /*! @return The type of primitives in this range.
    */
   PrimitiveType type() const { return m_type; }
@@ -47,6 +47,7 @@ namespace wendy
 class VertexBuffer;
 class IndexBuffer;
 class Context;
+class VertexRange;
 class PrimitiveRange;
 
 ///////////////////////////////////////////////////////////////////////
@@ -173,6 +174,10 @@ class RenderState
 {
 public:
   RenderState();
+  /*! @return A compact descriptor of this render state.  Identical render
+   *  states have identical descriptors, so they can be compared as integers.
+   */
+  uint64 descriptor() const;
   bool depthTesting;
   bool depthWriting;
   bool colorWriting;
@@ -241,6 +246,13 @@ public:
   /*! The number of available vertex attributes.
    */
   uint maxVertexAttributes;
+  /*! Whether vertex buffers may have persistently mapped storage.
+   */
+  bool persistentBuffers;
+  /*! Whether multiple indexed ranges can be drawn with a single indirect
+   *  call.
+   */
+  bool multiDrawIndirect;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -257,16 +269,30 @@ public:
     Frame();
     uint operationCount;
     uint stateChangeCount;
+    uint skippedStateChangeCount;
     uint vertexCount;
     uint pointCount;
     uint lineCount;
     uint triangleCount;
+    uint occlusionTestCount;
+    uint occludedCount;
+    uint uniformCount;
+    uint skippedUniformCount;
+    uint samplerCount;
+    uint skippedSamplerCount;
+    uint vertexArrayHitCount;
+    uint vertexArrayMissCount;
     Time duration;
   };
   Stats();
   void addFrame();
-  void addStateChange();
-  void addPrimitives(PrimitiveType type, uint vertexCount);
+  void addStateChange(bool skipped);
+  void addDrawCall();
+  void addPrimitives(PrimitiveType type, uint vertexCount, uint instanceCount = 1);
+  void addOcclusionTests(uint testCount, uint occludedCount);
+  void addUniformUpload(bool skipped);
+  void addSamplerBinding(bool skipped);
+  void addVertexArrayLookup(bool hit);
   void addTexture(size_t size);
   void removeTexture(size_t size);
   void addVertexBuffer(size_t size);
@@ -322,6 +348,8 @@ public:
  */
 class Context : public Trackable
 {
+  friend class VertexBuffer;
+  friend class IndexBuffer;
 public:
   /*! Destructor.
    */
@@ -354,6 +382,22 @@ public:
    *  @pre A GLSL program must be set before calling this method.
    */
   void render(const PrimitiveRange& range);
+  /*! Renders one instance of the specified primitive range for each vertex of
+   *  the specified instance range, using the current GLSL program.  Program
+   *  attributes not found in the vertex format of the primitive range are
+   *  sourced per instance from the format of the instance range.
+   *  @pre A GLSL program must be set before calling this method.
+   */
+  void render(const PrimitiveRange& range, const VertexRange& instances);
+  /*! Renders each of the specified primitive ranges as a single instance,
+   *  using consecutive vertices of the specified instance range for their
+   *  per-instance attributes.  The ranges must share type and buffers.
+   *  Indexed ranges are drawn with a single indirect call when supported.
+   *  @pre A GLSL program must be set before calling this method.
+   */
+  void render(const PrimitiveRange* ranges,
+              uint count,
+              const VertexRange& instances);
   /*! Renders the specified primitive range to the current framebuffer, using
    *  the current GLSL program.
    *  @pre A GLSL program must be set before calling this method.
@@ -368,9 +412,15 @@ public:
   /*! @return The shared ID of the specified sampler uniform signature.
    */
   int sharedSamplerID(const char* name, SamplerType type) const;
+  /*! @return The shared ID of the specified sampler uniform signature.
+   */
+  int sharedSamplerID(NameID nameID, SamplerType type) const;
   /*! @return The shared ID of the specified non-sampler uniform signature.
    */
   int sharedUniformID(const char* name, UniformType type) const;
+  /*! @return The shared ID of the specified non-sampler uniform signature.
+   */
+  int sharedUniformID(NameID nameID, UniformType type) const;
   /*! @return The current shared program state, or @c nullptr if no shared
    *  program state is currently set.
    */
@@ -458,7 +508,15 @@ public:
   bool isCullingInverted();
   void setCullingInversion(bool newState);
   const RenderState& currentRenderState() const;
+  /*! Sets the current render state.  This builds the descriptor of the
+   *  state, so states applied repeatedly should keep their descriptor and use
+   *  the overload below, as render::Pass does.
+   */
   void setCurrentRenderState(const RenderState& newState);
+  /*! Sets the current render state, using a descriptor previously retrieved
+   *  from it with RenderState::descriptor.
+   */
+  void setCurrentRenderState(const RenderState& newState, uint64 descriptor);
   Stats* stats() const;
   void setStats(Stats* newStats);
   /*! @return The limits of this context.
@@ -483,12 +541,26 @@ private:
   Context(ResourceCache& cache);
   Context(const Context&) = delete;
   bool init(const WindowConfig& wc, const ContextConfig& cc);
-  void applyState(const RenderState& newState);
-  void forceState(const RenderState& newState);
+  void applyState(const RenderState& newState, uint64 descriptor);
+  void forceState(const RenderState& newState, uint64 descriptor);
+  void draw(PrimitiveType type,
+            uint start,
+            uint count,
+            uint base,
+            const VertexRange* instances);
+  bool prepareDraw(const VertexRange* instances);
+  bool applyVertexArray(bool instanced);
+  uint createVertexArray(bool instanced);
+  bool applyInstanceAttributes(const VertexRange& instances);
+  void destroyVertexArray(uint arrayID);
+  void releaseVertexArrays(const VertexBuffer& buffer);
+  void releaseVertexArrays(const IndexBuffer& buffer);
   Context& operator = (const Context&) = delete;
   void onFrame();
   class SharedSampler;
   class SharedUniform;
+  class VertexArray;
+  class IndirectCommand;
   ResourceCache& m_cache;
   Window m_window;
   GLFWwindow* m_handle;
@@ -499,9 +571,12 @@ private:
   bool m_dirtyBinding;
   bool m_dirtyState;
   bool m_cullingInverted;
+  uint m_currentVertexArray;
+  bool m_instancedBinding;
   TextureList m_textureUnits;
   uint m_activeTextureUnit;
   RenderState m_currentState;
+  uint64 m_currentDescriptor;
   Ref<Program> m_currentProgram;
   Ref<VertexBuffer> m_currentVertexBuffer;
   Ref<IndexBuffer> m_currentIndexBuffer;
@@ -510,6 +585,9 @@ private:
   Ref<DefaultFramebuffer> m_defaultFramebuffer;
   std::vector<SharedSampler> m_samplers;
   std::vector<SharedUniform> m_uniforms;
+  std::vector<VertexArray> m_vertexArrays;
+  std::vector<IndirectCommand> m_indirectCommands;
+  uint m_indirectBufferID;
   String m_declaration;
   Stats* m_stats;
 };
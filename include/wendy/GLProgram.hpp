@@ -110,6 +110,11 @@ public:
    *  current vertex buffer.
    */
   void bind(size_t stride, size_t offset);
+  /*! Binds this attribute to the specified stride and offset of the
+   *  current vertex buffer, using the storage type of the specified
+   *  vertex format component.
+   */
+  void bind(size_t stride, size_t offset, const VertexComponent& component);
   /*! @return @c true if the name of this attribute matches the specified
    *  string, or @c false otherwise.
    */
@@ -126,6 +131,9 @@ public:
   /*! @return The name of this attribute.
    */
   const String& name() const { return m_name; }
+  /*! @return The interned ID of the name of this attribute.
+   */
+  NameID nameID() const { return m_nameID; }
   /*! @return The number of elements in this attribute.
    */
   uint elementCount() const;
@@ -135,6 +143,7 @@ public:
 private:
   AttributeType m_type;
   String m_name;
+  NameID m_nameID;
   int m_location;
 };
 
@@ -162,6 +171,9 @@ class Sampler
   friend class Program;
 public:
   /*! Binds this sampler to the specified texture unit.
+   *
+   *  @remarks The call is skipped if the sampler is already bound to that
+   *  unit.
    */
   void bind(uint unit);
   /*! @return @c true if the name of this sampler matches the specified string,
@@ -180,6 +192,9 @@ public:
   /*! @return The name of this sampler.
    */
   const String& name() const { return m_name; }
+  /*! @return The interned ID of the name of this sampler.
+   */
+  NameID nameID() const { return m_nameID; }
   /*! @return The shared ID of this sampler, or INVALID_SHARED_STATE_ID if
    *  it is not shared.
    */
@@ -188,10 +203,13 @@ public:
    */
   static const char* typeName(SamplerType type);
 private:
+  Program* m_program;
   String m_name;
+  NameID m_nameID;
   SamplerType m_type;
   int m_location;
   int m_sharedID;
+  int m_unit;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -224,6 +242,7 @@ public:
    *
    *  @remarks It is the responsibility of the caller to ensure that the source
    *  data type matches.
+   *  @remarks The upload is skipped if the value matches the one last copied.
    */
   void copyFrom(const void* data);
   /*! @return @c true if the name of this uniform matches the specified string,
@@ -251,6 +270,9 @@ public:
   /*! @return The name of this uniform.
    */
   const String& name() const { return m_name; }
+  /*! @return The interned ID of the name of this uniform.
+   */
+  NameID nameID() const { return m_nameID; }
   /*! @return The number of elements in this uniform.
    */
   uint elementCount() const;
@@ -262,10 +284,14 @@ public:
    */
   static const char* typeName(UniformType type);
 private:
+  Program* m_program;
   String m_name;
+  NameID m_nameID;
   UniformType m_type;
   int m_location;
   int m_sharedID;
+  bool m_cached;
+  float m_value[4 * 4];
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -280,10 +306,16 @@ public:
   ~Program();
   Attribute* findAttribute(const char* name);
   const Attribute* findAttribute(const char* name) const;
+  Attribute* findAttribute(NameID nameID);
+  const Attribute* findAttribute(NameID nameID) const;
   Sampler* findSampler(const char* name);
   const Sampler* findSampler(const char* name) const;
+  Sampler* findSampler(NameID nameID);
+  const Sampler* findSampler(NameID nameID) const;
   Uniform* findUniform(const char* name);
   const Uniform* findUniform(const char* name) const;
+  Uniform* findUniform(NameID nameID);
+  const Uniform* findUniform(NameID nameID) const;
   uint attributeCount() const;
   Attribute& attribute(uint index);
   const Attribute& attribute(uint index) const;
@@ -294,6 +326,19 @@ public:
   Uniform& uniform(uint index);
   const Uniform& uniform(uint index) const;
   Context& context() const;
+  /*! @return The tag of the program state last applied to this program.
+   */
+  uint64 stateTag() const { return m_stateTag; }
+  /*! Sets the tag of the program state last applied to this program.
+   *
+   *  @remarks This allows a state object to skip uploading its values when
+   *  it was the last one applied and has not changed since.
+   */
+  void setStateTag(uint64 newTag) { m_stateTag = newTag; }
+  /*! @return The ID of this program, which is unique among existing programs
+   *  and kept small by reusing the IDs of destroyed programs.
+   */
+  uint ID() const { return m_ID; }
   static Ref<Program> create(const ResourceInfo& info,
                              Context& context,
                              Shader& vertexShader,
@@ -308,17 +353,23 @@ private:
   bool retrieveUniforms();
   bool retrieveAttributes();
   void bind();
-  void unbind();
   Program& operator = (const Program&) = delete;
   bool isValid() const;
+  static uint allocateID();
+  static void releaseID(uint ID);
   String infoLog() const;
   Context& m_context;
   Ref<Shader> m_vertexShader;
   Ref<Shader> m_fragmentShader;
   uint m_programID;
+  uint m_ID;
+  uint64 m_stateTag;
+  uint m_layoutID;
   std::vector<Attribute> m_attributes;
   std::vector<Sampler> m_samplers;
   std::vector<Uniform> m_uniforms;
+  static std::vector<uint> m_usedIDs;
+  static uint m_nextID;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -85,6 +85,50 @@ private:
   bool m_active;
 };
 
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Fence sync object.
+ *  @ingroup opengl
+ *
+ *  A fence is signaled once the GL has completed all commands issued before
+ *  it was set.  This allows the client to know when it can safely reuse
+ *  memory that the GL may be reading from.
+ */
+class Fence : public RefObject
+{
+public:
+  /*! Destructor.
+   */
+  ~Fence();
+  /*! Inserts this fence into the command stream, replacing any previous
+   *  position.
+   */
+  void set();
+  /*! Blocks until this fence is signaled.  Returns immediately if the fence
+   *  has not been set.
+   */
+  void wait();
+  /*! @return @c true if this fence has been signaled or has not been set,
+   *  otherwise @c false.
+   */
+  bool isSignaled() const;
+  /*! @return The context within which this fence was created.
+   */
+  Context& context() const { return m_context; }
+  /*! Creates a fence.
+   *  @param[in] context The context within which to create the fence.
+   *  @return The newly created fence.
+   */
+  static Ref<Fence> create(Context& context);
+private:
+  Fence(Context& context);
+  Fence(const Fence&) = delete;
+  Fence& operator = (const Fence&) = delete;
+  void release();
+  Context& m_context;
+  void* m_sync;
+};
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace GL*/
@@ -32,6 +32,7 @@
 #include <wendy/Resource.hpp>
 #include <wendy/Pixel.hpp>
 #include <wendy/Image.hpp>
+#include <wendy/Thread.hpp>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -44,6 +45,7 @@ namespace wendy
 
 class Texture;
 class Context;
+class TextureLoader;
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -154,6 +156,10 @@ public:
   uint height;
   uint depth;
   const void* texels;
+  /*! The pixel data of each successive mipmap level below the base level.
+   *  Only used for two-dimensional textures.
+   */
+  std::vector<const void*> mipmaps;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -167,6 +173,17 @@ public:
   TextureParams(TextureType type, uint flags);
   TextureType type;
   uint flags;
+  /*! The filter to generate mipmaps with, if the source data has none.
+   */
+  MipmapFilter mipmapFilter;
+  /*! The alpha test reference value for which to preserve alpha coverage in
+   *  generated mipmaps, or zero to not preserve it.
+   */
+  float alphaReference;
+  /*! The thread pool to generate mipmaps with, or @c nullptr to generate
+   *  them on the calling thread.
+   */
+  ThreadPool* pool;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -233,11 +250,15 @@ class Texture : public Resource, public RefObject
 {
   friend class Context;
   friend class TextureImage;
+  friend class TextureLoader;
 public:
   /*! Destructor.
    */
   ~Texture();
-  /*! Generates mipmaps based on the top-level image.
+  /*! Generates mipmaps on the GPU based on the top-level image.
+   *  @remarks Mipmaps for two-dimensional textures created with @c
+   *  TF_MIPMAPPED are generated on the CPU, or taken from the source image, at
+   *  creation instead.
    */
   void generateMipmaps();
   /*! @return @c true if this texture is one-dimensional, otherwise @c false.
@@ -277,6 +298,10 @@ public:
   /*! @return The number of mipmap levels of this texture.
    */
   uint levelCount() const { return m_levels; }
+  /*! @return The ID of this texture, which is unique among existing textures
+   *  and kept small by reusing the IDs of destroyed textures.
+   */
+  uint ID() const { return m_ID; }
   /*! @param[in] level The desired mipmap level.
    *  @param[in] face The desired cube map face if this texture is a cubemap,
    *  or @c NO_CUBE_FACE otherwise.
@@ -335,6 +360,9 @@ private:
   Texture(const ResourceInfo& info, Context& context);
   Texture(const Texture&) = delete;
   bool init(const TextureParams& params, const TextureData& data);
+  static String cacheName(const TextureParams& params, const String& imageName);
+  static uint allocateID();
+  static void releaseID(uint ID);
   void retrieveImages();
   uint retrieveTargetImages(uint target, CubeFace face);
   void applyDefaults();
@@ -342,12 +370,15 @@ private:
   Context& m_context;
   TextureType m_type;
   uint m_textureID;
+  uint m_ID;
   uint m_levels;
   FilterMode m_filterMode;
   AddressMode m_addressMode;
   float m_maxAnisotropy;
   PixelFormat m_format;
   std::vector<Ref<TextureImage>> m_images;
+  static std::vector<uint> m_usedIDs;
+  static uint m_nextID;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -356,6 +387,85 @@ private:
  */
 typedef std::vector<Ref<Texture>> TextureList;
 
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Asynchronous texture reader.
+ *  @ingroup opengl
+ *
+ *  PNG images are decoded from memory-mapped files by the workers of a thread
+ *  pool, straight into mapped pixel unpack buffers, and uploaded from those on
+ *  the context thread, so that the uploads overlap with the decoding of later
+ *  images.  Images in other formats are read synchronously on the context
+ *  thread.  The resulting textures are the same as those of Texture::read.
+ */
+class TextureLoader : public RefObject
+{
+public:
+  /*! Completion callback type.  The texture is @c nullptr if it could not be
+   *  read.
+   */
+  typedef std::function<void (Texture*)> Callback;
+  /*! Destructor.  Waits for all running decodes to complete.  Callbacks of
+   *  pending requests are not called.
+   */
+  ~TextureLoader();
+  /*! Requests the specified texture.  This does not block on reading or
+   *  decoding the image.
+   *  @param[in] params The creation parameters for the texture.
+   *  @param[in] imageName The name of the image to create the texture from.
+   *  @param[in] callback The function to call from update when the texture
+   *  has been created or has failed to be read.
+   */
+  void request(const TextureParams& params,
+               const String& imageName,
+               const Callback& callback);
+  /*! Starts decoding of requested images for which there are free unpack
+   *  buffers, creates textures from decoded images and calls the callbacks of
+   *  completed requests.  This must be called regularly on the context thread.
+   */
+  void update();
+  /*! Waits for and completes all pending requests.
+   */
+  void finish();
+  /*! @return The number of requests whose callbacks have not been called.
+   */
+  size_t pendingCount() const { return m_requests.size(); }
+  /*! @return The context used by this loader.
+   */
+  Context& context() const { return m_context; }
+  /*! Creates a texture loader.
+   *  @param[in] context The OpenGL context within which to create textures.
+   *  @param[in] pool The thread pool to decode images with.
+   *  @param[in] maxBuffers The maximum number of images to decode at the same
+   *  time, or zero to use twice the number of workers in the pool.
+   *  @return The newly created texture loader.
+   */
+  static Ref<TextureLoader> create(Context& context,
+                                   ThreadPool& pool,
+                                   uint maxBuffers = 0);
+private:
+  class Request;
+  TextureLoader(Context& context, ThreadPool& pool);
+  TextureLoader(const TextureLoader&) = delete;
+  bool init(uint maxBuffers);
+  void start(Request& request);
+  void complete(Request& request);
+  void open(Request& request);
+  void decode(Request& request);
+  void finishTask(Request& request, int state);
+  bool isReady() const;
+  TextureLoader& operator = (const TextureLoader&) = delete;
+  Context& m_context;
+  ThreadPool& m_pool;
+  std::vector<Ref<Request>> m_requests;
+  std::vector<uint> m_buffers;
+  uint m_mappedCount;
+  uint m_maxBuffers;
+  uint m_taskCount;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+};
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace GL*/
@@ -31,7 +31,58 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+class ThreadPool;
+class Image;
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Block compression quality enumeration.
+ */
+enum CompressionQuality
+{
+  /*! Use bounding box endpoints.  Suitable for previews.
+   */
+  COMPRESS_FASTEST,
+  /*! Use principal axis endpoints refined once.
+   */
+  COMPRESS_NORMAL,
+  /*! Refine endpoints repeatedly and try all block modes.  Suitable for
+   *  offline conversion.
+   */
+  COMPRESS_BEST
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Mipmap generation filter enumeration.
+ */
+enum MipmapFilter
+{
+  /*! Average the source pixels covered by each target pixel.
+   */
+  MIPMAP_BOX,
+  /*! Use a Kaiser-windowed sinc filter.  Sharper than the box filter but may
+   *  cause slight ringing.
+   */
+  MIPMAP_KAISER
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! List of images.
+ */
+typedef std::vector<Ref<Image>> ImageList;
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief Container for one- or two-dimensional pixel data.
+ *
+ *  An image may have block-compressed pixel data, in which case it cannot be
+ *  accessed per pixel, cropped or transformed, only flipped along the x axis
+ *  or decompressed.
+ *
+ *  An image may also carry the smaller mipmap levels below it, as loaded from
+ *  a KTX or DDS file or set explicitly.
  */
 class Image : public Resource, public RefObject
 {
@@ -42,6 +93,17 @@ public:
    *  @param[in] transform The pixel transform to use.
    */
   bool transformTo(const PixelFormat& format, PixelTransform& transform);
+  /*! Transforms the contents of this image to the specified pixel format using
+   *  a PixelConverter with the specified flags.  Unlike the above, this also
+   *  transforms images already in the specified format if any flags are set.
+   *  @param[in] format The desired pixel format.
+   *  @param[in] flags The desired pixel transform flags.
+   *  @param[in] pool The thread pool to convert with, or @c nullptr to
+   *  convert on the calling thread.
+   */
+  bool transformTo(const PixelFormat& format,
+                   uint flags = PT_NONE,
+                   ThreadPool* pool = nullptr);
   /*! Sets this image to the specified area of the current image data.
    *  @param[in] area The desired area.
    *  @return @c true if successful, otherwise @c false.
@@ -50,12 +112,50 @@ public:
    *  outside the current image data.
    */
   bool crop(const Recti& area);
-  /*! Flips this image along the x axis.
+  /*! Flips this image and its mipmaps along the x axis.  Block-compressed
+   *  images must have a height that is either a multiple of four or less
+   *  than four.
    */
   void flipHorizontal();
-  /*! Flips this image along the y axis.
+  /*! Flips this image and its mipmaps along the y axis.
    */
   void flipVertical();
+  /*! Creates a block-compressed copy of this image and its mipmaps.  This
+   *  image must have an 8-bit uncompressed format.  When compressing to BC5,
+   *  the luminance and alpha channels of an LA image are used, and otherwise
+   *  the red and green channels.
+   *  @param[in] format The desired block-compressed pixel format.
+   *  @param[in] quality The desired trade-off between speed and quality.
+   *  @param[in] pool The thread pool to encode with, or @c nullptr to encode
+   *  on the calling thread.
+   *  @return The compressed image, or @c nullptr if an error occurred.
+   */
+  Ref<Image> compress(const PixelFormat& format,
+                      CompressionQuality quality = COMPRESS_NORMAL,
+                      ThreadPool* pool = nullptr) const;
+  /*! Creates an 8-bit uncompressed copy of this block-compressed image and
+   *  its mipmaps.
+   *  @return The decompressed image, or @c nullptr if an error occurred.
+   */
+  Ref<Image> decompress() const;
+  /*! Generates and stores the full mipmap chain of this image, replacing any
+   *  existing mipmaps.  Each level is filtered from the one above it.
+   *  @param[in] filter The filter to use.
+   *  @param[in] sRGB Whether the color channels of this image are sRGB
+   *  encoded, in which case they are filtered in linear light.  This only
+   *  applies to 8-bit images.
+   *  @param[in] alphaReference The alpha test reference value for which to
+   *  preserve the alpha coverage of this image in each level, or zero to
+   *  leave the alpha channel as filtered.
+   *  @param[in] pool The thread pool to filter with, or @c nullptr to filter
+   *  on the calling thread.
+   *  @return @c true if successful, or @c false if the pixel format of this
+   *  image is not supported.
+   */
+  bool generateMipmaps(MipmapFilter filter = MIPMAP_BOX,
+                       bool sRGB = false,
+                       float alphaReference = 0.f,
+                       ThreadPool* pool = nullptr);
   /*! @return @c true if this image has power-of-two dimensions, otherwise @c false.
    */
   bool isPOT() const;
@@ -83,7 +183,8 @@ public:
    *  @param[in] z The z coordinate of the desired pixel.
    *
    *  @return The address of the desired pixel, or @c nullptr if the specified
-   *  coordinates are outside of the current image data.
+   *  coordinates are outside of the current image data or the image is
+   *  block-compressed.
    */
   void* pixel(uint x, uint y = 0, uint z = 0);
   /*! Helper method to calculate the address of the specified pixel.
@@ -97,6 +198,20 @@ public:
   /*! @return The pixel format of this image.
    */
   const PixelFormat& format() const { return m_format; }
+  /*! @return The size, in bytes, of the pixel data of this image, not
+   *  including its mipmaps.
+   */
+  size_t size() const { return m_data.size(); }
+  /*! @return The mipmap levels below this image, from the largest to the
+   *  smallest, or an empty list if it has none.
+   */
+  const ImageList& mipmaps() const { return m_mipmaps; }
+  /*! Sets the mipmap levels below this image.  Each level must have the pixel
+   *  format of this image and half the size of the level above it, rounded
+   *  down but no smaller than one.
+   *  @return @c true if successful, or @c false if the levels do not match.
+   */
+  bool setMipmaps(const ImageList& mipmaps);
   /*! @return The number of dimensions (that differ from 1) in this image.
    */
   uint dimensionCount() const;
@@ -130,6 +245,10 @@ public:
                            const void* pixels = nullptr,
                            ptrdiff_t pitch = 0);
   static Ref<Image> read(ResourceCache& cache, const String& name);
+  /*! @return @c true if mipmaps can be generated for images of the specified
+   *  pixel format, otherwise @c false.
+   */
+  static bool canGenerateMipmaps(const PixelFormat& format);
 private:
   Image(const ResourceInfo& info);
   Image(const Image&) = delete;
@@ -139,30 +258,51 @@ private:
             uint depth,
             const char* pixels,
             ptrdiff_t pitch);
+  bool convertPixels(const PixelFormat& format, PixelTransform& transform);
   Image& operator = (const Image&) = delete;
   uint m_width;
   uint m_height;
   uint m_depth;
   PixelFormat m_format;
   std::vector<char> m_data;
+  ImageList m_mipmaps;
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Image reader.
+ *
+ *  Reads PNG files and, by suffix, KTX and DDS files.  KTX and DDS files may
+ *  hold block-compressed pixel data and mipmaps.  Only two-dimensional images
+ *  are supported in those formats.
+ */
 class ImageReader : public ResourceReader<Image>
 {
 public:
   ImageReader(ResourceCache& cache);
   using ResourceReader<Image>::read;
   Ref<Image> read(const String& name, const Path& path);
+private:
+  Ref<Image> readPNG(const String& name, const Path& path);
+  Ref<Image> readKTX(const String& name, const Path& path);
+  Ref<Image> readDDS(const String& name, const Path& path);
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Image writer.
+ *
+ *  Writes PNG files and, for paths with the @c ktx suffix, KTX files.  KTX
+ *  files include any mipmaps of the image and support block-compressed and
+ *  8-bit pixel formats.
+ */
 class ImageWriter
 {
 public:
   bool write(const Path& path, const Image& image);
+private:
+  bool writePNG(const Path& path, const Image& image);
+  bool writeKTX(const Path& path, const Image& image);
 };
 
 ///////////////////////////////////////////////////////////////////////
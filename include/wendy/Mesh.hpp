@@ -33,6 +33,7 @@ namespace wendy
 
 class AABB;
 class Sphere;
+class ThreadPool;
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -101,11 +102,61 @@ public:
   MeshSection* findSection(const char* materialName);
   /*! Generates and stores triangle and vertex normals for this
    *  mesh, according to the specified generation mode.
+   *  @param[in] type The normal generation mode.
+   *  @param[in] pool The thread pool to use, or @c nullptr to run on the
+   *  calling thread.
    */
-  void generateNormals(NormalType type = SMOOTH_FACES);
+  void generateNormals(NormalType type = SMOOTH_FACES,
+                       ThreadPool* pool = nullptr);
   /*! Generates and stores triangle normals for this mesh.
+   *  @param[in] pool The thread pool to use, or @c nullptr to run on the
+   *  calling thread.
    */
-  void generateTriangleNormals();
+  void generateTriangleNormals(ThreadPool* pool = nullptr);
+  /*! Merges vertices whose positions, normals and texture coordinates are
+   *  equal after quantizing them to a grid of the specified spacing.
+   *  Vertices closer than the spacing but on either side of a grid boundary
+   *  are not merged.
+   *  @param[in] epsilon The grid spacing.
+   */
+  void weldVertices(float epsilon = 0.001f);
+  /*! Reduces the number of triangles in this mesh by collapsing edges in
+   *  order of increasing quadric error.  Material boundaries, texture seams
+   *  and open borders are preserved, so simplification may stop before the
+   *  target is reached.  Unreferenced vertices are removed afterwards.
+   *  @param[in] targetCount The desired number of triangles.
+   */
+  void simplify(size_t targetCount);
+  /*! Optimizes the triangle and vertex order of this mesh for rendering.
+   *  @param[in] cacheSize The number of entries in the post-transform vertex
+   *  cache to optimize for.
+   */
+  void optimize(uint cacheSize = 16);
+  /*! Reorders the triangles of each section for the post-transform vertex
+   *  cache using Tipsify, then orders the resulting clusters so that those
+   *  facing outwards are drawn first, to reduce overdraw.  The cluster order
+   *  is only used if it keeps the cache misses within the specified factor
+   *  of the vertex cache optimized order.
+   *  @param[in] cacheSize The number of entries in the post-transform vertex
+   *  cache to optimize for.
+   *  @param[in] threshold The largest acceptable increase in cache misses
+   *  from the overdraw ordering.
+   */
+  void optimizeTriangleOrder(uint cacheSize = 16, float threshold = 1.05f);
+  /*! Reorders the vertices of this mesh in order of first use by the
+   *  triangles, to improve vertex fetch locality.  Unreferenced vertices
+   *  are kept after all referenced ones.
+   */
+  void optimizeVertexOrder();
+  /*! @return The average number of post-transform vertex cache misses per
+   *  triangle (ACMR), assuming a FIFO cache of the specified size.
+   */
+  float averageCacheMissRatio(uint cacheSize = 16) const;
+  /*! @return The average number of post-transform vertex cache misses per
+   *  referenced vertex (ATVR), assuming a FIFO cache of the specified size.
+   *  The ideal value is one.
+   */
+  float averageTransformRatio(uint cacheSize = 16) const;
   /*! Generates the bounding box of this mesh.
    */
   AABB generateBoundingAABB() const;
@@ -118,7 +169,15 @@ public:
   /*! @return The number of triangles in all sections of this mesh.
    */
   size_t triangleCount() const;
-  static Ref<Mesh> read(ResourceCache& cache, const String& name);
+  /*! Reads the specified mesh.
+   *  @param[in] cache The resource cache to use.
+   *  @param[in] name The name of the mesh.
+   *  @param[in] pool The thread pool to parse large files with, or @c nullptr
+   *  to parse on the calling thread.
+   */
+  static Ref<Mesh> read(ResourceCache& cache,
+                        const String& name,
+                        ThreadPool* pool = nullptr);
   typedef std::vector<MeshVertex> VertexList;
   /*! The list of sections in this mesh.
    */
@@ -126,21 +185,26 @@ public:
   /*! The list of vertices in this mesh.
    */
   VertexList vertices;
+private:
+  size_t cacheMissCount(uint cacheSize) const;
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Wavefront OBJ mesh reader.
+ *
+ *  The file is memory-mapped where supported.  If a thread pool is specified,
+ *  large files are split at line boundaries and the parts parsed in parallel.
+ *  The resulting mesh is the same either way.
+ */
 class MeshReader : public ResourceReader<Mesh>
 {
 public:
-  MeshReader(ResourceCache& cache);
+  MeshReader(ResourceCache& cache, ThreadPool* pool = nullptr);
   using ResourceReader<Mesh>::read;
   Ref<Mesh> read(const String& name, const Path& path);
 private:
-  String parseName(const char** text);
-  int parseInteger(const char** text);
-  float parseFloat(const char** text);
-  bool interesting(const char** text);
+  ThreadPool* m_pool;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -148,7 +212,13 @@ private:
 class MeshWriter
 {
 public:
-  bool write(const Path& path, const Mesh& mesh);
+  /*! Writes the specified mesh as a Wavefront OBJ file.
+   *  @param[in] path The path of the file to write.
+   *  @param[in] mesh The mesh to write.
+   *  @param[in] optimize Whether to write the mesh with its triangle and
+   *  vertex order optimized for rendering.
+   */
+  bool write(const Path& path, const Mesh& mesh, bool optimize = false);
 };
 
 ///////////////////////////////////////////////////////////////////////
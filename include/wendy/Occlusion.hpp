@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_OCCLUSION_HPP
+#define WENDY_OCCLUSION_HPP
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+class Camera;
+class Mesh;
+class Sphere;
+class Transform3;
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Software hierarchical depth buffer for occlusion culling.
+ *
+ *  Occluder meshes are rasterized on the CPU into a low resolution depth
+ *  buffer, which is then summarized into tiles holding the farthest depth
+ *  within them.  Bounding spheres are tested against the tiles first, and
+ *  against individual depths only for tiles where the coarse test fails.
+ *
+ *  Occluders should be simplified proxies lying entirely inside the objects
+ *  they represent, as anything they cover is considered hidden.
+ */
+class OcclusionBuffer : public RefObject
+{
+public:
+  /*! Clears this buffer and sets the camera to rasterize and test from.
+   */
+  void clear(const Camera& camera);
+  /*! Rasterizes the triangles of the specified mesh into this buffer.
+   *  @param[in] mesh The occluder mesh.
+   *  @param[in] transform The local-to-world transform of the mesh.
+   */
+  void addOccluder(const Mesh& mesh, const Transform3& transform);
+  /*! @param[in] bounds A bounding sphere in world space.
+   *  @return @c true if the sphere is entirely hidden by the occluders in this
+   *  buffer, or @c false otherwise.
+   */
+  bool isOccluded(const Sphere& bounds) const;
+  /*! @return @c true if any occluder has been added since this buffer was
+   *  last cleared, or @c false otherwise.
+   */
+  bool hasOccluders() const { return m_triangleCount > 0; }
+  /*! @return The number of occluder triangles rasterized since this buffer
+   *  was last cleared.
+   */
+  uint triangleCount() const { return m_triangleCount; }
+  /*! @return The width, in pixels, of this buffer.
+   */
+  uint width() const { return m_width; }
+  /*! @return The height, in pixels, of this buffer.
+   */
+  uint height() const { return m_height; }
+  /*! @return The normalized depth at the specified pixel.
+   */
+  float depth(uint x, uint y) const { return m_depths[y * m_width + x]; }
+  /*! Creates an occlusion buffer.
+   *  @param[in] width The desired width, in pixels.  This is rounded up to a
+   *  multiple of the tile size.
+   *  @param[in] height The desired height, in pixels.  This is rounded up to
+   *  a multiple of the tile size.
+   *  @return The newly created occlusion buffer.
+   */
+  static Ref<OcclusionBuffer> create(uint width = 256, uint height = 128);
+private:
+  OcclusionBuffer();
+  OcclusionBuffer(const OcclusionBuffer&) = delete;
+  bool init(uint width, uint height);
+  void addTriangle(const vec4& P0, const vec4& P1, const vec4& P2);
+  void rasterize(const vec3& P0, const vec3& P1, const vec3& P2);
+  void updateTiles() const;
+  OcclusionBuffer& operator = (const OcclusionBuffer&) = delete;
+  uint m_width;
+  uint m_height;
+  uint m_tileCountX;
+  uint m_tileCountY;
+  uint m_triangleCount;
+  mat4 m_view;
+  mat4 m_projection;
+  mat4 m_viewProjection;
+  std::vector<float> m_depths;
+  std::vector<vec4> m_vertices;
+  mutable std::vector<float> m_tiles;
+  mutable bool m_dirtyTiles;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_OCCLUSION_HPP*/
+///////////////////////////////////////////////////////////////////////
@@ -31,9 +31,18 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+class ThreadPool;
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief %Pixel format descriptor.
  *
  *  All formats are at least byte aligned, although their channels may not be.
+ *
+ *  The block-compressed types store 4x4 pixel blocks of fixed size rather
+ *  than individual pixels, so size and channelSize return zero for them.  Use
+ *  imageSize to find the size of an image in any format.  BC1 may be used with
+ *  RGB or RGBA, BC3 with RGBA, BC4 with L and BC5 with LA.
  */
 class PixelFormat
 {
@@ -59,7 +68,11 @@ public:
     UINT24,
     UINT32,
     FLOAT16,
-    FLOAT32
+    FLOAT32,
+    BC1,
+    BC3,
+    BC4,
+    BC5
   };
   /*! Default constructor.
    *  @param[in] semantic The desired semantic of this pixel format.
@@ -80,10 +93,21 @@ public:
   /*! @return @c true if this pixel format describes to a physical pixel
    *  format.
    */
-  bool isValid() const { return m_semantic != NONE && m_type != DUMMY; }
+  bool isValid() const;
+  /*! @return @c true if this pixel format is block-compressed.
+   */
+  bool isCompressed() const { return m_type >= BC1; }
   /*! @return The size, in bytes, of a pixel in this pixel format.
    */
   size_t size() const { return channelSize() * channelCount(); }
+  /*! @return The size, in bytes, of a 4x4 block in this pixel format, or zero
+   *  if it is not block-compressed.
+   */
+  size_t blockSize() const;
+  /*! @return The size, in bytes, of an image of the specified dimensions in
+   *  this pixel format.
+   */
+  size_t imageSize(uint width, uint height = 1, uint depth = 1) const;
   /*! @return The size, in bytes, of a channel of a pixel in this pixel format.
    */
   size_t channelSize() const;
@@ -120,6 +144,11 @@ public:
   static const PixelFormat DEPTH32;
   static const PixelFormat DEPTH16F;
   static const PixelFormat DEPTH32F;
+  static const PixelFormat RGB_BC1;
+  static const PixelFormat RGBA_BC1;
+  static const PixelFormat RGBA_BC3;
+  static const PixelFormat L_BC4;
+  static const PixelFormat LA_BC5;
 private:
   Semantic m_semantic;
   Type m_type;
@@ -135,6 +164,11 @@ public:
   virtual ~PixelTransform();
   virtual bool supports(const PixelFormat& targetFormat,
                         const PixelFormat& sourceFormat) = 0;
+  /*! @return @c true if this transform can convert pixels in place, i.e. with
+   *  the same address as target and source, otherwise @c false.
+   */
+  virtual bool supportsInPlace(const PixelFormat& targetFormat,
+                               const PixelFormat& sourceFormat);
   virtual void convert(void* target,
                        const PixelFormat& targetFormat,
                        const void* source,
@@ -144,16 +178,74 @@ public:
 
 ///////////////////////////////////////////////////////////////////////
 
-class RGBtoRGBA : public PixelTransform
+/*! @brief Pixel transform flags.
+ */
+enum PixelTransformFlags
+{
+  PT_NONE                = 0x00,
+  PT_SWAP_RED_BLUE       = 0x01,
+  PT_PREMULTIPLY_ALPHA   = 0x02,
+  PT_UNPREMULTIPLY_ALPHA = 0x04,
+  PT_SRGB_TO_LINEAR      = 0x08,
+  PT_LINEAR_TO_SRGB      = 0x10
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief General pixel format converter.
+ *
+ *  Converts between any two uncompressed pixel formats, except between depth
+ *  and color formats other than luminance.  Integer types are treated as
+ *  normalized.  Missing color channels are replicated from luminance, missing
+ *  alpha is opaque and luminance is computed with Rec. 709 weights.
+ *
+ *  Common conversions between 8-bit and floating point formats have dedicated
+ *  kernels.  All others go through floating point, which may lose precision
+ *  for 32-bit integer types.
+ *
+ *  The flags apply in the order sRGB to linear, unpremultiply, premultiply,
+ *  linear to sRGB and red and blue swap.  The sRGB conversions leave alpha
+ *  unchanged.
+ */
+class PixelConverter : public PixelTransform
 {
 public:
+  /*! Constructor.
+   *  @param[in] flags The desired pixel transform flags.
+   *  @param[in] pool The thread pool to convert large pixel ranges with, or
+   *  @c nullptr to always convert on the calling thread.
+   */
+  PixelConverter(uint flags = PT_NONE, ThreadPool* pool = nullptr);
   bool supports(const PixelFormat& targetFormat,
                 const PixelFormat& sourceFormat);
+  /*! @return @c true if the pixel formats are supported and have the same
+   *  size, otherwise @c false.
+   */
+  bool supportsInPlace(const PixelFormat& targetFormat,
+                       const PixelFormat& sourceFormat);
   void convert(void* target,
                const PixelFormat& targetFormat,
                const void* source,
                const PixelFormat& sourceFormat,
                size_t count);
+  uint flags() const { return m_flags; }
+private:
+  uint m_flags;
+  ThreadPool* m_pool;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief RGB to RGBA pixel transform.
+ *
+ *  @remarks This is a restricted PixelConverter kept for compatibility.  The
+ *  alpha channel is set to opaque.
+ */
+class RGBtoRGBA : public PixelConverter
+{
+public:
+  bool supports(const PixelFormat& targetFormat,
+                const PixelFormat& sourceFormat);
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy default renderer
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_RENDERCOMMAND_HPP
+#define WENDY_RENDERCOMMAND_HPP
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/GLBuffer.hpp>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+  namespace render
+  {
+
+///////////////////////////////////////////////////////////////////////
+
+class VertexPool;
+class SharedProgramState;
+class Pass;
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Render command type enumeration.
+ *  @ingroup renderer
+ */
+enum CommandType
+{
+  /*! Clears the color buffer.
+   */
+  COMMAND_CLEAR_COLOR,
+  /*! Clears the depth buffer.
+   */
+  COMMAND_CLEAR_DEPTH,
+  /*! Sets the render pass used by subsequent draws.
+   */
+  COMMAND_SET_PASS,
+  /*! Sets the model matrix used by subsequent non-instanced draws.
+   */
+  COMMAND_SET_MODEL_MATRIX,
+  /*! Draws a primitive range.
+   */
+  COMMAND_DRAW,
+  /*! Draws instances of a primitive range.
+   */
+  COMMAND_DRAW_INSTANCED,
+  /*! Draws a single instance of each of several primitive ranges.
+   */
+  COMMAND_DRAW_MULTI
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Recorded render command.
+ *  @ingroup renderer
+ *
+ *  The arguments of a command are stored in the command buffer that recorded
+ *  it, and referenced by index.
+ */
+class Command
+{
+public:
+  /*! The type of this command.
+   */
+  CommandType type;
+  /*! The index of the argument of this command in the arrays of its command
+   *  buffer.
+   */
+  uint32 index;
+  /*! The index of the first instance transform, for instanced draws and
+   *  multi-draws.
+   */
+  uint32 transform;
+  /*! The number of instances, for instanced draws and multi-draws.
+   */
+  uint32 count;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Render command target interface.
+ *  @ingroup renderer
+ *
+ *  This is the interface for objects able to replay recorded render commands.
+ */
+class CommandTarget
+{
+public:
+  /*! Destructor.
+   */
+  virtual ~CommandTarget();
+  virtual void clearColor(const vec4& color) = 0;
+  virtual void clearDepth(float depth) = 0;
+  virtual void setPass(const Pass& pass) = 0;
+  virtual void setModelMatrix(const mat4& matrix) = 0;
+  virtual void draw(const GL::PrimitiveRange& range) = 0;
+  /*! Draws one instance of the specified range for each of the specified
+   *  model matrices.
+   */
+  virtual void drawInstanced(const GL::PrimitiveRange& range,
+                             const mat4* transforms,
+                             uint count) = 0;
+  /*! Draws one instance of each of the specified ranges, using the
+   *  corresponding model matrix.  The ranges share type and buffers.
+   */
+  virtual void drawMulti(const GL::PrimitiveRange* ranges,
+                         const mat4* transforms,
+                         uint count) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Render command buffer.
+ *  @ingroup renderer
+ *
+ *  A command buffer is a compact list of render commands.  Recording makes no
+ *  GL calls, so any thread may record into a buffer it owns, while the
+ *  context thread replays buffers recorded earlier.
+ *
+ *  @remarks To avoid thrashing the heap, keep your command buffer objects
+ *  around between frames when possible.
+ */
+class CommandBuffer
+{
+public:
+  /*! Records a color buffer clear.
+   */
+  void clearColor(const vec4& color = vec4(0.f));
+  /*! Records a depth buffer clear.
+   */
+  void clearDepth(float depth = 1.f);
+  /*! Records setting the render pass used by subsequent draws.
+   *  @remarks The pass must remain valid until the buffer has been replayed.
+   */
+  void setPass(const Pass& pass);
+  /*! Records setting the model matrix used by subsequent draws.
+   */
+  void setModelMatrix(const mat4& matrix);
+  /*! Records drawing the specified primitive range.
+   */
+  void draw(const GL::PrimitiveRange& range);
+  /*! Records drawing one instance of the specified primitive range for each
+   *  of the specified model matrices.
+   */
+  void drawInstanced(const GL::PrimitiveRange& range,
+                     const mat4* transforms,
+                     uint count);
+  /*! Records drawing one instance of each of the specified primitive ranges,
+   *  using the corresponding model matrix.  The ranges must share type and
+   *  buffers.
+   */
+  void drawMulti(const GL::PrimitiveRange* ranges,
+                 const mat4* transforms,
+                 uint count);
+  /*! Replays the commands in this buffer, in order, to the specified target.
+   */
+  void execute(CommandTarget& target) const;
+  /*! Destroys all commands in this buffer.
+   */
+  void removeCommands();
+  /*! @return @c true if this buffer contains no commands, or @c false
+   *  otherwise.
+   */
+  bool isEmpty() const { return m_commands.empty(); }
+  /*! @return The commands in this buffer.
+   */
+  const std::vector<Command>& commands() const { return m_commands; }
+private:
+  std::vector<Command> m_commands;
+  std::vector<const Pass*> m_passes;
+  std::vector<GL::PrimitiveRange> m_ranges;
+  std::vector<mat4> m_transforms;
+  std::vector<vec4> m_colors;
+  std::vector<float> m_depths;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Render command target for the current context.
+ *  @ingroup renderer
+ *
+ *  Replays render commands using the context of the specified vertex pool.
+ *  Instance transforms are allocated from the pool.
+ */
+class ContextTarget : public CommandTarget
+{
+public:
+  /*! Constructor.
+   */
+  ContextTarget(VertexPool& pool, SharedProgramState& state);
+  void clearColor(const vec4& color);
+  void clearDepth(float depth);
+  void setPass(const Pass& pass);
+  void setModelMatrix(const mat4& matrix);
+  void draw(const GL::PrimitiveRange& range);
+  void drawInstanced(const GL::PrimitiveRange& range,
+                     const mat4* transforms,
+                     uint count);
+  void drawMulti(const GL::PrimitiveRange* ranges,
+                 const mat4* transforms,
+                 uint count);
+private:
+  bool applyPass();
+  VertexPool& m_pool;
+  SharedProgramState& m_state;
+  const Pass* m_pass;
+  bool m_dirtyPass;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Null render command target.
+ *  @ingroup renderer
+ *
+ *  Counts replayed render commands without making any GL calls, allowing
+ *  render queue building, state sorting and draw counts to be measured
+ *  without a context.
+ */
+class NullTarget : public CommandTarget
+{
+public:
+  /*! Constructor.
+   */
+  NullTarget();
+  void clearColor(const vec4& color);
+  void clearDepth(float depth);
+  void setPass(const Pass& pass);
+  void setModelMatrix(const mat4& matrix);
+  void draw(const GL::PrimitiveRange& range);
+  void drawInstanced(const GL::PrimitiveRange& range,
+                     const mat4* transforms,
+                     uint count);
+  void drawMulti(const GL::PrimitiveRange* ranges,
+                 const mat4* transforms,
+                 uint count);
+  /*! Resets all counters to zero.
+   */
+  void reset();
+  /*! @return The number of buffer clears replayed.
+   */
+  uint clearCount() const { return m_clearCount; }
+  /*! @return The number of pass changes replayed.
+   */
+  uint passCount() const { return m_passCount; }
+  /*! @return The number of model matrix changes replayed.
+   */
+  uint transformCount() const { return m_transformCount; }
+  /*! @return The number of draws replayed, counting each instanced draw and
+   *  multi-draw once.
+   */
+  uint drawCount() const { return m_drawCount; }
+  /*! @return The number of instances drawn, counting each non-instanced draw
+   *  as a single instance.
+   */
+  uint instanceCount() const { return m_instanceCount; }
+  /*! @return The number of vertices drawn, over all instances.
+   */
+  uint vertexCount() const { return m_vertexCount; }
+private:
+  uint m_clearCount;
+  uint m_passCount;
+  uint m_transformCount;
+  uint m_drawCount;
+  uint m_instanceCount;
+  uint m_vertexCount;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+  } /*namespace render*/
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_RENDERCOMMAND_HPP*/
+///////////////////////////////////////////////////////////////////////
@@ -41,6 +41,38 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Model vertex storage flags.
+ *  @ingroup renderer
+ *
+ *  By default model vertices are stored as 32-bit floats.  These flags select
+ *  smaller storage types for individual vertex components.  Half precision
+ *  positions lose accuracy for coordinates far from the origin, so they are
+ *  best suited for models of moderate extent.  Octahedral normals must be
+ *  declared as @c vec2 and decoded by the vertex shader.
+ */
+enum ModelVertexFlags
+{
+  MV_NONE               = 0x00,
+  /*! Store positions as half floats, padded to four elements.
+   */
+  MV_HALF_POSITIONS     = 0x01,
+  /*! Store normals in the normalized 10:10:10:2 format.
+   */
+  MV_PACKED_NORMALS     = 0x02,
+  /*! Store normals as octahedral-encoded normalized shorts.
+   */
+  MV_OCTAHEDRAL_NORMALS = 0x04,
+  /*! Store texture coordinates as half floats.
+   */
+  MV_HALF_TEXCOORDS     = 0x08,
+  /*! Half positions and texture coordinates and packed normals, for a total
+   *  of 16 bytes per vertex instead of 32.
+   */
+  MV_COMPACT            = MV_HALF_POSITIONS | MV_PACKED_NORMALS | MV_HALF_TEXCOORDS
+};
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief Model section.
  *  @ingroup renderer
  *
@@ -75,53 +107,146 @@ typedef std::vector<ModelSection> ModelSectionList;
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Model level of detail.
+ *  @ingroup renderer
+ *
+ *  This class represents the sections of a single level of detail of a model.
+ */
+class ModelLevel
+{
+public:
+  /*! Constructor.
+   */
+  ModelLevel(float screenSize);
+  /*! @return The projected size, as a fraction of the viewport height, below
+   *  which this level is used.
+   */
+  float screenSize() const { return m_screenSize; }
+  /*! @return The list of geometries in this level.
+   */
+  const ModelSectionList& sections() const { return m_sections; }
+  /*! @return The list of geometries in this level.
+   */
+  ModelSectionList& sections() { return m_sections; }
+private:
+  float m_screenSize;
+  ModelSectionList m_sections;
+};
+
+/*! @ingroup renderer
+ */
+typedef std::vector<ModelLevel> ModelLevelList;
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief Triangle mesh model.
  *  @ingroup renderer
  *
  *  This class represents a single model consisting of one or more
  *  sections.  Each section is a range of triangles sharing a material.
+ *
+ *  A model may have coarser levels of detail, each used when the projected
+ *  size of the model falls below its threshold.  All levels share the same
+ *  vertex and index ranges.
+ *
+ *  The vertices and indices of a model are allocated from the static geometry
+ *  pool of its render system, so models of the same vertex format share
+ *  buffers.
  */
 class Model : public Renderable, public Resource
 {
 public:
+  /*! @brief Source data for a coarser level of detail.
+   */
+  class LevelData
+  {
+  public:
+    LevelData(const Mesh& mesh, float screenSize);
+    const Mesh* mesh;
+    float screenSize;
+  };
   typedef std::map<String, Ref<Material>> MaterialMap;
+  typedef std::vector<LevelData> LevelDataList;
+  /*! Destructor.
+   */
+  ~Model();
   void enqueue(Scene& scene,
                const Camera& camera,
                const Transform3& transform) const override;
+  void enqueue(Scene& scene,
+               const Camera& camera,
+               const Transform3& transform,
+               uint& level) const override;
   Sphere bounds() const override;
+  const Mesh* occluder() const override;
+  /*! Sets the occluder mesh of this model.
+   *  @param[in] newOccluder The desired occluder mesh, or @c nullptr to not
+   *  use this model as an occluder.
+   */
+  void setOccluder(Mesh* newOccluder);
   /*! @return The bounding AABB of this model.
    */
   const AABB& boundingAABB() const { return m_boundingAABB; }
   /*! @return The bounding sphere of this model.
    */
   const Sphere& boundingSphere() const { return m_boundingSphere; }
-  /*! @return The list of geometries in this model.
+  /*! @return The list of geometries in the most detailed level of this
+   *  model.
    */
-  const ModelSectionList& sections() { return m_sections; }
-  /*! @return The vertex buffer used by this model.
+  const ModelSectionList& sections() { return m_levels.front().sections(); }
+  /*! @return The levels of detail of this model, from the most to the least
+   *  detailed.
    */
-  GL::VertexBuffer& vertexBuffer() { return *m_vertexBuffer; }
-  /*! @return The vertex buffer used by this model.
+  const ModelLevelList& levels() const { return m_levels; }
+  /*! Selects the level of detail to use for the specified camera and
+   *  transform.  The current level is kept until the projected size has moved
+   *  past the threshold of another level by a margin, to avoid flickering
+   *  between levels near a threshold.
+   *  @param[in] camera The camera to select for.
+   *  @param[in] transform The local-to-world transform.
+   *  @param[in] current The level currently in use.
+   *  @return The index of the level to use.
    */
-  const GL::VertexBuffer& vertexBuffer() const { return *m_vertexBuffer; }
-  /*! @return The index buffer used by this model.
+  uint selectLevel(const Camera& camera,
+                   const Transform3& transform,
+                   uint current) const;
+  /*! @return The range of vertices used by this model.  Index ranges of its
+   *  sections are relative to the start of this range.
    */
-  GL::IndexBuffer& indexBuffer() { return *m_indexBuffer; }
-  /*! @return The index buffer used by this model.
+  const GL::VertexRange& vertexRange() const { return m_vertices; }
+  /*! @return The vertex buffer used by this model, shared with other models.
    */
-  const GL::IndexBuffer& indexBuffer() const { return *m_indexBuffer; }
+  GL::VertexBuffer& vertexBuffer() const { return *m_vertices.vertexBuffer(); }
   /*! Creates a model from the specified mesh.
    *  @param[in] info The resource info for the texture.
    *  @param[in] system The render system within which to create the texture.
    *  @param[in] data The mesh to use.
    *  @param[in] materials The materials to use.
+   *  @param[in] levels The coarser levels of detail to use, if any.
+   *  @param[in] vertexFlags The vertex storage flags to use.
    *  @return The newly created model, or @c nullptr if an error
    *  occurred.
    */
   static Ref<Model> create(const ResourceInfo& info,
                            System& system,
                            const Mesh& data,
-                           const MaterialMap& materials);
+                           const MaterialMap& materials,
+                           const LevelDataList& levels = LevelDataList(),
+                           uint vertexFlags = MV_NONE);
+  /*! Creates a model from the specified binary model data, as written by
+   *  ModelWriter.  The vertices and indices are copied directly from the
+   *  data and its materials and occluder are loaded by name.
+   *  @param[in] info The resource info for the model.
+   *  @param[in] system The render system within which to create the model.
+   *  @param[in] data The binary model data to use.
+   *  @param[in] size The size, in bytes, of the binary model data.
+   *  @return The newly created model, or @c nullptr if an error
+   *  occurred.
+   */
+  static Ref<Model> create(const ResourceInfo& info,
+                           System& system,
+                           const void* data,
+                           size_t size);
   /*! Creates a model specification using the specified file.
    *  @param[in] context The OpenGL context within which to create the texture.
    *  @param[in] path The path of the specification file to use.
@@ -131,17 +256,85 @@ public:
 private:
   Model(const ResourceInfo& info);
   Model(const Model&) = delete;
-  bool init(System& system, const Mesh& data, const MaterialMap& materials);
+  bool init(System& system,
+            const Mesh& data,
+            const MaterialMap& materials,
+            const LevelDataList& levels,
+            uint vertexFlags);
+  bool init(System& system, const void* data, size_t size);
+  bool initGeometry(System& system,
+                    const VertexFormat& format,
+                    const void* vertices,
+                    uint vertexCount,
+                    const void* indices,
+                    uint indexCount,
+                    GL::IndexBufferType indexType,
+                    GL::IndexRange& range);
   Model& operator = (const Model&) = delete;
-  ModelSectionList m_sections;
-  Ref<GL::VertexBuffer> m_vertexBuffer;
-  Ref<GL::IndexBuffer> m_indexBuffer;
+  ModelLevelList m_levels;
+  Ref<GeometryPool> m_geometryPool;
+  GL::VertexRange m_vertices;
   Sphere m_boundingSphere;
   AABB m_boundingAABB;
+  Ref<Mesh> m_occluder;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Model specification data.
+ *  @ingroup renderer
+ *
+ *  This class holds the meshes, material names and levels of detail described
+ *  by a model specification file, without creating any %render resources.
+ */
+class ModelData
+{
+public:
+  /*! Constructor.
+   */
+  ModelData();
+  /*! Reads the specified model specification file.
+   *  @param[in] cache The resource cache to load meshes from.
+   *  @param[in] name The name of the model.
+   *  @param[in] path The path of the specification file.
+   *  @param[in] pool The thread pool to parse large meshes with, or @c nullptr
+   *  to parse them on the calling thread.
+   *  @return @c true if successful, or @c false if an error occurred.
+   */
+  bool read(ResourceCache& cache,
+            const String& name,
+            const Path& path,
+            ThreadPool* pool = nullptr);
+  /*! The most detailed mesh of the model.
+   */
+  Ref<Mesh> mesh;
+  /*! The meshes of the coarser levels of detail.
+   */
+  std::vector<Ref<Mesh>> levelMeshes;
+  /*! The coarser levels of detail, from the most to the least detailed.
+   */
+  Model::LevelDataList levels;
+  /*! The material names, indexed by the material aliases used by the meshes.
+   */
+  std::map<String, String> materials;
+  /*! The name of the occluder mesh, or the empty string if none is used.
+   */
+  String occluderName;
+  /*! The vertex storage flags.
+   *  @sa ModelVertexFlags
+   */
+  uint vertexFlags;
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Model reader.
+ *  @ingroup renderer
+ *
+ *  Reads either XML model specifications or, for files with the @c wmdl
+ *  suffix, binary models as written by ModelWriter.  Binary models are
+ *  memory-mapped where supported.
+ */
 class ModelReader : public ResourceReader<Model>
 {
 public:
@@ -149,9 +342,26 @@ public:
   using ResourceReader<Model>::read;
   Ref<Model> read(const String& name, const Path& path);
 private:
+  Ref<Model> readBinary(const String& name, const Path& path);
   System& system;
 };
 
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Binary model writer.
+ *  @ingroup renderer
+ *
+ *  Writes models in a binary format holding interleaved vertices in the
+ *  format selected by the vertex flags of the model data, indices of a
+ *  pre-chosen width, section ranges, material names and precomputed bounds.
+ *  The data is stored in native byte order.
+ */
+class ModelWriter
+{
+public:
+  bool write(const Path& path, const ModelData& data);
+};
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace render*/
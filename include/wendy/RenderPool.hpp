@@ -31,6 +31,10 @@
 
 #include <wendy/GLTexture.hpp>
 #include <wendy/GLBuffer.hpp>
+#include <wendy/GLQuery.hpp>
+
+#include <mutex>
+#include <thread>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -43,6 +47,18 @@ namespace wendy
 
 /*! @brief Vertex pool.
  *  @ingroup renderer
+ *
+ *  Allocation is thread-safe.  Vertex data written from threads other than the
+ *  one that created the pool is staged in memory and uploaded by flush.  If
+ *  the existing buffers are full, such allocations reserve space in a new
+ *  buffer whose storage is created by flush.
+ *
+ *  If the context supports persistent buffers, each vertex format is served
+ *  from a single persistently mapped buffer used as a ring of per-frame
+ *  regions, guarded by fences.  Vertex data is then written directly into
+ *  buffer memory from any thread, and only the flush of written ranges needs
+ *  the context thread.  Allocations that do not fit the current region fall
+ *  back to regular buffers, and the ring is grown at the end of the frame.
  */
 class VertexPool : public Trackable, public RefObject
 {
@@ -56,6 +72,47 @@ public:
    *  current frame.
    */
   GL::VertexRange allocate(uint count, const VertexFormat& format);
+  /*! Allocates a range of temporary vertices of the specified format and
+   *  fills it with the specified vertex data.
+   *  @param[in] count The number of vertices to allocate.
+   *  @param[in] format The format of vertices to allocate.
+   *  @param[in] vertices The vertex data to copy into the range.
+   *  @return @c The newly allocated vertex range.
+   *
+   *  @remarks When called from a thread other than the one that created this
+   *  pool, the range is only valid for rendering after the next call to
+   *  flush.
+   */
+  GL::VertexRange allocate(uint count,
+                           const VertexFormat& format,
+                           const void* vertices);
+  /*! Allocates a range of temporary vertices of the specified format and
+   *  returns the address to which their data is to be written.  The data must
+   *  then be made visible with flush(range) before rendering.
+   *  @param[out] range The newly allocated vertex range.
+   *  @param[in] count The number of vertices to allocate.
+   *  @param[in] format The format of vertices to allocate.
+   *  @return The address of the vertex data, or @c nullptr if the allocation
+   *  failed.
+   *
+   *  @remarks For persistent pools this is mapped buffer memory, which should
+   *  only be written to.
+   */
+  void* map(GL::VertexRange& range, uint count, const VertexFormat& format);
+  /*! Makes the data written to the specified range, allocated with map,
+   *  visible to the GL.  When called from a thread other than the one that
+   *  created this pool, this is deferred until the next call to flush.
+   */
+  void flush(const GL::VertexRange& range);
+  /*! Creates the storage of vertex buffers reserved by other threads and
+   *  uploads the vertex data they staged.  This must be called on the thread
+   *  that created this pool, before rendering.
+   */
+  void flush();
+  /*! @return @c true if this pool uses persistently mapped buffers, or @c
+   *  false otherwise.
+   */
+  bool isPersistent() const { return m_persistent; }
   /*! @return The OpenGL context used by this pool.
    */
   GL::Context& context() const { return m_context; }
@@ -70,17 +127,128 @@ private:
   VertexPool(const VertexPool&) = delete;
   bool init(size_t granularity);
   VertexPool& operator = (const VertexPool&) = delete;
+  enum
+  {
+    REGION_COUNT = 3
+  };
+  /*! @internal
+   */
+  struct Ring
+  {
+    Ref<GL::VertexBuffer> buffer;
+    Ref<GL::Fence> fences[REGION_COUNT];
+    uint regionSize;
+    uint region;
+    uint used;
+    uint requested;
+    uint flushStart;
+    uint flushEnd;
+  };
   /*! @internal
    */
   struct Slot
   {
     Ref<GL::VertexBuffer> buffer;
     uint available;
+    std::vector<char> staging;
+    uint stagedStart;
+    uint stagedEnd;
+  };
+  /*! @internal
+   */
+  struct Shortfall
+  {
+    VertexFormat format;
+    uint count;
   };
+  bool allocateFromRing(GL::VertexRange& range,
+                        uint count,
+                        const VertexFormat& format,
+                        bool contextThread);
+  void* storageOf(const GL::VertexRange& range);
+  Ring* findRing(const VertexFormat& format);
+  Ring* findRing(const GL::VertexBuffer& buffer);
+  bool initRing(Ring& ring, uint count, const VertexFormat& format);
+  Slot* findSlot(uint count, const VertexFormat& format);
+  Slot* findSlot(const GL::VertexBuffer& buffer);
+  Slot* createSlot(uint count, const VertexFormat& format, bool contextThread);
   void onFrame();
   GL::Context& m_context;
   size_t m_granularity;
+  bool m_persistent;
+  std::vector<Ring> m_rings;
+  std::vector<Ring> m_retiredRings;
   std::vector<Slot> m_slots;
+  std::vector<Shortfall> m_shortfalls;
+  std::thread::id m_threadID;
+  std::mutex m_mutex;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Static geometry pool.
+ *  @ingroup renderer
+ *
+ *  Suballocates vertex and index ranges for static geometry from large shared
+ *  blocks, one kind per vertex format and index type, so that objects using
+ *  the same format can be drawn without rebinding buffers.  Indices are
+ *  relative to the start of their vertex range, which is used as the base
+ *  vertex of primitive ranges.
+ *
+ *  Blocks are not compacted; a block is reused once all ranges allocated from
+ *  it have been released.
+ */
+class GeometryPool : public RefObject
+{
+public:
+  /*! Allocates a range of vertices and a range of indices referencing them.
+   *  @param[out] vertices The newly allocated vertex range.
+   *  @param[out] indices The newly allocated index range.
+   *  @param[in] vertexCount The number of vertices to allocate.
+   *  @param[in] format The format of vertices to allocate.
+   *  @param[in] indexCount The number of indices to allocate.
+   *  @param[in] indexType The type of indices to allocate.
+   *  @return @c true if successful, or @c false otherwise.
+   */
+  bool allocate(GL::VertexRange& vertices,
+                GL::IndexRange& indices,
+                uint vertexCount,
+                const VertexFormat& format,
+                uint indexCount,
+                GL::IndexBufferType indexType);
+  /*! Releases the ranges allocated together with the specified vertex range.
+   */
+  void release(const GL::VertexRange& vertices);
+  /*! @return The OpenGL context used by this pool.
+   */
+  GL::Context& context() const { return m_context; }
+  /*! Creates a static geometry pool.
+   *  @param[in] context The OpenGL context to be used.
+   *  @param[in] granularity The desired number of vertices per block.
+   *  @return The newly created static geometry pool.
+   */
+  static Ref<GeometryPool> create(GL::Context& context, uint granularity = 65536);
+private:
+  GeometryPool(GL::Context& context, uint granularity);
+  GeometryPool(const GeometryPool&) = delete;
+  GeometryPool& operator = (const GeometryPool&) = delete;
+  /*! @internal
+   */
+  struct Block
+  {
+    Ref<GL::VertexBuffer> vertexBuffer;
+    Ref<GL::IndexBuffer> indexBuffer;
+    uint vertexCount;
+    uint indexCount;
+    uint allocationCount;
+  };
+  Block* createBlock(uint vertexCount,
+                     const VertexFormat& format,
+                     uint indexCount,
+                     GL::IndexBufferType indexType);
+  GL::Context& m_context;
+  uint m_granularity;
+  std::vector<Block> m_blocks;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -34,6 +34,14 @@
 
 namespace wendy
 {
+
+///////////////////////////////////////////////////////////////////////
+
+class Mesh;
+class ThreadPool;
+
+///////////////////////////////////////////////////////////////////////
+
   namespace render
   {
 
@@ -65,9 +73,29 @@ public:
   virtual void enqueue(Scene& scene,
                        const Camera& camera,
                        const Transform3& transform) const = 0;
+  /*! Queries this renderable for render operations, keeping the level of
+   *  detail of a single instance.  The default implementation ignores the
+   *  level.
+   *  @param[in,out] scene The render scene where the operations are to
+   *  be created.
+   *  @param[in] camera The camera for which operations are requested.
+   *  @param[in] transform The local-to-world transform.
+   *  @param[in,out] level The level of detail last used for this instance,
+   *  updated to the level used now.
+   */
+  virtual void enqueue(Scene& scene,
+                       const Camera& camera,
+                       const Transform3& transform,
+                       uint& level) const;
   /*! Returns the local space bounds of this renderable.
    */
   virtual Sphere bounds() const = 0;
+  /*! Returns the local space occluder mesh of this renderable, if any.
+   *
+   *  An occluder is a simplified mesh lying entirely within the visible
+   *  surface of this renderable, used to cull other renderables behind it.
+   */
+  virtual const Mesh* occluder() const;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -120,38 +148,54 @@ private:
 
 ///////////////////////////////////////////////////////////////////////
 
-#pragma pack(push, 1)
-
-/*! @ingroup renderer
+/*! @brief Render operation sort key.
+ *  @ingroup renderer
+ *
+ *  The sort value is 128 bits wide and split into a high and a low half.  The
+ *  high half packs, from most to least significant, an 8-bit layer and a
+ *  56-bit state, and the low half a 24-bit texture binding, a 16-bit state ID
+ *  and a 24-bit depth.  For opaque operations the state is Pass::sortState,
+ *  which holds a 24-bit program ID and a 32-bit render state index, and the
+ *  binding is Pass::sortBinding.  Each field is as wide as the range of IDs
+ *  it holds, as program and texture IDs are reused and cannot exceed the
+ *  number of existing programs and textures.  The index of the operation is
+ *  kept outside of the sort value.
  */
 class SortKey
 {
 public:
-  static SortKey makeOpaqueKey(uint8 layer, uint16 state, float depth);
+  static SortKey makeOpaqueKey(uint8 layer,
+                               uint64 state,
+                               uint64 binding,
+                               float depth);
   static SortKey makeBlendedKey(uint8 layer, float depth);
-  SortKey(): value(0) { }
-  SortKey(uint64 value): value(value) { }
-  operator uint64 () const { return value; }
-  union
+  SortKey(): high(0), low(0), index(0) { }
+  bool operator < (const SortKey& other) const
   {
-    uint64 value;
-    struct
-    {
-      unsigned index : 16;
-      unsigned depth : 24;
-      unsigned state : 16;
-      unsigned layer : 8;
-    };
-  };
+    if (high != other.high)
+      return high < other.high;
+    return low < other.low;
+  }
+  uint8 layer() const { return uint8(high >> 56); }
+  uint64 state() const { return high & 0xffffffffffffffull; }
+  uint64 binding() const { return low >> 24; }
+  uint32 depth() const { return uint32(low & 0xffffff); }
+  /*! The high half of the value to sort by.
+   */
+  uint64 high;
+  /*! The low half of the value to sort by.
+   */
+  uint64 low;
+  /*! The index of the operation in its queue.
+   */
+  uint32 index;
 };
 
-#pragma pack(pop)
-
 ///////////////////////////////////////////////////////////////////////
 
 /*! @ingroup renderer
  */
-typedef std::vector<uint64> SortKeyList;
+typedef std::vector<SortKey> SortKeyList;
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -159,7 +203,9 @@ typedef std::vector<uint64> SortKeyList;
  *  @ingroup renderer
  *
  *  This represents a single render operation, including render state, a
- *  primitive range and a local-to-world transformation.
+ *  primitive range and a local-to-world transformation.  The primitive range
+ *  and transformation are stored once in the scene, and shared by all passes
+ *  of a material using them.
  *
  *  @remarks Note that this class does not include any references to a camera.
  *  The camera transformation is handled by the Camera class.
@@ -170,16 +216,15 @@ public:
   /*! Constructor.
    */
   Operation();
-  /*! The primitive range to render.
-   */
-  GL::PrimitiveRange range;
   /*! The render technique to use.
    */
   const Pass* state;
-  /*! The local-to-world transformation.  Leave this set to identity if the
-   *  geometry already is in world space.
+  /*! The index of the primitive range to render in the scene.
+   */
+  uint32 range;
+  /*! The index of the local-to-world transformation in the scene.
    */
-  mat4 transform;
+  uint32 transform;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -193,10 +238,12 @@ typedef std::vector<Operation> OperationList;
 /*! @brief Render operation queue.
  *  @ingroup renderer
  *
+ *  Sort keys are sorted with a least significant digit radix sort.  If the
+ *  operations of a frame are added in the same order as in the previous frame,
+ *  the previous order is tried first and kept if it is still sorted.
+ *
  *  @remarks To avoid thrashing the heap, keep your queue objects around
  *  between frames when possible.
- *
- *  @remarks Each queue can only contain 65536 render operations.
  */
 class Queue
 {
@@ -207,19 +254,34 @@ public:
   /*! Adds a render operation in this render queue.
    */
   void addOperation(const Operation& operation, SortKey key);
+  /*! Appends the render operations of the specified queue to this queue,
+   *  merging their sort keys with the sort keys of this queue.
+   *  @param[in] other The queue to merge.
+   *  @param[in] rangeOffset The offset to add to primitive range indices.
+   *  @param[in] transformOffset The offset to add to transform indices.
+   */
+  void merge(const Queue& other, uint32 rangeOffset, uint32 transformOffset);
   /*! Destroys all render operations in this render queue.
    */
   void removeOperations();
   /*! @return The render operations in this render queue.
    */
   const OperationList& operations() const { return m_operations; }
-  /*! @return The sor keys in this render queue.
+  /*! @return The sorted keys in this render queue.
    */
   const SortKeyList& keys() const;
+  /*! @return The sorted keys in this render queue, sorted using the workers
+   *  of the specified thread pool if needed.
+   */
+  const SortKeyList& keys(ThreadPool& pool) const;
 private:
+  void sort(ThreadPool* pool) const;
   OperationList m_operations;
   mutable SortKeyList m_keys;
+  mutable SortKeyList m_scratch;
+  mutable std::vector<uint32> m_order;
   mutable bool m_sorted;
+  mutable bool m_insertionOrder;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -235,6 +297,21 @@ public:
                         const GL::PrimitiveRange& range,
                         const Material& material,
                         float depth);
+  /*! Stores a primitive range in this scene.
+   *  @return The index of the range, for use by operations.
+   */
+  uint32 addRange(const GL::PrimitiveRange& range);
+  /*! Stores a local-to-world transformation in this scene.
+   *  @return The index of the transformation, for use by operations.
+   */
+  uint32 addTransform(const mat4& transform);
+  /*! Appends the render operations and lights of the specified scene to this
+   *  scene.  This is used to combine scenes filled on different threads.
+   */
+  void merge(const Scene& other);
+  /*! Destroys all render operations, and the primitive ranges and
+   *  transformations used by them.
+   */
   void removeOperations();
   void addLight(const LightData& light);
   void removeLights();
@@ -242,6 +319,8 @@ public:
   const vec3& ambientIntensity() const { return m_ambient; }
   void setAmbientIntensity(const vec3& newIntensity);
   VertexPool& vertexPool() const { return *m_pool; }
+  const std::vector<GL::PrimitiveRange>& ranges() const { return m_ranges; }
+  const std::vector<mat4>& transforms() const { return m_transforms; }
   Queue& opaqueQueue() { return m_opaqueQueue; }
   const Queue& opaqueQueue() const { return m_opaqueQueue; }
   Queue& blendedQueue() { return m_blendedQueue; }
@@ -253,6 +332,8 @@ private:
   Phase m_phase;
   Queue m_opaqueQueue;
   Queue m_blendedQueue;
+  std::vector<GL::PrimitiveRange> m_ranges;
+  std::vector<mat4> m_transforms;
   std::vector<LightData> m_lights;
   vec3 m_ambient;
 };
@@ -241,6 +241,9 @@ public:
    */
   ~ProgramState();
   /*! Applies this GLSL program state to the current context.
+   *
+   *  @remarks Uniform uploads are skipped if this state was the last one
+   *  applied to its program and has not been modified since.
    */
   void apply() const;
   bool hasUniformState(const char* name) const;
@@ -278,6 +281,10 @@ public:
    */
   void setProgram(GL::Program* newProgram);
   StateID ID() const { return m_ID; }
+protected:
+  /*! @return The textures of the non-shared samplers of this state.
+   */
+  const GL::TextureList& textures() const { return m_textures; }
 private:
   static StateID allocateID();
   static void releaseID(StateID ID);
@@ -289,11 +296,13 @@ private:
   const void* data(UniformStateIndex index, GL::UniformType type) const;
   typedef std::deque<StateID> IDQueue;
   StateID m_ID;
+  uint64 m_revision;
   Ref<GL::Program> m_program;
   std::vector<float> m_floats;
   GL::TextureList m_textures;
   static IDQueue m_usedIDs;
   static StateID m_nextID;
+  static uint64 m_nextRevision;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -309,9 +318,26 @@ private:
 class Pass : public ProgramState
 {
 public:
+  /*! Constructor.
+   */
+  Pass();
   /*! Applies this render state to the current context.
    */
   void apply() const;
+  /*! @return The packed descriptor of the render state of this pass.
+   */
+  uint64 descriptor() const { return m_descriptor; }
+  /*! @return The value by which to sort opaque operations using this pass.
+   *  This packs the ID of the program above the interned index of the render
+   *  state descriptor, so operations sharing programs and render states end
+   *  up together.
+   */
+  uint64 sortState() const;
+  /*! @return The value by which to sort opaque operations using this pass
+   *  within the same sort state.  This packs the ID of the first texture, or
+   *  zero if there is none, above the state ID.
+   */
+  uint64 sortBinding() const;
   /*! @return @c true if this render state uses any form of culling, otherwise
    *  @c false.
    */
@@ -451,7 +477,10 @@ public:
    */
   void setBlendFactors(GL::BlendFactor src, GL::BlendFactor dst);
 private:
+  void updateDescriptor();
   GL::RenderState m_data;
+  uint64 m_descriptor;
+  uint32 m_descriptorIndex;
 };
 
 ///////////////////////////////////////////////////////////////////////
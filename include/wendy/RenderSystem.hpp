@@ -51,6 +51,9 @@ public:
   ResourceCache& cache() const;
   GL::Context& context() const;
   VertexPool& vertexPool() const;
+  /*! @return The pool from which static geometry is allocated.
+   */
+  GeometryPool& geometryPool() const;
   Type type() const;
 protected:
   System(VertexPool& pool, Type type);
@@ -58,6 +61,7 @@ private:
   System(const System&) = delete;
   System& operator = (const System&) = delete;
   Ref<VertexPool> m_pool;
+  Ref<GeometryPool> m_geometryPool;
   Type m_type;
 };
 
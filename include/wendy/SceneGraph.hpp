@@ -39,6 +39,85 @@ namespace wendy
 ///////////////////////////////////////////////////////////////////////
 
 class Graph;
+class Node;
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Dynamic bounding volume tree.
+ *  @ingroup scene
+ *
+ *  This is the spatial index used by the scene graph to answer queries without
+ *  visiting every node.  Each proxy is stored as a loose (slightly enlarged)
+ *  axis-aligned box, so that small movements only require a containment check
+ *  rather than a re-insertion.  The tree is kept balanced by tree rotations on
+ *  insertion and removal.
+ */
+class BoundsTree
+{
+public:
+  /*! Constructor.
+   */
+  BoundsTree();
+  /*! Creates a proxy for the specified node.
+   *  @param[in] bounds The world space bounds of the node.
+   *  @param[in] node The node the proxy represents.
+   *  @return The ID of the newly created proxy.
+   */
+  int createProxy(const Sphere& bounds, Node* node);
+  /*! Destroys the specified proxy.
+   */
+  void destroyProxy(int proxyID);
+  /*! Updates the bounds of the specified proxy.
+   *  @return @c true if the proxy was re-inserted, or @c false if the new
+   *  bounds were still within its loose box.
+   */
+  bool moveProxy(int proxyID, const Sphere& bounds);
+  /*! Collects the nodes whose bounds intersect the specified sphere.
+   */
+  void query(const Sphere& sphere, std::vector<Node*>& nodes) const;
+  /*! Collects the nodes whose bounds intersect the specified frustum.
+   */
+  void query(const Frustum& frustum, std::vector<Node*>& nodes) const;
+  /*! Collects the nodes whose bounds are hit by the specified ray, ordered by
+   *  increasing hit distance.
+   */
+  void query(const Ray3& ray, std::vector<Node*>& nodes) const;
+  /*! Collects at most the specified number of nodes closest to the specified
+   *  point, ordered by increasing distance to their bounds.
+   */
+  void queryNearest(const vec3& point,
+                    uint count,
+                    std::vector<Node*>& nodes) const;
+  /*! @return The height of this tree, or zero if it is empty.
+   */
+  uint height() const;
+  /*! @return The number of proxies in this tree.
+   */
+  uint proxyCount() const { return m_proxyCount; }
+private:
+  class Entry
+  {
+  public:
+    bool isLeaf() const { return children[0] == -1; }
+    vec3 minimum;
+    vec3 maximum;
+    int parent;
+    int children[2];
+    int height;
+    Node* node;
+    Sphere bounds;
+  };
+  int allocateEntry();
+  void freeEntry(int entryID);
+  void insertLeaf(int leafID);
+  void removeLeaf(int leafID);
+  int balance(int entryID);
+  void setLooseBox(Entry& entry, const Sphere& bounds);
+  std::vector<Entry> m_entries;
+  int m_root;
+  int m_free;
+  uint m_proxyCount;
+};
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -47,6 +126,9 @@ class Graph;
  *
  *  This is the base class for all kinds of nodes in a scene graph. It provides
  *  local and world transforms, and a set of callbacks for scene graph events.
+ *
+ *  While a node is attached to a graph, its transforms and bounds are stored
+ *  in the contiguous arrays of that graph and the node acts as a handle.
  */
 class Node
 {
@@ -87,7 +169,7 @@ public:
   const std::vector<Node*>& children() const { return m_children; }
   /*! @return The local-to-parent transform of this scene node.
    */
-  const Transform3& localTransform() const { return m_local; }
+  const Transform3& localTransform() const;
   /*! Sets the local-to-parent transform of this scene node.
    */
   void setLocalTransform(const Transform3& newTransform);
@@ -125,8 +207,11 @@ protected:
   void enqueue(render::Scene& scene, const Camera& camera) const;
 private:
   Node(const Node&) = delete;
+  Transform3& local();
   void invalidateBounds();
   void invalidateWorldTransform();
+  void invalidateIndex();
+  Sphere worldBounds() const;
   Node& operator = (const Node&) = delete;
   void setGraph(Graph* newGraph);
   Node* m_parent;
@@ -140,6 +225,10 @@ private:
   mutable bool m_dirtyBounds;
   Ref<render::Renderable> m_renderable;
   Ref<Camera> m_camera;
+  int m_proxyID;
+  bool m_dirtyIndex;
+  int m_slot;
+  mutable uint m_level;
 };
 
 ///////////////////////////////////////////////////////////////////////
@@ -149,22 +238,95 @@ private:
  *
  *  This class represents a single scene graph, and is a logical tree root node,
  *  although it doesn't have a transform or bounds.
+ *
+ *  The local and world transforms and bounds of all attached nodes are kept in
+ *  contiguous arrays sorted in parent-before-child order, with a dirty bit per
+ *  node.  World transforms and total bounds are brought up to date by a single
+ *  linear pass over these arrays, instead of by recursion on every change.
+ *  Each root subtree occupies a contiguous range of the arrays.
  */
 class Graph
 {
   friend class Node;
 public:
+  Graph();
   ~Graph();
+  /*! Updates world transforms, total bounds and the spatial index, and
+   *  updates camera nodes.
+   */
   void update();
   void enqueue(render::Scene& scene, const Camera& camera) const;
+  /*! Enqueues the visible nodes of this scene graph using the workers of the
+   *  specified thread pool.  Each thread fills its own scene, and these are
+   *  then merged into the specified scene by sort key.
+   *
+   *  @remarks The renderables of all visible nodes must be safe to enqueue
+   *  from any thread.
+   */
+  void enqueue(render::Scene& scene, const Camera& camera, ThreadPool& pool) const;
+  /*! Collects all nodes whose world space bounds intersect the specified
+   *  sphere.
+   */
   void query(const Sphere& sphere, std::vector<Node*>& nodes) const;
+  /*! Collects all nodes whose world space bounds intersect the specified
+   *  frustum.
+   */
   void query(const Frustum& frustum, std::vector<Node*>& nodes) const;
+  /*! Collects all nodes whose world space bounds are hit by the specified
+   *  ray, ordered from nearest to farthest.
+   */
+  void query(const Ray3& ray, std::vector<Node*>& nodes) const;
+  /*! Collects at most the specified number of nodes nearest to the specified
+   *  point, ordered from nearest to farthest.
+   */
+  void queryNearest(const vec3& point,
+                    uint count,
+                    std::vector<Node*>& nodes) const;
   void addRootNode(Node& node);
   void destroyRootNodes();
   const std::vector<Node*>& roots() const { return m_roots; }
+  /*! @return The spatial index of this scene graph.
+   */
+  const BoundsTree& index() const;
+  /*! @return The occlusion buffer used when enqueueing, or @c nullptr if
+   *  occlusion culling is disabled.
+   */
+  OcclusionBuffer* occlusionBuffer() const { return m_occlusionBuffer; }
+  /*! Sets the occlusion buffer to use when enqueueing.  If set, the occluders
+   *  of all visible renderables are rasterized into it and nodes hidden behind
+   *  them are not enqueued.
+   *  @param[in] newBuffer The desired occlusion buffer, or @c nullptr to
+   *  disable occlusion culling.
+   */
+  void setOcclusionBuffer(OcclusionBuffer* newBuffer);
 private:
+  Graph(const Graph&) = delete;
+  void attachNode(Node& node);
+  void detachNode(Node& node);
+  const Transform3& worldTransform(const Node& node) const;
+  const Sphere& totalBounds(const Node& node) const;
+  void updateOrder() const;
+  void updateTransforms() const;
+  void updateIndex() const;
+  void cullOccluded(render::Scene& scene,
+                    const Camera& camera,
+                    std::vector<Node*>& nodes) const;
+  Graph& operator = (const Graph&) = delete;
   std::vector<Node*> m_roots;
   std::vector<Node*> m_updated;
+  mutable std::vector<Node*> m_nodes;
+  mutable std::vector<int> m_parents;
+  mutable std::vector<Transform3> m_locals;
+  mutable std::vector<Transform3> m_worlds;
+  mutable std::vector<Sphere> m_localBounds;
+  mutable std::vector<Sphere> m_totalBounds;
+  mutable std::vector<bool> m_dirtyWorlds;
+  mutable std::vector<bool> m_dirtyBounds;
+  mutable bool m_dirtyOrder;
+  mutable bool m_dirtyTransforms;
+  mutable std::vector<Node*> m_dirty;
+  mutable BoundsTree m_index;
+  Ref<OcclusionBuffer> m_occlusionBuffer;
 };
 
 ///////////////////////////////////////////////////////////////////////
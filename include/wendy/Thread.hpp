@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+#ifndef WENDY_THREAD_HPP
+#define WENDY_THREAD_HPP
+///////////////////////////////////////////////////////////////////////
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Pool of worker threads.
+ *
+ *  Tasks are run in submission order by the first available worker.  Tasks
+ *  must not touch the OpenGL context, as it is only current on the thread that
+ *  created it.
+ */
+class ThreadPool : public RefObject
+{
+public:
+  /*! Task function type.
+   */
+  typedef std::function<void ()> Task;
+  /*! Range function type.  The arguments are the first and one past the last
+   *  index of the range to process.
+   */
+  typedef std::function<void (size_t, size_t)> RangeTask;
+  /*! Destructor.  Waits for all submitted tasks to complete.
+   */
+  ~ThreadPool();
+  /*! Submits a task to be run on a worker thread.
+   */
+  void submit(const Task& task);
+  /*! Waits for all submitted tasks to complete.
+   */
+  void wait();
+  /*! Splits the specified number of items into contiguous ranges and runs the
+   *  specified function on them in parallel, using the workers and the calling
+   *  thread.  Returns when all ranges have been processed.  This must not be
+   *  called from within a task of the same pool.
+   *  @param[in] count The number of items to process.
+   *  @param[in] task The function to run on each range.
+   *  @param[in] granularity The smallest number of items worth giving to a
+   *  thread.
+   */
+  void parallelFor(size_t count, const RangeTask& task, size_t granularity = 1);
+  /*! @return The number of worker threads in this pool.
+   */
+  uint workerCount() const { return (uint) m_threads.size(); }
+  /*! Creates a thread pool.
+   *  @param[in] workerCount The desired number of worker threads, or zero to
+   *  use one less than the number of hardware threads.
+   *  @return The newly created thread pool.
+   */
+  static Ref<ThreadPool> create(uint workerCount = 0);
+private:
+  ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  bool init(uint workerCount);
+  void run();
+  ThreadPool& operator = (const ThreadPool&) = delete;
+  std::vector<std::thread> m_threads;
+  std::deque<Task> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_taskCondition;
+  std::condition_variable m_idleCondition;
+  uint m_running;
+  bool m_stopping;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
+#endif /*WENDY_THREAD_HPP*/
+///////////////////////////////////////////////////////////////////////
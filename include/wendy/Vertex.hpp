@@ -26,11 +26,52 @@
 #define WENDY_VERTEX_HPP
 ///////////////////////////////////////////////////////////////////////
 
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////
+
 namespace wendy
 {
 
 ///////////////////////////////////////////////////////////////////////
 
+/*! @brief Vertex component storage type.
+ *
+ *  Each type has a character used for it in vertex format specifications.
+ */
+enum VertexComponentType
+{
+  /*! 32-bit floating point, @c f.
+   */
+  VERTEX_FLOAT,
+  /*! 16-bit floating point, @c h.
+   */
+  VERTEX_HALF,
+  /*! Signed normalized 8-bit integer, @c b.
+   */
+  VERTEX_BYTE_NORM,
+  /*! Unsigned normalized 8-bit integer, @c B.
+   */
+  VERTEX_UBYTE_NORM,
+  /*! Signed normalized 16-bit integer, @c s.
+   */
+  VERTEX_SHORT_NORM,
+  /*! Unsigned normalized 16-bit integer, @c S.
+   */
+  VERTEX_USHORT_NORM,
+  /*! Signed normalized 10:10:10:2 integers packed into 32 bits, @c p.
+   *  Components of this type must have four elements.
+   */
+  VERTEX_PACKED,
+  /*! Unit vector octahedral-encoded into two signed normalized 16-bit
+   *  integers, @c o.  Components of this type must have two elements, and
+   *  programs must decode the vector themselves.
+   */
+  VERTEX_OCTAHEDRAL
+};
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief Vertex format component descriptor.
  *
  *  This class describes a single logical component of a vertex format.
@@ -42,37 +83,210 @@ class VertexComponent
 public:
   /*! Constructor.
    */
-  VertexComponent(const char* name, size_t count);
+  VertexComponent(const char* name,
+                  size_t count,
+                  VertexComponentType type = VERTEX_FLOAT);
   /*! Equality operator.
    */
   bool operator == (const VertexComponent& other) const
   {
-    return m_name == other.m_name && m_count == other.m_count;
+    return m_nameID == other.m_nameID &&
+           m_count == other.m_count &&
+           m_type == other.m_type;
   }
   /*! Inequality operator.
    */
   bool operator != (const VertexComponent& other) const
   {
-    return m_name != other.m_name || m_count != other.m_count;
+    return !(*this == other);
   }
+  /*! Converts the specified values to the storage type of this component
+   *  and writes them to the specified location.
+   *  @param[out] target The location of this component in a vertex.
+   *  @param[in] source The values to convert, one per element, except for
+   *  octahedral components, which take a three element unit vector.
+   */
+  void store(void* target, const float* source) const;
   /*! @return The size, in bytes, of this component.
    */
-  size_t size() const { return m_count * sizeof(float); }
+  size_t size() const;
+  /*! @return The storage type of this component.
+   */
+  VertexComponentType type() const { return m_type; }
+  /*! @return @c true if the elements of this component are stored as
+   *  normalized integers.
+   */
+  bool isNormalized() const;
   /*! @return The name of this component.
    */
   const String& name() const { return m_name; }
+  /*! @return The interned ID of the name of this component.
+   */
+  NameID nameID() const { return m_nameID; }
   /*! @return The offset, in bytes, of this component in a vertex.
    */
   size_t offset() const { return m_offset; }
   /*! @return The number of elements in this component.
    */
   size_t elementCount() const { return m_count; }
+  /*! @return The vertex format specification character of the specified
+   *  storage type.
+   */
+  static char typeCharacter(VertexComponentType type);
 private:
   String m_name;
+  NameID m_nameID;
   size_t m_count;
   size_t m_offset;
+  VertexComponentType m_type;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+const uint64 VERTEX_HASH_BASIS = 0xcbf29ce484222325ull;
+const uint64 VERTEX_HASH_PRIME = 0x100000001b3ull;
+
+/*! @return The size, in bytes, of a vertex component of the specified
+ *  element count and storage type.
+ */
+constexpr size_t vertexComponentSize(size_t count, VertexComponentType type)
+{
+  return type == VERTEX_FLOAT ? count * 4 :
+         type == VERTEX_PACKED ? 4 :
+         type == VERTEX_BYTE_NORM || type == VERTEX_UBYTE_NORM ? count :
+         count * 2;
+}
+
+/*! @return The specified layout hash updated with the bytes of the specified
+ *  string, including its terminator.
+ */
+constexpr uint64 vertexHashString(const char* string, uint64 hash)
+{
+  return *string ? vertexHashString(string + 1, (hash ^ uint8(*string)) * VERTEX_HASH_PRIME) :
+                   hash * VERTEX_HASH_PRIME;
+}
+
+/*! @return The specified layout hash updated with the specified vertex
+ *  component.  The offset is implied by the preceding components.
+ */
+constexpr uint64 vertexHashComponent(const char* name,
+                                     size_t count,
+                                     VertexComponentType type,
+                                     uint64 hash)
+{
+  return (((vertexHashString(name, hash) ^ count) * VERTEX_HASH_PRIME) ^ uint(type)) * VERTEX_HASH_PRIME;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Compile-time vertex component description.
+ */
+class VertexComponentInfo
+{
+public:
+  constexpr VertexComponentInfo(const char* initName,
+                                size_t initCount,
+                                VertexComponentType initType,
+                                size_t initOffset):
+    name(initName),
+    count(initCount),
+    type(initType),
+    offset(initOffset)
+  {
+  }
+  /*! @return @c true if the element count of this component is valid for its
+   *  storage type.
+   */
+  constexpr bool isValid() const
+  {
+    return type == VERTEX_PACKED ? count == 4 :
+           type == VERTEX_OCTAHEDRAL ? count == 2 :
+           count >= 1 && count <= 4;
+  }
+  constexpr size_t size() const { return vertexComponentSize(count, type); }
+  const char* name;
+  size_t count;
+  VertexComponentType type;
+  size_t offset;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Compile-time vertex layout description.
+ *
+ *  Vertex structs declare their layout through a static constexpr function
+ *  returning one of these, with offsets taken from @c offsetof, for example:
+ *
+ *  @code
+ *  static constexpr VertexLayout<2> layout()
+ *  {
+ *    return {{ WENDY_VERTEX_COMPONENT(Vertex2ft2fv, texcoord, "vTexCoord", 2, VERTEX_FLOAT),
+ *              WENDY_VERTEX_COMPONENT(Vertex2ft2fv, position, "vPosition", 2, VERTEX_FLOAT) },
+ *            sizeof(Vertex2ft2fv)};
+ *  }
+ *  @endcode
+ *
+ *  The layout can then be checked with @c static_assert after the struct,
+ *  and a VertexFormat created from it without parsing a specification.
+ */
+template <size_t N>
+class VertexLayout
+{
+public:
+  /*! @return The layout hash of this layout, which is equal to the hash of
+   *  any VertexFormat with the same components.
+   */
+  constexpr uint64 hash() const { return hashComponents(0, VERTEX_HASH_BASIS); }
+  /*! @return @c true if the components of this layout are valid, tightly
+   *  packed in declaration order and cover the entire vertex, as is
+   *  required by VertexFormat.
+   */
+  constexpr bool isValid() const { return isValid(0, 0); }
+  /*! @return @c true if this layout has a component with the specified name
+   *  and element count.
+   */
+  constexpr bool contains(const char* name, size_t count) const
+  {
+    return contains(0, name, count);
+  }
+  /*! @return The number of components in this layout.
+   */
+  constexpr size_t count() const { return N; }
+  VertexComponentInfo components[N];
+  size_t size;
+private:
+  constexpr uint64 hashComponents(size_t index, uint64 hash) const
+  {
+    return index == N ? hash :
+           hashComponents(index + 1, vertexHashComponent(components[index].name,
+                                                         components[index].count,
+                                                         components[index].type,
+                                                         hash));
+  }
+  constexpr bool isValid(size_t index, size_t offset) const
+  {
+    return index == N ? offset == size :
+           components[index].isValid() &&
+           components[index].offset == offset &&
+           isValid(index + 1, offset + components[index].size());
+  }
+  constexpr bool contains(size_t index, const char* name, size_t count) const
+  {
+    return index == N ? false :
+           (equals(components[index].name, name) && components[index].count == count) ||
+           contains(index + 1, name, count);
+  }
+  static constexpr bool equals(const char* a, const char* b)
+  {
+    return *a == *b && (*a == '\0' || equals(a + 1, b + 1));
+  }
 };
 
+/*! Creates a VertexComponentInfo for the specified member of a vertex struct.
+ */
+#define WENDY_VERTEX_COMPONENT(type, member, name, count, componentType) \
+  VertexComponentInfo(name, count, componentType, offsetof(type, member))
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Vertex format descriptor.
@@ -82,6 +296,14 @@ private:
  *
  *  It allows the renderer to work with vertex buffers of (almost) arbitrary
  *  layout without client intervention.
+ *
+ *  A specification is a space separated list of components, each written as
+ *  its element count, its type character and its name, for example
+ *  @c "3f:vPosition 4p:vNormal 2h:vTexCoord".
+ *
+ *  Each format keeps a 64-bit hash of its layout, so comparing formats is a
+ *  single integer comparison.  Formats for vertex structs are best created
+ *  from a compile-time VertexLayout.
  */
 class VertexFormat
 {
@@ -94,30 +316,66 @@ public:
    *  @remarks This will throw if the specification is syntactically malformed.
    */
   explicit VertexFormat(const char* specification);
-  bool createComponent(const char* name, size_t count);
+  /*! Constructor.  Creates components according to the specified
+   *  compile-time layout.
+   */
+  template <size_t N>
+  explicit VertexFormat(const VertexLayout<N>& layout);
+  bool createComponent(const char* name,
+                       size_t count,
+                       VertexComponentType type = VERTEX_FLOAT);
   bool createComponents(const char* specification);
   void destroyComponents();
   const VertexComponent* findComponent(const char* name) const;
+  const VertexComponent* findComponent(NameID nameID) const;
   const std::vector<VertexComponent>& components() const { return m_components; }
-  bool operator == (const VertexFormat& other) const;
-  bool operator != (const VertexFormat& other) const;
+  bool operator == (const VertexFormat& other) const { return m_hash == other.m_hash; }
+  bool operator != (const VertexFormat& other) const { return m_hash != other.m_hash; }
   String asString() const;
-  size_t size() const;
+  /*! @return The size, in bytes, of a vertex in this format.
+   */
+  size_t size() const { return m_size; }
+  /*! @return The layout hash of this format.
+   */
+  uint64 hash() const { return m_hash; }
 private:
   std::vector<VertexComponent> m_components;
+  size_t m_size;
+  uint64 m_hash;
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+template <size_t N>
+inline VertexFormat::VertexFormat(const VertexLayout<N>& layout):
+  m_size(0),
+  m_hash(VERTEX_HASH_BASIS)
+{
+  for (auto& c : layout.components)
+  {
+    if (!createComponent(c.name, c.count, c.type))
+      throw Exception("Invalid vertex layout");
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+
 /*! @brief Predefined vertex format.
  */
 class Vertex3fv
 {
 public:
   vec3 position;
+  static constexpr VertexLayout<1> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex3fv, position, "vPosition", 3, VERTEX_FLOAT) },
+            sizeof(Vertex3fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex3fv::layout().isValid(), "Invalid Vertex3fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -127,9 +385,17 @@ class Vertex3fn3fv
 public:
   vec3 normal;
   vec3 position;
+  static constexpr VertexLayout<2> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex3fn3fv, normal, "vNormal", 3, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex3fn3fv, position, "vPosition", 3, VERTEX_FLOAT) },
+            sizeof(Vertex3fn3fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex3fn3fv::layout().isValid(), "Invalid Vertex3fn3fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -138,9 +404,16 @@ class Vertex2fv
 {
 public:
   vec2 position;
+  static constexpr VertexLayout<1> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex2fv, position, "vPosition", 2, VERTEX_FLOAT) },
+            sizeof(Vertex2fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex2fv::layout().isValid(), "Invalid Vertex2fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -150,9 +423,17 @@ class Vertex2ft2fv
 public:
   vec2 texcoord;
   vec2 position;
+  static constexpr VertexLayout<2> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex2ft2fv, texcoord, "vTexCoord", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex2ft2fv, position, "vPosition", 2, VERTEX_FLOAT) },
+            sizeof(Vertex2ft2fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex2ft2fv::layout().isValid(), "Invalid Vertex2ft2fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -162,9 +443,17 @@ class Vertex2ft3fv
 public:
   vec2 texcoord;
   vec3 position;
+  static constexpr VertexLayout<2> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex2ft3fv, texcoord, "vTexCoord", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex2ft3fv, position, "vPosition", 3, VERTEX_FLOAT) },
+            sizeof(Vertex2ft3fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex2ft3fv::layout().isValid(), "Invalid Vertex2ft3fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -175,9 +464,18 @@ public:
   vec4 color;
   vec2 texcoord;
   vec3 position;
+  static constexpr VertexLayout<3> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex4fc2ft3fv, color, "vColor", 4, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex4fc2ft3fv, texcoord, "vTexCoord", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex4fc2ft3fv, position, "vPosition", 3, VERTEX_FLOAT) },
+            sizeof(Vertex4fc2ft3fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex4fc2ft3fv::layout().isValid(), "Invalid Vertex4fc2ft3fv vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 /*! @brief Predefined vertex format.
@@ -188,9 +486,41 @@ public:
   vec3 normal;
   vec2 texcoord;
   vec3 position;
+  static constexpr VertexLayout<3> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(Vertex3fn2ft3fv, normal, "vNormal", 3, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex3fn2ft3fv, texcoord, "vTexCoord", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(Vertex3fn2ft3fv, position, "vPosition", 3, VERTEX_FLOAT) },
+            sizeof(Vertex3fn2ft3fv)};
+  }
   static const VertexFormat format;
 };
 
+static_assert(Vertex3fn2ft3fv::layout().isValid(), "Invalid Vertex3fn2ft3fv vertex layout");
+
+///////////////////////////////////////////////////////////////////////
+
+/*! @brief Predefined per-instance vertex format.
+ *
+ *  Holds the model matrix of a single instance, one column per component.
+ */
+class InstanceTransform
+{
+public:
+  mat4 transform;
+  static constexpr VertexLayout<4> layout()
+  {
+    return {{ VertexComponentInfo("vModel0", 4, VERTEX_FLOAT, offsetof(InstanceTransform, transform)),
+              VertexComponentInfo("vModel1", 4, VERTEX_FLOAT, offsetof(InstanceTransform, transform) + 16),
+              VertexComponentInfo("vModel2", 4, VERTEX_FLOAT, offsetof(InstanceTransform, transform) + 32),
+              VertexComponentInfo("vModel3", 4, VERTEX_FLOAT, offsetof(InstanceTransform, transform) + 48) },
+            sizeof(InstanceTransform)};
+  }
+  static const VertexFormat format;
+};
+
+static_assert(InstanceTransform::layout().isValid(), "Invalid InstanceTransform vertex layout");
+
 ///////////////////////////////////////////////////////////////////////
 
 } /*namespace wendy*/
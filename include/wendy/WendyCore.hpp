@@ -32,6 +32,7 @@
 #include <wendy/Bimap.hpp>
 #include <wendy/Signal.hpp>
 #include <wendy/Timer.hpp>
+#include <wendy/Thread.hpp>
 #include <wendy/Profile.hpp>
 
 #include <wendy/Transform.hpp>
@@ -50,6 +51,7 @@
 
 #include <wendy/Image.hpp>
 #include <wendy/Mesh.hpp>
+#include <wendy/Occlusion.hpp>
 #include <wendy/Face.hpp>
 
 ///////////////////////////////////////////////////////////////////////
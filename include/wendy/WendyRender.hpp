@@ -39,6 +39,7 @@
 #include <wendy/RenderSystem.hpp>
 #include <wendy/RenderMaterial.hpp>
 #include <wendy/RenderScene.hpp>
+#include <wendy/RenderCommand.hpp>
 #include <wendy/RenderSprite.hpp>
 #include <wendy/RenderModel.hpp>
 
@@ -0,0 +1,824 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+#include <wendy/Core.hpp>
+#include <wendy/Path.hpp>
+#include <wendy/Rect.hpp>
+#include <wendy/Pixel.hpp>
+#include <wendy/Resource.hpp>
+#include <wendy/Image.hpp>
+
+#include <internal/BlockCompression.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define WENDY_BLOCK_SSE2 1
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/* The pixels of a color block, in planar form for the index search.
+ */
+class ColorBlock
+{
+public:
+  ColorBlock(const uint8* pixels, bool alpha);
+  float r[16];
+  float g[16];
+  float b[16];
+  bool transparent[16];
+  uint opaqueCount;
+};
+
+/* An encoded BC1 color block and its squared error.
+ */
+class ColorCandidate
+{
+public:
+  ColorCandidate();
+  void store(uint8* target) const;
+  uint16 color0;
+  uint16 color1;
+  uint8 indices[16];
+  float error;
+};
+
+ColorBlock::ColorBlock(const uint8* pixels, bool alpha):
+  opaqueCount(0)
+{
+  for (uint i = 0;  i < 16;  i++)
+  {
+    r[i] = pixels[i * 4 + 0];
+    g[i] = pixels[i * 4 + 1];
+    b[i] = pixels[i * 4 + 2];
+    transparent[i] = alpha && pixels[i * 4 + 3] < 128;
+
+    if (!transparent[i])
+      opaqueCount++;
+  }
+}
+
+ColorCandidate::ColorCandidate():
+  color0(0),
+  color1(0),
+  error(std::numeric_limits<float>::max())
+{
+  std::memset(indices, 0, sizeof(indices));
+}
+
+void ColorCandidate::store(uint8* target) const
+{
+  target[0] = uint8(color0 & 0xff);
+  target[1] = uint8(color0 >> 8);
+  target[2] = uint8(color1 & 0xff);
+  target[3] = uint8(color1 >> 8);
+
+  for (uint y = 0;  y < 4;  y++)
+  {
+    target[4 + y] = uint8(indices[y * 4 + 0] |
+                          (indices[y * 4 + 1] << 2) |
+                          (indices[y * 4 + 2] << 4) |
+                          (indices[y * 4 + 3] << 6));
+  }
+}
+
+uint16 packColor(const vec3& color)
+{
+  const vec3 c = clamp(color, vec3(0.f), vec3(255.f));
+
+  const uint r = uint(c.r * 31.f / 255.f + 0.5f);
+  const uint g = uint(c.g * 63.f / 255.f + 0.5f);
+  const uint b = uint(c.b * 31.f / 255.f + 0.5f);
+
+  return uint16((r << 11) | (g << 5) | b);
+}
+
+vec3 unpackColor(uint16 color)
+{
+  const uint r = (color >> 11) & 31;
+  const uint g = (color >> 5) & 63;
+  const uint b = color & 31;
+
+  return vec3(float((r << 3) | (r >> 2)),
+              float((g << 2) | (g >> 4)),
+              float((b << 3) | (b >> 2)));
+}
+
+/* Finds the nearest of the first count palette entries for each pixel and
+ * returns the total squared error of the opaque pixels.  Transparent pixels
+ * are given index three.
+ */
+float findColorIndices(uint8* indices,
+                       const ColorBlock& block,
+                       const vec3* palette,
+                       uint count)
+{
+  float errors[16];
+
+#if WENDY_BLOCK_SSE2
+  for (uint i = 0;  i < 16;  i += 4)
+  {
+    const __m128 r = _mm_loadu_ps(block.r + i);
+    const __m128 g = _mm_loadu_ps(block.g + i);
+    const __m128 b = _mm_loadu_ps(block.b + i);
+
+    __m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128i bestIndex = _mm_setzero_si128();
+
+    for (uint j = 0;  j < count;  j++)
+    {
+      const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[j].r));
+      const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[j].g));
+      const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[j].b));
+
+      const __m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr),
+                                                 _mm_mul_ps(dg, dg)),
+                                      _mm_mul_ps(db, db));
+
+      const __m128i less = _mm_castps_si128(_mm_cmplt_ps(error, best));
+      bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(int(j))),
+                               _mm_andnot_si128(less, bestIndex));
+      best = _mm_min_ps(error, best);
+    }
+
+    int32 selected[4];
+    _mm_storeu_si128((__m128i*) selected, bestIndex);
+    _mm_storeu_ps(errors + i, best);
+
+    for (uint k = 0;  k < 4;  k++)
+      indices[i + k] = uint8(selected[k]);
+  }
+#else
+  for (uint i = 0;  i < 16;  i++)
+  {
+    errors[i] = std::numeric_limits<float>::max();
+
+    for (uint j = 0;  j < count;  j++)
+    {
+      const float dr = block.r[i] - palette[j].r;
+      const float dg = block.g[i] - palette[j].g;
+      const float db = block.b[i] - palette[j].b;
+      const float error = dr * dr + dg * dg + db * db;
+
+      if (error < errors[i])
+      {
+        errors[i] = error;
+        indices[i] = uint8(j);
+      }
+    }
+  }
+#endif
+
+  float total = 0.f;
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    if (block.transparent[i])
+      indices[i] = 3;
+    else
+      total += errors[i];
+  }
+
+  return total;
+}
+
+/* Encodes the specified endpoints in the specified mode and keeps the result
+ * if it is better than the current candidate.  In four color mode the first
+ * packed color must be greater and in three color mode it must not be.
+ */
+void tryColorEndpoints(ColorCandidate& best,
+                       const ColorBlock& block,
+                       const vec3& a,
+                       const vec3& b,
+                       bool fourColor,
+                       bool alpha)
+{
+  ColorCandidate candidate;
+  candidate.color0 = packColor(a);
+  candidate.color1 = packColor(b);
+
+  if (fourColor ? candidate.color0 < candidate.color1
+                : candidate.color0 > candidate.color1)
+  {
+    std::swap(candidate.color0, candidate.color1);
+  }
+
+  vec3 palette[4];
+  palette[0] = unpackColor(candidate.color0);
+  palette[1] = unpackColor(candidate.color1);
+
+  uint count = 4;
+
+  if (fourColor)
+  {
+    // Equal endpoints select three color mode, where the first two entries
+    // are still exact, so only those are used
+    if (candidate.color0 == candidate.color1)
+      count = 1;
+
+    palette[2] = (palette[0] * 2.f + palette[1]) / 3.f;
+    palette[3] = (palette[0] + palette[1] * 2.f) / 3.f;
+  }
+  else
+  {
+    palette[2] = (palette[0] + palette[1]) / 2.f;
+    palette[3] = vec3(0.f);
+
+    // The fourth entry is transparent black in blocks with alpha
+    if (alpha)
+      count = 3;
+  }
+
+  candidate.error = findColorIndices(candidate.indices, block, palette, count);
+
+  if (candidate.error < best.error)
+    best = candidate;
+}
+
+/* Solves for the endpoints that minimize the squared error of the specified
+ * candidate's index assignment.  Returns false if the system is singular.
+ */
+bool solveColorEndpoints(vec3& a,
+                         vec3& b,
+                         const ColorBlock& block,
+                         const ColorCandidate& candidate)
+{
+  const bool fourColor = candidate.color0 > candidate.color1;
+
+  float aa = 0.f, bb = 0.f, ab = 0.f;
+  vec3 ax(0.f), bx(0.f);
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    if (block.transparent[i])
+      continue;
+
+    float weight;
+
+    switch (candidate.indices[i])
+    {
+      case 0:
+        weight = 1.f;
+        break;
+      case 1:
+        weight = 0.f;
+        break;
+      case 2:
+        weight = fourColor ? 2.f / 3.f : 0.5f;
+        break;
+      default:
+      {
+        // Black in three color mode does not depend on the endpoints
+        if (!fourColor)
+          continue;
+
+        weight = 1.f / 3.f;
+        break;
+      }
+    }
+
+    const vec3 pixel(block.r[i], block.g[i], block.b[i]);
+
+    aa += weight * weight;
+    bb += (1.f - weight) * (1.f - weight);
+    ab += weight * (1.f - weight);
+    ax += pixel * weight;
+    bx += pixel * (1.f - weight);
+  }
+
+  const float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f)
+    return false;
+
+  a = (ax * bb - bx * ab) / det;
+  b = (bx * aa - ax * ab) / det;
+  return true;
+}
+
+void encodeColorBlock(uint8* target,
+                      const uint8* pixels,
+                      bool alpha,
+                      bool forceFourColor,
+                      CompressionQuality quality)
+{
+  const ColorBlock block(pixels, alpha);
+
+  ColorCandidate best;
+
+  if (block.opaqueCount == 0)
+  {
+    // Fully transparent, so any three color mode block will do
+    best.color0 = 0;
+    best.color1 = 0;
+    std::memset(best.indices, 3, sizeof(best.indices));
+    best.store(target);
+    return;
+  }
+
+  vec3 mean(0.f), minimum(255.f), maximum(0.f);
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    if (block.transparent[i])
+      continue;
+
+    const vec3 pixel(block.r[i], block.g[i], block.b[i]);
+    mean += pixel;
+    minimum = min(minimum, pixel);
+    maximum = max(maximum, pixel);
+  }
+
+  mean /= float(block.opaqueCount);
+
+  float cov[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    if (block.transparent[i])
+      continue;
+
+    const vec3 d = vec3(block.r[i], block.g[i], block.b[i]) - mean;
+    cov[0] += d.r * d.r;
+    cov[1] += d.r * d.g;
+    cov[2] += d.r * d.b;
+    cov[3] += d.g * d.g;
+    cov[4] += d.g * d.b;
+    cov[5] += d.b * d.b;
+  }
+
+  // Transparent pixels require three color mode, which BC3 cannot use
+  const bool transparent = block.opaqueCount < 16;
+  const bool fourColor = !transparent || forceFourColor;
+
+  vec3 a, b;
+
+  if (quality == COMPRESS_FASTEST)
+  {
+    // Bounding box diagonal, oriented by the covariance with the channel of
+    // largest extent and inset to reduce the error at the extremes
+    const vec3 extent = maximum - minimum;
+
+    uint axis = 0;
+    if (extent.g > extent[axis])
+      axis = 1;
+    if (extent.b > extent[axis])
+      axis = 2;
+
+    const uint covIndex[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+
+    a = maximum;
+    b = minimum;
+
+    for (uint c = 0;  c < 3;  c++)
+    {
+      if (cov[covIndex[axis][c]] < 0.f)
+        std::swap(a[c], b[c]);
+    }
+
+    const vec3 inset = (a - b) / 16.f;
+    a -= inset;
+    b += inset;
+  }
+  else
+  {
+    // Principal axis by power iteration, starting from the box diagonal
+    vec3 axis = maximum - minimum;
+    if (axis == vec3(0.f))
+      axis = vec3(1.f);
+
+    for (uint i = 0;  i < 8;  i++)
+    {
+      const vec3 next(cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                      cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                      cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+
+      const float scale = max(max(std::abs(next.r), std::abs(next.g)), std::abs(next.b));
+      if (scale < 1e-6f)
+        break;
+
+      axis = next / scale;
+    }
+
+    axis = normalize(axis);
+
+    float lowest = std::numeric_limits<float>::max();
+    float highest = -std::numeric_limits<float>::max();
+
+    for (uint i = 0;  i < 16;  i++)
+    {
+      if (block.transparent[i])
+        continue;
+
+      const float t = dot(vec3(block.r[i], block.g[i], block.b[i]) - mean, axis);
+      lowest = min(lowest, t);
+      highest = max(highest, t);
+    }
+
+    a = mean + axis * highest;
+    b = mean + axis * lowest;
+  }
+
+  tryColorEndpoints(best, block, a, b, fourColor, alpha);
+
+  if (quality == COMPRESS_BEST && !forceFourColor)
+  {
+    // Three color mode is sometimes better for opaque blocks as well, as it
+    // has an exact midpoint and black
+    tryColorEndpoints(best, block, a, b, false, alpha);
+  }
+
+  const uint iterations = quality == COMPRESS_BEST ? 8 :
+                          quality == COMPRESS_NORMAL ? 1 : 0;
+
+  for (uint i = 0;  i < iterations;  i++)
+  {
+    const float previous = best.error;
+    if (previous == 0.f)
+      break;
+
+    if (!solveColorEndpoints(a, b, block, best))
+      break;
+
+    tryColorEndpoints(best, block, a, b, best.color0 > best.color1 || forceFourColor, alpha);
+
+    if (best.error >= previous)
+      break;
+  }
+
+  best.store(target);
+}
+
+void buildAlphaPalette(uint8* palette, uint e0, uint e1)
+{
+  palette[0] = uint8(e0);
+  palette[1] = uint8(e1);
+
+  if (e0 > e1)
+  {
+    for (uint i = 1;  i < 7;  i++)
+      palette[i + 1] = uint8(((7 - i) * e0 + i * e1 + 3) / 7);
+  }
+  else
+  {
+    for (uint i = 1;  i < 5;  i++)
+      palette[i + 1] = uint8(((5 - i) * e0 + i * e1 + 2) / 5);
+
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+uint findAlphaIndices(uint8* indices, const uint8* values, uint e0, uint e1)
+{
+  uint8 palette[8];
+  buildAlphaPalette(palette, e0, e1);
+
+  uint total = 0;
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    uint best = std::numeric_limits<uint>::max();
+
+    for (uint j = 0;  j < 8;  j++)
+    {
+      const int difference = int(values[i]) - int(palette[j]);
+      const uint error = uint(difference * difference);
+
+      if (error < best)
+      {
+        best = error;
+        indices[i] = uint8(j);
+      }
+    }
+
+    total += best;
+  }
+
+  return total;
+}
+
+/* Encodes a single channel block, as used by BC3 alpha, BC4 and BC5.  The
+ * values are read with the specified stride.
+ */
+void encodeAlphaBlock(uint8* target,
+                      const uint8* source,
+                      size_t stride,
+                      CompressionQuality quality)
+{
+  uint8 values[16];
+  uint minimum = 255, maximum = 0;
+  uint innerMinimum = 255, innerMaximum = 0;
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    values[i] = source[i * stride];
+    minimum = std::min(minimum, uint(values[i]));
+    maximum = std::max(maximum, uint(values[i]));
+
+    if (values[i] != 0 && values[i] != 255)
+    {
+      innerMinimum = std::min(innerMinimum, uint(values[i]));
+      innerMaximum = std::max(innerMaximum, uint(values[i]));
+    }
+  }
+
+  uint8 indices[16], candidate[16];
+  uint e0 = maximum, e1 = minimum;
+
+  // Eight value mode requires the first endpoint to be greater, while equal
+  // endpoints select six value mode, where the first entry is still exact
+  uint error = findAlphaIndices(indices, values, e0, e1);
+
+  if (quality != COMPRESS_FASTEST && innerMinimum <= innerMaximum)
+  {
+    // Six value mode has exact zero and one, freeing the endpoints for the
+    // values in between
+    const uint sixError = findAlphaIndices(candidate, values, innerMinimum, innerMaximum);
+    if (sixError < error)
+    {
+      error = sixError;
+      e0 = innerMinimum;
+      e1 = innerMaximum;
+      std::memcpy(indices, candidate, sizeof(indices));
+    }
+  }
+
+  if (quality == COMPRESS_BEST && error > 0 && maximum > minimum)
+  {
+    // Search a small neighbourhood of the eight value mode endpoints
+    for (int d0 = -2;  d0 <= 2;  d0++)
+    {
+      for (int d1 = -2;  d1 <= 2;  d1++)
+      {
+        const int c0 = int(maximum) + d0;
+        const int c1 = int(minimum) + d1;
+
+        if (c0 > 255 || c1 < 0 || c0 <= c1)
+          continue;
+
+        const uint nearError = findAlphaIndices(candidate, values, c0, c1);
+        if (nearError < error)
+        {
+          error = nearError;
+          e0 = c0;
+          e1 = c1;
+          std::memcpy(indices, candidate, sizeof(indices));
+        }
+      }
+    }
+  }
+
+  target[0] = uint8(e0);
+  target[1] = uint8(e1);
+
+  uint64 bits = 0;
+
+  for (uint i = 0;  i < 16;  i++)
+    bits |= uint64(indices[i]) << (i * 3);
+
+  for (uint i = 0;  i < 6;  i++)
+    target[2 + i] = uint8(bits >> (i * 8));
+}
+
+void decodeColorBlock(uint8* pixels,
+                      const uint8* source,
+                      bool alpha,
+                      bool forceFourColor)
+{
+  const uint16 color0 = uint16(source[0] | (source[1] << 8));
+  const uint16 color1 = uint16(source[2] | (source[3] << 8));
+
+  const vec3 c0 = unpackColor(color0);
+  const vec3 c1 = unpackColor(color1);
+
+  uint8 palette[4][4];
+
+  for (uint c = 0;  c < 3;  c++)
+  {
+    const uint p0 = uint(c0[c]), p1 = uint(c1[c]);
+
+    palette[0][c] = uint8(p0);
+    palette[1][c] = uint8(p1);
+
+    if (color0 > color1 || forceFourColor)
+    {
+      palette[2][c] = uint8((2 * p0 + p1 + 1) / 3);
+      palette[3][c] = uint8((p0 + 2 * p1 + 1) / 3);
+    }
+    else
+    {
+      palette[2][c] = uint8((p0 + p1) / 2);
+      palette[3][c] = 0;
+    }
+  }
+
+  palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+  if (color0 <= color1 && !forceFourColor && alpha)
+    palette[3][3] = 0;
+
+  for (uint i = 0;  i < 16;  i++)
+  {
+    const uint index = (source[4 + i / 4] >> ((i % 4) * 2)) & 3;
+    std::memcpy(pixels + i * 4, palette[index], 4);
+  }
+}
+
+void decodeAlphaBlock(uint8* target, size_t stride, const uint8* source)
+{
+  uint8 palette[8];
+  buildAlphaPalette(palette, source[0], source[1]);
+
+  uint64 bits = 0;
+
+  for (uint i = 0;  i < 6;  i++)
+    bits |= uint64(source[2 + i]) << (i * 8);
+
+  for (uint i = 0;  i < 16;  i++)
+    target[i * stride] = palette[(bits >> (i * 3)) & 7];
+}
+
+void flipColorBlock(uint8* block, uint rows)
+{
+  std::reverse(block + 4, block + 4 + rows);
+}
+
+void flipAlphaBlock(uint8* block, uint rows)
+{
+  uint64 bits = 0;
+
+  for (uint i = 0;  i < 6;  i++)
+    bits |= uint64(block[2 + i]) << (i * 8);
+
+  uint64 result = bits;
+
+  for (uint y = 0;  y < rows;  y++)
+  {
+    const uint64 row = (bits >> (y * 12)) & 0xfff;
+    const uint shift = (rows - 1 - y) * 12;
+
+    result &= ~(uint64(0xfff) << shift);
+    result |= row << shift;
+  }
+
+  for (uint i = 0;  i < 6;  i++)
+    block[2 + i] = uint8(result >> (i * 8));
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+void encodeBlock(uint8* target,
+                 const uint8* pixels,
+                 const PixelFormat& format,
+                 CompressionQuality quality)
+{
+  switch (format.type())
+  {
+    case PixelFormat::BC1:
+    {
+      encodeColorBlock(target,
+                       pixels,
+                       format.semantic() == PixelFormat::RGBA,
+                       false,
+                       quality);
+      break;
+    }
+
+    case PixelFormat::BC3:
+    {
+      encodeAlphaBlock(target, pixels + 3, 4, quality);
+      encodeColorBlock(target + 8, pixels, false, true, quality);
+      break;
+    }
+
+    case PixelFormat::BC4:
+    {
+      encodeAlphaBlock(target, pixels, 4, quality);
+      break;
+    }
+
+    case PixelFormat::BC5:
+    {
+      encodeAlphaBlock(target, pixels, 4, quality);
+      encodeAlphaBlock(target + 8, pixels + 1, 4, quality);
+      break;
+    }
+
+    default:
+      panic("Invalid block-compressed pixel format %s", format.asString().c_str());
+  }
+}
+
+void decodeBlock(uint8* pixels, const uint8* source, const PixelFormat& format)
+{
+  switch (format.type())
+  {
+    case PixelFormat::BC1:
+    {
+      decodeColorBlock(pixels,
+                       source,
+                       format.semantic() == PixelFormat::RGBA,
+                       false);
+      break;
+    }
+
+    case PixelFormat::BC3:
+    {
+      decodeColorBlock(pixels, source + 8, false, true);
+      decodeAlphaBlock(pixels + 3, 4, source);
+      break;
+    }
+
+    case PixelFormat::BC4:
+    {
+      std::memset(pixels, 0, 64);
+      decodeAlphaBlock(pixels, 4, source);
+
+      for (uint i = 0;  i < 16;  i++)
+        pixels[i * 4 + 3] = 255;
+
+      break;
+    }
+
+    case PixelFormat::BC5:
+    {
+      std::memset(pixels, 0, 64);
+      decodeAlphaBlock(pixels, 4, source);
+      decodeAlphaBlock(pixels + 1, 4, source + 8);
+
+      for (uint i = 0;  i < 16;  i++)
+        pixels[i * 4 + 3] = 255;
+
+      break;
+    }
+
+    default:
+      panic("Invalid block-compressed pixel format %s", format.asString().c_str());
+  }
+}
+
+void flipBlock(uint8* block, const PixelFormat& format, uint rows)
+{
+  switch (format.type())
+  {
+    case PixelFormat::BC1:
+      flipColorBlock(block, rows);
+      break;
+    case PixelFormat::BC3:
+      flipAlphaBlock(block, rows);
+      flipColorBlock(block + 8, rows);
+      break;
+    case PixelFormat::BC4:
+      flipAlphaBlock(block, rows);
+      break;
+    case PixelFormat::BC5:
+      flipAlphaBlock(block, rows);
+      flipAlphaBlock(block + 8, rows);
+      break;
+    default:
+      panic("Invalid block-compressed pixel format %s", format.asString().c_str());
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
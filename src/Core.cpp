@@ -31,6 +31,9 @@
 #include <exception>
 #include <sstream>
 #include <iostream>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 
 #include <cstdlib>
 #include <cstring>
@@ -48,6 +51,43 @@ namespace
 
 std::vector<LogConsumer*> consumers;
 
+class NameTable
+{
+public:
+  NameTable();
+  NameID find(const char* name, StringHash hash) const;
+  std::unordered_multimap<StringHash, NameID> IDs;
+  std::deque<String> names;
+  std::mutex mutex;
+};
+
+NameTable::NameTable()
+{
+  // Reserve the invalid ID
+  names.push_back(String());
+}
+
+NameID NameTable::find(const char* name, StringHash hash) const
+{
+  auto range = IDs.equal_range(hash);
+
+  for (auto i = range.first;  i != range.second;  i++)
+  {
+    if (names[i->second] == name)
+      return i->second;
+  }
+
+  return INVALID_NAME_ID;
+}
+
+NameTable& nameTable()
+{
+  // Constructed on first use, as names are interned during static
+  // initialization of vertex formats
+  static NameTable table;
+  return table;
+}
+
 } /*namespace*/
 
 ///////////////////////////////////////////////////////////////////////
@@ -234,6 +274,47 @@ StringHash hashString(const char* string)
   return hash;
 }
 
+NameID internName(const char* name)
+{
+  NameTable& table = nameTable();
+  const StringHash hash = hashString(name);
+
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  NameID ID = table.find(name, hash);
+  if (ID == INVALID_NAME_ID)
+  {
+    ID = NameID(table.names.size());
+    table.names.push_back(name);
+    table.IDs.insert(std::make_pair(hash, ID));
+  }
+
+  return ID;
+}
+
+NameID internName(const String& name)
+{
+  return internName(name.c_str());
+}
+
+NameID findName(const char* name)
+{
+  NameTable& table = nameTable();
+  const StringHash hash = hashString(name);
+
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return table.find(name, hash);
+}
+
+const String& nameString(NameID ID)
+{
+  NameTable& table = nameTable();
+
+  std::lock_guard<std::mutex> lock(table.mutex);
+  assert(ID < table.names.size());
+  return table.names[ID];
+}
+
 void logError(const char* format, ...)
 {
   va_list vl;
@@ -92,7 +92,7 @@ Interface::Interface(Window& window, UI::Drawer& drawer):
   root(nullptr)
 {
   root = new Panel(*this);
-  root->setArea(Rect(0.f, 0.f, 150.f, 220.f));
+  root->setArea(Rect(0.f, 0.f, 150.f, 300.f));
   addRootWidget(*root);
 
   UI::Layout* layout = new UI::Layout(*this, UI::VERTICAL, true);
@@ -117,11 +117,16 @@ void Interface::update()
 
     updateCountItem(ITEM_FRAMERATE, "fps", (size_t) (stats->frameRate() + 0.5f));
     updateCountItem(ITEM_STATECHANGES, "states / f", frame.stateChangeCount);
+    updateCountItem(ITEM_SAMESTATES, "same states / f", frame.skippedStateChangeCount);
     updateCountItem(ITEM_OPERATIONS, "operations / f", frame.operationCount);
     updateCountItem(ITEM_VERTICES, "vertices / f", frame.vertexCount);
     updateCountItem(ITEM_POINTS, "points / f", frame.pointCount);
     updateCountItem(ITEM_LINES, "lines / f", frame.lineCount);
     updateCountItem(ITEM_TRIANGLES, "triangles / f", frame.triangleCount);
+    updateCountItem(ITEM_OCCLUDED, "occluded / f", frame.occludedCount);
+    updateCountItem(ITEM_UNIFORMS, "uniforms / f", frame.uniformCount);
+    updateCountItem(ITEM_SKIPPED, "skipped / f",
+                    frame.skippedUniformCount + frame.skippedSamplerCount);
 
     updateCountItem(ITEM_PROGRAMS, "programs", stats->programCount());
     updateCountSizeItem(ITEM_TEXTURES,
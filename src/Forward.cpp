@@ -50,6 +50,20 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+bool isBatchable(const GL::PrimitiveRange& first, const GL::PrimitiveRange& other)
+{
+  return first.type() == other.type() &&
+         first.vertexBuffer() == other.vertexBuffer() &&
+         first.indexBuffer() == other.indexBuffer();
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
 Config::Config(render::VertexPool& initPool):
   pool(&initPool)
 {
@@ -61,6 +75,14 @@ void Renderer::render(const render::Scene& scene, const Camera& camera)
 {
   ProfileNodeCall call("forward::Renderer::render");
 
+  m_commands.removeCommands();
+  record(m_commands, scene);
+
+  render(m_commands, camera);
+}
+
+void Renderer::render(const render::CommandBuffer& commands, const Camera& camera)
+{
   context().setCurrentSharedProgramState(m_state);
 
   const Recti& viewportArea = context().viewportArea();
@@ -79,12 +101,19 @@ void Renderer::render(const render::Scene& scene, const Camera& camera)
                                  camera.farZ());
   }
 
-  renderOperations(scene.opaqueQueue());
-  renderOperations(scene.blendedQueue());
+  render::ContextTarget target(vertexPool(), *m_state);
+  commands.execute(target);
 
   context().setCurrentSharedProgramState(nullptr);
 }
 
+void Renderer::record(render::CommandBuffer& commands,
+                      const render::Scene& scene) const
+{
+  recordOperations(commands, scene, scene.opaqueQueue());
+  recordOperations(commands, scene, scene.blendedQueue());
+}
+
 Ref<Renderer> Renderer::create(const Config& config)
 {
   if (!config.pool)
@@ -116,20 +145,84 @@ bool Renderer::init(const Config& config)
   return true;
 }
 
-void Renderer::renderOperations(const render::Queue& queue)
+void Renderer::recordOperations(render::CommandBuffer& commands,
+                                const render::Scene& scene,
+                                const render::Queue& queue) const
 {
   const render::OperationList& operations = queue.operations();
+  const render::SortKeyList& keys = queue.keys();
+  const std::vector<GL::PrimitiveRange>& ranges = scene.ranges();
+  const std::vector<mat4>& transforms = scene.transforms();
+
+  const render::Pass* state = nullptr;
+  uint32 transform = uint32(-1);
+  std::vector<mat4> instances;
+  std::vector<GL::PrimitiveRange> batch;
 
-  for (auto k : queue.keys())
+  for (size_t i = 0;  i < keys.size();  )
   {
-    const render::SortKey key(k);
-    const render::Operation& op = operations[key.index];
+    const render::Operation& op = operations[keys[i].index];
+    const GL::PrimitiveRange& range = ranges[op.range];
+
+    // Consecutive operations often share a pass
+    if (op.state != state)
+    {
+      state = op.state;
+      commands.setPass(*state);
+    }
+
+    if (!isInstanced(*op.state))
+    {
+      // Consecutive operations often share a transform
+      if (op.transform != transform)
+      {
+        transform = op.transform;
+        commands.setModelMatrix(transforms[transform]);
+      }
+
+      commands.draw(range);
+      i++;
+      continue;
+    }
+
+    // Sorting places operations with the same pass next to each other, so
+    // draw each run sharing buffers together, either as instances of a single
+    // range or as a multi-draw of different ones
+    instances.clear();
+    batch.clear();
+
+    bool identical = true;
+
+    while (i < keys.size())
+    {
+      const render::Operation& next = operations[keys[i].index];
+      if (next.state != op.state || !isBatchable(range, ranges[next.range]))
+        break;
+
+      if (ranges[next.range] != range)
+        identical = false;
+
+      instances.push_back(transforms[next.transform]);
+      batch.push_back(ranges[next.range]);
+      i++;
+    }
+
+    if (identical)
+      commands.drawInstanced(range, instances.data(), uint(instances.size()));
+    else
+      commands.drawMulti(batch.data(), instances.data(), uint(instances.size()));
+  }
+}
 
-    m_state->setModelMatrix(op.transform);
-    op.state->apply();
+bool Renderer::isInstanced(const render::Pass& pass)
+{
+  static const NameID modelID = internName("vModel0");
 
-    context().render(op.range);
-  }
+  const GL::Program* program = pass.program();
+  if (!program)
+    return false;
+
+  return program->findAttribute(modelID) != nullptr;
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -37,6 +37,8 @@
 
 #include <internal/GLHelper.hpp>
 
+#include <cstring>
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -58,6 +60,7 @@ GLenum convertToGL(BufferUsage usage)
     case USAGE_STREAM:
       return GL_STREAM_DRAW;
     case USAGE_DYNAMIC:
+    case USAGE_PERSISTENT:
       return GL_DYNAMIC_DRAW;
   }
 
@@ -122,15 +125,25 @@ bool isColorAttachment(TextureFramebuffer::Attachment attachment)
 
 VertexBuffer::~VertexBuffer()
 {
+  m_context.releaseVertexArrays(*this);
+
   if (m_bufferID)
+  {
     glDeleteBuffers(1, &m_bufferID);
 
-  if (Stats* stats = m_context.stats())
-    stats->removeVertexBuffer(size());
+    if (Stats* stats = m_context.stats())
+      stats->removeVertexBuffer(size());
+  }
 }
 
 void VertexBuffer::discard()
 {
+  if (m_mapping)
+  {
+    logError("Cannot discard persistently mapped vertex buffer");
+    return;
+  }
+
   m_context.setCurrentVertexBuffer(this);
 
   glBufferData(GL_ARRAY_BUFFER,
@@ -151,9 +164,17 @@ void VertexBuffer::copyFrom(const void* source, size_t sourceCount, size_t start
     return;
   }
 
+  const size_t size = m_format.size();
+
+  if (m_mapping)
+  {
+    std::memcpy((char*) m_mapping + start * size, source, sourceCount * size);
+    flush(sourceCount, start);
+    return;
+  }
+
   m_context.setCurrentVertexBuffer(this);
 
-  const size_t size = m_format.size();
   glBufferSubData(GL_ARRAY_BUFFER, start * size, sourceCount * size, source);
 
 #if WENDY_DEBUG
@@ -161,6 +182,30 @@ void VertexBuffer::copyFrom(const void* source, size_t sourceCount, size_t start
 #endif
 }
 
+void VertexBuffer::flush(size_t count, size_t start)
+{
+  if (!m_mapping)
+  {
+    logError("Cannot flush vertex buffer without mapped storage");
+    return;
+  }
+
+  if (start + count > m_count)
+  {
+    logError("Too many vertices flushed in vertex buffer");
+    return;
+  }
+
+  m_context.setCurrentVertexBuffer(this);
+
+  const size_t size = m_format.size();
+  glFlushMappedBufferRange(GL_ARRAY_BUFFER, start * size, count * size);
+
+#if WENDY_DEBUG
+  checkGL("Error during flush of vertex buffer");
+#endif
+}
+
 void VertexBuffer::copyTo(void* target, size_t targetCount, size_t start)
 {
   if (start + targetCount > m_count)
@@ -191,11 +236,32 @@ Ref<VertexBuffer> VertexBuffer::create(Context& context,
   return buffer;
 }
 
+Ref<VertexBuffer> VertexBuffer::createDeferred(Context& context,
+                                               size_t count,
+                                               const VertexFormat& format,
+                                               BufferUsage usage)
+{
+  Ref<VertexBuffer> buffer(new VertexBuffer(context));
+  buffer->m_format = format;
+  buffer->m_count = count;
+  buffer->m_usage = usage;
+  return buffer;
+}
+
+bool VertexBuffer::realize()
+{
+  if (m_bufferID)
+    return true;
+
+  return init(m_format, m_count, m_usage);
+}
+
 VertexBuffer::VertexBuffer(Context& context):
   m_context(context),
   m_bufferID(0),
   m_count(0),
-  m_usage(USAGE_STATIC)
+  m_usage(USAGE_STATIC),
+  m_mapping(nullptr)
 {
 }
 
@@ -205,14 +271,33 @@ bool VertexBuffer::init(const VertexFormat& format, size_t count, BufferUsage us
   m_usage = usage;
   m_count = count;
 
+  if (m_usage == USAGE_PERSISTENT && !bufferStorage)
+  {
+    logError("Persistent vertex buffers are not supported by this context");
+    return false;
+  }
+
   glGenBuffers(1, &m_bufferID);
 
   m_context.setCurrentVertexBuffer(this);
 
-  glBufferData(GL_ARRAY_BUFFER,
-               m_count * m_format.size(),
-               nullptr,
-               convertToGL(m_usage));
+  if (m_usage == USAGE_PERSISTENT)
+  {
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+
+    bufferStorage(GL_ARRAY_BUFFER, m_count * m_format.size(), nullptr, flags);
+
+    m_mapping = glMapBufferRange(GL_ARRAY_BUFFER,
+                                 0, m_count * m_format.size(),
+                                 flags | GL_MAP_FLUSH_EXPLICIT_BIT);
+  }
+  else
+  {
+    glBufferData(GL_ARRAY_BUFFER,
+                 m_count * m_format.size(),
+                 nullptr,
+                 convertToGL(m_usage));
+  }
 
   if (!checkGL("Error during creation of vertex buffer of format %s",
                m_format.asString().c_str()))
@@ -231,6 +316,8 @@ bool VertexBuffer::init(const VertexFormat& format, size_t count, BufferUsage us
 
 IndexBuffer::~IndexBuffer()
 {
+  m_context.releaseVertexArrays(*this);
+
   if (m_bufferID)
     glDeleteBuffers(1, &m_bufferID);
 
@@ -321,6 +408,12 @@ bool IndexBuffer::init(size_t count, IndexBufferType type, BufferUsage usage)
   m_usage = usage;
   m_count = count;
 
+  if (m_usage == USAGE_PERSISTENT)
+  {
+    logError("Index buffers cannot have persistently mapped storage");
+    return false;
+  }
+
   glGenBuffers(1, &m_bufferID);
 
   m_context.setCurrentIndexBuffer(this);
@@ -43,6 +43,9 @@
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -227,6 +230,104 @@ CullMode invertCullMode(CullMode mode)
   panic("Invalid cull mode %u", mode);
 }
 
+// Bit layout of packed render state descriptors; the upper 32 bits hold the
+// interned ID of the values too wide to pack
+enum
+{
+  DEPTH_TESTING_BIT = 1 << 0,
+  DEPTH_WRITING_BIT = 1 << 1,
+  COLOR_WRITING_BIT = 1 << 2,
+  STENCIL_TESTING_BIT = 1 << 3,
+  WIREFRAME_BIT = 1 << 4,
+  LINE_SMOOTHING_BIT = 1 << 5,
+  MULTISAMPLING_BIT = 1 << 6,
+  CULL_MODE_SHIFT = 7,
+  SRC_FACTOR_SHIFT = 9,
+  DST_FACTOR_SHIFT = 13,
+  DEPTH_FUNCTION_SHIFT = 17,
+  STENCIL_FUNCTION_SHIFT = 20,
+  STENCIL_FAIL_OP_SHIFT = 23,
+  DEPTH_FAIL_OP_SHIFT = 26,
+  DEPTH_PASS_OP_SHIFT = 29,
+  EXTRA_SHIFT = 32
+};
+
+// Change masks for the groups of render state applied together
+const uint64 CULL_MASK = uint64(3) << CULL_MODE_SHIFT;
+const uint64 BLEND_MASK = uint64(0xff) << SRC_FACTOR_SHIFT;
+const uint64 DEPTH_MASK = DEPTH_TESTING_BIT |
+                          DEPTH_WRITING_BIT |
+                          (uint64(7) << DEPTH_FUNCTION_SHIFT);
+const uint64 STENCIL_FUNCTION_MASK = uint64(7) << STENCIL_FUNCTION_SHIFT;
+const uint64 STENCIL_OP_MASK = uint64(0x1ff) << STENCIL_FAIL_OP_SHIFT;
+const uint64 EXTRA_MASK = uint64(0xffffffff) << EXTRA_SHIFT;
+
+class RenderStateExtra
+{
+public:
+  bool operator == (const RenderStateExtra& other) const
+  {
+    return lineWidth == other.lineWidth &&
+           stencilRef == other.stencilRef &&
+           stencilMask == other.stencilMask;
+  }
+  float lineWidth;
+  uint stencilRef;
+  uint stencilMask;
+};
+
+class RenderStateExtraHash
+{
+public:
+  size_t operator () (const RenderStateExtra& extra) const
+  {
+    // Equal widths must hash equally, including positive and negative zero
+    uint32 widthBits = 0;
+    if (extra.lineWidth != 0.f)
+      std::memcpy(&widthBits, &extra.lineWidth, sizeof(widthBits));
+
+    return (size_t(widthBits) * 31 + extra.stencilRef) * 31 + extra.stencilMask;
+  }
+};
+
+uint32 internRenderStateExtra(float lineWidth, uint stencilRef, uint stencilMask)
+{
+  const RenderStateExtra extra = { lineWidth, stencilRef, stencilMask };
+
+  // Nearly all states use the same extras, so the last match of each thread
+  // is checked before taking the lock
+  static thread_local RenderStateExtra lastExtra;
+  static thread_local uint32 lastID = 0;
+
+  if (lastID && lastExtra == extra)
+    return lastID;
+
+  static std::mutex mutex;
+  static std::unordered_map<RenderStateExtra, uint32, RenderStateExtraHash> extras;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const uint32 nextID = uint32(extras.size() + 1);
+
+  lastExtra = extra;
+  lastID = extras.insert(std::make_pair(extra, nextID)).first->second;
+  return lastID;
+}
+
+CullMode packedCullMode(uint64 descriptor)
+{
+  return CullMode((descriptor & CULL_MASK) >> CULL_MODE_SHIFT);
+}
+
+Function effectiveDepthFunction(const RenderState& state)
+{
+  // NOTE: Special case; depth buffer filling uses a specific function
+  if (state.depthWriting && !state.depthTesting)
+    return ALLOW_ALWAYS;
+
+  return state.depthFunction;
+}
+
 GLenum convertToGL(BlendFactor factor)
 {
   switch (factor)
@@ -308,6 +409,10 @@ GLenum convertToGL(StencilOp operation)
 
 bool isCompatible(const Attribute& attribute, const VertexComponent& component)
 {
+  // Octahedral normals are decoded by the shader
+  if (component.type() == VERTEX_OCTAHEDRAL)
+    return attribute.type() == ATTRIBUTE_VEC2;
+
   switch (attribute.type())
   {
     case ATTRIBUTE_FLOAT:
@@ -315,7 +420,14 @@ bool isCompatible(const Attribute& attribute, const VertexComponent& component)
     case ATTRIBUTE_VEC2:
       return component.elementCount() == 2;
     case ATTRIBUTE_VEC3:
+    {
+      // Packed and half components are padded to four elements for
+      // alignment, and the extra element is ignored
+      if (component.type() != VERTEX_FLOAT && component.elementCount() == 4)
+        return true;
+
       return component.elementCount() == 3;
+    }
     case ATTRIBUTE_VEC4:
       return component.elementCount() == 4;
   }
@@ -372,6 +484,40 @@ RenderState::RenderState():
 {
 }
 
+uint64 RenderState::descriptor() const
+{
+  uint64 result = 0;
+
+  if (depthTesting)
+    result |= DEPTH_TESTING_BIT;
+  if (depthWriting)
+    result |= DEPTH_WRITING_BIT;
+  if (colorWriting)
+    result |= COLOR_WRITING_BIT;
+  if (stencilTesting)
+    result |= STENCIL_TESTING_BIT;
+  if (wireframe)
+    result |= WIREFRAME_BIT;
+  if (lineSmoothing)
+    result |= LINE_SMOOTHING_BIT;
+  if (multisampling)
+    result |= MULTISAMPLING_BIT;
+
+  result |= uint64(cullMode) << CULL_MODE_SHIFT;
+  result |= uint64(srcFactor) << SRC_FACTOR_SHIFT;
+  result |= uint64(dstFactor) << DST_FACTOR_SHIFT;
+  result |= uint64(depthFunction) << DEPTH_FUNCTION_SHIFT;
+  result |= uint64(stencilFunction) << STENCIL_FUNCTION_SHIFT;
+  result |= uint64(stencilFailOp) << STENCIL_FAIL_OP_SHIFT;
+  result |= uint64(depthFailOp) << DEPTH_FAIL_OP_SHIFT;
+  result |= uint64(depthPassOp) << DEPTH_PASS_OP_SHIFT;
+
+  const uint32 extraID = internRenderStateExtra(lineWidth, stencilRef, stencilMask);
+  result |= uint64(extraID) << EXTRA_SHIFT;
+
+  return result;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 Limits::Limits(Context& context)
@@ -392,6 +538,9 @@ Limits::Limits(Context& context)
     maxTextureAnisotropy = getFloat(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT);
   else
     maxTextureAnisotropy = 1.f;
+
+  persistentBuffers = (bufferStorage != nullptr);
+  multiDrawIndirect = (multiDrawElementsIndirect != nullptr);
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -434,43 +583,85 @@ void Stats::addFrame()
     m_frames.pop_back();
 }
 
-void Stats::addStateChange()
+void Stats::addStateChange(bool skipped)
 {
   Frame& frame = m_frames.front();
-  frame.stateChangeCount++;
+  if (skipped)
+    frame.skippedStateChangeCount++;
+  else
+    frame.stateChangeCount++;
 }
 
-void Stats::addPrimitives(PrimitiveType type, uint vertexCount)
+void Stats::addDrawCall()
 {
   Frame& frame = m_frames.front();
-  frame.vertexCount += vertexCount;
   frame.operationCount++;
+}
+
+void Stats::addPrimitives(PrimitiveType type, uint vertexCount, uint instanceCount)
+{
+  Frame& frame = m_frames.front();
+  frame.vertexCount += vertexCount * instanceCount;
 
   switch (type)
   {
     case POINT_LIST:
-      frame.pointCount += vertexCount;
+      frame.pointCount += vertexCount * instanceCount;
       break;
     case LINE_LIST:
-      frame.lineCount += vertexCount / 2;
+      frame.lineCount += vertexCount / 2 * instanceCount;
       break;
     case LINE_STRIP:
-      frame.lineCount += vertexCount - 1;
+      frame.lineCount += (vertexCount - 1) * instanceCount;
       break;
     case TRIANGLE_LIST:
-      frame.triangleCount += vertexCount / 3;
+      frame.triangleCount += vertexCount / 3 * instanceCount;
       break;
     case TRIANGLE_STRIP:
-      frame.triangleCount += vertexCount - 2;
+      frame.triangleCount += (vertexCount - 2) * instanceCount;
       break;
     case TRIANGLE_FAN:
-      frame.triangleCount += vertexCount - 2;
+      frame.triangleCount += (vertexCount - 2) * instanceCount;
       break;
     default:
       panic("Invalid primitive type %u", type);
   }
 }
 
+void Stats::addOcclusionTests(uint testCount, uint occludedCount)
+{
+  Frame& frame = m_frames.front();
+  frame.occlusionTestCount += testCount;
+  frame.occludedCount += occludedCount;
+}
+
+void Stats::addUniformUpload(bool skipped)
+{
+  Frame& frame = m_frames.front();
+  if (skipped)
+    frame.skippedUniformCount++;
+  else
+    frame.uniformCount++;
+}
+
+void Stats::addSamplerBinding(bool skipped)
+{
+  Frame& frame = m_frames.front();
+  if (skipped)
+    frame.skippedSamplerCount++;
+  else
+    frame.samplerCount++;
+}
+
+void Stats::addVertexArrayLookup(bool hit)
+{
+  Frame& frame = m_frames.front();
+  if (hit)
+    frame.vertexArrayHitCount++;
+  else
+    frame.vertexArrayMissCount++;
+}
+
 void Stats::addTexture(size_t size)
 {
   m_textureCount++;
@@ -520,12 +711,21 @@ void Stats::removeProgram()
 ///////////////////////////////////////////////////////////////////////
 
 Stats::Frame::Frame():
-  stateChangeCount(0),
   operationCount(0),
+  stateChangeCount(0),
+  skippedStateChangeCount(0),
   vertexCount(0),
   pointCount(0),
   lineCount(0),
   triangleCount(0),
+  occlusionTestCount(0),
+  occludedCount(0),
+  uniformCount(0),
+  skippedUniformCount(0),
+  samplerCount(0),
+  skippedSamplerCount(0),
+  vertexArrayHitCount(0),
+  vertexArrayMissCount(0),
   duration(0.0)
 {
 }
@@ -537,11 +737,13 @@ class Context::SharedSampler
 public:
   SharedSampler(const char* name, SamplerType type, int ID):
     name(name),
+    nameID(internName(name)),
     type(type),
     ID(ID)
   {
   }
   String name;
+  NameID nameID;
   SamplerType type;
   int ID;
 };
@@ -553,17 +755,72 @@ class Context::SharedUniform
 public:
   SharedUniform(const char* name, UniformType type, int ID):
     name(name),
+    nameID(internName(name)),
     type(type),
     ID(ID)
   {
   }
   String name;
+  NameID nameID;
   UniformType type;
   int ID;
 };
 
 ///////////////////////////////////////////////////////////////////////
 
+class Context::VertexArray
+{
+public:
+  VertexArray(uint layoutID,
+              const VertexBuffer* vertexBuffer,
+              const IndexBuffer* indexBuffer,
+              bool instanced):
+    layoutID(layoutID),
+    vertexBuffer(vertexBuffer),
+    indexBuffer(indexBuffer),
+    instanced(instanced),
+    arrayID(0)
+  {
+  }
+  bool operator < (const VertexArray& other) const
+  {
+    if (layoutID != other.layoutID)
+      return layoutID < other.layoutID;
+    if (vertexBuffer != other.vertexBuffer)
+      return vertexBuffer < other.vertexBuffer;
+    if (indexBuffer != other.indexBuffer)
+      return indexBuffer < other.indexBuffer;
+    return instanced < other.instanced;
+  }
+  bool operator == (const VertexArray& other) const
+  {
+    return layoutID == other.layoutID &&
+           vertexBuffer == other.vertexBuffer &&
+           indexBuffer == other.indexBuffer &&
+           instanced == other.instanced;
+  }
+  uint layoutID;
+  const VertexBuffer* vertexBuffer;
+  const IndexBuffer* indexBuffer;
+  bool instanced;
+  uint arrayID;
+};
+
+///////////////////////////////////////////////////////////////////////
+
+// Layout mandated by glMultiDrawElementsIndirect
+class Context::IndirectCommand
+{
+public:
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+///////////////////////////////////////////////////////////////////////
+
 Context::~Context()
 {
   if (m_defaultFramebuffer)
@@ -573,6 +830,14 @@ Context::~Context()
   setCurrentIndexBuffer(nullptr);
   setCurrentProgram(nullptr);
 
+  for (auto& a : m_vertexArrays)
+    glDeleteVertexArrays(1, &a.arrayID);
+
+  m_vertexArrays.clear();
+
+  if (m_indirectBufferID)
+    glDeleteBuffers(1, &m_indirectBufferID);
+
   for (size_t i = 0;  i < m_textureUnits.size();  i++)
   {
     setActiveTextureUnit(i);
@@ -592,7 +857,7 @@ void Context::clearColorBuffer(const vec4& color)
 
   RenderState clearState = m_currentState;
   clearState.colorWriting = true;
-  applyState(clearState);
+  applyState(clearState, clearState.descriptor());
 
   glClearColor(color.r, color.g, color.b, color.a);
   glClear(GL_COLOR_BUFFER_BIT);
@@ -601,7 +866,7 @@ void Context::clearColorBuffer(const vec4& color)
   checkGL("Error during color buffer clearing");
 #endif
 
-  applyState(previousState);
+  applyState(previousState, previousState.descriptor());
 }
 
 void Context::clearDepthBuffer(float depth)
@@ -610,7 +875,7 @@ void Context::clearDepthBuffer(float depth)
 
   RenderState clearState = m_currentState;
   clearState.depthWriting = true;
-  applyState(clearState);
+  applyState(clearState, clearState.descriptor());
 
   glClearDepth(depth);
   glClear(GL_DEPTH_BUFFER_BIT);
@@ -619,7 +884,7 @@ void Context::clearDepthBuffer(float depth)
   checkGL("Error during color buffer clearing");
 #endif
 
-  applyState(previousState);
+  applyState(previousState, previousState.descriptor());
 }
 
 void Context::clearStencilBuffer(uint value)
@@ -628,7 +893,7 @@ void Context::clearStencilBuffer(uint value)
 
   RenderState clearState = m_currentState;
   clearState.stencilMask = ~0u;
-  applyState(clearState);
+  applyState(clearState, clearState.descriptor());
 
   glClearStencil(value);
   glClear(GL_STENCIL_BUFFER_BIT);
@@ -637,7 +902,7 @@ void Context::clearStencilBuffer(uint value)
   checkGL("Error during color buffer clearing");
 #endif
 
-  applyState(previousState);
+  applyState(previousState, previousState.descriptor());
 }
 
 void Context::clearBuffers(const vec4& color, float depth, uint value)
@@ -648,7 +913,7 @@ void Context::clearBuffers(const vec4& color, float depth, uint value)
   clearState.colorWriting = true;
   clearState.depthWriting = true;
   clearState.stencilMask = ~0u;
-  applyState(clearState);
+  applyState(clearState, clearState.descriptor());
 
   glClearColor(color.r, color.g, color.b, color.a);
   glClearDepth(depth);
@@ -660,7 +925,7 @@ void Context::clearBuffers(const vec4& color, float depth, uint value)
   checkGL("Error during color buffer clearing");
 #endif
 
-  applyState(previousState);
+  applyState(previousState, previousState.descriptor());
 }
 
 void Context::render(const PrimitiveRange& range)
@@ -675,83 +940,211 @@ void Context::render(const PrimitiveRange& range)
   setCurrentVertexBuffer(range.vertexBuffer());
   setCurrentIndexBuffer(range.indexBuffer());
 
-  render(range.type(), range.start(), range.count(), range.base());
+  draw(range.type(), range.start(), range.count(), range.base(), nullptr);
 }
 
-void Context::render(PrimitiveType type, uint start, uint count, uint base)
+void Context::render(const PrimitiveRange& range, const VertexRange& instances)
 {
-  ProfileNodeCall call("GL::Context::render");
-
-  if (!m_currentProgram)
+  if (range.isEmpty() || instances.isEmpty())
   {
-    logError("Cannot render without a current shader program");
+    logWarning("Rendering empty primitive or instance range with shader program %s",
+               m_currentProgram->name().c_str());
     return;
   }
 
-  if (!m_currentVertexBuffer)
-  {
-    logError("Cannot render without a current vertex buffer");
+  setCurrentVertexBuffer(range.vertexBuffer());
+  setCurrentIndexBuffer(range.indexBuffer());
+
+  draw(range.type(), range.start(), range.count(), range.base(), &instances);
+}
+
+void Context::render(const PrimitiveRange* ranges,
+                     uint count,
+                     const VertexRange& instances)
+{
+  ProfileNodeCall call("GL::Context::render");
+
+  if (!count)
     return;
-  }
 
-  if (m_dirtyBinding)
-  {
-    const VertexFormat& format = m_currentVertexBuffer->format();
+  const PrimitiveRange& first = ranges[0];
 
-    if (m_currentProgram->attributeCount() > format.components().size())
+  for (uint i = 1;  i < count;  i++)
+  {
+    if (ranges[i].type() != first.type() ||
+        ranges[i].vertexBuffer() != first.vertexBuffer() ||
+        ranges[i].indexBuffer() != first.indexBuffer())
     {
-      logError("Shader program %s has more attributes than vertex format has components",
-               m_currentProgram->name().c_str());
+      logError("Primitive ranges of a multi-draw must share type and buffers");
       return;
     }
+  }
+
+  if (instances.count() < count)
+  {
+    logError("Multi-draw needs one instance for each primitive range");
+    return;
+  }
+
+  setCurrentVertexBuffer(first.vertexBuffer());
+  setCurrentIndexBuffer(first.indexBuffer());
 
-    for (size_t i = 0;  i < m_currentProgram->attributeCount();  i++)
+  if (!m_currentIndexBuffer || !multiDrawElementsIndirect)
+  {
+    // Fall back to one draw per range, each with its own instance
+    for (uint i = 0;  i < count;  i++)
     {
-      Attribute& attribute = m_currentProgram->attribute(i);
+      const VertexRange instance(*instances.vertexBuffer(),
+                                 instances.start() + i,
+                                 1);
+
+      draw(ranges[i].type(),
+           ranges[i].start(),
+           ranges[i].count(),
+           ranges[i].base(),
+           &instance);
+    }
 
-      const VertexComponent* component = format.findComponent(attribute.name().c_str());
-      if (!component)
-      {
-        logError("Attribute %s of program %s has no corresponding vertex format component",
-                 attribute.name().c_str(),
-                 m_currentProgram->name().c_str());
-        return;
-      }
+    return;
+  }
 
-      if (!isCompatible(attribute, *component))
-      {
-        logError("Attribute %s of shader program %s has incompatible type",
-                 attribute.name().c_str(),
-                 m_currentProgram->name().c_str());
-        return;
-      }
+  if (!prepareDraw(&instances))
+    return;
 
-      attribute.bind(format.size(), component->offset());
-    }
+  // The base instance selects the instance attributes of each range
+  m_indirectCommands.resize(count);
 
-    m_dirtyBinding = false;
+  for (uint i = 0;  i < count;  i++)
+  {
+    IndirectCommand& command = m_indirectCommands[i];
+    command.count = ranges[i].count();
+    command.instanceCount = 1;
+    command.firstIndex = ranges[i].start();
+    command.baseVertex = ranges[i].base();
+    command.baseInstance = i;
   }
 
+  if (!m_indirectBufferID)
+    glGenBuffers(1, &m_indirectBufferID);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBufferID);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,
+               count * sizeof(IndirectCommand),
+               &m_indirectCommands[0],
+               GL_STREAM_DRAW);
+
+  multiDrawElementsIndirect(convertToGL(first.type()),
+                            convertToGL(m_currentIndexBuffer->type()),
+                            nullptr,
+                            count,
+                            0);
+
 #if WENDY_DEBUG
-  if (!m_currentProgram->isValid())
-    return;
+  checkGL("Error during multi-draw");
 #endif
 
+  if (m_stats)
+  {
+    m_stats->addDrawCall();
+
+    for (uint i = 0;  i < count;  i++)
+      m_stats->addPrimitives(ranges[i].type(), ranges[i].count());
+  }
+}
+
+void Context::render(PrimitiveType type, uint start, uint count, uint base)
+{
+  draw(type, start, count, base, nullptr);
+}
+
+void Context::draw(PrimitiveType type,
+                   uint start,
+                   uint count,
+                   uint base,
+                   const VertexRange* instances)
+{
+  ProfileNodeCall call("GL::Context::render");
+
+  if (!prepareDraw(instances))
+    return;
+
+  const bool instanced = (instances != nullptr);
+  const uint instanceCount = instanced ? instances->count() : 1;
+
   if (m_currentIndexBuffer)
   {
     const size_t size = IndexBuffer::typeSize(m_currentIndexBuffer->type());
 
-    glDrawElementsBaseVertex(convertToGL(type),
-                             count,
-                             convertToGL(m_currentIndexBuffer->type()),
-                             (GLvoid*) (size * start),
-                             base);
+    if (instanced)
+    {
+      glDrawElementsInstancedBaseVertex(convertToGL(type),
+                                        count,
+                                        convertToGL(m_currentIndexBuffer->type()),
+                                        (GLvoid*) (size * start),
+                                        instanceCount,
+                                        base);
+    }
+    else
+    {
+      glDrawElementsBaseVertex(convertToGL(type),
+                               count,
+                               convertToGL(m_currentIndexBuffer->type()),
+                               (GLvoid*) (size * start),
+                               base);
+    }
   }
   else
-    glDrawArrays(convertToGL(type), start, count);
+  {
+    if (instanced)
+      glDrawArraysInstanced(convertToGL(type), start, count, instanceCount);
+    else
+      glDrawArrays(convertToGL(type), start, count);
+  }
 
   if (m_stats)
-    m_stats->addPrimitives(type, count);
+  {
+    m_stats->addDrawCall();
+    m_stats->addPrimitives(type, count, instanceCount);
+  }
+}
+
+bool Context::prepareDraw(const VertexRange* instances)
+{
+  if (!m_currentProgram)
+  {
+    logError("Cannot render without a current shader program");
+    return false;
+  }
+
+  if (!m_currentVertexBuffer)
+  {
+    logError("Cannot render without a current vertex buffer");
+    return false;
+  }
+
+  const bool instanced = (instances != nullptr);
+
+  if (m_dirtyBinding || instanced != m_instancedBinding)
+  {
+    if (!applyVertexArray(instanced))
+      return false;
+
+    m_dirtyBinding = false;
+    m_instancedBinding = instanced;
+  }
+
+  if (instanced)
+  {
+    if (!applyInstanceAttributes(*instances))
+      return false;
+  }
+
+#if WENDY_DEBUG
+  if (!m_currentProgram->isValid())
+    return false;
+#endif
+
+  return true;
 }
 
 void Context::createSharedSampler(const char* name, SamplerType type, int ID)
@@ -779,10 +1172,19 @@ void Context::createSharedUniform(const char* name, UniformType type, int ID)
 }
 
 int Context::sharedSamplerID(const char* name, SamplerType type) const
+{
+  const NameID nameID = findName(name);
+  if (nameID == INVALID_NAME_ID)
+    return INVALID_SHARED_STATE_ID;
+
+  return sharedSamplerID(nameID, type);
+}
+
+int Context::sharedSamplerID(NameID nameID, SamplerType type) const
 {
   for (auto& s : m_samplers)
   {
-    if (s.name == name && s.type == type)
+    if (s.nameID == nameID && s.type == type)
       return s.ID;
   }
 
@@ -790,10 +1192,19 @@ int Context::sharedSamplerID(const char* name, SamplerType type) const
 }
 
 int Context::sharedUniformID(const char* name, UniformType type) const
+{
+  const NameID nameID = findName(name);
+  if (nameID == INVALID_NAME_ID)
+    return INVALID_SHARED_STATE_ID;
+
+  return sharedUniformID(nameID, type);
+}
+
+int Context::sharedUniformID(NameID nameID, UniformType type) const
 {
   for (auto& u : m_uniforms)
   {
-    if (u.name == name && u.type == type)
+    if (u.nameID == nameID && u.type == type)
       return u.ID;
   }
 
@@ -908,9 +1319,6 @@ void Context::setCurrentProgram(Program* newProgram)
 {
   if (newProgram != m_currentProgram)
   {
-    if (m_currentProgram)
-      m_currentProgram->unbind();
-
     m_currentProgram = newProgram;
     m_dirtyBinding = true;
 
@@ -957,6 +1365,14 @@ void Context::setCurrentIndexBuffer(IndexBuffer* newIndexBuffer)
     m_currentIndexBuffer = newIndexBuffer;
     m_dirtyBinding = true;
 
+    // The index buffer binding is part of vertex array state, so make sure
+    // not to modify a cached vertex array
+    if (m_currentVertexArray)
+    {
+      glBindVertexArray(0);
+      m_currentVertexArray = 0;
+    }
+
     if (m_currentIndexBuffer)
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_currentIndexBuffer->m_bufferID);
     else
@@ -1054,7 +1470,12 @@ const RenderState& Context::currentRenderState() const
 
 void Context::setCurrentRenderState(const RenderState& newState)
 {
-  applyState(newState);
+  applyState(newState, newState.descriptor());
+}
+
+void Context::setCurrentRenderState(const RenderState& newState, uint64 descriptor)
+{
+  applyState(newState, descriptor);
 }
 
 Stats* Context::stats() const
@@ -1099,7 +1520,11 @@ Context::Context(ResourceCache& cache):
   m_dirtyBinding(true),
   m_dirtyState(true),
   m_cullingInverted(false),
+  m_currentVertexArray(0),
+  m_instancedBinding(false),
   m_activeTextureUnit(0),
+  m_currentDescriptor(0),
+  m_indirectBufferID(0),
   m_stats(nullptr)
 {
 }
@@ -1177,6 +1602,17 @@ bool Context::init(const WindowConfig& wc, const ContextConfig& cc)
       glDebugMessageCallbackARB(debugCallback, nullptr);
       glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
     }
+
+    if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+      bufferStorage = (BufferStorageProc) glfwGetProcAddress("glBufferStorage");
+
+    // Multi-draw relies on the base instance to select per-draw attributes
+    if (glfwExtensionSupported("GL_ARB_multi_draw_indirect") &&
+        glfwExtensionSupported("GL_ARB_base_instance"))
+    {
+      multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)
+        glfwGetProcAddress("glMultiDrawElementsIndirect");
+    }
   }
 
   // Retrieve context limits and set up dependent caches
@@ -1213,7 +1649,7 @@ bool Context::init(const WindowConfig& wc, const ContextConfig& cc)
     setScissorArea(Recti(0, 0, width, height));
 
     setSwapInterval(1);
-    forceState(m_currentState);
+    forceState(m_currentState, m_currentState.descriptor());
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   }
@@ -1221,166 +1657,326 @@ bool Context::init(const WindowConfig& wc, const ContextConfig& cc)
   return true;
 }
 
-void Context::applyState(const RenderState& newState)
+bool Context::applyVertexArray(bool instanced)
 {
-  if (m_stats)
-    m_stats->addStateChange();
+  const VertexArray key(m_currentProgram->m_layoutID,
+                        m_currentVertexBuffer,
+                        m_currentIndexBuffer,
+                        instanced);
 
-  if (m_dirtyState)
+  auto entry = std::lower_bound(m_vertexArrays.begin(), m_vertexArrays.end(), key);
+  if (entry != m_vertexArrays.end() && *entry == key)
   {
-    forceState(newState);
-    return;
+    if (m_stats)
+      m_stats->addVertexArrayLookup(true);
   }
+  else
+  {
+    if (m_stats)
+      m_stats->addVertexArrayLookup(false);
 
-  CullMode cullMode = newState.cullMode;
-  if (m_cullingInverted)
-    cullMode = invertCullMode(cullMode);
+    const uint arrayID = createVertexArray(instanced);
+    if (!arrayID)
+      return false;
 
-  if (cullMode != m_currentState.cullMode)
+    entry = m_vertexArrays.insert(entry, key);
+    entry->arrayID = arrayID;
+  }
+
+  if (entry->arrayID != m_currentVertexArray)
   {
-    if ((cullMode == CULL_NONE) != (m_currentState.cullMode == CULL_NONE))
-      setBooleanState(GL_CULL_FACE, cullMode != CULL_NONE);
+    glBindVertexArray(entry->arrayID);
+    m_currentVertexArray = entry->arrayID;
+  }
 
-    if (cullMode != CULL_NONE)
-      glCullFace(convertToGL(cullMode));
+  return true;
+}
+
+uint Context::createVertexArray(bool instanced)
+{
+  const VertexFormat& format = m_currentVertexBuffer->format();
 
-    m_currentState.cullMode = cullMode;
+  if (!instanced && m_currentProgram->attributeCount() > format.components().size())
+  {
+    logError("Shader program %s has more attributes than vertex format has components",
+             m_currentProgram->name().c_str());
+    return 0;
   }
 
-  if (newState.srcFactor != m_currentState.srcFactor ||
-      newState.dstFactor != m_currentState.dstFactor)
+  uint arrayID;
+  glGenVertexArrays(1, &arrayID);
+  glBindVertexArray(arrayID);
+  m_currentVertexArray = arrayID;
+
+  // The current vertex buffer is already bound, as that binding is not part
+  // of vertex array state, but the index buffer binding is
+  if (m_currentIndexBuffer)
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_currentIndexBuffer->m_bufferID);
+
+  for (size_t i = 0;  i < m_currentProgram->attributeCount();  i++)
   {
-    setBooleanState(GL_BLEND, newState.srcFactor != BLEND_ONE ||
-                              newState.dstFactor != BLEND_ZERO);
+    Attribute& attribute = m_currentProgram->attribute(i);
 
-    if (newState.srcFactor != BLEND_ONE || newState.dstFactor != BLEND_ZERO)
+    const VertexComponent* component = format.findComponent(attribute.nameID());
+    if (!component)
     {
-      glBlendFunc(convertToGL(newState.srcFactor),
-                  convertToGL(newState.dstFactor));
+      // Per-instance attributes are specified at each draw
+      if (instanced)
+        continue;
+
+      logError("Attribute %s of program %s has no corresponding vertex format component",
+               attribute.name().c_str(),
+               m_currentProgram->name().c_str());
+      destroyVertexArray(arrayID);
+      return 0;
     }
 
-    m_currentState.srcFactor = newState.srcFactor;
-    m_currentState.dstFactor = newState.dstFactor;
+    if (!isCompatible(attribute, *component))
+    {
+      logError("Attribute %s of shader program %s has incompatible type",
+               attribute.name().c_str(),
+               m_currentProgram->name().c_str());
+      destroyVertexArray(arrayID);
+      return 0;
+    }
+
+    glEnableVertexAttribArray(attribute.m_location);
+    attribute.bind(format.size(), component->offset(), *component);
   }
 
-  if (newState.depthTesting || newState.depthWriting)
+#if WENDY_DEBUG
+  if (!checkGL("Failed to create vertex array for program %s",
+               m_currentProgram->name().c_str()))
   {
-    // Set depth buffer writing.
-    if (newState.depthWriting != m_currentState.depthWriting)
-      glDepthMask(newState.depthWriting ? GL_TRUE : GL_FALSE);
+    destroyVertexArray(arrayID);
+    return 0;
+  }
+#endif
 
-    if (newState.depthTesting)
+  return arrayID;
+}
+
+bool Context::applyInstanceAttributes(const VertexRange& instances)
+{
+  const VertexFormat& format = m_currentVertexBuffer->format();
+  const VertexFormat& instanceFormat = instances.vertexBuffer()->format();
+  const size_t stride = instanceFormat.size();
+
+  glBindBuffer(GL_ARRAY_BUFFER, instances.vertexBuffer()->m_bufferID);
+
+  bool success = true;
+
+  for (size_t i = 0;  i < m_currentProgram->attributeCount();  i++)
+  {
+    Attribute& attribute = m_currentProgram->attribute(i);
+
+    if (format.findComponent(attribute.nameID()))
+      continue;
+
+    const VertexComponent* component = instanceFormat.findComponent(attribute.nameID());
+    if (!component)
     {
-      // Set depth buffer function.
-      if (newState.depthFunction != m_currentState.depthFunction)
-      {
-        glDepthFunc(convertToGL(newState.depthFunction));
-        m_currentState.depthFunction = newState.depthFunction;
-      }
+      logError("Attribute %s of program %s has no corresponding vertex or instance format component",
+               attribute.name().c_str(),
+               m_currentProgram->name().c_str());
+      success = false;
+      break;
     }
-    else if (newState.depthWriting)
-    {
-      // NOTE: Special case; depth buffer filling.
-      //       Set specific depth buffer function.
-      const Function depthFunction = ALLOW_ALWAYS;
 
-      if (m_currentState.depthFunction != depthFunction)
-      {
-        glDepthFunc(convertToGL(depthFunction));
-        m_currentState.depthFunction = depthFunction;
-      }
+    if (!isCompatible(attribute, *component))
+    {
+      logError("Attribute %s of shader program %s has incompatible type",
+               attribute.name().c_str(),
+               m_currentProgram->name().c_str());
+      success = false;
+      break;
     }
 
-    if (!(m_currentState.depthTesting || m_currentState.depthWriting))
-      glEnable(GL_DEPTH_TEST);
+    glEnableVertexAttribArray(attribute.m_location);
+    attribute.bind(stride,
+                   instances.start() * stride + component->offset(),
+                   *component);
+    glVertexAttribDivisor(attribute.m_location, 1);
   }
-  else
+
+  // The array buffer binding is not vertex array state, so restore it
+  glBindBuffer(GL_ARRAY_BUFFER, m_currentVertexBuffer->m_bufferID);
+
+  return success;
+}
+
+void Context::destroyVertexArray(uint arrayID)
+{
+  if (arrayID == m_currentVertexArray)
   {
-    if (m_currentState.depthTesting || m_currentState.depthWriting)
-      glDisable(GL_DEPTH_TEST);
+    // Deleting the bound vertex array reverts to the default one, which
+    // needs to have the current index buffer bound
+    glBindVertexArray(0);
+    m_currentVertexArray = 0;
+    m_dirtyBinding = true;
+
+    if (m_currentIndexBuffer)
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_currentIndexBuffer->m_bufferID);
+    else
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
   }
 
-  m_currentState.depthTesting = newState.depthTesting;
-  m_currentState.depthWriting = newState.depthWriting;
+  glDeleteVertexArrays(1, &arrayID);
+}
+
+void Context::releaseVertexArrays(const VertexBuffer& buffer)
+{
+  auto e = m_vertexArrays.begin();
 
-  if (newState.colorWriting != m_currentState.colorWriting)
+  while (e != m_vertexArrays.end())
   {
-    const GLboolean state = newState.colorWriting ? GL_TRUE : GL_FALSE;
-    glColorMask(state, state, state, state);
-    m_currentState.colorWriting = newState.colorWriting;
+    if (e->vertexBuffer == &buffer)
+    {
+      destroyVertexArray(e->arrayID);
+      e = m_vertexArrays.erase(e);
+    }
+    else
+      e++;
   }
+}
 
-  if (newState.stencilTesting != m_currentState.stencilTesting)
+void Context::releaseVertexArrays(const IndexBuffer& buffer)
+{
+  auto e = m_vertexArrays.begin();
+
+  while (e != m_vertexArrays.end())
   {
-    setBooleanState(GL_STENCIL_TEST, newState.stencilTesting);
-    m_currentState.stencilTesting = newState.stencilTesting;
+    if (e->indexBuffer == &buffer)
+    {
+      destroyVertexArray(e->arrayID);
+      e = m_vertexArrays.erase(e);
+    }
+    else
+      e++;
   }
+}
+
+void Context::applyState(const RenderState& newState, uint64 descriptor)
+{
+  CullMode cullMode = newState.cullMode;
 
-  if (newState.stencilTesting)
+  if (m_cullingInverted)
   {
-    if (newState.stencilFunction != m_currentState.stencilFunction ||
-        newState.stencilRef != m_currentState.stencilRef ||
-        newState.stencilMask != m_currentState.stencilMask)
-    {
-      glStencilFunc(convertToGL(newState.stencilFunction),
-                    newState.stencilRef, newState.stencilMask);
+    cullMode = invertCullMode(cullMode);
+    descriptor = (descriptor & ~CULL_MASK) | (uint64(cullMode) << CULL_MODE_SHIFT);
+  }
 
-      m_currentState.stencilFunction = newState.stencilFunction;
-      m_currentState.stencilRef = newState.stencilRef;
-      m_currentState.stencilMask = newState.stencilMask;
-    }
+  if (m_dirtyState)
+  {
+    if (m_stats)
+      m_stats->addStateChange(false);
 
-    if (newState.stencilFailOp != m_currentState.stencilFailOp ||
-        newState.depthFailOp != m_currentState.depthFailOp ||
-        newState.depthPassOp != m_currentState.depthPassOp)
-    {
-      glStencilOp(convertToGL(newState.stencilFailOp),
-                  convertToGL(newState.depthFailOp),
-                  convertToGL(newState.depthPassOp));
+    forceState(newState, descriptor);
+    return;
+  }
+
+  // Identical states have identical descriptors
+  const uint64 changes = descriptor ^ m_currentDescriptor;
 
-      m_currentState.stencilFailOp = newState.stencilFailOp;
-      m_currentState.depthFailOp = newState.depthFailOp;
-      m_currentState.depthPassOp = newState.depthPassOp;
+  if (m_stats)
+    m_stats->addStateChange(changes == 0);
+
+  if (!changes)
+    return;
+
+  const RenderState& oldState = m_currentState;
+
+  if (changes & CULL_MASK)
+  {
+    const CullMode oldCullMode = packedCullMode(m_currentDescriptor);
+
+    if ((cullMode == CULL_NONE) != (oldCullMode == CULL_NONE))
+      setBooleanState(GL_CULL_FACE, cullMode != CULL_NONE);
+
+    if (cullMode != CULL_NONE)
+      glCullFace(convertToGL(cullMode));
+  }
+
+  if (changes & BLEND_MASK)
+  {
+    setBooleanState(GL_BLEND, newState.srcFactor != BLEND_ONE ||
+                              newState.dstFactor != BLEND_ZERO);
+
+    if (newState.srcFactor != BLEND_ONE || newState.dstFactor != BLEND_ZERO)
+    {
+      glBlendFunc(convertToGL(newState.srcFactor),
+                  convertToGL(newState.dstFactor));
     }
   }
 
-  if (newState.wireframe != m_currentState.wireframe)
+  if (changes & DEPTH_MASK)
   {
-    const GLenum state = newState.wireframe ? GL_LINE : GL_FILL;
-    glPolygonMode(GL_FRONT_AND_BACK, state);
-    m_currentState.wireframe = newState.wireframe;
+    const bool depth = newState.depthTesting || newState.depthWriting;
+    if (depth != (oldState.depthTesting || oldState.depthWriting))
+      setBooleanState(GL_DEPTH_TEST, depth);
+
+    if (newState.depthWriting != oldState.depthWriting)
+      glDepthMask(newState.depthWriting ? GL_TRUE : GL_FALSE);
+
+    const Function depthFunction = effectiveDepthFunction(newState);
+    if (depthFunction != effectiveDepthFunction(oldState))
+      glDepthFunc(convertToGL(depthFunction));
   }
 
-  if (newState.lineSmoothing != m_currentState.lineSmoothing)
+  if (changes & COLOR_WRITING_BIT)
   {
-    setBooleanState(GL_LINE_SMOOTH, newState.lineSmoothing);
-    m_currentState.lineSmoothing = newState.lineSmoothing;
+    const GLboolean state = newState.colorWriting ? GL_TRUE : GL_FALSE;
+    glColorMask(state, state, state, state);
   }
 
-  if (newState.multisampling != m_currentState.multisampling)
+  if (changes & STENCIL_TESTING_BIT)
+    setBooleanState(GL_STENCIL_TEST, newState.stencilTesting);
+
+  if ((changes & STENCIL_FUNCTION_MASK) ||
+      ((changes & EXTRA_MASK) &&
+       (newState.stencilRef != oldState.stencilRef ||
+        newState.stencilMask != oldState.stencilMask)))
   {
-    setBooleanState(GL_MULTISAMPLE, newState.multisampling);
-    m_currentState.multisampling = newState.multisampling;
+    glStencilFunc(convertToGL(newState.stencilFunction),
+                  newState.stencilRef, newState.stencilMask);
   }
 
-  if (newState.lineWidth != m_currentState.lineWidth)
+  if (changes & STENCIL_OP_MASK)
   {
-    glLineWidth(newState.lineWidth);
-    m_currentState.lineWidth = newState.lineWidth;
+    glStencilOp(convertToGL(newState.stencilFailOp),
+                convertToGL(newState.depthFailOp),
+                convertToGL(newState.depthPassOp));
   }
 
+  if (changes & WIREFRAME_BIT)
+  {
+    const GLenum state = newState.wireframe ? GL_LINE : GL_FILL;
+    glPolygonMode(GL_FRONT_AND_BACK, state);
+  }
+
+  if (changes & LINE_SMOOTHING_BIT)
+    setBooleanState(GL_LINE_SMOOTH, newState.lineSmoothing);
+
+  if (changes & MULTISAMPLING_BIT)
+    setBooleanState(GL_MULTISAMPLE, newState.multisampling);
+
+  if ((changes & EXTRA_MASK) && newState.lineWidth != oldState.lineWidth)
+    glLineWidth(newState.lineWidth);
+
+  m_currentState = newState;
+  m_currentDescriptor = descriptor;
+
 #if WENDY_DEBUG
   checkGL("Error when applying render state");
 #endif
 }
 
-void Context::forceState(const RenderState& newState)
+void Context::forceState(const RenderState& newState, uint64 descriptor)
 {
   m_currentState = newState;
+  m_currentDescriptor = descriptor;
 
-  CullMode cullMode = newState.cullMode;
-  if (m_cullingInverted)
-    cullMode = invertCullMode(cullMode);
+  const CullMode cullMode = packedCullMode(descriptor);
 
   setBooleanState(GL_CULL_FACE, cullMode != CULL_NONE);
   if (cullMode != CULL_NONE)
@@ -1392,15 +1988,7 @@ void Context::forceState(const RenderState& newState)
 
   glDepthMask(newState.depthWriting ? GL_TRUE : GL_FALSE);
   setBooleanState(GL_DEPTH_TEST, newState.depthTesting || newState.depthWriting);
-
-  if (newState.depthWriting && !newState.depthTesting)
-  {
-    const Function depthFunction = ALLOW_ALWAYS;
-    glDepthFunc(convertToGL(depthFunction));
-    m_currentState.depthFunction = depthFunction;
-  }
-  else
-    glDepthFunc(convertToGL(newState.depthFunction));
+  glDepthFunc(convertToGL(effectiveDepthFunction(newState)));
 
   const GLboolean state = newState.colorWriting ? GL_TRUE : GL_FALSE;
   glColorMask(state, state, state, state);
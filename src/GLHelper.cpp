@@ -108,6 +108,30 @@ GLenum convertToGL(IndexBufferType type)
   panic("Invalid index buffer type %u", type);
 }
 
+GLenum convertToGL(VertexComponentType type)
+{
+  switch (type)
+  {
+    case VERTEX_FLOAT:
+      return GL_FLOAT;
+    case VERTEX_HALF:
+      return GL_HALF_FLOAT;
+    case VERTEX_BYTE_NORM:
+      return GL_BYTE;
+    case VERTEX_UBYTE_NORM:
+      return GL_UNSIGNED_BYTE;
+    case VERTEX_SHORT_NORM:
+    case VERTEX_OCTAHEDRAL:
+      return GL_SHORT;
+    case VERTEX_USHORT_NORM:
+      return GL_UNSIGNED_SHORT;
+    case VERTEX_PACKED:
+      return GL_INT_2_10_10_10_REV;
+  }
+
+  panic("Invalid vertex component type %u", type);
+}
+
 GLenum convertToGL(PixelFormat::Type type)
 {
   switch (type)
@@ -296,6 +320,44 @@ GLenum convertToGL(const PixelFormat& format, bool sRGB)
       break;
     }
 
+    case PixelFormat::BC1:
+    case PixelFormat::BC3:
+    {
+      if (!GLEW_EXT_texture_compression_s3tc)
+      {
+        logError("S3TC texture compression not supported; cannot convert pixel format");
+        return 0;
+      }
+
+      if (format.type() == PixelFormat::BC3)
+      {
+        if (sRGB)
+          return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+        else
+          return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      }
+
+      if (format.semantic() == PixelFormat::RGB)
+      {
+        if (sRGB)
+          return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+        else
+          return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      }
+      else
+      {
+        if (sRGB)
+          return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+        else
+          return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+      }
+    }
+
+    case PixelFormat::BC4:
+      return GL_COMPRESSED_RED_RGTC1;
+    case PixelFormat::BC5:
+      return GL_COMPRESSED_RG_RGTC2;
+
     default:
       break;
   }
@@ -345,6 +407,11 @@ GLfloat getFloat(GLenum token)
   return value;
 }
 
+///////////////////////////////////////////////////////////////////////
+
+BufferStorageProc bufferStorage = nullptr;
+MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace GL*/
@@ -37,6 +37,7 @@
 #include <internal/GLParser.hpp>
 
 #include <algorithm>
+#include <map>
 
 #include <cstring>
 
@@ -187,6 +188,31 @@ GLenum convertToGL(ShaderType type)
   panic("Invalid GLSL shader type %i", type);
 }
 
+struct LayoutEntry
+{
+  bool operator < (const LayoutEntry& other) const
+  {
+    if (nameID != other.nameID)
+      return nameID < other.nameID;
+    if (type != other.type)
+      return type < other.type;
+    return location < other.location;
+  }
+  NameID nameID;
+  AttributeType type;
+  int location;
+};
+
+typedef std::vector<LayoutEntry> Layout;
+
+// Maps each distinct attribute layout to a small non-zero ID, kept apart
+// from the global name table
+uint internLayout(const Layout& layout)
+{
+  static std::map<Layout, uint> layouts;
+  return layouts.insert(std::make_pair(layout, uint(layouts.size() + 1))).first->second;
+}
+
 } /*namespace*/
 
 ///////////////////////////////////////////////////////////////////////
@@ -380,6 +406,22 @@ void Attribute::bind(size_t stride, size_t offset)
 #endif
 }
 
+void Attribute::bind(size_t stride,
+                     size_t offset,
+                     const VertexComponent& component)
+{
+  glVertexAttribPointer(m_location,
+                        GLint(component.elementCount()),
+                        convertToGL(component.type()),
+                        component.isNormalized() ? GL_TRUE : GL_FALSE,
+                        stride,
+                        (const void*) offset);
+
+#if WENDY_DEBUG
+  checkGL("Failed to set attribute %s", m_name.c_str());
+#endif
+}
+
 const char* Attribute::typeName(AttributeType type)
 {
   switch (type)
@@ -401,7 +443,21 @@ const char* Attribute::typeName(AttributeType type)
 
 void Sampler::bind(uint unit)
 {
+  Stats* stats = m_program->context().stats();
+
+  if (m_unit == int(unit))
+  {
+    if (stats)
+      stats->addSamplerBinding(true);
+
+    return;
+  }
+
   glUniform1i(m_location, unit);
+  m_unit = unit;
+
+  if (stats)
+    stats->addSamplerBinding(false);
 
 #if WENDY_DEBUG
   checkGL("Failed to set sampler %s", m_name.c_str());
@@ -436,6 +492,20 @@ const char* Sampler::typeName(SamplerType type)
 
 void Uniform::copyFrom(const void* data)
 {
+  Stats* stats = m_program->context().stats();
+  const size_t size = elementCount() * sizeof(float);
+
+  if (m_cached && std::memcmp(m_value, data, size) == 0)
+  {
+    if (stats)
+      stats->addUniformUpload(true);
+
+    return;
+  }
+
+  std::memcpy(m_value, data, size);
+  m_cached = true;
+
   switch (m_type)
   {
     case UNIFORM_FLOAT:
@@ -461,6 +531,9 @@ void Uniform::copyFrom(const void* data)
       break;
   }
 
+  if (stats)
+    stats->addUniformUpload(false);
+
 #if WENDY_DEBUG
   checkGL("Failed to set uniform %s", m_name.c_str());
 #endif
@@ -538,62 +611,106 @@ Program::~Program()
   if (m_programID)
     glDeleteProgram(m_programID);
 
+  releaseID(m_ID);
+
   if (Stats* stats = m_context.stats())
     stats->removeProgram();
 }
 
 Attribute* Program::findAttribute(const char* name)
 {
-  auto a = std::find(m_attributes.begin(), m_attributes.end(), name);
-  if (a == m_attributes.end())
-    return nullptr;
-
-  return &(*a);
+  return findAttribute(findName(name));
 }
 
 const Attribute* Program::findAttribute(const char* name) const
 {
-  auto a = std::find(m_attributes.begin(), m_attributes.end(), name);
-  if (a == m_attributes.end())
-    return nullptr;
+  return findAttribute(findName(name));
+}
+
+Attribute* Program::findAttribute(NameID nameID)
+{
+  for (auto& a : m_attributes)
+  {
+    if (a.nameID() == nameID)
+      return &a;
+  }
 
-  return &(*a);
+  return nullptr;
 }
 
-Sampler* Program::findSampler(const char* name)
+const Attribute* Program::findAttribute(NameID nameID) const
 {
-  auto s = std::find(m_samplers.begin(), m_samplers.end(), name);
-  if (s == m_samplers.end())
-    return nullptr;
+  for (auto& a : m_attributes)
+  {
+    if (a.nameID() == nameID)
+      return &a;
+  }
 
-  return &(*s);
+  return nullptr;
+}
+
+Sampler* Program::findSampler(const char* name)
+{
+  return findSampler(findName(name));
 }
 
 const Sampler* Program::findSampler(const char* name) const
 {
-  auto s = std::find(m_samplers.begin(), m_samplers.end(), name);
-  if (s == m_samplers.end())
-    return nullptr;
+  return findSampler(findName(name));
+}
+
+Sampler* Program::findSampler(NameID nameID)
+{
+  for (auto& s : m_samplers)
+  {
+    if (s.nameID() == nameID)
+      return &s;
+  }
 
-  return &(*s);
+  return nullptr;
 }
 
-Uniform* Program::findUniform(const char* name)
+const Sampler* Program::findSampler(NameID nameID) const
 {
-  auto u = std::find(m_uniforms.begin(), m_uniforms.end(), name);
-  if (u == m_uniforms.end())
-    return nullptr;
+  for (auto& s : m_samplers)
+  {
+    if (s.nameID() == nameID)
+      return &s;
+  }
+
+  return nullptr;
+}
 
-  return &(*u);
+Uniform* Program::findUniform(const char* name)
+{
+  return findUniform(findName(name));
 }
 
 const Uniform* Program::findUniform(const char* name) const
 {
-  auto u = std::find(m_uniforms.begin(), m_uniforms.end(), name);
-  if (u == m_uniforms.end())
-    return nullptr;
+  return findUniform(findName(name));
+}
+
+Uniform* Program::findUniform(NameID nameID)
+{
+  for (auto& u : m_uniforms)
+  {
+    if (u.nameID() == nameID)
+      return &u;
+  }
+
+  return nullptr;
+}
+
+const Uniform* Program::findUniform(NameID nameID) const
+{
+  for (auto& u : m_uniforms)
+  {
+    if (u.nameID() == nameID)
+      return &u;
+  }
 
-  return &(*u);
+  return nullptr;
 }
 
 uint Program::attributeCount() const
@@ -694,7 +811,10 @@ Ref<Program> Program::read(Context& context,
 Program::Program(const ResourceInfo& info, Context& context):
   Resource(info),
   m_context(context),
-  m_programID(0)
+  m_programID(0),
+  m_ID(allocateID()),
+  m_stateTag(0),
+  m_layoutID(0)
 {
   if (Stats* stats = m_context.stats())
     stats->addProgram();
@@ -801,19 +921,25 @@ bool Program::retrieveUniforms()
     {
       m_uniforms.push_back(Uniform());
       Uniform& uniform = m_uniforms.back();
+      uniform.m_program = this;
+      uniform.m_cached = false;
       uniform.m_name = uniformName;
+      uniform.m_nameID = internName(uniformName);
       uniform.m_type = convertUniformType(uniformType);
       uniform.m_location = glGetUniformLocation(m_programID, uniformName);
-      uniform.m_sharedID = m_context.sharedUniformID(uniformName, uniform.type());
+      uniform.m_sharedID = m_context.sharedUniformID(uniform.m_nameID, uniform.type());
     }
     else if (isSupportedSamplerType(uniformType))
     {
       m_samplers.push_back(Sampler());
       Sampler& sampler = m_samplers.back();
+      sampler.m_program = this;
+      sampler.m_unit = -1;
       sampler.m_name = uniformName;
+      sampler.m_nameID = internName(uniformName);
       sampler.m_type = convertSamplerType(uniformType);
       sampler.m_location = glGetUniformLocation(m_programID, uniformName);
-      sampler.m_sharedID = m_context.sharedSamplerID(uniformName, sampler.type());
+      sampler.m_sharedID = m_context.sharedSamplerID(sampler.m_nameID, sampler.type());
     }
     else
       logWarning("Skipping uniform %s of unsupported type", uniformName);
@@ -862,6 +988,7 @@ bool Program::retrieveAttributes()
     m_attributes.push_back(Attribute());
     Attribute& attribute = m_attributes.back();
     attribute.m_name = attributeName;
+    attribute.m_nameID = internName(attributeName);
     attribute.m_type = convertAttributeType(attributeType);
     attribute.m_location = glGetAttribLocation(m_programID, attributeName);
   }
@@ -871,21 +998,25 @@ bool Program::retrieveAttributes()
   if (!checkGL("Failed to retrieve attributes for program %s", name().c_str()))
     return false;
 
+  // Programs with identical attribute layouts can share vertex arrays, so
+  // intern the layout
+  Layout layout;
+  layout.reserve(m_attributes.size());
+
+  for (auto& a : m_attributes)
+  {
+    const LayoutEntry entry = { a.m_nameID, a.m_type, a.m_location };
+    layout.push_back(entry);
+  }
+
+  m_layoutID = internLayout(layout);
+
   return true;
 }
 
 void Program::bind()
 {
   glUseProgram(m_programID);
-
-  for (auto& a : m_attributes)
-    glEnableVertexAttribArray(a.m_location);
-}
-
-void Program::unbind()
-{
-  for (auto& a : m_attributes)
-    glDisableVertexAttribArray(a.m_location);
 }
 
 bool Program::isValid() const
@@ -921,6 +1052,25 @@ String Program::infoLog() const
   return result;
 }
 
+uint Program::allocateID()
+{
+  if (m_usedIDs.empty())
+    return m_nextID++;
+
+  const uint ID = m_usedIDs.back();
+  m_usedIDs.pop_back();
+  return ID;
+}
+
+void Program::releaseID(uint ID)
+{
+  m_usedIDs.push_back(ID);
+}
+
+std::vector<uint> Program::m_usedIDs;
+
+uint Program::m_nextID = 0;
+
 ///////////////////////////////////////////////////////////////////////
 
 void ProgramInterface::addSampler(const char* name, SamplerType type)
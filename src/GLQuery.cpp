@@ -151,6 +151,80 @@ bool OcclusionQuery::init()
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////
+
+Fence::~Fence()
+{
+  release();
+}
+
+void Fence::set()
+{
+  release();
+
+  m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+#if WENDY_DEBUG
+  checkGL("OpenGL error during fence set");
+#endif
+}
+
+void Fence::wait()
+{
+  if (!m_sync)
+    return;
+
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+
+  for (;;)
+  {
+    const GLenum result = glClientWaitSync((GLsync) m_sync, flags, 1000000);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+      break;
+
+    if (result == GL_WAIT_FAILED)
+    {
+      checkGL("OpenGL error during fence wait");
+      break;
+    }
+
+    // The commands have been flushed by now
+    flags = 0;
+  }
+
+  release();
+}
+
+bool Fence::isSignaled() const
+{
+  if (!m_sync)
+    return true;
+
+  GLint status;
+  glGetSynciv((GLsync) m_sync, GL_SYNC_STATUS, 1, nullptr, &status);
+  return status == GL_SIGNALED;
+}
+
+Ref<Fence> Fence::create(Context& context)
+{
+  return new Fence(context);
+}
+
+Fence::Fence(Context& context):
+  m_context(context),
+  m_sync(nullptr)
+{
+}
+
+void Fence::release()
+{
+  if (m_sync)
+  {
+    glDeleteSync((GLsync) m_sync);
+    m_sync = nullptr;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace GL*/
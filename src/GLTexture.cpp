@@ -34,9 +34,14 @@
 #include <GL/glew.h>
 
 #include <internal/GLHelper.hpp>
+#include <internal/MappedFile.hpp>
+#include <internal/PNGDecoder.hpp>
 
 #include <glm/gtx/bit.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -166,6 +171,8 @@ TextureData::TextureData(const Image& image):
   depth(image.depth()),
   texels(image.pixels())
 {
+  for (auto& m : image.mipmaps())
+    mipmaps.push_back(m->pixels());
 }
 
 TextureData::TextureData(PixelFormat initFormat,
@@ -201,7 +208,10 @@ uint TextureData::dimensionCount() const
 
 TextureParams::TextureParams(TextureType initType, uint initFlags):
   type(initType),
-  flags(initFlags)
+  flags(initFlags),
+  mipmapFilter(MIPMAP_BOX),
+  alphaReference(0.f),
+  pool(nullptr)
 {
   if (type == TEXTURE_RECT)
     flags &= ~TF_MIPMAPPED;
@@ -219,7 +229,25 @@ bool TextureImage::copyFrom(const Image& source, uint x, uint y, uint z)
     return false;
   }
 
-  if (m_texture.is1D())
+  if (m_texture.format().isCompressed())
+  {
+    m_texture.context().setCurrentTexture(&m_texture);
+
+    GLint internalFormat;
+    glGetTexLevelParameteriv(convertToGL(m_texture.type()),
+                             m_level,
+                             GL_TEXTURE_INTERNAL_FORMAT,
+                             &internalFormat);
+
+    glCompressedTexSubImage2D(convertToGL(m_texture.type()),
+                              m_level,
+                              x, y,
+                              source.width(), source.height(),
+                              internalFormat,
+                              GLsizei(source.size()),
+                              source.pixels());
+  }
+  else if (m_texture.is1D())
   {
     if (source.dimensionCount() > 1)
     {
@@ -292,11 +320,20 @@ Ref<Image> TextureImage::data() const
 
   m_texture.context().setCurrentTexture(&m_texture);
 
-  glGetTexImage(convertToGL(m_texture.type()),
-                m_level,
-                convertToGL(m_texture.format().semantic()),
-                convertToGL(m_texture.format().type()),
-                result->pixels());
+  if (m_texture.format().isCompressed())
+  {
+    glGetCompressedTexImage(convertToGL(m_texture.type()),
+                            m_level,
+                            result->pixels());
+  }
+  else
+  {
+    glGetTexImage(convertToGL(m_texture.type()),
+                  m_level,
+                  convertToGL(m_texture.format().semantic()),
+                  convertToGL(m_texture.format().type()),
+                  result->pixels());
+  }
 
 #if WENDY_DEBUG
   if (!checkGL("Error during copy to image from level %u of texture %s",
@@ -312,7 +349,7 @@ Ref<Image> TextureImage::data() const
 
 size_t TextureImage::size() const
 {
-  return m_width * m_height * m_depth * m_texture.format().size();
+  return m_texture.format().imageSize(m_width, m_height, m_depth);
 }
 
 TextureImage::TextureImage(Texture& texture,
@@ -403,12 +440,27 @@ Texture::~Texture()
   if (m_textureID)
     glDeleteTextures(1, &m_textureID);
 
+  releaseID(m_ID);
+
   if (Stats* stats = m_context.stats())
     stats->removeTexture(size());
 }
 
 void Texture::generateMipmaps()
 {
+  if (m_format.isCompressed())
+  {
+    logWarning("Cannot generate mipmaps for block-compressed texture %s; "
+               "mipmaps must be provided with the source image",
+               name().c_str());
+
+    // Still describe the levels provided when called during creation
+    if (m_images.empty())
+      retrieveImages();
+
+    return;
+  }
+
   glGenerateMipmap(convertToGL(m_type));
 
   if (!hasMipmaps())
@@ -566,13 +618,7 @@ Ref<Texture> Texture::read(Context& context,
 {
   ResourceCache& cache = context.cache();
 
-  String name;
-  name += "source:";
-  name += imageName;
-  name += " mipmapped:";
-  name += (params.flags & TF_MIPMAPPED) ? "true" : "false";
-  name += " sRGB:";
-  name += (params.flags & TF_SRGB) ? "true" : "false";
+  const String name = cacheName(params, imageName);
 
   if (Ref<Texture> texture = cache.find<Texture>(name))
     return texture;
@@ -591,6 +637,7 @@ Texture::Texture(const ResourceInfo& info, Context& context):
   Resource(info),
   m_context(context),
   m_textureID(0),
+  m_ID(allocateID()),
   m_levels(0),
   m_filterMode(FILTER_BILINEAR),
   m_addressMode(ADDRESS_WRAP),
@@ -614,6 +661,13 @@ bool Texture::init(const TextureParams& params, const TextureData& data)
     return false;
   }
 
+  if (m_format.isCompressed() && m_type != TEXTURE_2D)
+  {
+    logError("Block-compressed texture %s must be two-dimensional",
+             name().c_str());
+    return false;
+  }
+
   // Figure out which texture target to use
 
   if (m_type == TEXTURE_RECT)
@@ -699,6 +753,17 @@ bool Texture::init(const TextureParams& params, const TextureData& data)
                  convertToGL(m_format.type()),
                  nullptr);
   }
+  else if (m_format.isCompressed())
+  {
+    glCompressedTexImage2D(convertToProxyGL(m_type),
+                           0,
+                           convertToGL(m_format, sRGB),
+                           width,
+                           height,
+                           0,
+                           GLsizei(m_format.imageSize(width, height)),
+                           nullptr);
+  }
   else
   {
     glTexImage2D(convertToProxyGL(m_type),
@@ -729,6 +794,31 @@ bool Texture::init(const TextureParams& params, const TextureData& data)
     return false;
   }
 
+  std::vector<const void*> mipmaps = data.mipmaps;
+  Ref<Image> source;
+
+  // Generate the mipmap chain on the CPU where possible, so that the filter
+  // does not depend on the driver and sRGB textures are filtered correctly.
+  // Textures without initial texels are left to glGenerateMipmap
+  if (mipmapped && mipmaps.empty() && data.texels && m_type == TEXTURE_2D &&
+      Image::canGenerateMipmaps(m_format))
+  {
+    source = Image::create(cache(), m_format, width, height, 1, data.texels);
+    if (!source)
+      return false;
+
+    if (!source->generateMipmaps(params.mipmapFilter,
+                                 sRGB,
+                                 params.alphaReference,
+                                 params.pool))
+    {
+      return false;
+    }
+
+    for (auto& m : source->mipmaps())
+      mipmaps.push_back(m->pixels());
+  }
+
   glGenTextures(1, &m_textureID);
 
   m_context.setCurrentTexture(this);
@@ -788,17 +878,58 @@ bool Texture::init(const TextureParams& params, const TextureData& data)
   }
   else
   {
-    glTexImage2D(convertToGL(m_type),
-                 0,
-                 convertToGL(m_format, sRGB),
-                 width, height,
-                 0,
-                 convertToGL(m_format.semantic()),
-                 convertToGL(m_format.type()),
-                 data.texels);
+    const uint levelCount = mipmapped ? uint(mipmaps.size() + 1) : 1;
+
+    for (uint level = 0;  level < levelCount;  level++)
+    {
+      const void* texels = level ? mipmaps[level - 1] : data.texels;
+
+      if (m_format.isCompressed())
+      {
+        glCompressedTexImage2D(convertToGL(m_type),
+                               level,
+                               convertToGL(m_format, sRGB),
+                               width, height,
+                               0,
+                               GLsizei(m_format.imageSize(width, height)),
+                               texels);
+      }
+      else
+      {
+        glTexImage2D(convertToGL(m_type),
+                     level,
+                     convertToGL(m_format, sRGB),
+                     width, height,
+                     0,
+                     convertToGL(m_format.semantic()),
+                     convertToGL(m_format.type()),
+                     texels);
+      }
+
+      width = std::max(width / 2, 1u);
+      height = std::max(height / 2, 1u);
+    }
+
+    if (levelCount > 1)
+      glTexParameteri(convertToGL(m_type), GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    // Single-channel formats are read as red by default
+    if (GLEW_ARB_texture_swizzle)
+    {
+      if (m_format.type() == PixelFormat::BC4)
+      {
+        const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        glTexParameteriv(convertToGL(m_type), GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+      }
+      else if (m_format.type() == PixelFormat::BC5)
+      {
+        const GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        glTexParameteriv(convertToGL(m_type), GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+      }
+    }
   }
 
-  if (mipmapped)
+  if (mipmapped && mipmaps.empty())
     generateMipmaps();
   else
     retrieveImages();
@@ -818,6 +949,41 @@ bool Texture::init(const TextureParams& params, const TextureData& data)
   return true;
 }
 
+String Texture::cacheName(const TextureParams& params, const String& imageName)
+{
+  String name;
+  name += "source:";
+  name += imageName;
+  name += " mipmapped:";
+  name += (params.flags & TF_MIPMAPPED) ? "true" : "false";
+  name += " sRGB:";
+  name += (params.flags & TF_SRGB) ? "true" : "false";
+
+  if (params.flags & TF_MIPMAPPED)
+  {
+    name += " filter:";
+    name += (params.mipmapFilter == MIPMAP_KAISER) ? "kaiser" : "box";
+    name += wendy::format(" alphaReference:%g", params.alphaReference);
+  }
+
+  return name;
+}
+
+uint Texture::allocateID()
+{
+  if (m_usedIDs.empty())
+    return m_nextID++;
+
+  const uint ID = m_usedIDs.back();
+  m_usedIDs.pop_back();
+  return ID;
+}
+
+void Texture::releaseID(uint ID)
+{
+  m_usedIDs.push_back(ID);
+}
+
 void Texture::retrieveImages()
 {
   m_images.clear();
@@ -872,6 +1038,416 @@ void Texture::applyDefaults()
   glTexParameteri(convertToGL(m_type), GL_TEXTURE_WRAP_R, convertToGL(m_addressMode));
 }
 
+std::vector<uint> Texture::m_usedIDs;
+
+uint Texture::m_nextID = 0;
+
+///////////////////////////////////////////////////////////////////////
+
+class TextureLoader::Request : public RefObject
+{
+public:
+  enum State
+  {
+    OPENING,
+    OPENED,
+    DECODING,
+    DECODED,
+    READ,
+    CACHED,
+    FAILED
+  };
+  Request(const TextureParams& params);
+  TextureParams params;
+  String imageName;
+  String name;
+  Path path;
+  Callback callback;
+  State state;
+  MappedFile file;
+  PNGDecoder decoder;
+  uint bufferID;
+  void* mapping;
+  std::vector<size_t> offsets;
+  Ref<Texture> texture;
+};
+
+TextureLoader::Request::Request(const TextureParams& initParams):
+  params(initParams),
+  state(OPENING),
+  bufferID(0),
+  mapping(nullptr)
+{
+}
+
+///////////////////////////////////////////////////////////////////////
+
+TextureLoader::~TextureLoader()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return m_taskCount == 0; });
+  }
+
+  for (auto& r : m_requests)
+  {
+    if (r->mapping)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, r->bufferID);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (r->bufferID)
+      m_buffers.push_back(r->bufferID);
+  }
+
+  if (!m_buffers.empty())
+    glDeleteBuffers(GLsizei(m_buffers.size()), &m_buffers[0]);
+}
+
+void TextureLoader::request(const TextureParams& params,
+                            const String& imageName,
+                            const Callback& callback)
+{
+  ResourceCache& cache = m_context.cache();
+
+  Ref<Request> request = new Request(params);
+  request->imageName = imageName;
+  request->name = Texture::cacheName(params, imageName);
+  request->callback = callback;
+
+  request->texture = cache.find<Texture>(request->name);
+  if (request->texture)
+    request->state = Request::CACHED;
+  else if (cache.find<Image>(imageName))
+    request->state = Request::READ;
+  else
+  {
+    request->path = cache.findFile(imageName);
+    if (request->path.isEmpty())
+    {
+      logError("Failed to find image %s for texture %s",
+               imageName.c_str(),
+               request->name.c_str());
+      request->state = Request::FAILED;
+    }
+    else
+    {
+      const String suffix = request->path.suffix();
+
+      // Only PNG files are decoded in the background
+      if (suffix == "ktx" || suffix == "KTX" || suffix == "dds" || suffix == "DDS")
+        request->state = Request::READ;
+      else
+      {
+        Request* target = request;
+
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_taskCount++;
+        }
+
+        m_pool.submit([this, target] { open(*target); });
+      }
+    }
+  }
+
+  m_requests.push_back(request);
+}
+
+void TextureLoader::update()
+{
+  std::vector<Ref<Request>> opened, completed;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& r : m_requests)
+    {
+      if (r->state == Request::OPENED)
+        opened.push_back(r);
+      else if (r->state != Request::OPENING && r->state != Request::DECODING)
+        completed.push_back(r);
+    }
+  }
+
+  // Decodes are started without holding the lock, as a pool without workers
+  // runs them inline and they lock it on finishing
+  for (auto& r : opened)
+  {
+    if (m_mappedCount < m_maxBuffers)
+      start(*r);
+  }
+
+  if (completed.empty())
+    return;
+
+  for (auto& r : completed)
+  {
+    m_requests.erase(std::find(m_requests.begin(), m_requests.end(), r));
+    complete(*r);
+  }
+
+  // Callbacks may request more textures, so they are called last
+  for (auto& r : completed)
+  {
+    if (r->callback)
+      r->callback(r->texture);
+  }
+}
+
+void TextureLoader::finish()
+{
+  while (!m_requests.empty())
+  {
+    update();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return isReady(); });
+  }
+}
+
+Ref<TextureLoader> TextureLoader::create(Context& context,
+                                         ThreadPool& pool,
+                                         uint maxBuffers)
+{
+  Ref<TextureLoader> loader(new TextureLoader(context, pool));
+  if (!loader->init(maxBuffers))
+    return nullptr;
+
+  return loader;
+}
+
+TextureLoader::TextureLoader(Context& context, ThreadPool& pool):
+  m_context(context),
+  m_pool(pool),
+  m_mappedCount(0),
+  m_maxBuffers(0),
+  m_taskCount(0)
+{
+}
+
+bool TextureLoader::init(uint maxBuffers)
+{
+  if (maxBuffers)
+    m_maxBuffers = maxBuffers;
+  else
+    m_maxBuffers = std::max(m_pool.workerCount() * 2, 2u);
+
+  return true;
+}
+
+void TextureLoader::start(Request& request)
+{
+  const PNGDecoder& decoder = request.decoder;
+  const PixelFormat& format = decoder.format();
+
+  uint width = decoder.width();
+  uint height = decoder.height();
+  size_t size = format.size() * width * height;
+
+  request.offsets.push_back(0);
+
+  // Mipmaps that Texture::init would generate on the CPU are generated by the
+  // worker instead and uploaded along with the base level
+  if ((request.params.flags & TF_MIPMAPPED) &&
+      request.params.type == TEXTURE_2D &&
+      Image::canGenerateMipmaps(format))
+  {
+    while (width > 1 || height > 1)
+    {
+      width = std::max(width / 2, 1u);
+      height = std::max(height / 2, 1u);
+
+      request.offsets.push_back(size);
+      size += format.size() * width * height;
+    }
+  }
+
+  if (m_buffers.empty())
+    glGenBuffers(1, &request.bufferID);
+  else
+  {
+    request.bufferID = m_buffers.back();
+    m_buffers.pop_back();
+  }
+
+  // Respecifying the storage lets the driver hand out new memory if the
+  // previous contents of the buffer are still being uploaded
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request.bufferID);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  request.mapping = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                     0, size,
+                                     GL_MAP_WRITE_BIT |
+                                     GL_MAP_INVALIDATE_BUFFER_BIT);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (!request.mapping)
+  {
+    checkGL("Failed to map unpack buffer for texture %s",
+            request.name.c_str());
+    request.state = Request::FAILED;
+    return;
+  }
+
+  m_mappedCount++;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_taskCount++;
+    request.state = Request::DECODING;
+  }
+
+  Request* target = &request;
+  m_pool.submit([this, target] { decode(*target); });
+}
+
+void TextureLoader::complete(Request& request)
+{
+  ResourceCache& cache = m_context.cache();
+
+  if (request.state == Request::READ)
+    request.texture = Texture::read(m_context, request.params, request.imageName);
+  else if (request.mapping)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, request.bufferID);
+
+    const bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) ? true : false;
+
+    request.mapping = nullptr;
+    m_mappedCount--;
+
+    // The same texture may have been requested more than once
+    if (request.state == Request::DECODED)
+      request.texture = cache.find<Texture>(request.name);
+
+    if (!request.texture && request.state == Request::DECODED)
+    {
+      if (intact)
+      {
+        const PNGDecoder& decoder = request.decoder;
+
+        // With an unpack buffer bound, texel pointers are offsets into it
+        TextureData data(decoder.format(),
+                         decoder.width(),
+                         decoder.height(),
+                         1,
+                         (const void*) request.offsets[0]);
+
+        for (size_t i = 1;  i < request.offsets.size();  i++)
+          data.mipmaps.push_back((const void*) request.offsets[i]);
+
+        request.texture = Texture::create(ResourceInfo(cache, request.name),
+                                          m_context,
+                                          request.params,
+                                          data);
+      }
+      else
+        logError("Unpack buffer for texture %s was lost", request.name.c_str());
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  if (request.bufferID)
+  {
+    m_buffers.push_back(request.bufferID);
+    request.bufferID = 0;
+  }
+
+  if (!request.texture && request.state != Request::CACHED)
+    logError("Failed to read image for texture %s", request.name.c_str());
+}
+
+void TextureLoader::open(Request& request)
+{
+  bool success = false;
+
+  if (request.file.open(request.path))
+  {
+    success = request.decoder.open(request.file.data(),
+                                   request.file.size(),
+                                   request.imageName);
+  }
+  else
+    logError("Failed to open image file %s", request.path.name().c_str());
+
+  finishTask(request, success ? Request::OPENED : Request::FAILED);
+}
+
+void TextureLoader::decode(Request& request)
+{
+  PNGDecoder& decoder = request.decoder;
+  char* target = static_cast<char*>(request.mapping);
+  bool success = false;
+
+  if (request.offsets.size() > 1)
+  {
+    // The mipmap filter reads the base level, which is slow to do from the
+    // write-combined memory of a mapped buffer
+    Ref<Image> image = Image::create(m_context.cache(),
+                                     decoder.format(),
+                                     decoder.width(),
+                                     decoder.height());
+
+    if (image && decoder.decode(image->pixels()))
+    {
+      const TextureParams& params = request.params;
+      const bool sRGB = (params.flags & TF_SRGB) ? true : false;
+
+      // The pool cannot be used from within one of its own tasks
+      if (image->generateMipmaps(params.mipmapFilter, sRGB, params.alphaReference))
+      {
+        std::memcpy(target, image->pixels(), image->size());
+
+        const ImageList& mipmaps = image->mipmaps();
+
+        for (size_t i = 0;  i < mipmaps.size();  i++)
+        {
+          std::memcpy(target + request.offsets[i + 1],
+                      mipmaps[i]->pixels(),
+                      mipmaps[i]->size());
+        }
+
+        success = true;
+      }
+    }
+  }
+  else
+    success = decoder.decode(target);
+
+  finishTask(request, success ? Request::DECODED : Request::FAILED);
+}
+
+void TextureLoader::finishTask(Request& request, int state)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  request.state = Request::State(state);
+  m_taskCount--;
+  m_condition.notify_all();
+}
+
+bool TextureLoader::isReady() const
+{
+  if (m_taskCount == 0)
+    return true;
+
+  for (auto& r : m_requests)
+  {
+    if (r->state == Request::OPENED)
+    {
+      if (m_mappedCount < m_maxBuffers)
+        return true;
+    }
+    else if (r->state != Request::OPENING && r->state != Request::DECODING)
+      return true;
+  }
+
+  return false;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace GL*/
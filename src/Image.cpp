@@ -31,8 +31,16 @@
 #include <wendy/Pixel.hpp>
 #include <wendy/Resource.hpp>
 #include <wendy/Image.hpp>
+#include <wendy/Thread.hpp>
 
+#include <internal/BlockCompression.hpp>
+#include <internal/ImageFilter.hpp>
+#include <internal/MappedFile.hpp>
+#include <internal/PNGDecoder.hpp>
+
+#include <algorithm>
 #include <cstring>
+#include <limits>
 
 #include <pugixml.hpp>
 
@@ -84,41 +92,6 @@ bool convertToColorType(int& result, const PixelFormat& format)
   }
 }
 
-PixelFormat::Semantic convertToSemantic(int colorType)
-{
-  switch (colorType)
-  {
-    case PNG_COLOR_TYPE_GRAY:
-      return PixelFormat::L;
-    case PNG_COLOR_TYPE_GRAY_ALPHA:
-      return PixelFormat::LA;
-    case PNG_COLOR_TYPE_RGB:
-      return PixelFormat::RGB;
-    case PNG_COLOR_TYPE_RGB_ALPHA:
-      return PixelFormat::RGBA;
-  }
-
-  return PixelFormat::NONE;
-}
-
-PixelFormat::Type convertToType(int bitDepth)
-{
-  switch (bitDepth)
-  {
-    case 8:
-      return PixelFormat::UINT8;
-    case 16:
-      return PixelFormat::UINT16;
-  }
-
-  return PixelFormat::DUMMY;
-}
-
-PixelFormat convertToPixelFormat(int colorType, int bitDepth)
-{
-  return PixelFormat(convertToSemantic(colorType), convertToType(bitDepth));
-}
-
 void writeErrorPNG(png_structp context, png_const_charp error)
 {
   logError("libpng error: %s", error);
@@ -129,12 +102,6 @@ void writeWarningPNG(png_structp context, png_const_charp warning)
   logWarning("libpng warning: %s", warning);
 }
 
-void readStreamPNG(png_structp context, png_bytep data, png_size_t length)
-{
-  std::ifstream* stream = reinterpret_cast<std::ifstream*>(png_get_io_ptr(context));
-  stream->read((char*) data, length);
-}
-
 void writeStreamPNG(png_structp context, png_bytep data, png_size_t length)
 {
   std::ofstream* stream = reinterpret_cast<std::ofstream*>(png_get_io_ptr(context));
@@ -149,6 +116,199 @@ void flushStreamPNG(png_structp context)
 
 const uint IMAGE_CUBE_XML_VERSION = 2;
 
+const uint8 KTX_IDENTIFIER[12] =
+{
+  0xab, 0x4b, 0x54, 0x58, 0x20, 0x31, 0x31, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+const uint32 KTX_ENDIANNESS = 0x04030201;
+
+class KTXHeader
+{
+public:
+  uint8 identifier[12];
+  uint32 endianness;
+  uint32 glType;
+  uint32 glTypeSize;
+  uint32 glFormat;
+  uint32 glInternalFormat;
+  uint32 glBaseInternalFormat;
+  uint32 pixelWidth;
+  uint32 pixelHeight;
+  uint32 pixelDepth;
+  uint32 numberOfArrayElements;
+  uint32 numberOfFaces;
+  uint32 numberOfMipmapLevels;
+  uint32 bytesOfKeyValueData;
+};
+
+/* OpenGL enumerants for the pixel formats that can be stored in KTX files.
+ * The first entry for each pixel format is used when writing.
+ */
+class KTXFormat
+{
+public:
+  PixelFormat::Semantic semantic;
+  PixelFormat::Type type;
+  uint32 internalFormat;
+  uint32 baseFormat;
+};
+
+const uint32 KTX_UNSIGNED_BYTE = 0x1401;
+
+const KTXFormat KTX_FORMATS[] =
+{
+  { PixelFormat::L, PixelFormat::UINT8, 0x8040, 0x1909 },
+  { PixelFormat::L, PixelFormat::UINT8, 0x8229, 0x1903 },
+  { PixelFormat::LA, PixelFormat::UINT8, 0x8045, 0x190a },
+  { PixelFormat::LA, PixelFormat::UINT8, 0x822b, 0x8227 },
+  { PixelFormat::RGB, PixelFormat::UINT8, 0x8051, 0x1907 },
+  { PixelFormat::RGB, PixelFormat::UINT8, 0x8c41, 0x1907 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, 0x8058, 0x1908 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, 0x8c43, 0x1908 },
+  { PixelFormat::RGB, PixelFormat::BC1, 0x83f0, 0x1907 },
+  { PixelFormat::RGB, PixelFormat::BC1, 0x8c4c, 0x1907 },
+  { PixelFormat::RGBA, PixelFormat::BC1, 0x83f1, 0x1908 },
+  { PixelFormat::RGBA, PixelFormat::BC1, 0x8c4d, 0x1908 },
+  { PixelFormat::RGBA, PixelFormat::BC3, 0x83f3, 0x1908 },
+  { PixelFormat::RGBA, PixelFormat::BC3, 0x8c4f, 0x1908 },
+  { PixelFormat::L, PixelFormat::BC4, 0x8dbb, 0x1903 },
+  { PixelFormat::LA, PixelFormat::BC5, 0x8dbd, 0x8227 }
+};
+
+const char DDS_MAGIC[4] = { 'D', 'D', 'S', ' ' };
+
+const uint32 DDPF_ALPHAPIXELS = 0x1;
+const uint32 DDPF_FOURCC = 0x4;
+const uint32 DDPF_RGB = 0x40;
+const uint32 DDPF_LUMINANCE = 0x20000;
+const uint32 DDSCAPS2_CUBEMAP = 0x200;
+const uint32 DDSCAPS2_VOLUME = 0x200000;
+
+class DDSPixelFormat
+{
+public:
+  uint32 size;
+  uint32 flags;
+  char fourCC[4];
+  uint32 bitCount;
+  uint32 redMask;
+  uint32 greenMask;
+  uint32 blueMask;
+  uint32 alphaMask;
+};
+
+class DDSHeader
+{
+public:
+  char magic[4];
+  uint32 size;
+  uint32 flags;
+  uint32 height;
+  uint32 width;
+  uint32 pitchOrLinearSize;
+  uint32 depth;
+  uint32 mipMapCount;
+  uint32 reserved1[11];
+  DDSPixelFormat pixelFormat;
+  uint32 caps;
+  uint32 caps2;
+  uint32 caps3;
+  uint32 caps4;
+  uint32 reserved2;
+};
+
+class DDSHeaderDX10
+{
+public:
+  uint32 dxgiFormat;
+  uint32 resourceDimension;
+  uint32 miscFlag;
+  uint32 arraySize;
+  uint32 miscFlags2;
+};
+
+PixelFormat convertFourCC(const DDSPixelFormat& format)
+{
+  const String fourCC(format.fourCC, format.fourCC + 4);
+
+  if (fourCC == "DXT1")
+  {
+    if (format.flags & DDPF_ALPHAPIXELS)
+      return PixelFormat::RGBA_BC1;
+    else
+      return PixelFormat::RGB_BC1;
+  }
+  else if (fourCC == "DXT5")
+    return PixelFormat::RGBA_BC3;
+  else if (fourCC == "ATI1" || fourCC == "BC4U")
+    return PixelFormat::L_BC4;
+  else if (fourCC == "ATI2" || fourCC == "BC5U")
+    return PixelFormat::LA_BC5;
+
+  return PixelFormat();
+}
+
+PixelFormat convertDXGI(uint32 format)
+{
+  switch (format)
+  {
+    case 28:
+    case 29:
+      return PixelFormat::RGBA8;
+    case 49:
+      return PixelFormat::LA8;
+    case 61:
+      return PixelFormat::L8;
+    case 71:
+    case 72:
+      return PixelFormat::RGBA_BC1;
+    case 77:
+    case 78:
+      return PixelFormat::RGBA_BC3;
+    case 80:
+      return PixelFormat::L_BC4;
+    case 83:
+      return PixelFormat::LA_BC5;
+  }
+
+  return PixelFormat();
+}
+
+// Computes the size of a KTX image level, including the padding of all but
+// the last row, failing if it does not fit in a size_t
+bool getKTXLevelSize(const PixelFormat& format, uint width, uint height, size_t& size)
+{
+  const size_t limit = std::numeric_limits<size_t>::max();
+
+  size_t rowCount, rowSize, pitch;
+
+  if (format.isCompressed())
+  {
+    const size_t blockCount = (size_t(width) + 3) / 4;
+    if (blockCount > limit / format.blockSize())
+      return false;
+
+    rowCount = (size_t(height) + 3) / 4;
+    rowSize = pitch = blockCount * format.blockSize();
+  }
+  else
+  {
+    if (width > (limit - 3) / format.size())
+      return false;
+
+    rowCount = height;
+    rowSize = width * format.size();
+    pitch = (rowSize + 3) & ~size_t(3);
+  }
+
+  if (rowCount > 1 && pitch > (limit - rowSize) / (rowCount - 1))
+    return false;
+
+  size = pitch * (rowCount - 1) + rowSize;
+  return true;
+}
+
 } /*namespace*/
 
 ///////////////////////////////////////////////////////////////////////
@@ -158,19 +318,26 @@ bool Image::transformTo(const PixelFormat& format, PixelTransform& transform)
   if (m_format == format)
     return true;
 
-  if (!transform.supports(format, m_format))
-    return false;
+  return convertPixels(format, transform);
+}
 
-  std::vector<char> temp(m_width * m_height * m_depth * format.size());
-  transform.convert(&temp[0], format, &m_data[0], m_format, m_width * m_height * m_depth);
-  std::swap(m_data, temp);
+bool Image::transformTo(const PixelFormat& format, uint flags, ThreadPool* pool)
+{
+  if (m_format == format && flags == PT_NONE)
+    return true;
 
-  m_format = format;
-  return true;
+  PixelConverter converter(flags, pool);
+  return convertPixels(format, converter);
 }
 
 bool Image::crop(const Recti& area)
 {
+  if (m_format.isCompressed())
+  {
+    logError("Cannot crop block-compressed image");
+    return false;
+  }
+
   if (dimensionCount() > 2)
   {
     logError("Cannot 2D crop 3D image");
@@ -197,11 +364,43 @@ bool Image::crop(const Recti& area)
   m_height = area.size.y;
 
   std::swap(m_data, temp);
+
+  // The mipmaps no longer match
+  m_mipmaps.clear();
   return true;
 }
 
 void Image::flipHorizontal()
 {
+  for (auto& m : m_mipmaps)
+    m->flipHorizontal();
+
+  if (m_format.isCompressed())
+  {
+    if (m_height > 4 && m_height % 4 != 0)
+    {
+      logError("Cannot flip block-compressed image with height %u", m_height);
+      return;
+    }
+
+    const size_t blockSize = m_format.blockSize();
+    const size_t rowSize = ((m_width + 3) / 4) * blockSize;
+    const size_t rowCount = (m_height + 3) / 4;
+    const uint rows = std::min(m_height, 4u);
+
+    for (size_t y = 0;  y < rowCount / 2;  y++)
+    {
+      std::swap_ranges(m_data.begin() + y * rowSize,
+                       m_data.begin() + (y + 1) * rowSize,
+                       m_data.begin() + (rowCount - y - 1) * rowSize);
+    }
+
+    for (size_t i = 0;  i < m_data.size();  i += blockSize)
+      flipBlock((uint8*) &m_data[i], m_format, rows);
+
+    return;
+  }
+
   const size_t rowSize = m_width * m_format.size();
   std::vector<char> temp(m_data.size());
 
@@ -222,6 +421,15 @@ void Image::flipHorizontal()
 
 void Image::flipVertical()
 {
+  if (m_format.isCompressed())
+  {
+    logError("Cannot flip block-compressed image along the y axis");
+    return;
+  }
+
+  for (auto& m : m_mipmaps)
+    m->flipVertical();
+
   const size_t pixelSize = m_format.size();
   std::vector<char> temp(m_data.size());
 
@@ -251,7 +459,7 @@ bool Image::isPOT() const
 
 void* Image::pixel(uint x, uint y, uint z)
 {
-  if (x >= m_width || y >= m_height || z >= m_depth)
+  if (x >= m_width || y >= m_height || z >= m_depth || m_format.isCompressed())
     return nullptr;
 
   return &m_data[0] + ((z * m_height + y) * m_width + x) * m_format.size();
@@ -259,7 +467,7 @@ void* Image::pixel(uint x, uint y, uint z)
 
 const void* Image::pixel(uint x, uint y, uint z) const
 {
-  if (x >= m_width || y >= m_height || z >= m_depth)
+  if (x >= m_width || y >= m_height || z >= m_depth || m_format.isCompressed())
     return nullptr;
 
   return &m_data[0] + ((z * m_height + y) * m_width + x) * m_format.size();
@@ -278,6 +486,12 @@ uint Image::dimensionCount() const
 
 Ref<Image> Image::area(const Recti& area) const
 {
+  if (m_format.isCompressed())
+  {
+    logError("Cannot retrieve area of block-compressed image");
+    return nullptr;
+  }
+
   if (dimensionCount() > 2)
   {
     logError("Cannot retrieve area of 3D image");
@@ -303,6 +517,247 @@ Ref<Image> Image::area(const Recti& area) const
   return result;
 }
 
+Ref<Image> Image::compress(const PixelFormat& format,
+                           CompressionQuality quality,
+                           ThreadPool* pool) const
+{
+  if (!format.isCompressed() || !format.isValid())
+  {
+    logError("Pixel format %s is not a block-compressed format",
+             format.asString().c_str());
+    return nullptr;
+  }
+
+  if (m_format.type() != PixelFormat::UINT8 || m_format.semantic() == PixelFormat::DEPTH)
+  {
+    logError("Cannot compress image with pixel format %s",
+             m_format.asString().c_str());
+    return nullptr;
+  }
+
+  if (m_depth > 1)
+  {
+    logError("Cannot compress 3D image");
+    return nullptr;
+  }
+
+  Ref<Image> result = create(cache(), format, m_width, m_height);
+  if (!result)
+    return nullptr;
+
+  const uint channels = m_format.channelCount();
+  const bool hasAlpha = m_format.semantic() == PixelFormat::LA ||
+                        m_format.semantic() == PixelFormat::RGBA;
+  const bool alphaAsGreen = format.type() == PixelFormat::BC5 &&
+                            m_format.semantic() == PixelFormat::LA;
+  const size_t columns = (m_width + 3) / 4;
+  const size_t blockSize = format.blockSize();
+  const uint8* source = (const uint8*) &m_data[0];
+  uint8* target = (uint8*) result->pixels();
+
+  const ThreadPool::RangeTask task = [&](size_t first, size_t last)
+  {
+    uint8 block[64];
+
+    for (size_t by = first;  by < last;  by++)
+    {
+      for (size_t bx = 0;  bx < columns;  bx++)
+      {
+        // Edge pixels are repeated to fill partial blocks
+        for (uint y = 0;  y < 4;  y++)
+        {
+          const size_t sy = std::min(by * 4 + y, size_t(m_height - 1));
+
+          for (uint x = 0;  x < 4;  x++)
+          {
+            const size_t sx = std::min(bx * 4 + x, size_t(m_width - 1));
+            const uint8* pixel = source + (sy * m_width + sx) * channels;
+            uint8* texel = block + (y * 4 + x) * 4;
+
+            if (channels < 3)
+              texel[0] = texel[1] = texel[2] = pixel[0];
+            else
+              std::memcpy(texel, pixel, 3);
+
+            texel[3] = hasAlpha ? pixel[channels - 1] : 255;
+
+            if (alphaAsGreen)
+              texel[1] = pixel[1];
+          }
+        }
+
+        encodeBlock(target + (by * columns + bx) * blockSize, block, format, quality);
+      }
+    }
+  };
+
+  const size_t rows = (m_height + 3) / 4;
+
+  if (pool)
+    pool->parallelFor(rows, task, 4);
+  else
+    task(0, rows);
+
+  for (auto& m : m_mipmaps)
+  {
+    Ref<Image> mipmap = m->compress(format, quality, pool);
+    if (!mipmap)
+      return nullptr;
+
+    result->m_mipmaps.push_back(mipmap);
+  }
+
+  return result;
+}
+
+Ref<Image> Image::decompress() const
+{
+  if (!m_format.isCompressed())
+  {
+    logError("Image with pixel format %s is not block-compressed",
+             m_format.asString().c_str());
+    return nullptr;
+  }
+
+  const PixelFormat format(m_format.semantic(), PixelFormat::UINT8);
+
+  Ref<Image> result = create(cache(), format, m_width, m_height);
+  if (!result)
+    return nullptr;
+
+  const uint channels = format.channelCount();
+  const size_t columns = (m_width + 3) / 4;
+  const size_t blockSize = m_format.blockSize();
+  uint8* target = (uint8*) result->pixels();
+  uint8 block[64];
+
+  for (size_t by = 0;  by < (m_height + 3) / 4;  by++)
+  {
+    for (size_t bx = 0;  bx < columns;  bx++)
+    {
+      decodeBlock(block, (const uint8*) &m_data[(by * columns + bx) * blockSize], m_format);
+
+      for (uint y = 0;  y < 4 && by * 4 + y < m_height;  y++)
+      {
+        for (uint x = 0;  x < 4 && bx * 4 + x < m_width;  x++)
+        {
+          const uint8* texel = block + (y * 4 + x) * 4;
+          uint8* pixel = target + ((by * 4 + y) * m_width + bx * 4 + x) * channels;
+
+          if (format.semantic() == PixelFormat::L)
+            pixel[0] = texel[0];
+          else if (format.semantic() == PixelFormat::LA)
+          {
+            pixel[0] = texel[0];
+            pixel[1] = texel[1];
+          }
+          else
+            std::memcpy(pixel, texel, channels);
+        }
+      }
+    }
+  }
+
+  for (auto& m : m_mipmaps)
+  {
+    Ref<Image> mipmap = m->decompress();
+    if (!mipmap)
+      return nullptr;
+
+    result->m_mipmaps.push_back(mipmap);
+  }
+
+  return result;
+}
+
+bool Image::generateMipmaps(MipmapFilter filter,
+                            bool sRGB,
+                            float alphaReference,
+                            ThreadPool* pool)
+{
+  if (!canGenerateMipmaps(m_format))
+  {
+    logError("Cannot generate mipmaps for image with pixel format %s",
+             m_format.asString().c_str());
+    return false;
+  }
+
+  if (m_depth > 1)
+  {
+    logError("Cannot generate mipmaps for 3D image");
+    return false;
+  }
+
+  const uint channels = m_format.channelCount();
+  const bool hasAlpha = m_format.semantic() == PixelFormat::LA ||
+                        m_format.semantic() == PixelFormat::RGBA;
+
+  uint width = m_width, height = m_height;
+
+  std::vector<float> level(width * height * channels);
+  convertToFloat(&level[0], &m_data[0], m_format, width * height, sRGB);
+
+  float coverage = 0.f;
+  if (hasAlpha && alphaReference > 0.f)
+    coverage = alphaCoverage(&level[0], width * height, channels, alphaReference);
+
+  ImageList mipmaps;
+
+  while (width > 1 || height > 1)
+  {
+    const uint targetWidth = std::max(width / 2, 1u);
+    const uint targetHeight = std::max(height / 2, 1u);
+    const size_t count = targetWidth * targetHeight;
+
+    std::vector<float> next(count * channels);
+    downsample(&next[0], targetWidth, targetHeight,
+               &level[0], width, height,
+               channels, filter, pool);
+
+    // Each level is filtered from the unscaled level above it
+    float alphaScale = 1.f;
+    if (coverage > 0.f)
+      alphaScale = alphaCoverageScale(&next[0], count, channels, alphaReference, coverage);
+
+    Ref<Image> mipmap = create(cache(), m_format, targetWidth, targetHeight);
+    if (!mipmap)
+      return false;
+
+    convertFromFloat(mipmap->pixels(), &next[0], m_format, count, sRGB, alphaScale);
+    mipmaps.push_back(mipmap);
+
+    std::swap(level, next);
+    width = targetWidth;
+    height = targetHeight;
+  }
+
+  m_mipmaps = mipmaps;
+  return true;
+}
+
+bool Image::setMipmaps(const ImageList& mipmaps)
+{
+  uint width = m_width, height = m_height, depth = m_depth;
+
+  for (auto& m : mipmaps)
+  {
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+    depth = std::max(depth / 2, 1u);
+
+    // One-dimensional levels may have been stored along the x axis
+    if (m->format() != m_format ||
+        m->width() * m->height() * m->depth() != width * height * depth)
+    {
+      logError("Mipmap levels do not match image");
+      return false;
+    }
+  }
+
+  m_mipmaps = mipmaps;
+  return true;
+}
+
 Ref<Image> Image::create(const ResourceInfo& info,
                          const PixelFormat& format,
                          uint width,
@@ -324,6 +779,15 @@ Ref<Image> Image::read(ResourceCache& cache, const String& name)
   return reader.read(name);
 }
 
+bool Image::canGenerateMipmaps(const PixelFormat& format)
+{
+  if (format.semantic() == PixelFormat::DEPTH)
+    return false;
+
+  return format.type() == PixelFormat::UINT8 ||
+         format.type() == PixelFormat::FLOAT32;
+}
+
 Image::Image(const ResourceInfo& info):
   Resource(info)
 {
@@ -353,6 +817,25 @@ bool Image::init(const PixelFormat& format,
     return false;
   }
 
+  if (m_format.isCompressed())
+  {
+    if (m_depth > 1)
+    {
+      logError("Cannot create 3D block-compressed image");
+      return false;
+    }
+
+    // Blocks are laid out in two dimensions, so these cannot be collapsed
+    const size_t size = m_format.imageSize(m_width, m_height);
+
+    if (pixels)
+      m_data.assign(pixels, pixels + size);
+    else
+      m_data.resize(size, 0);
+
+    return true;
+  }
+
   if ((m_height > 1) && (m_width == 1))
   {
     m_width = m_height;
@@ -394,6 +877,38 @@ bool Image::init(const PixelFormat& format,
   return true;
 }
 
+bool Image::convertPixels(const PixelFormat& format, PixelTransform& transform)
+{
+  if (m_format.isCompressed() || format.isCompressed())
+  {
+    logError("Cannot transform block-compressed images");
+    return false;
+  }
+
+  if (!transform.supports(format, m_format))
+    return false;
+
+  for (auto& m : m_mipmaps)
+  {
+    if (!m->convertPixels(format, transform))
+      return false;
+  }
+
+  const size_t count = m_width * m_height * m_depth;
+
+  if (transform.supportsInPlace(format, m_format))
+    transform.convert(&m_data[0], format, &m_data[0], m_format, count);
+  else
+  {
+    std::vector<char> temp(count * format.size());
+    transform.convert(&temp[0], format, &m_data[0], m_format, count);
+    std::swap(m_data, temp);
+  }
+
+  m_format = format;
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 ImageReader::ImageReader(ResourceCache& cache):
@@ -403,102 +918,327 @@ ImageReader::ImageReader(ResourceCache& cache):
 
 Ref<Image> ImageReader::read(const String& name, const Path& path)
 {
-  std::ifstream stream(path.name().c_str(), std::ios::in | std::ios::binary);
-  if (stream.fail())
+  const String suffix = path.suffix();
+
+  if (suffix == "ktx" || suffix == "KTX")
+    return readKTX(name, path);
+  else if (suffix == "dds" || suffix == "DDS")
+    return readDDS(name, path);
+  else
+    return readPNG(name, path);
+}
+
+Ref<Image> ImageReader::readPNG(const String& name, const Path& path)
+{
+  MappedFile file;
+  if (!file.open(path))
   {
     logError("Failed to open image file %s", path.name().c_str());
     return nullptr;
   }
 
-  // Check if file is valid
+  PNGDecoder decoder;
+  if (!decoder.open(file.data(), file.size(), name))
+    return nullptr;
+
+  const ResourceInfo info(cache, name, path);
+
+  Ref<Image> result = Image::create(info,
+                                    decoder.format(),
+                                    decoder.width(),
+                                    decoder.height());
+  if (!result)
+    return nullptr;
+
+  if (!decoder.decode(result->pixels()))
+    return nullptr;
+
+  return result;
+}
+
+Ref<Image> ImageReader::readKTX(const String& name, const Path& path)
+{
+  MappedFile file;
+  if (!file.open(path))
   {
-    unsigned char header[8];
+    logError("Failed to open image file %s", path.name().c_str());
+    return nullptr;
+  }
 
-    if (!stream.read((char*) header, sizeof(header)))
-    {
-      logError("Failed to read PNG header from image %s", name.c_str());
-      return nullptr;
-    }
+  KTXHeader header;
 
-    if (png_sig_cmp(header, 0, sizeof(header)))
+  if (file.size() < sizeof(header))
+  {
+    logError("Failed to read KTX header from image %s", name.c_str());
+    return nullptr;
+  }
+
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (std::memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+  {
+    logError("Invalid KTX identifier in image %s", name.c_str());
+    return nullptr;
+  }
+
+  if (header.endianness != KTX_ENDIANNESS)
+  {
+    logError("KTX image %s has non-native endianness", name.c_str());
+    return nullptr;
+  }
+
+  if (header.pixelDepth > 1 || header.numberOfArrayElements > 0 ||
+      header.numberOfFaces > 1)
+  {
+    logError("KTX image %s is not a two-dimensional image", name.c_str());
+    return nullptr;
+  }
+
+  if (header.glType != 0 && header.glType != KTX_UNSIGNED_BYTE)
+  {
+    logError("KTX image %s has unsupported pixel type 0x%x",
+             name.c_str(), header.glType);
+    return nullptr;
+  }
+
+  PixelFormat format;
+
+  for (const KTXFormat& f : KTX_FORMATS)
+  {
+    if (f.internalFormat == header.glInternalFormat)
     {
-      logError("Invalid PNG signature in image %s", name.c_str());
-      return nullptr;
+      format = PixelFormat(f.semantic, f.type);
+      break;
     }
   }
 
-  png_structp context;
-  png_infop pngInfo;
-  png_infop pngEndInfo;
+  if (!format.isValid())
+  {
+    logError("KTX image %s has unsupported internal format 0x%x",
+             name.c_str(), header.glInternalFormat);
+    return nullptr;
+  }
+
+  size_t baseSize;
+
+  if (header.pixelWidth == 0 ||
+      !getKTXLevelSize(format, header.pixelWidth, std::max(header.pixelHeight, 1u), baseSize))
+  {
+    logError("KTX image %s has invalid dimensions %ux%u",
+             name.c_str(), header.pixelWidth, header.pixelHeight);
+    return nullptr;
+  }
+
+  const uint levelCount = std::max(header.numberOfMipmapLevels, 1u);
+
+  uint maxLevelCount = 1;
 
-  // Set up for image reading
+  for (uint size = std::max(std::max(header.pixelWidth, header.pixelHeight), header.pixelDepth);
+       size > 1;
+       size /= 2)
   {
-    context = png_create_read_struct(PNG_LIBPNG_VER_STRING,
-                                     nullptr,
-                                     writeErrorPNG,
-                                     writeWarningPNG);
-    if (!context)
+    maxLevelCount++;
+  }
+
+  if (levelCount > maxLevelCount)
+  {
+    logError("KTX image %s has %u mipmap levels but at most %u are possible",
+             name.c_str(), levelCount, maxLevelCount);
+    return nullptr;
+  }
+
+  const ResourceInfo info(cache, name, path);
+
+  size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+  uint width = header.pixelWidth;
+  uint height = std::max(header.pixelHeight, 1u);
+
+  Ref<Image> result;
+  ImageList mipmaps;
+
+  for (uint level = 0;  level < levelCount;  level++)
+  {
+    uint32 imageSize;
+
+    if (offset + sizeof(imageSize) > file.size())
     {
-      logError("Failed to create PNG read struct for image %s",
-               name.c_str());
+      logError("KTX image %s is truncated", name.c_str());
       return nullptr;
     }
 
-    png_set_read_fn(context, &stream, readStreamPNG);
+    std::memcpy(&imageSize, file.data() + offset, sizeof(imageSize));
+    offset += sizeof(imageSize);
 
-    pngInfo = png_create_info_struct(context);
-    if (!pngInfo)
+    if (imageSize > file.size() - offset)
     {
-      png_destroy_read_struct(&context, nullptr, nullptr);
-
-      logError("Failed to create PNG info struct for image %s",
-               name.c_str());
+      logError("KTX image %s is truncated", name.c_str());
       return nullptr;
     }
 
-    pngEndInfo = png_create_info_struct(context);
-    if (!pngEndInfo)
-    {
-      png_destroy_read_struct(&context, &pngInfo, nullptr);
+    // Uncompressed rows are padded to four bytes
+    const ptrdiff_t pitch = format.isCompressed() ? 0 : (width * format.size() + 3) & ~3;
+
+    // Levels are no larger than the base level, so this cannot overflow
+    size_t requiredSize;
+    getKTXLevelSize(format, width, height, requiredSize);
 
-      logError("Failed to create PNG end info struct for image %s",
-               name.c_str());
+    if (imageSize < requiredSize)
+    {
+      logError("KTX image %s has level %u with invalid size %u",
+               name.c_str(), level, imageSize);
       return nullptr;
     }
 
-    png_set_sig_bytes(context, 8);
+    // Only the base level is named
+    const ResourceInfo levelInfo = level ? ResourceInfo(cache) : info;
+
+    Ref<Image> image = Image::create(levelInfo, format, width, height, 1,
+                                     file.data() + offset, pitch);
+    if (!image)
+      return nullptr;
+
+    if (result)
+      mipmaps.push_back(image);
+    else
+      result = image;
 
-    png_read_png(context, pngInfo, PNG_TRANSFORM_PACKING | PNG_TRANSFORM_EXPAND, nullptr);
+    offset += (imageSize + 3) & ~3;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
   }
 
-  const PixelFormat format = convertToPixelFormat(png_get_color_type(context, pngInfo),
-                                                  png_get_bit_depth(context, pngInfo));
+  if (!result->setMipmaps(mipmaps))
+    return nullptr;
 
-  if (!format.isValid())
+  return result;
+}
+
+Ref<Image> ImageReader::readDDS(const String& name, const Path& path)
+{
+  MappedFile file;
+  if (!file.open(path))
   {
-    png_destroy_read_struct(&context, &pngInfo, &pngEndInfo);
+    logError("Failed to open image file %s", path.name().c_str());
+    return nullptr;
+  }
+
+  DDSHeader header;
+
+  if (file.size() < sizeof(header))
+  {
+    logError("Failed to read DDS header from image %s", name.c_str());
+    return nullptr;
+  }
+
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, DDS_MAGIC, sizeof(DDS_MAGIC)) != 0)
+  {
+    logError("Invalid DDS signature in image %s", name.c_str());
+    return nullptr;
+  }
+
+  if (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+  {
+    logError("DDS image %s is not a two-dimensional image", name.c_str());
+    return nullptr;
+  }
+
+  size_t offset = sizeof(header);
+  PixelFormat format;
+
+  const DDSPixelFormat& ddpf = header.pixelFormat;
+
+  if (ddpf.flags & DDPF_FOURCC)
+  {
+    if (std::memcmp(ddpf.fourCC, "DX10", 4) == 0)
+    {
+      DDSHeaderDX10 extension;
+
+      if (file.size() < offset + sizeof(extension))
+      {
+        logError("Failed to read DDS header from image %s", name.c_str());
+        return nullptr;
+      }
+
+      std::memcpy(&extension, file.data() + offset, sizeof(extension));
+      offset += sizeof(extension);
+
+      if (extension.arraySize > 1)
+      {
+        logError("DDS image %s is not a two-dimensional image", name.c_str());
+        return nullptr;
+      }
+
+      format = convertDXGI(extension.dxgiFormat);
+    }
+    else
+      format = convertFourCC(ddpf);
+  }
+  else if ((ddpf.flags & DDPF_RGB) && ddpf.bitCount == 32 &&
+           ddpf.redMask == 0x000000ff && ddpf.alphaMask == 0xff000000)
+  {
+    format = PixelFormat::RGBA8;
+  }
+  else if ((ddpf.flags & DDPF_LUMINANCE) && ddpf.bitCount == 8)
+    format = PixelFormat::L8;
 
-    logError("Image %s has unsupported pixel format", name.c_str());
+  if (!format.isValid())
+  {
+    logError("DDS image %s has unsupported pixel format", name.c_str());
     return nullptr;
   }
 
-  const uint width  = png_get_image_width(context, pngInfo);
-  const uint height = png_get_image_height(context, pngInfo);
+  const uint levelCount = std::max(header.mipMapCount, 1u);
   const ResourceInfo info(cache, name, path);
 
-  Ref<Image> result = Image::create(info, format, width, height);
+  uint width = header.width;
+  uint height = header.height;
+
+  Ref<Image> result;
+  ImageList mipmaps;
 
-  // Read image data
+  for (uint level = 0;  level < levelCount;  level++)
   {
-    const size_t rowSize = png_get_rowbytes(context, pngInfo);
-    png_byte** rows = png_get_rows(context, pngInfo);
+    const size_t size = format.imageSize(width, height);
 
-    for (size_t i = 0;  i < height;  i++)
-      std::memcpy(result->pixel(0, height - i - 1), rows[i], rowSize);
+    if (offset + size > file.size())
+    {
+      logError("DDS image %s is truncated", name.c_str());
+      return nullptr;
+    }
+
+    // Blocks can only be flipped whole or within the first block row
+    if (format.isCompressed() && height > 4 && height % 4 != 0)
+    {
+      logError("DDS image %s has level with height %u that cannot be flipped",
+               name.c_str(), height);
+      return nullptr;
+    }
+
+    // Only the base level is named
+    const ResourceInfo levelInfo = level ? ResourceInfo(cache) : info;
+
+    Ref<Image> image = Image::create(levelInfo, format, width, height, 1,
+                                     file.data() + offset);
+    if (!image)
+      return nullptr;
+
+    if (result)
+      mipmaps.push_back(image);
+    else
+      result = image;
+
+    offset += size;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
   }
 
-  // Clean up library structures
-  png_destroy_read_struct(&context, &pngInfo, &pngEndInfo);
+  if (!result->setMipmaps(mipmaps))
+    return nullptr;
+
+  // DDS images are stored top to bottom
+  result->flipHorizontal();
 
   return result;
 }
@@ -507,6 +1247,22 @@ Ref<Image> ImageReader::read(const String& name, const Path& path)
 
 bool ImageWriter::write(const Path& path, const Image& image)
 {
+  const String suffix = path.suffix();
+
+  if (suffix == "ktx" || suffix == "KTX")
+    return writeKTX(path, image);
+  else
+    return writePNG(path, image);
+}
+
+bool ImageWriter::writePNG(const Path& path, const Image& image)
+{
+  if (image.format().isCompressed())
+  {
+    logError("Cannot write block-compressed images to PNG file");
+    return false;
+  }
+
   if (image.dimensionCount() > 2)
   {
     logError("Cannot write 3D images to PNG file");
@@ -579,6 +1335,98 @@ bool ImageWriter::write(const Path& path, const Image& image)
   return true;
 }
 
+bool ImageWriter::writeKTX(const Path& path, const Image& image)
+{
+  if (image.dimensionCount() > 2)
+  {
+    logError("Cannot write 3D images to KTX file");
+    return false;
+  }
+
+  const PixelFormat& format = image.format();
+  const KTXFormat* entry = nullptr;
+
+  for (const KTXFormat& f : KTX_FORMATS)
+  {
+    if (f.semantic == format.semantic() && f.type == format.type())
+    {
+      entry = &f;
+      break;
+    }
+  }
+
+  if (!entry)
+  {
+    logError("Failed to write image %s: pixel format %s is not supported by the KTX writer",
+             image.name().c_str(),
+             format.asString().c_str());
+    return false;
+  }
+
+  std::ofstream stream(path.name().c_str(), std::ios::out | std::ios::binary);
+  if (!stream.is_open())
+  {
+    logError("Failed to create image file %s", path.name().c_str());
+    return false;
+  }
+
+  KTXHeader header;
+  std::memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+  header.endianness = KTX_ENDIANNESS;
+  header.glType = format.isCompressed() ? 0 : KTX_UNSIGNED_BYTE;
+  header.glTypeSize = 1;
+  header.glFormat = format.isCompressed() ? 0 : entry->baseFormat;
+  header.glInternalFormat = entry->internalFormat;
+  header.glBaseInternalFormat = entry->baseFormat;
+  header.pixelWidth = image.width();
+  header.pixelHeight = image.height();
+  header.pixelDepth = 0;
+  header.numberOfArrayElements = 0;
+  header.numberOfFaces = 1;
+  header.numberOfMipmapLevels = uint32(image.mipmaps().size() + 1);
+  header.bytesOfKeyValueData = 0;
+
+  stream.write((const char*) &header, sizeof(header));
+
+  const char padding[4] = { 0, 0, 0, 0 };
+
+  for (uint level = 0;  level < header.numberOfMipmapLevels;  level++)
+  {
+    const Image& source = level ? *image.mipmaps()[level - 1] : image;
+    const char* data = (const char*) source.pixels();
+
+    if (format.isCompressed())
+    {
+      const uint32 imageSize = uint32(source.size());
+      stream.write((const char*) &imageSize, sizeof(imageSize));
+      stream.write(data, imageSize);
+      stream.write(padding, (4 - imageSize % 4) % 4);
+    }
+    else
+    {
+      // Uncompressed rows are padded to four bytes
+      const size_t rowSize = source.width() * format.size();
+      const size_t rowPadding = (4 - rowSize % 4) % 4;
+      const uint32 imageSize = uint32((rowSize + rowPadding) * source.height());
+      stream.write((const char*) &imageSize, sizeof(imageSize));
+
+      for (uint y = 0;  y < source.height();  y++)
+      {
+        stream.write(data + y * rowSize, rowSize);
+        stream.write(padding, rowPadding);
+      }
+    }
+  }
+
+  if (stream.fail())
+  {
+    logError("Failed to write image file %s", path.name().c_str());
+    return false;
+  }
+
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 } /*namespace wendy*/
@@ -0,0 +1,465 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+#include <wendy/Core.hpp>
+#include <wendy/Path.hpp>
+#include <wendy/Rect.hpp>
+#include <wendy/Pixel.hpp>
+#include <wendy/Resource.hpp>
+#include <wendy/Image.hpp>
+#include <wendy/Thread.hpp>
+
+#include <internal/ImageFilter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define WENDY_FILTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+/* The support radius and shape parameter of the Kaiser-windowed sinc filter,
+ * in target pixels.
+ */
+const float KAISER_RADIUS = 3.f;
+const float KAISER_ALPHA = 4.f;
+
+/* The source pixels and weights making up each target pixel along one axis.
+ */
+class FilterTaps
+{
+public:
+  FilterTaps(uint targetSize, uint sourceSize, MipmapFilter filter);
+  std::vector<uint> offsets;
+  std::vector<uint> indices;
+  std::vector<float> weights;
+};
+
+float besselI0(float x)
+{
+  float sum = 1.f, term = 1.f;
+
+  for (uint i = 1;  i < 20;  i++)
+  {
+    term *= (x * x) / (4.f * i * i);
+    sum += term;
+  }
+
+  return sum;
+}
+
+float sinc(float x)
+{
+  if (std::fabs(x) < 1e-6f)
+    return 1.f;
+
+  return std::sin(pi<float>() * x) / (pi<float>() * x);
+}
+
+float kaiser(float x)
+{
+  const float t = x / KAISER_RADIUS;
+  if (t * t >= 1.f)
+    return 0.f;
+
+  return sinc(x) * besselI0(KAISER_ALPHA * std::sqrt(1.f - t * t)) /
+         besselI0(KAISER_ALPHA);
+}
+
+FilterTaps::FilterTaps(uint targetSize, uint sourceSize, MipmapFilter filter)
+{
+  const float scale = float(sourceSize) / targetSize;
+  const float radius = (filter == MIPMAP_BOX) ? scale / 2.f : KAISER_RADIUS * scale;
+
+  offsets.push_back(0);
+
+  for (uint x = 0;  x < targetSize;  x++)
+  {
+    const float center = (x + 0.5f) * scale;
+    const int first = int(std::floor(center - radius));
+    const int last = int(std::ceil(center + radius));
+    const size_t start = weights.size();
+
+    float sum = 0.f;
+
+    for (int i = first;  i < last;  i++)
+    {
+      float weight;
+
+      if (filter == MIPMAP_BOX)
+      {
+        // The overlap of the source pixel with the target pixel
+        weight = std::min(i + 1.f, center + radius) - std::max(float(i), center - radius);
+      }
+      else
+        weight = kaiser((i + 0.5f - center) / scale);
+
+      if (weight == 0.f)
+        continue;
+
+      indices.push_back(uint(clamp(i, 0, int(sourceSize) - 1)));
+      weights.push_back(weight);
+      sum += weight;
+    }
+
+    for (size_t i = start;  i < weights.size();  i++)
+      weights[i] /= sum;
+
+    offsets.push_back(uint(weights.size()));
+  }
+}
+
+float convertToLinear(float value)
+{
+  if (value <= 0.04045f)
+    return value / 12.92f;
+  else
+    return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+/* The linear light value of each 8-bit sRGB value.
+ */
+class LinearTable
+{
+public:
+  LinearTable();
+  float values[256];
+  float thresholds[255];
+};
+
+LinearTable::LinearTable()
+{
+  for (uint i = 0;  i < 256;  i++)
+    values[i] = convertToLinear(i / 255.f);
+
+  // The linear values halfway between adjacent sRGB values, for rounding
+  for (uint i = 0;  i < 255;  i++)
+    thresholds[i] = convertToLinear((i + 0.5f) / 255.f);
+}
+
+const LinearTable& linearTable()
+{
+  static const LinearTable table;
+  return table;
+}
+
+bool isColorChannel(const PixelFormat& format, uint channel)
+{
+  if (format.semantic() == PixelFormat::LA)
+    return channel == 0;
+  else if (format.semantic() == PixelFormat::RGBA)
+    return channel < 3;
+  else
+    return true;
+}
+
+bool hasAlphaChannel(const PixelFormat& format)
+{
+  return format.semantic() == PixelFormat::LA ||
+         format.semantic() == PixelFormat::RGBA;
+}
+
+void filterRows(float* target,
+                const float* source,
+                uint targetWidth,
+                uint width,
+                uint channels,
+                const FilterTaps& taps,
+                size_t first,
+                size_t last)
+{
+  for (size_t y = first;  y < last;  y++)
+  {
+    const float* row = source + y * width * channels;
+    float* result = target + y * targetWidth * channels;
+
+    for (uint x = 0;  x < targetWidth;  x++)
+    {
+      const uint start = taps.offsets[x], end = taps.offsets[x + 1];
+
+#if WENDY_FILTER_SSE2
+      if (channels == 4)
+      {
+        __m128 sum = _mm_setzero_ps();
+
+        for (uint i = start;  i < end;  i++)
+        {
+          const __m128 pixel = _mm_loadu_ps(row + taps.indices[i] * 4);
+          sum = _mm_add_ps(sum, _mm_mul_ps(pixel, _mm_set1_ps(taps.weights[i])));
+        }
+
+        _mm_storeu_ps(result + x * 4, sum);
+        continue;
+      }
+#endif
+
+      for (uint c = 0;  c < channels;  c++)
+      {
+        float sum = 0.f;
+
+        for (uint i = start;  i < end;  i++)
+          sum += row[taps.indices[i] * channels + c] * taps.weights[i];
+
+        result[x * channels + c] = sum;
+      }
+    }
+  }
+}
+
+void filterColumns(float* target,
+                   const float* source,
+                   size_t rowSize,
+                   const FilterTaps& taps,
+                   size_t first,
+                   size_t last)
+{
+  for (size_t y = first;  y < last;  y++)
+  {
+    float* result = target + y * rowSize;
+    std::fill(result, result + rowSize, 0.f);
+
+    for (uint i = taps.offsets[y];  i < taps.offsets[y + 1];  i++)
+    {
+      const float* row = source + taps.indices[i] * rowSize;
+      const float weight = taps.weights[i];
+      size_t x = 0;
+
+#if WENDY_FILTER_SSE2
+      const __m128 w = _mm_set1_ps(weight);
+
+      for (;  x + 4 <= rowSize;  x += 4)
+      {
+        const __m128 sum = _mm_loadu_ps(result + x);
+        const __m128 value = _mm_loadu_ps(row + x);
+        _mm_storeu_ps(result + x, _mm_add_ps(sum, _mm_mul_ps(value, w)));
+      }
+#endif
+
+      for (;  x < rowSize;  x++)
+        result[x] += row[x] * weight;
+    }
+  }
+}
+
+void forEachRange(ThreadPool* pool,
+                  size_t count,
+                  const ThreadPool::RangeTask& task,
+                  size_t granularity)
+{
+  if (pool)
+    pool->parallelFor(count, task, granularity);
+  else
+    task(0, count);
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+void convertToFloat(float* target,
+                    const void* source,
+                    const PixelFormat& format,
+                    size_t count,
+                    bool sRGB)
+{
+  const uint channels = format.channelCount();
+
+  if (format.type() == PixelFormat::FLOAT32)
+  {
+    std::copy((const float*) source, (const float*) source + count * channels, target);
+    return;
+  }
+
+  const LinearTable& table = linearTable();
+  const uint8* pixels = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    for (uint c = 0;  c < channels;  c++)
+    {
+      const uint8 value = pixels[i * channels + c];
+
+      if (sRGB && isColorChannel(format, c))
+        target[i * channels + c] = table.values[value];
+      else
+        target[i * channels + c] = value / 255.f;
+    }
+  }
+}
+
+void convertFromFloat(void* target,
+                      const float* source,
+                      const PixelFormat& format,
+                      size_t count,
+                      bool sRGB,
+                      float alphaScale)
+{
+  const uint channels = format.channelCount();
+  const bool alpha = hasAlphaChannel(format);
+
+  if (format.type() == PixelFormat::FLOAT32)
+  {
+    float* pixels = (float*) target;
+
+    for (size_t i = 0;  i < count;  i++)
+    {
+      for (uint c = 0;  c < channels;  c++)
+      {
+        if (alpha && c == channels - 1)
+          pixels[i * channels + c] = source[i * channels + c] * alphaScale;
+        else
+          pixels[i * channels + c] = source[i * channels + c];
+      }
+    }
+
+    return;
+  }
+
+  const LinearTable& table = linearTable();
+  uint8* pixels = (uint8*) target;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    for (uint c = 0;  c < channels;  c++)
+    {
+      float value = source[i * channels + c];
+
+      if (alpha && c == channels - 1)
+        value *= alphaScale;
+
+      if (sRGB && isColorChannel(format, c))
+      {
+        pixels[i * channels + c] = uint8(std::upper_bound(table.thresholds,
+                                                          table.thresholds + 255,
+                                                          value) - table.thresholds);
+      }
+      else
+        pixels[i * channels + c] = uint8(clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+    }
+  }
+}
+
+void downsample(float* target,
+                uint targetWidth,
+                uint targetHeight,
+                const float* source,
+                uint width,
+                uint height,
+                uint channels,
+                MipmapFilter filter,
+                ThreadPool* pool)
+{
+  const FilterTaps columns(targetWidth, width, filter);
+  const FilterTaps rows(targetHeight, height, filter);
+
+  std::vector<float> temp(targetWidth * height * channels);
+
+  forEachRange(pool, height, [&](size_t first, size_t last)
+  {
+    filterRows(&temp[0], source, targetWidth, width, channels, columns, first, last);
+  }, 16);
+
+  forEachRange(pool, targetHeight, [&](size_t first, size_t last)
+  {
+    filterColumns(target, &temp[0], targetWidth * channels, rows, first, last);
+  }, 16);
+}
+
+float alphaCoverage(const float* pixels,
+                    size_t count,
+                    uint channels,
+                    float reference)
+{
+  size_t covered = 0;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    if (pixels[i * channels + channels - 1] > reference)
+      covered++;
+  }
+
+  return float(covered) / count;
+}
+
+float alphaCoverageScale(const float* pixels,
+                         size_t count,
+                         uint channels,
+                         float reference,
+                         float coverage)
+{
+  const size_t desired = size_t(coverage * count + 0.5f);
+
+  std::vector<float> alphas(count);
+
+  for (size_t i = 0;  i < count;  i++)
+    alphas[i] = pixels[i * channels + channels - 1];
+
+  std::sort(alphas.begin(), alphas.end(), std::greater<float>());
+
+  // Pixels with equal alpha are either all covered or all uncovered, so find
+  // the nearest achievable number of covered pixels
+  size_t lower = desired, upper = desired;
+
+  while (lower > 0 && lower < count && alphas[lower - 1] == alphas[lower])
+    lower--;
+
+  while (upper > 0 && upper < count && alphas[upper - 1] == alphas[upper])
+    upper++;
+
+  const size_t covered = (desired - lower <= upper - desired) ? lower : upper;
+  if (covered == 0)
+    return 1.f;
+
+  float threshold;
+
+  if (covered < count)
+    threshold = (alphas[covered - 1] + alphas[covered]) / 2.f;
+  else
+    threshold = alphas[count - 1] * 0.99f;
+
+  if (threshold <= 0.f)
+    return 1.f;
+
+  return reference / threshold;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
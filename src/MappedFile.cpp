@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+
+#include <wendy/Core.hpp>
+#include <wendy/Path.hpp>
+
+#include <internal/MappedFile.hpp>
+
+#if WENDY_HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if WENDY_HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#if WENDY_HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#if WENDY_HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+MappedFile::MappedFile():
+  m_data(nullptr),
+  m_size(0),
+  m_mapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+#if WENDY_HAVE_SYS_MMAN_H
+  if (m_mapped)
+    munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+bool MappedFile::open(const Path& path)
+{
+#if WENDY_HAVE_SYS_MMAN_H && WENDY_HAVE_SYS_STAT_H && WENDY_HAVE_FCNTL_H && WENDY_HAVE_UNISTD_H
+  const int fd = ::open(path.name().c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat sb;
+  if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+  {
+    void* address = mmap(nullptr, size_t(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED)
+    {
+      m_data = static_cast<const char*>(address);
+      m_size = size_t(sb.st_size);
+      m_mapped = true;
+    }
+  }
+
+  close(fd);
+
+  if (m_mapped)
+    return true;
+#endif
+
+  std::ifstream stream(path.name().c_str(), std::ios::in | std::ios::binary);
+  if (stream.fail())
+    return false;
+
+  stream.seekg(0, std::ios::end);
+  m_buffer.resize(size_t(stream.tellg()));
+  stream.seekg(0, std::ios::beg);
+
+  if (!m_buffer.empty())
+    stream.read(&m_buffer[0], m_buffer.size());
+
+  if (stream.fail())
+    return false;
+
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
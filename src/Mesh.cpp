@@ -30,14 +30,21 @@
 #include <wendy/Resource.hpp>
 #include <wendy/Primitive.hpp>
 #include <wendy/Mesh.hpp>
+#include <wendy/Thread.hpp>
+
+#include <internal/MappedFile.hpp>
 
 #include <limits>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <cctype>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <glm/gtx/compatibility.hpp>
-#include <glm/gtc/epsilon.hpp>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -49,6 +56,150 @@ namespace wendy
 namespace
 {
 
+const float WELD_EPSILON = 0.001f;
+
+/* Vertex attributes quantized to a grid, for hashing.  Values closer than the
+ * grid spacing may still fall in different cells, so welding through these
+ * keys is approximate near cell boundaries.
+ */
+class WeldKey
+{
+public:
+  WeldKey();
+  void set(uint index, float value, double scale);
+  bool operator == (const WeldKey& other) const;
+  uint64 hash() const;
+  int64 values[8];
+};
+
+WeldKey::WeldKey()
+{
+  std::fill(values, values + 8, 0);
+}
+
+void WeldKey::set(uint index, float value, double scale)
+{
+  values[index] = int64(std::floor(value * scale + 0.5));
+}
+
+bool WeldKey::operator == (const WeldKey& other) const
+{
+  return std::equal(values, values + 8, other.values);
+}
+
+uint64 WeldKey::hash() const
+{
+  uint64 result = 14695981039346656037ull;
+
+  for (uint i = 0;  i < 8;  i++)
+  {
+    result ^= uint64(values[i]);
+    result *= 1099511628211ull;
+    result ^= result >> 29;
+  }
+
+  return result;
+}
+
+/* Open addressing hash set of weld keys, assigning each distinct key an
+ * index in order of insertion.
+ */
+class VertexWelder
+{
+public:
+  VertexWelder(size_t capacity = 0);
+  uint32 insert(const WeldKey& key, bool& inserted);
+  size_t size() const { return m_keys.size(); }
+private:
+  void resize(size_t slotCount);
+  std::vector<WeldKey> m_keys;
+  std::vector<uint32> m_slots;
+};
+
+VertexWelder::VertexWelder(size_t capacity)
+{
+  m_keys.reserve(capacity);
+
+  size_t slotCount = 16;
+  while (slotCount < capacity * 2)
+    slotCount *= 2;
+
+  resize(slotCount);
+}
+
+uint32 VertexWelder::insert(const WeldKey& key, bool& inserted)
+{
+  if ((m_keys.size() + 1) * 2 > m_slots.size())
+    resize(m_slots.size() * 2);
+
+  const size_t mask = m_slots.size() - 1;
+
+  // Slots hold one more than the key index, so that zero marks empty slots
+  for (size_t i = size_t(key.hash()) & mask;  ;  i = (i + 1) & mask)
+  {
+    const uint32 slot = m_slots[i];
+    if (!slot)
+    {
+      m_keys.push_back(key);
+      m_slots[i] = uint32(m_keys.size());
+      inserted = true;
+      return uint32(m_keys.size() - 1);
+    }
+
+    if (m_keys[slot - 1] == key)
+    {
+      inserted = false;
+      return slot - 1;
+    }
+  }
+}
+
+void VertexWelder::resize(size_t slotCount)
+{
+  m_slots.assign(slotCount, 0);
+
+  const size_t mask = slotCount - 1;
+
+  for (size_t k = 0;  k < m_keys.size();  k++)
+  {
+    size_t i = size_t(m_keys[k].hash()) & mask;
+    while (m_slots[i])
+      i = (i + 1) & mask;
+
+    m_slots[i] = uint32(k + 1);
+  }
+}
+
+void forEachRange(ThreadPool* pool,
+                  size_t count,
+                  const ThreadPool::RangeTask& task,
+                  size_t granularity)
+{
+  if (pool)
+    pool->parallelFor(count, task, granularity);
+  else
+    task(0, count);
+}
+
+inline bool isSimilar(float a, float b)
+{
+  return std::abs(a - b) < WELD_EPSILON;
+}
+
+inline bool isSimilar(const vec2& a, const vec2& b)
+{
+  return isSimilar(a.x, b.x) && isSimilar(a.y, b.y);
+}
+
+inline bool isSimilar(const vec3& a, const vec3& b)
+{
+  return isSimilar(a.x, b.x) && isSimilar(a.y, b.y) && isSimilar(a.z, b.z);
+}
+
+/* Splits positions into vertices by their attribute layers.  Layers are kept
+ * in a flat array, chained per position in order of insertion, as most
+ * positions have only a few.
+ */
 class VertexTool
 {
 public:
@@ -57,162 +208,1339 @@ public:
     PRESERVE_NORMALS,
     MERGE_NORMALS
   };
-  VertexTool();
   VertexTool(const Mesh::VertexList& vertices);
-  void importPositions(const Mesh::VertexList& vertices);
   uint32 addAttributeLayer(uint32 vertexIndex,
                            const vec3& normal,
                            const vec2& texcoord = vec2(0.f));
-  void realizeVertices(Mesh::VertexList& result) const;
+  void realizeVertices(Mesh::VertexList& result, ThreadPool* pool = nullptr) const;
   void setNormalMode(NormalMode newMode);
 private:
-  struct VertexLayer
+  struct Layer
   {
     vec3 normal;
     vec2 texcoord;
+    uint32 next;
     uint32 index;
   };
-  struct Vertex
+  struct Target
   {
-    vec3 position;
-    std::vector<VertexLayer> layers;
+    uint32 position;
+    uint32 layer;
   };
-  typedef std::vector<Vertex> VertexList;
-  VertexList vertices;
-  uint32 targetCount;
+  std::vector<vec3> positions;
+  std::vector<vec3> normals;
+  std::vector<uint32> firstLayers;
+  std::vector<Layer> layers;
+  std::vector<Target> targets;
   NormalMode mode;
 };
 
-VertexTool::VertexTool():
-  targetCount(0),
-  mode(PRESERVE_NORMALS)
-{
-}
+const uint32 NO_LAYER = 0xffffffff;
 
-VertexTool::VertexTool(const Mesh::VertexList& initVertices):
-  targetCount(0),
+VertexTool::VertexTool(const Mesh::VertexList& vertices):
+  positions(vertices.size()),
+  firstLayers(vertices.size(), NO_LAYER),
   mode(PRESERVE_NORMALS)
 {
-  importPositions(initVertices);
-}
-
-void VertexTool::importPositions(const Mesh::VertexList& initVertices)
-{
-  vertices.resize(initVertices.size());
   for (size_t i = 0;  i < vertices.size();  i++)
-    vertices[i].position = initVertices[i].position;
+    positions[i] = vertices[i].position;
+
+  layers.reserve(vertices.size());
+  targets.reserve(vertices.size());
 }
 
 uint32 VertexTool::addAttributeLayer(uint32 vertexIndex,
                                      const vec3& normal,
                                      const vec2& texcoord)
 {
-  Vertex& vertex = vertices[vertexIndex];
+  uint32 index = NO_LAYER;
+  uint32 last = NO_LAYER;
 
-  if (mode == PRESERVE_NORMALS)
+  for (uint32 i = firstLayers[vertexIndex];  i != NO_LAYER;  i = layers[i].next)
   {
-    for (auto& l : vertex.layers)
+    const Layer& l = layers[i];
+
+    if (isSimilar(l.texcoord, texcoord))
     {
-      if (all(epsilonEqual(l.normal, normal, 0.001f)) &&
-          all(epsilonEqual(l.texcoord, texcoord, 0.001f)))
-      {
+      if (isSimilar(l.normal, normal))
         return l.index;
-      }
+
+      // With merged normals, layers differing only by normal share a vertex
+      if (mode == MERGE_NORMALS)
+        index = l.index;
     }
 
-    vertex.layers.push_back(VertexLayer());
-    VertexLayer& layer = vertex.layers.back();
+    last = i;
+  }
+
+  const uint32 layer = uint32(layers.size());
 
-    layer.normal = normal;
-    layer.texcoord = texcoord;
-    layer.index = targetCount++;
+  if (index == NO_LAYER)
+  {
+    index = uint32(targets.size());
 
-    return layer.index;
+    const Target target = { vertexIndex, layer };
+    targets.push_back(target);
   }
+
+  const Layer l = { normal, texcoord, NO_LAYER, index };
+  layers.push_back(l);
+
+  if (last == NO_LAYER)
+    firstLayers[vertexIndex] = layer;
   else
+    layers[last].next = layer;
+
+  if (mode == MERGE_NORMALS)
+    normals[vertexIndex] += normal;
+
+  return index;
+}
+
+void VertexTool::realizeVertices(Mesh::VertexList& result, ThreadPool* pool) const
+{
+  result.resize(targets.size());
+
+  forEachRange(pool, targets.size(), [&](size_t first, size_t last)
+  {
+    for (size_t i = first;  i < last;  i++)
+    {
+      const Target& t = targets[i];
+      const Layer& l = layers[t.layer];
+
+      result[i].position = positions[t.position];
+      result[i].texcoord = l.texcoord;
+
+      if (mode == MERGE_NORMALS)
+        result[i].normal = normalize(normals[t.position]);
+      else
+        result[i].normal = l.normal;
+    }
+  }, 4096);
+}
+
+void VertexTool::setNormalMode(NormalMode newMode)
+{
+  mode = newMode;
+
+  if (mode == MERGE_NORMALS)
+    normals.assign(positions.size(), vec3(0.f));
+}
+
+class Quadric
+{
+public:
+  Quadric();
+  Quadric(const vec3& normal, float distance, float weight);
+  Quadric& operator += (const Quadric& other);
+  double evaluate(const vec3& point) const;
+private:
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+};
+
+Quadric::Quadric():
+  a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0),
+  b0(0.0), b1(0.0), b2(0.0),
+  c(0.0)
+{
+}
+
+Quadric::Quadric(const vec3& n, float d, float w):
+  a00(w * n.x * n.x), a01(w * n.x * n.y), a02(w * n.x * n.z),
+  a11(w * n.y * n.y), a12(w * n.y * n.z), a22(w * n.z * n.z),
+  b0(w * n.x * d), b1(w * n.y * d), b2(w * n.z * d),
+  c(w * d * d)
+{
+}
+
+Quadric& Quadric::operator += (const Quadric& other)
+{
+  a00 += other.a00;
+  a01 += other.a01;
+  a02 += other.a02;
+  a11 += other.a11;
+  a12 += other.a12;
+  a22 += other.a22;
+  b0 += other.b0;
+  b1 += other.b1;
+  b2 += other.b2;
+  c += other.c;
+  return *this;
+}
+
+double Quadric::evaluate(const vec3& p) const
+{
+  const double x = p.x, y = p.y, z = p.z;
+
+  return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z +
+         a11 * y * y + 2.0 * a12 * y * z + a22 * z * z +
+         2.0 * (b0 * x + b1 * y + b2 * z) + c;
+}
+
+/* Quadric error metric simplifier using half-edge collapses.
+ *
+ * Vertices sharing a position form a group, and each vertex of a group is a
+ * wedge with its own attributes.  Groups are classified by the wedges and
+ * edges around them, and only collapses that cannot move a material boundary
+ * or tear a texture seam or mesh border are performed.
+ */
+class Simplifier
+{
+public:
+  Simplifier(Mesh& mesh);
+  void simplify(size_t targetCount);
+private:
+  enum Kind
   {
-    size_t index;
-    bool discontinuous = true;
+    MANIFOLD,
+    BORDER,
+    SEAM,
+    LOCKED
+  };
+  struct Collapse
+  {
+    uint32 source;
+    uint32 target;
+    uint32 pairSource;
+    uint32 pairTarget;
+    double cost;
+  };
+  static uint64 key(uint32 a, uint32 b) { return (uint64(a) << 32) | b; }
+  void groupPositions();
+  void computeQuadrics();
+  void classify();
+  bool findCollapse(uint32 source, uint32 target, Collapse& collapse) const;
+  bool flips(uint32 group, uint32 target, const vec3& position) const;
+  void writeBack();
+  Mesh& mesh;
+  std::vector<uint32> triangles;
+  std::vector<uint32> sectionIndices;
+  std::vector<uint32> groups;
+  std::vector<uint32> wedges;
+  std::vector<bool> used;
+  std::vector<Kind> kinds;
+  std::vector<Quadric> quadrics;
+  std::vector<uint32> adjacencyOffsets;
+  std::vector<uint32> adjacency;
+  std::unordered_set<uint64> edges;
+  std::unordered_set<uint64> groupEdges;
+};
+
+const float BORDER_WEIGHT = 10.f;
+
+Simplifier::Simplifier(Mesh& initMesh):
+  mesh(initMesh)
+{
+  for (uint32 i = 0;  i < mesh.sections.size();  i++)
+  {
+    for (auto& t : mesh.sections[i].triangles)
+    {
+      triangles.insert(triangles.end(), t.indices, t.indices + 3);
+      sectionIndices.push_back(i);
+    }
+  }
+
+  groupPositions();
+  classify();
+  computeQuadrics();
+}
+
+void Simplifier::simplify(size_t targetCount)
+{
+  const Mesh::VertexList& vertices = mesh.vertices;
+  const uint32 vertexCount = uint32(vertices.size());
+
+  std::vector<Collapse> collapses;
+  std::vector<int> best(vertexCount);
+  std::vector<bool> touched(vertexCount);
+  std::vector<uint32> remap(vertexCount);
 
-    for (auto& l : vertex.layers)
+  size_t count = triangles.size() / 3;
+
+  while (count > targetCount)
+  {
+    // Find the cheapest valid collapse of each position group
+    collapses.clear();
+    std::fill(best.begin(), best.end(), -1);
+
+    for (size_t i = 0;  i < triangles.size();  i += 3)
     {
-      if (all(epsilonEqual(l.texcoord, texcoord, 0.001f)))
+      for (uint k = 0;  k < 3;  k++)
       {
-        if (all(epsilonEqual(l.normal, normal, 0.001f)))
-          return l.index;
+        const uint32 a = triangles[i + k];
+        const uint32 b = triangles[i + (k + 1) % 3];
 
-        discontinuous = false;
-        index = l.index;
+        Collapse collapse;
+
+        if (findCollapse(a, b, collapse))
+        {
+          int& index = best[groups[a]];
+          if (index == -1)
+          {
+            index = int(collapses.size());
+            collapses.push_back(collapse);
+          }
+          else if (collapse.cost < collapses[index].cost)
+            collapses[index] = collapse;
+        }
+
+        if (findCollapse(b, a, collapse))
+        {
+          int& index = best[groups[b]];
+          if (index == -1)
+          {
+            index = int(collapses.size());
+            collapses.push_back(collapse);
+          }
+          else if (collapse.cost < collapses[index].cost)
+            collapses[index] = collapse;
+        }
+      }
+    }
+
+    if (collapses.empty())
+      break;
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    std::fill(touched.begin(), touched.end(), false);
+
+    for (uint32 i = 0;  i < vertexCount;  i++)
+      remap[i] = i;
+
+    // Perform collapses whose neighborhoods are untouched by earlier collapses
+    // in this pass, so that their costs and flip checks remain valid
+    size_t removed = 0;
+
+    for (auto& c : collapses)
+    {
+      if (count - removed <= targetCount)
+        break;
+
+      const uint32 source = groups[c.source];
+      const uint32 target = groups[c.target];
+
+      if (touched[source] || touched[target])
+        continue;
+
+      if (flips(source, target, vertices[c.target].position))
+        continue;
+
+      if (kinds[source] == SEAM)
+      {
+        remap[c.source] = c.target;
+        remap[c.pairSource] = c.pairTarget;
+      }
+      else
+      {
+        for (uint32 w = c.source;  ;  )
+        {
+          remap[w] = c.target;
+          w = wedges[w];
+          if (w == c.source)
+            break;
+        }
+      }
+
+      quadrics[target] += quadrics[source];
+
+      for (uint32 i = adjacencyOffsets[source];  i < adjacencyOffsets[source + 1];  i++)
+      {
+        const uint32* t = &triangles[adjacency[i] * 3];
+
+        if (groups[t[0]] == target || groups[t[1]] == target || groups[t[2]] == target)
+          removed++;
+
+        for (uint k = 0;  k < 3;  k++)
+          touched[groups[t[k]]] = true;
       }
     }
 
-    if (discontinuous)
-      index = targetCount++;
+    if (!removed)
+      break;
+
+    // Apply the collapses and drop triangles that became degenerate
+    size_t write = 0;
 
-    vertex.layers.push_back(VertexLayer());
-    VertexLayer& layer = vertex.layers.back();
+    for (size_t i = 0;  i < triangles.size();  i += 3)
+    {
+      const uint32 a = remap[triangles[i + 0]];
+      const uint32 b = remap[triangles[i + 1]];
+      const uint32 c = remap[triangles[i + 2]];
+
+      if (groups[a] == groups[b] || groups[b] == groups[c] || groups[c] == groups[a])
+        continue;
+
+      triangles[write + 0] = a;
+      triangles[write + 1] = b;
+      triangles[write + 2] = c;
+      sectionIndices[write / 3] = sectionIndices[i / 3];
+      write += 3;
+    }
 
-    layer.normal = normal;
-    layer.texcoord = texcoord;
-    layer.index = index;
+    triangles.resize(write);
+    sectionIndices.resize(write / 3);
+    count = write / 3;
 
-    return index;
+    classify();
   }
+
+  writeBack();
 }
 
-void VertexTool::realizeVertices(Mesh::VertexList& result) const
+void Simplifier::groupPositions()
 {
-  result.resize(targetCount);
+  const Mesh::VertexList& vertices = mesh.vertices;
+  const uint32 vertexCount = uint32(vertices.size());
 
-  for (auto& v : vertices)
+  std::vector<uint32> order(vertexCount);
+  for (uint32 i = 0;  i < vertexCount;  i++)
+    order[i] = i;
+
+  std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b)
   {
-    vec3 normal;
+    const vec3& pa = vertices[a].position;
+    const vec3& pb = vertices[b].position;
+
+    if (pa.x != pb.x)
+      return pa.x < pb.x;
+    if (pa.y != pb.y)
+      return pa.y < pb.y;
+    if (pa.z != pb.z)
+      return pa.z < pb.z;
+
+    return a < b;
+  });
 
-    if (mode == MERGE_NORMALS)
+  // Each group is named by its first vertex, with its wedges linked in a ring
+  groups.resize(vertexCount);
+  wedges.resize(vertexCount);
+
+  for (uint32 i = 0;  i < vertexCount;  )
+  {
+    uint32 j = i + 1;
+
+    while (j < vertexCount &&
+           vertices[order[j]].position == vertices[order[i]].position)
     {
-      for (auto& l : v.layers)
-        normal += l.normal;
+      j++;
+    }
 
-      normal = normalize(normal);
+    for (uint32 k = i;  k < j;  k++)
+    {
+      groups[order[k]] = order[i];
+      wedges[order[k]] = order[k + 1 < j ? k + 1 : i];
     }
 
-    for (auto& l : v.layers)
+    i = j;
+  }
+}
+
+void Simplifier::computeQuadrics()
+{
+  const Mesh::VertexList& vertices = mesh.vertices;
+
+  quadrics.assign(vertices.size(), Quadric());
+
+  for (size_t i = 0;  i < triangles.size();  i += 3)
+  {
+    const uint32* t = &triangles[i];
+    const vec3& p0 = vertices[t[0]].position;
+    const vec3& p1 = vertices[t[1]].position;
+    const vec3& p2 = vertices[t[2]].position;
+
+    vec3 normal = cross(p1 - p0, p2 - p0);
+    const float area = length(normal);
+    if (area == 0.f)
+      continue;
+
+    normal /= area;
+
+    const Quadric plane(normal, -dot(normal, p0), area * 0.5f);
+
+    for (uint k = 0;  k < 3;  k++)
     {
-      result[l.index].position = v.position;
-      result[l.index].texcoord = l.texcoord;
+      quadrics[groups[t[k]]] += plane;
 
-      if (mode == MERGE_NORMALS)
-        result[l.index].normal = normal;
-      else
-        result[l.index].normal = l.normal;
+      // Keep open borders in place by adding a plane perpendicular to the
+      // triangle through each border edge
+      const uint32 a = groups[t[k]];
+      const uint32 b = groups[t[(k + 1) % 3]];
+
+      if (!groupEdges.count(key(b, a)))
+      {
+        const vec3& pa = vertices[t[k]].position;
+        const vec3 edge = vertices[t[(k + 1) % 3]].position - pa;
+        const vec3 border = normalize(cross(edge, normal));
+        const Quadric constraint(border, -dot(border, pa), dot(edge, edge) * BORDER_WEIGHT);
+
+        quadrics[a] += constraint;
+        quadrics[b] += constraint;
+      }
+    }
+  }
+}
+
+void Simplifier::classify()
+{
+  const uint32 vertexCount = uint32(mesh.vertices.size());
+  const uint32 none = uint32(-1);
+
+  used.assign(vertexCount, false);
+  edges.clear();
+  groupEdges.clear();
+
+  std::vector<uint32> sections(vertexCount, none);
+  std::vector<uint32> wedgeCounts(vertexCount, 0);
+  std::vector<uint32> borderCounts(vertexCount, 0);
+  std::vector<bool> complex(vertexCount, false);
+
+  adjacencyOffsets.assign(vertexCount + 1, 0);
+
+  for (size_t i = 0;  i < triangles.size();  i += 3)
+  {
+    for (uint k = 0;  k < 3;  k++)
+    {
+      const uint32 a = triangles[i + k];
+      const uint32 b = triangles[i + (k + 1) % 3];
+      const uint32 group = groups[a];
+
+      used[a] = true;
+      edges.insert(key(a, b));
+
+      // More than two triangles on an edge is not a manifold surface
+      if (!groupEdges.insert(key(group, groups[b])).second)
+        complex[group] = complex[groups[b]] = true;
+
+      // Groups spanning several materials are material boundaries
+      const uint32 section = sectionIndices[i / 3];
+      if (sections[group] == none)
+        sections[group] = section;
+      else if (sections[group] != section)
+        complex[group] = true;
+
+      adjacencyOffsets[group + 1]++;
+    }
+  }
+
+  for (uint32 i = 0;  i < vertexCount;  i++)
+  {
+    if (used[i])
+      wedgeCounts[groups[i]]++;
+
+    adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+  }
+
+  adjacency.resize(adjacencyOffsets[vertexCount]);
+  std::vector<uint32> offsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+  for (size_t i = 0;  i < triangles.size();  i += 3)
+  {
+    for (uint k = 0;  k < 3;  k++)
+    {
+      const uint32 a = groups[triangles[i + k]];
+      const uint32 b = groups[triangles[i + (k + 1) % 3]];
+
+      adjacency[offsets[a]++] = uint32(i / 3);
+
+      if (!groupEdges.count(key(b, a)))
+      {
+        borderCounts[a]++;
+        borderCounts[b]++;
+      }
     }
   }
+
+  kinds.assign(vertexCount, LOCKED);
+
+  for (uint32 i = 0;  i < vertexCount;  i++)
+  {
+    if (groups[i] != i || complex[i] || wedgeCounts[i] > 2)
+      continue;
+
+    if (borderCounts[i] == 0)
+      kinds[i] = wedgeCounts[i] == 1 ? MANIFOLD : SEAM;
+    else if (borderCounts[i] == 2 && wedgeCounts[i] == 1)
+      kinds[i] = BORDER;
+  }
 }
 
-void VertexTool::setNormalMode(NormalMode newMode)
-{
-  mode = newMode;
-}
+bool Simplifier::findCollapse(uint32 source, uint32 target, Collapse& collapse) const
+{
+  const uint32 sourceGroup = groups[source];
+  const uint32 targetGroup = groups[target];
+
+  if (sourceGroup == targetGroup)
+    return false;
+
+  const bool continuous = edges.count(key(source, target)) &&
+                          edges.count(key(target, source));
+
+  switch (kinds[sourceGroup])
+  {
+    case MANIFOLD:
+    {
+      // Moving across an attribute discontinuity would drag it along
+      if (!continuous)
+        return false;
+
+      break;
+    }
+
+    case BORDER:
+    {
+      // Only slide along the border
+      if (groupEdges.count(key(sourceGroup, targetGroup)) &&
+          groupEdges.count(key(targetGroup, sourceGroup)))
+      {
+        return false;
+      }
+
+      break;
+    }
+
+    case SEAM:
+    {
+      // Only slide along the seam, moving both sides of it together
+      if (continuous || kinds[targetGroup] == MANIFOLD || kinds[targetGroup] == BORDER)
+        return false;
+
+      uint32 pair = wedges[source];
+      while (!used[pair])
+        pair = wedges[pair];
+
+      if (pair == source)
+        return false;
+
+      uint32 pairTarget = target;
+
+      for (;;)
+      {
+        if (used[pairTarget] &&
+            (edges.count(key(pair, pairTarget)) || edges.count(key(pairTarget, pair))))
+        {
+          break;
+        }
+
+        pairTarget = wedges[pairTarget];
+        if (pairTarget == target)
+          return false;
+      }
+
+      collapse.pairSource = pair;
+      collapse.pairTarget = pairTarget;
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  collapse.source = source;
+  collapse.target = target;
+  collapse.cost = quadrics[sourceGroup].evaluate(mesh.vertices[target].position);
+  return true;
+}
+
+bool Simplifier::flips(uint32 group, uint32 target, const vec3& position) const
+{
+  const Mesh::VertexList& vertices = mesh.vertices;
+
+  for (uint32 i = adjacencyOffsets[group];  i < adjacencyOffsets[group + 1];  i++)
+  {
+    const uint32* t = &triangles[adjacency[i] * 3];
+
+    if (groups[t[0]] == target || groups[t[1]] == target || groups[t[2]] == target)
+      continue;
+
+    vec3 p[3];
+    for (uint k = 0;  k < 3;  k++)
+      p[k] = vertices[t[k]].position;
+
+    const vec3 before = cross(p[1] - p[0], p[2] - p[0]);
+
+    for (uint k = 0;  k < 3;  k++)
+    {
+      if (groups[t[k]] == group)
+        p[k] = position;
+    }
+
+    const vec3 after = cross(p[1] - p[0], p[2] - p[0]);
+
+    if (dot(before, after) <= 0.f)
+      return true;
+  }
+
+  return false;
+}
+
+void Simplifier::writeBack()
+{
+  for (auto& s : mesh.sections)
+    s.triangles.clear();
+
+  for (size_t i = 0;  i < triangles.size();  i += 3)
+  {
+    MeshTriangle triangle;
+    triangle.setIndices(triangles[i + 0], triangles[i + 1], triangles[i + 2]);
+    mesh.sections[sectionIndices[i / 3]].triangles.push_back(triangle);
+  }
+}
+
+struct Triplet
+{
+  uint32 vertex;
+  uint32 normal;
+  uint32 texcoord;
+};
+
+struct Face
+{
+  Triplet p[3];
+};
+
+typedef std::vector<Face> FaceList;
+
+struct FaceGroup
+{
+  FaceList faces;
+  String name;
+};
+
+const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+/* Consecutive faces of an OBJ chunk using the same material.  A run without a
+ * material continues the material of the previous chunk.
+ */
+struct ObjFaceRun
+{
+  bool hasMaterial;
+  String materialName;
+  FaceList faces;
+  uint firstLine;
+};
+
+struct ObjWarning
+{
+  uint line;
+  String command;
+};
+
+/* Results of parsing a range of whole lines of an OBJ file.  Face indices are
+ * absolute, so chunks can be parsed independently and concatenated in order.
+ */
+class ObjChunk
+{
+public:
+  ObjChunk(const char* start, const char* end);
+  void parse();
+  const char* start;
+  const char* end;
+  uint lineCount;
+  std::vector<vec3> positions;
+  std::vector<vec3> normals;
+  std::vector<vec2> texcoords;
+  std::vector<ObjFaceRun> runs;
+  std::vector<ObjWarning> warnings;
+  String error;
+  uint errorLine;
+private:
+  void parseLine(const char* text, const char* lineEnd);
+};
+
+inline bool isSpace(char c)
+{
+  return std::isspace((unsigned char) c) != 0;
+}
+
+inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline bool isNameChar(char c)
+{
+  return std::isalnum((unsigned char) c) || c == '_';
+}
+
+inline void skipSpace(const char** text, const char* end)
+{
+  while (*text < end && isSpace(**text))
+    (*text)++;
+}
+
+bool matches(const char* name, size_t length, const char* command)
+{
+  return std::strlen(command) == length && std::memcmp(name, command, length) == 0;
+}
+
+size_t parseName(const char** text, const char* end)
+{
+  skipSpace(text, end);
+
+  const char* start = *text;
+
+  while (*text < end && isNameChar(**text))
+    (*text)++;
+
+  if (*text == start)
+    throw Exception("Expected but missing name");
+
+  return *text - start;
+}
+
+// Handles the cases the fast paths below leave to the C library, so that
+// results always match those of strtol and strtod
+int parseLibraryInteger(const char** text, const char* end)
+{
+  const String token(*text, end);
+  char* stop;
+
+  const int result = std::strtol(token.c_str(), &stop, 0);
+  if (stop == token.c_str())
+    throw Exception("Expected but missing integer value");
+
+  *text += stop - token.c_str();
+  return result;
+}
+
+float parseLibraryFloat(const char** text, const char* end)
+{
+  const String token(*text, end);
+  char* stop;
+
+  const float result = float(std::strtod(token.c_str(), &stop));
+  if (stop == token.c_str())
+    throw Exception("Expected but missing float value");
+
+  *text += stop - token.c_str();
+  return result;
+}
+
+int parseInteger(const char** text, const char* end)
+{
+  const char* p = *text;
+  skipSpace(&p, end);
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-'))
+    negative = (*p++ == '-');
+
+  if (p == end || !isDigit(*p))
+    throw Exception("Expected but missing integer value");
+
+  // Leave octal and hexadecimal prefixes to the library
+  if (*p == '0' && p + 1 < end && (isDigit(p[1]) || p[1] == 'x' || p[1] == 'X'))
+    return parseLibraryInteger(text, end);
+
+  long result = 0;
+
+  while (p < end && isDigit(*p))
+    result = result * 10 + (*p++ - '0');
+
+  *text = p;
+  return int(negative ? -result : result);
+}
+
+float parseFloat(const char** text, const char* end)
+{
+  // Exact powers of ten representable as doubles
+  static const double powers[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char* p = *text;
+  skipSpace(&p, end);
+
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-'))
+    negative = (*p++ == '-');
+
+  uint64 mantissa = 0;
+  int digitCount = 0;
+  int exponent = 0;
+  bool found = false;
+
+  while (p < end && isDigit(*p))
+  {
+    if (digitCount == 19)
+      return parseLibraryFloat(text, end);
+
+    mantissa = mantissa * 10 + (*p++ - '0');
+    if (mantissa)
+      digitCount++;
+
+    found = true;
+  }
+
+  if (p < end && *p == '.')
+  {
+    p++;
+
+    while (p < end && isDigit(*p))
+    {
+      if (digitCount == 19)
+        return parseLibraryFloat(text, end);
+
+      mantissa = mantissa * 10 + (*p++ - '0');
+      if (mantissa)
+        digitCount++;
+
+      exponent--;
+      found = true;
+    }
+  }
+
+  // Infinities, NaNs and malformed values are left to the library
+  if (!found)
+    return parseLibraryFloat(text, end);
+
+  if (p < end && (*p == 'e' || *p == 'E'))
+  {
+    const char* q = p + 1;
+
+    bool negativeExponent = false;
+    if (q < end && (*q == '+' || *q == '-'))
+      negativeExponent = (*q++ == '-');
+
+    if (q < end && isDigit(*q))
+    {
+      int value = 0;
+
+      while (q < end && isDigit(*q))
+      {
+        if (value > 1000)
+          return parseLibraryFloat(text, end);
+
+        value = value * 10 + (*q++ - '0');
+      }
+
+      exponent += negativeExponent ? -value : value;
+      p = q;
+    }
+  }
+
+  if (p < end && (*p == 'x' || *p == 'X'))
+    return parseLibraryFloat(text, end);
+
+  // Both operands are exact, so the single rounding of the division or
+  // multiplication gives the correctly rounded double, as strtod does
+  if (mantissa > (uint64(1) << 53) || exponent < -22 || exponent > 22)
+    return parseLibraryFloat(text, end);
+
+  double result = double(mantissa);
+  if (exponent < 0)
+    result /= powers[-exponent];
+  else
+    result *= powers[exponent];
+
+  *text = p;
+  return float(negative ? -result : result);
+}
+
+ObjChunk::ObjChunk(const char* initStart, const char* initEnd):
+  start(initStart),
+  end(initEnd),
+  lineCount(0),
+  errorLine(0)
+{
+}
+
+void ObjChunk::parse()
+{
+  const char* line = start;
+
+  while (line < end)
+  {
+    const char* next = (const char*) std::memchr(line, '\n', end - line);
+    if (!next)
+      next = end;
+
+    ++lineCount;
+
+    // Lines starting with whitespace or a comment are skipped entirely
+    if (line < next && !isSpace(*line) && *line != '#' && *line != '\0')
+    {
+      try
+      {
+        parseLine(line, next);
+      }
+      catch (Exception& e)
+      {
+        error = e.what();
+        errorLine = lineCount;
+        return;
+      }
+    }
+
+    line = next + 1;
+  }
+}
+
+void ObjChunk::parseLine(const char* text, const char* lineEnd)
+{
+  const char* command = text;
+  const size_t length = parseName(&text, lineEnd);
+
+  if (matches(command, length, "v"))
+  {
+    vec3 vertex;
+
+    vertex.x = parseFloat(&text, lineEnd);
+    vertex.y = parseFloat(&text, lineEnd);
+    vertex.z = parseFloat(&text, lineEnd);
+    positions.push_back(vertex);
+  }
+  else if (matches(command, length, "vt"))
+  {
+    vec2 texcoord;
+
+    texcoord.x = parseFloat(&text, lineEnd);
+    texcoord.y = parseFloat(&text, lineEnd);
+    texcoords.push_back(texcoord);
+  }
+  else if (matches(command, length, "vn"))
+  {
+    vec3 normal;
+
+    normal.x = parseFloat(&text, lineEnd);
+    normal.y = parseFloat(&text, lineEnd);
+    normal.z = parseFloat(&text, lineEnd);
+    normals.push_back(normalize(normal));
+  }
+  else if (matches(command, length, "f"))
+  {
+    if (runs.empty())
+    {
+      runs.push_back(ObjFaceRun());
+      runs.back().hasMaterial = false;
+      runs.back().firstLine = lineCount;
+    }
+
+    FaceList& faces = runs.back().faces;
+
+    Triplet triplets[3];
+    uint count = 0;
+
+    while (text < lineEnd)
+    {
+      Triplet triplet;
+
+      triplet.vertex = parseInteger(&text, lineEnd);
+      triplet.texcoord = 0;
+      triplet.normal = 0;
+
+      if (text < lineEnd && *text == '/')
+      {
+        if (++text < lineEnd && isDigit(*text))
+          triplet.texcoord = parseInteger(&text, lineEnd);
+
+        if (text < lineEnd && *text == '/')
+        {
+          if (++text < lineEnd && isDigit(*text))
+            triplet.normal = parseInteger(&text, lineEnd);
+        }
+      }
+
+      skipSpace(&text, lineEnd);
+
+      // Polygons are triangulated as a fan around the first point
+      if (count < 2)
+        triplets[count] = triplet;
+      else
+      {
+        triplets[2] = triplet;
+
+        faces.push_back(Face());
+        Face& face = faces.back();
+
+        face.p[0] = triplets[0];
+        face.p[1] = triplets[1];
+        face.p[2] = triplets[2];
+
+        triplets[1] = triplet;
+      }
+
+      count++;
+    }
+  }
+  else if (matches(command, length, "usemtl"))
+  {
+    const char* materialName = text;
+    const size_t materialLength = parseName(&text, lineEnd);
+
+    skipSpace(&materialName, lineEnd);
+
+    runs.push_back(ObjFaceRun());
+    runs.back().hasMaterial = true;
+    runs.back().materialName.assign(materialName, materialLength);
+    runs.back().firstLine = lineCount;
+  }
+  else if (matches(command, length, "g") ||
+           matches(command, length, "o") ||
+           matches(command, length, "s") ||
+           matches(command, length, "mtllib"))
+  {
+    // Silently ignore group and object names, smoothing and .mtl files
+  }
+  else
+  {
+    warnings.push_back(ObjWarning());
+    warnings.back().line = lineCount;
+    warnings.back().command.assign(command, length);
+  }
+}
+
+
+typedef std::vector<MeshTriangle> TriangleList;
+
+/* Post-transform vertex cache simulation, using the FIFO replacement most
+ * hardware implements.
+ */
+class VertexCache
+{
+public:
+  VertexCache(size_t vertexCount, uint size);
+  bool miss(uint32 vertex);
+  bool contains(uint32 vertex) const { return m_time - m_stamps[vertex] <= m_size; }
+  void flush() { m_time += m_size + 1; }
+private:
+  std::vector<uint> m_stamps;
+  uint m_size;
+  uint m_time;
+};
+
+VertexCache::VertexCache(size_t vertexCount, uint size):
+  m_stamps(vertexCount, 0),
+  m_size(size),
+  m_time(size + 1)
+{
+}
+
+bool VertexCache::miss(uint32 vertex)
+{
+  if (contains(vertex))
+    return false;
+
+  m_stamps[vertex] = m_time++;
+  return true;
+}
+
+size_t countCacheMisses(const TriangleList& triangles,
+                        size_t first,
+                        size_t last,
+                        size_t vertexCount,
+                        uint cacheSize)
+{
+  VertexCache cache(vertexCount, cacheSize);
+  size_t misses = 0;
+
+  for (size_t i = first;  i < last;  i++)
+  {
+    for (uint k = 0;  k < 3;  k++)
+    {
+      if (cache.miss(triangles[i].indices[k]))
+        misses++;
+    }
+  }
+
+  return misses;
+}
+
+/* Reorders triangles for the vertex cache with the Tipsify algorithm by
+ * Sander, Nehab and Barczak.  The start of each run that had to jump to a
+ * vertex outside the cache is added to the cluster list.
+ */
+void tipsify(TriangleList& triangles,
+             size_t vertexCount,
+             uint cacheSize,
+             std::vector<size_t>& clusters)
+{
+  std::vector<uint> live(vertexCount, 0);
+
+  for (auto& t : triangles)
+  {
+    for (uint k = 0;  k < 3;  k++)
+      live[t.indices[k]]++;
+  }
+
+  std::vector<size_t> offsets(vertexCount + 1, 0);
+
+  for (size_t v = 0;  v < vertexCount;  v++)
+    offsets[v + 1] = offsets[v] + live[v];
+
+  std::vector<uint32> adjacency(offsets.back());
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+
+  for (size_t i = 0;  i < triangles.size();  i++)
+  {
+    for (uint k = 0;  k < 3;  k++)
+      adjacency[fill[triangles[i].indices[k]]++] = uint32(i);
+  }
+
+  TriangleList result;
+  result.reserve(triangles.size());
+
+  std::vector<bool> emitted(triangles.size(), false);
+  std::vector<uint32> deadEnds;
+  std::vector<uint32> candidates;
+  std::vector<uint> stamps(vertexCount, 0);
+  uint time = cacheSize + 1;
+  size_t cursor = 0;
+
+  auto skipDeadEnd = [&]() -> int64
+  {
+    while (!deadEnds.empty())
+    {
+      const uint32 vertex = deadEnds.back();
+      deadEnds.pop_back();
+
+      if (live[vertex])
+        return vertex;
+    }
+
+    while (cursor < vertexCount)
+    {
+      if (live[cursor])
+        return int64(cursor);
+
+      cursor++;
+    }
+
+    return -1;
+  };
+
+  clusters.clear();
+
+  int64 fan = skipDeadEnd();
+  if (fan != -1)
+    clusters.push_back(0);
+
+  while (fan != -1)
+  {
+    candidates.clear();
+
+    for (size_t a = offsets[fan];  a < offsets[fan + 1];  a++)
+    {
+      const uint32 triangle = adjacency[a];
+      if (emitted[triangle])
+        continue;
+
+      const MeshTriangle& t = triangles[triangle];
+
+      for (uint k = 0;  k < 3;  k++)
+      {
+        const uint32 vertex = t.indices[k];
+
+        deadEnds.push_back(vertex);
+        candidates.push_back(vertex);
+        live[vertex]--;
+
+        if (time - stamps[vertex] > cacheSize)
+          stamps[vertex] = time++;
+      }
+
+      emitted[triangle] = true;
+      result.push_back(t);
+    }
+
+    // Prefer the vertex that will still be in the cache after its remaining
+    // triangles have been emitted, and among those the oldest
+    int64 next = -1;
+    int best = -1;
+
+    for (auto vertex : candidates)
+    {
+      if (!live[vertex])
+        continue;
+
+      int priority = 0;
+      if (time - stamps[vertex] + 2 * live[vertex] <= cacheSize)
+        priority = int(time - stamps[vertex]);
+
+      if (priority > best)
+      {
+        best = priority;
+        next = vertex;
+      }
+    }
+
+    if (next == -1)
+    {
+      next = skipDeadEnd();
+      if (next != -1)
+        clusters.push_back(result.size());
+    }
+
+    fan = next;
+  }
+
+  triangles.swap(result);
+}
+
+/* Orders the specified clusters so that those facing away from the center of
+ * the mesh are drawn first, as they are the most likely to occlude others.
+ */
+void sortClusters(TriangleList& triangles,
+                  const std::vector<size_t>& clusters,
+                  const Mesh::VertexList& vertices,
+                  vec3 center)
+{
+  std::vector<std::pair<float, size_t>> order;
+
+  for (size_t c = 0;  c < clusters.size();  c++)
+  {
+    const size_t first = clusters[c];
+    const size_t last = (c + 1 < clusters.size()) ? clusters[c + 1] : triangles.size();
+
+    vec3 centroid;
+    vec3 normal;
+    float area = 0.f;
+
+    for (size_t i = first;  i < last;  i++)
+    {
+      const vec3& p0 = vertices[triangles[i].indices[0]].position;
+      const vec3& p1 = vertices[triangles[i].indices[1]].position;
+      const vec3& p2 = vertices[triangles[i].indices[2]].position;
+
+      const vec3 weighted = cross(p1 - p0, p2 - p0);
+      const float weight = length(weighted);
+
+      centroid += (p0 + p1 + p2) * (weight / 3.f);
+      normal += weighted;
+      area += weight;
+    }
+
+    if (area > 0.f)
+      centroid /= area;
+
+    order.push_back(std::make_pair(dot(centroid - center, normal), c));
+  }
+
+  std::stable_sort(order.begin(), order.end(),
+                   [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b)
+  {
+    return a.first > b.first;
+  });
 
-struct Triplet
-{
-  uint32 vertex;
-  uint32 normal;
-  uint32 texcoord;
-};
+  TriangleList result;
+  result.reserve(triangles.size());
 
-struct Face
-{
-  Triplet p[3];
-};
+  for (auto& o : order)
+  {
+    const size_t first = clusters[o.second];
+    const size_t last = (o.second + 1 < clusters.size()) ? clusters[o.second + 1] : triangles.size();
 
-typedef std::vector<Face> FaceList;
+    result.insert(result.end(), triangles.begin() + first, triangles.begin() + last);
+  }
 
-struct FaceGroup
-{
-  FaceList faces;
-  String name;
-};
+  triangles.swap(result);
+}
 
 } /*namespace*/
 
@@ -257,9 +1585,9 @@ MeshSection* Mesh::findSection(const char* materialName)
   return nullptr;
 }
 
-void Mesh::generateNormals(NormalType type)
+void Mesh::generateNormals(NormalType type, ThreadPool* pool)
 {
-  generateTriangleNormals();
+  generateTriangleNormals(pool);
 
   VertexTool tool(vertices);
 
@@ -279,23 +1607,271 @@ void Mesh::generateNormals(NormalType type)
     }
   }
 
-  tool.realizeVertices(vertices);
+  tool.realizeVertices(vertices, pool);
+}
+
+void Mesh::generateTriangleNormals(ThreadPool* pool)
+{
+  for (auto& s : sections)
+  {
+    std::vector<MeshTriangle>& triangles = s.triangles;
+
+    forEachRange(pool, triangles.size(), [&](size_t first, size_t last)
+    {
+      for (size_t i = first;  i < last;  i++)
+      {
+        MeshTriangle& t = triangles[i];
+
+        const vec3 one = vertices[t.indices[1]].position -
+                         vertices[t.indices[0]].position;
+        const vec3 two = vertices[t.indices[2]].position -
+                         vertices[t.indices[0]].position;
+
+        t.normal = normalize(cross(one, two));
+      }
+    }, 4096);
+  }
+}
+
+void Mesh::weldVertices(float epsilon)
+{
+  const double scale = 1.0 / epsilon;
+
+  VertexWelder welder(vertices.size());
+  std::vector<uint32> remap(vertices.size());
+  VertexList welded;
+
+  for (size_t i = 0;  i < vertices.size();  i++)
+  {
+    const MeshVertex& v = vertices[i];
+
+    WeldKey key;
+    key.set(0, v.position.x, scale);
+    key.set(1, v.position.y, scale);
+    key.set(2, v.position.z, scale);
+    key.set(3, v.normal.x, scale);
+    key.set(4, v.normal.y, scale);
+    key.set(5, v.normal.z, scale);
+    key.set(6, v.texcoord.x, scale);
+    key.set(7, v.texcoord.y, scale);
+
+    bool inserted;
+    remap[i] = welder.insert(key, inserted);
+    if (inserted)
+      welded.push_back(v);
+  }
+
+  for (auto& s : sections)
+  {
+    for (auto& t : s.triangles)
+    {
+      for (uint k = 0;  k < 3;  k++)
+        t.indices[k] = remap[t.indices[k]];
+    }
+  }
+
+  vertices.swap(welded);
+}
+
+void Mesh::simplify(size_t targetCount)
+{
+  Simplifier simplifier(*this);
+  simplifier.simplify(targetCount);
+
+  // Remove sections and vertices no longer referenced by any triangle
+  sections.erase(std::remove_if(sections.begin(), sections.end(),
+                                [](const MeshSection& s) { return s.triangles.empty(); }),
+                 sections.end());
+
+  const uint32 none = uint32(-1);
+  std::vector<uint32> remap(vertices.size(), none);
+  VertexList used;
+
+  for (auto& s : sections)
+  {
+    for (auto& t : s.triangles)
+    {
+      for (uint k = 0;  k < 3;  k++)
+      {
+        uint32& index = remap[t.indices[k]];
+        if (index == none)
+        {
+          index = uint32(used.size());
+          used.push_back(vertices[t.indices[k]]);
+        }
+
+        t.indices[k] = index;
+      }
+    }
+  }
+
+  vertices.swap(used);
+
+  generateTriangleNormals();
+}
+
+void Mesh::optimize(uint cacheSize)
+{
+  optimizeTriangleOrder(cacheSize);
+  optimizeVertexOrder();
+}
+
+void Mesh::optimizeTriangleOrder(uint cacheSize, float threshold)
+{
+  if (vertices.empty())
+    return;
+
+  vec3 center;
+
+  for (auto& v : vertices)
+    center += v.position;
+
+  center /= float(vertices.size());
+
+  for (auto& s : sections)
+  {
+    TriangleList& triangles = s.triangles;
+    if (triangles.empty())
+      continue;
+
+    std::vector<size_t> clusters;
+    tipsify(triangles, vertices.size(), cacheSize, clusters);
+
+    const size_t count = triangles.size();
+    const size_t misses = countCacheMisses(triangles, 0, count, vertices.size(), cacheSize);
+
+    // Split the clusters further wherever a cluster drawn on its own would
+    // already have reached the miss ratio of the whole section
+    std::vector<size_t> splits;
+    VertexCache cache(vertices.size(), cacheSize);
+
+    for (size_t c = 0;  c < clusters.size();  c++)
+    {
+      const size_t last = (c + 1 < clusters.size()) ? clusters[c + 1] : count;
+      size_t start = clusters[c];
+      size_t clusterMisses = 0;
+
+      splits.push_back(start);
+      cache.flush();
+
+      for (size_t i = start;  i < last;  i++)
+      {
+        for (uint k = 0;  k < 3;  k++)
+        {
+          if (cache.miss(triangles[i].indices[k]))
+            clusterMisses++;
+        }
+
+        if (i + 1 < last && clusterMisses * count <= misses * (i + 1 - start))
+        {
+          start = i + 1;
+          clusterMisses = 0;
+          splits.push_back(start);
+          cache.flush();
+        }
+      }
+    }
+
+    // Order the clusters to reduce overdraw, falling back to the coarser
+    // clusters and then to the original order if the cache suffers too much
+    const TriangleList ordered(triangles);
+    const size_t limit = size_t(misses * threshold);
+
+    sortClusters(triangles, splits, vertices, center);
+    if (countCacheMisses(triangles, 0, count, vertices.size(), cacheSize) <= limit)
+      continue;
+
+    triangles = ordered;
+    sortClusters(triangles, clusters, vertices, center);
+    if (countCacheMisses(triangles, 0, count, vertices.size(), cacheSize) <= limit)
+      continue;
+
+    triangles = ordered;
+  }
 }
 
-void Mesh::generateTriangleNormals()
+void Mesh::optimizeVertexOrder()
 {
+  const uint32 none = uint32(-1);
+  std::vector<uint32> remap(vertices.size(), none);
+  VertexList ordered;
+  ordered.reserve(vertices.size());
+
   for (auto& s : sections)
   {
     for (auto& t : s.triangles)
     {
-      const vec3 one = vertices[t.indices[1]].position -
-                       vertices[t.indices[0]].position;
-      const vec3 two = vertices[t.indices[2]].position -
-                       vertices[t.indices[0]].position;
+      for (uint k = 0;  k < 3;  k++)
+      {
+        uint32& index = remap[t.indices[k]];
+        if (index == none)
+        {
+          index = uint32(ordered.size());
+          ordered.push_back(vertices[t.indices[k]]);
+        }
+
+        t.indices[k] = index;
+      }
+    }
+  }
+
+  // Keep unreferenced vertices, after all referenced ones
+  for (size_t i = 0;  i < vertices.size();  i++)
+  {
+    if (remap[i] == none)
+      ordered.push_back(vertices[i]);
+  }
+
+  vertices.swap(ordered);
+}
+
+float Mesh::averageCacheMissRatio(uint cacheSize) const
+{
+  const size_t count = triangleCount();
+  if (!count)
+    return 0.f;
+
+  return float(cacheMissCount(cacheSize)) / count;
+}
 
-      t.normal = normalize(cross(one, two));
+float Mesh::averageTransformRatio(uint cacheSize) const
+{
+  std::vector<bool> used(vertices.size(), false);
+  size_t count = 0;
+
+  for (auto& s : sections)
+  {
+    for (auto& t : s.triangles)
+    {
+      for (uint k = 0;  k < 3;  k++)
+      {
+        if (!used[t.indices[k]])
+        {
+          used[t.indices[k]] = true;
+          count++;
+        }
+      }
     }
   }
+
+  if (!count)
+    return 0.f;
+
+  return float(cacheMissCount(cacheSize)) / count;
+}
+
+size_t Mesh::cacheMissCount(uint cacheSize) const
+{
+  size_t misses = 0;
+
+  // Each section is a separate draw call and starts with an empty cache
+  for (auto& s : sections)
+  {
+    misses += countCacheMisses(s.triangles, 0, s.triangles.size(),
+                               vertices.size(), cacheSize);
+  }
+
+  return misses;
 }
 
 AABB Mesh::generateBoundingAABB() const
@@ -382,171 +1958,157 @@ size_t Mesh::triangleCount() const
   return count;
 }
 
-Ref<Mesh> Mesh::read(ResourceCache& cache, const String& name)
+Ref<Mesh> Mesh::read(ResourceCache& cache, const String& name, ThreadPool* pool)
 {
-  MeshReader reader(cache);
+  MeshReader reader(cache, pool);
   return reader.read(name);
 }
 
 ///////////////////////////////////////////////////////////////////////
 
-MeshReader::MeshReader(ResourceCache& index):
-  ResourceReader<Mesh>(index)
+MeshReader::MeshReader(ResourceCache& index, ThreadPool* pool):
+  ResourceReader<Mesh>(index),
+  m_pool(pool)
 {
 }
 
 Ref<Mesh> MeshReader::read(const String& name, const Path& path)
 {
-  std::ifstream stream(path.name().c_str(), std::ios::in | std::ios::binary);
-  if (stream.fail())
+  MappedFile file;
+  if (!file.open(path))
   {
     logError("Failed to open mesh %s", name.c_str());
     return nullptr;
   }
 
-  String line;
-  uint lineNumber = 0;
+  const char* start = file.data();
+  const char* end = start + file.size();
 
-  std::vector<vec3> positions;
-  std::vector<vec3> normals;
-  std::vector<vec2> texcoords;
-  std::vector<Triplet> triplets;
+  size_t chunkCount = 1;
+  if (m_pool)
+  {
+    chunkCount = min(size_t(m_pool->workerCount() + 1),
+                     file.size() / OBJ_MIN_CHUNK_SIZE);
+    chunkCount = max(chunkCount, size_t(1));
+  }
 
-  std::vector<FaceGroup> groups;
-  FaceGroup* group = nullptr;
+  // Split the file at line boundaries so the chunks can be parsed in parallel
 
-  while (std::getline(stream, line))
-  {
-    const char* text = line.c_str();
-    ++lineNumber;
+  std::vector<ObjChunk> chunks;
 
-    if (!interesting(&text))
-      continue;
+  for (size_t i = 1;  i <= chunkCount;  i++)
+  {
+    const char* chunkEnd = end;
 
-    try
+    if (i < chunkCount)
     {
-      String command = parseName(&text);
+      chunkEnd = start + file.size() * i / chunkCount;
 
-      if (command == "g")
-      {
-        // Silently ignore group names
-      }
-      else if (command == "o")
-      {
-        // Silently ignore object names
-      }
-      else if (command == "s")
-      {
-        // Silently ignore smoothing
-      }
-      else if (command == "v")
-      {
-        vec3 vertex;
+      const char* newline = (const char*) std::memchr(chunkEnd, '\n', end - chunkEnd);
+      if (newline)
+        chunkEnd = newline + 1;
+      else
+        chunkEnd = end;
+    }
 
-        vertex.x = parseFloat(&text);
-        vertex.y = parseFloat(&text);
-        vertex.z = parseFloat(&text);
-        positions.push_back(vertex);
-      }
-      else if (command == "vt")
-      {
-        vec2 texcoord;
+    const char* chunkStart = chunks.empty() ? start : chunks.back().end;
+    if (chunkStart < chunkEnd)
+      chunks.push_back(ObjChunk(chunkStart, chunkEnd));
+  }
 
-        texcoord.x = parseFloat(&text);
-        texcoord.y = parseFloat(&text);
-        texcoords.push_back(texcoord);
-      }
-      else if (command == "vn")
-      {
-        vec3 normal;
+  if (chunks.size() > 1)
+  {
+    m_pool->parallelFor(chunks.size(), [&](size_t first, size_t last)
+    {
+      for (size_t i = first;  i < last;  i++)
+        chunks[i].parse();
+    });
+  }
+  else if (!chunks.empty())
+    chunks.front().parse();
 
-        normal.x = parseFloat(&text);
-        normal.y = parseFloat(&text);
-        normal.z = parseFloat(&text);
-        normals.push_back(normalize(normal));
-      }
-      else if (command == "usemtl")
-      {
-        String materialName = parseName(&text);
+  // Merge the chunks in file order, reporting the same warnings and errors as
+  // a sequential parse would
 
-        group = nullptr;
+  size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
 
-        for (auto& g : groups)
-        {
-          if (g.name == materialName)
-            group = &g;
-        }
+  for (auto& c : chunks)
+  {
+    positionCount += c.positions.size();
+    normalCount += c.normals.size();
+    texcoordCount += c.texcoords.size();
+  }
 
-        if (!group)
-        {
-          groups.push_back(FaceGroup());
-          groups.back().name = materialName;
-          group = &(groups.back());
-        }
-      }
-      else if (command == "mtllib")
-      {
-        // Silently ignore .mtl material files
-      }
-      else if (command == "f")
-      {
-        if (!group)
-          throw Exception("Expected \'usemtl\' before \'f\'");
+  std::vector<vec3> positions;
+  std::vector<vec3> normals;
+  std::vector<vec2> texcoords;
 
-        triplets.clear();
+  positions.reserve(positionCount);
+  normals.reserve(normalCount);
+  texcoords.reserve(texcoordCount);
 
-        while (*text != '\0')
-        {
-          triplets.push_back(Triplet());
-          Triplet& triplet = triplets.back();
+  std::vector<FaceGroup> groups;
+  std::unordered_map<String, size_t> groupIndices;
+  FaceGroup* group = nullptr;
 
-          triplet.vertex = parseInteger(&text);
-          triplet.texcoord = 0;
-          triplet.normal = 0;
+  uint lineBase = 0;
 
-          if (*text == '/')
-          {
-            if (std::isdigit(*(++text)))
-              triplet.texcoord = parseInteger(&text);
-
-            if (*text == '/')
-            {
-              if (std::isdigit(*(++text)))
-                triplet.normal = parseInteger(&text);
-            }
-          }
+  for (auto& c : chunks)
+  {
+    String error = c.error;
+    uint errorLine = c.errorLine;
 
-          while (std::isspace(*text))
-            text++;
-        }
+    if (!group && !c.runs.empty() && !c.runs.front().hasMaterial)
+    {
+      error = "Expected \'usemtl\' before \'f\'";
+      errorLine = c.runs.front().firstLine;
+    }
 
-        for (size_t i = 2;  i < triplets.size();  i++)
-        {
-          group->faces.push_back(Face());
-          Face& face = group->faces.back();
+    for (auto& w : c.warnings)
+    {
+      if (!error.empty() && w.line > errorLine)
+        break;
 
-          face.p[0] = triplets[0];
-          face.p[1] = triplets[i - 1];
-          face.p[2] = triplets[i];
-        }
-      }
-      else
-      {
-        logWarning("Unknown command %s in mesh %s line %d",
-                   command.c_str(),
-                   name.c_str(),
-                   lineNumber);
-      }
+      logWarning("Unknown command %s in mesh %s line %d",
+                 w.command.c_str(),
+                 name.c_str(),
+                 lineBase + w.line);
     }
-    catch (Exception& e)
+
+    if (!error.empty())
     {
       logError("%s in mesh %s line %d",
-               e.what(),
+               error.c_str(),
                name.c_str(),
-               lineNumber);
+               lineBase + errorLine);
 
       return nullptr;
     }
+
+    positions.insert(positions.end(), c.positions.begin(), c.positions.end());
+    normals.insert(normals.end(), c.normals.begin(), c.normals.end());
+    texcoords.insert(texcoords.end(), c.texcoords.begin(), c.texcoords.end());
+
+    for (auto& r : c.runs)
+    {
+      if (r.hasMaterial)
+      {
+        auto entry = groupIndices.find(r.materialName);
+        if (entry == groupIndices.end())
+        {
+          groupIndices[r.materialName] = groups.size();
+          groups.push_back(FaceGroup());
+          groups.back().name = r.materialName;
+          group = &(groups.back());
+        }
+        else
+          group = &groups[entry->second];
+      }
+
+      group->faces.insert(group->faces.end(), r.faces.begin(), r.faces.end());
+    }
+
+    lineBase += c.lineCount;
   }
 
   Ref<Mesh> mesh = new Mesh(ResourceInfo(cache, name, path));
@@ -590,65 +2152,26 @@ Ref<Mesh> MeshReader::read(const String& name, const Path& path)
     }
   }
 
-  tool.realizeVertices(mesh->vertices);
+  tool.realizeVertices(mesh->vertices, m_pool);
   return mesh;
 }
 
-String MeshReader::parseName(const char** text)
-{
-  while (std::isspace(**text))
-    (*text)++;
+///////////////////////////////////////////////////////////////////////
 
-  String result;
+bool MeshWriter::write(const Path& path, const Mesh& data, bool optimize)
+{
+  Ref<Mesh> optimized;
 
-  while (std::isalnum(**text) || **text == '_')
+  if (optimize)
   {
-    result.append(1, **text);
-    (*text)++;
+    optimized = new Mesh(ResourceInfo(data.cache()));
+    optimized->vertices = data.vertices;
+    optimized->sections = data.sections;
+    optimized->optimize();
   }
 
-  if (!result.size())
-    throw Exception("Expected but missing name");
-
-  return result;
-}
-
-int MeshReader::parseInteger(const char** text)
-{
-  char* end;
-
-  const int result = std::strtol(*text, &end, 0);
-  if (end == *text)
-    throw Exception("Expected but missing integer value");
-
-  *text = end;
-  return result;
-}
-
-float MeshReader::parseFloat(const char** text)
-{
-  char* end;
-
-  const float result = float(std::strtod(*text, &end));
-  if (end == *text)
-    throw Exception("Expected but missing float value");
-
-  *text = end;
-  return result;
-}
-
-bool MeshReader::interesting(const char** text)
-{
-  if (std::isspace(**text) || **text == '#' || **text == '\0' || **text == '\r')
-    return false;
-
-  return true;
-}
-
-///////////////////////////////////////////////////////////////////////
+  const Mesh& mesh = optimize ? *optimized : data;
 
-bool MeshWriter::write(const Path& path, const Mesh& mesh)
-{
   std::ofstream stream(path.name().c_str());
   if (!stream.is_open())
   {
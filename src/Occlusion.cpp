@@ -0,0 +1,398 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+
+#include <wendy/Core.hpp>
+#include <wendy/Transform.hpp>
+#include <wendy/Primitive.hpp>
+#include <wendy/Frustum.hpp>
+#include <wendy/Camera.hpp>
+#include <wendy/Path.hpp>
+#include <wendy/Resource.hpp>
+#include <wendy/Mesh.hpp>
+#include <wendy/Occlusion.hpp>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+const uint TILE_SIZE = 8;
+
+uint roundToTile(uint size)
+{
+  return (std::max(size, 1u) + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+void OcclusionBuffer::clear(const Camera& camera)
+{
+  m_view = camera.viewTransform();
+  m_projection = camera.projectionMatrix();
+  m_viewProjection = m_projection * m_view;
+
+  std::fill(m_depths.begin(), m_depths.end(), 1.f);
+
+  m_triangleCount = 0;
+  m_dirtyTiles = true;
+}
+
+void OcclusionBuffer::addOccluder(const Mesh& mesh, const Transform3& transform)
+{
+  const mat4 model = transform;
+  const mat4 matrix = m_viewProjection * model;
+
+  m_vertices.resize(mesh.vertices.size());
+
+  for (size_t i = 0;  i < mesh.vertices.size();  i++)
+    m_vertices[i] = matrix * vec4(mesh.vertices[i].position, 1.f);
+
+  for (const MeshSection& s : mesh.sections)
+  {
+    for (const MeshTriangle& t : s.triangles)
+    {
+      addTriangle(m_vertices[t.indices[0]],
+                  m_vertices[t.indices[1]],
+                  m_vertices[t.indices[2]]);
+    }
+  }
+
+  m_dirtyTiles = true;
+}
+
+bool OcclusionBuffer::isOccluded(const Sphere& bounds) const
+{
+  if (!m_triangleCount)
+    return false;
+
+  const vec3 center = vec3(m_view * vec4(bounds.center, 1.f));
+  const float radius = bounds.radius;
+
+  // The nearest point of the sphere determines the depth to test against, and
+  // if that point is in front of the near plane the sphere must be visible
+  const vec4 nearest = m_projection * vec4(center.x, center.y, center.z + radius, 1.f);
+  if (nearest.w <= 0.f || nearest.z < -nearest.w)
+    return false;
+
+  const float depth = nearest.z / nearest.w * 0.5f + 0.5f;
+  if (depth >= 1.f)
+    return false;
+
+  vec2 minimum(std::numeric_limits<float>::max());
+  vec2 maximum(-std::numeric_limits<float>::max());
+
+  for (uint i = 0;  i < 8;  i++)
+  {
+    const vec3 corner(center.x + ((i & 1) ? radius : -radius),
+                      center.y + ((i & 2) ? radius : -radius),
+                      center.z + ((i & 4) ? radius : -radius));
+
+    const vec4 clip = m_projection * vec4(corner, 1.f);
+    const vec2 point = vec2(clip) / clip.w;
+
+    minimum = min(minimum, point);
+    maximum = max(maximum, point);
+  }
+
+  const vec2 size = vec2(float(m_width), float(m_height));
+  minimum = (minimum * 0.5f + 0.5f) * size;
+  maximum = (maximum * 0.5f + 0.5f) * size;
+
+  if (maximum.x < 0.f || maximum.y < 0.f ||
+      minimum.x >= size.x || minimum.y >= size.y)
+  {
+    return false;
+  }
+
+  const uint x0 = uint(std::max(minimum.x, 0.f));
+  const uint y0 = uint(std::max(minimum.y, 0.f));
+  const uint x1 = uint(std::min(maximum.x, size.x - 1.f));
+  const uint y1 = uint(std::min(maximum.y, size.y - 1.f));
+
+  if (m_dirtyTiles)
+    updateTiles();
+
+  for (uint ty = y0 / TILE_SIZE;  ty <= y1 / TILE_SIZE;  ty++)
+  {
+    for (uint tx = x0 / TILE_SIZE;  tx <= x1 / TILE_SIZE;  tx++)
+    {
+      // Every occluder depth in this tile is nearer than the sphere
+      if (m_tiles[ty * m_tileCountX + tx] < depth)
+        continue;
+
+      const uint px0 = std::max(x0, tx * TILE_SIZE);
+      const uint py0 = std::max(y0, ty * TILE_SIZE);
+      const uint px1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1);
+      const uint py1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1);
+
+      for (uint y = py0;  y <= py1;  y++)
+      {
+        const float* row = &m_depths[y * m_width];
+
+        for (uint x = px0;  x <= px1;  x++)
+        {
+          if (row[x] >= depth)
+            return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+Ref<OcclusionBuffer> OcclusionBuffer::create(uint width, uint height)
+{
+  Ref<OcclusionBuffer> buffer(new OcclusionBuffer());
+  if (!buffer->init(width, height))
+    return nullptr;
+
+  return buffer;
+}
+
+OcclusionBuffer::OcclusionBuffer():
+  m_width(0),
+  m_height(0),
+  m_tileCountX(0),
+  m_tileCountY(0),
+  m_triangleCount(0),
+  m_dirtyTiles(false)
+{
+}
+
+bool OcclusionBuffer::init(uint width, uint height)
+{
+  m_width = roundToTile(width);
+  m_height = roundToTile(height);
+  m_tileCountX = m_width / TILE_SIZE;
+  m_tileCountY = m_height / TILE_SIZE;
+
+  m_depths.assign(m_width * m_height, 1.f);
+  m_tiles.assign(m_tileCountX * m_tileCountY, 1.f);
+
+  return true;
+}
+
+void OcclusionBuffer::addTriangle(const vec4& P0, const vec4& P1, const vec4& P2)
+{
+  // Reject triangles entirely outside any one clip plane except the near one
+  if ((P0.x > P0.w && P1.x > P1.w && P2.x > P2.w) ||
+      (P0.x < -P0.w && P1.x < -P1.w && P2.x < -P2.w) ||
+      (P0.y > P0.w && P1.y > P1.w && P2.y > P2.w) ||
+      (P0.y < -P0.w && P1.y < -P1.w && P2.y < -P2.w) ||
+      (P0.z > P0.w && P1.z > P1.w && P2.z > P2.w))
+  {
+    return;
+  }
+
+  // Clip against the near plane, which yields at most a quad
+  const vec4 input[3] = { P0, P1, P2 };
+  vec4 output[4];
+  uint count = 0;
+
+  for (uint i = 0;  i < 3;  i++)
+  {
+    const vec4& a = input[i];
+    const vec4& b = input[(i + 1) % 3];
+    const float da = a.z + a.w;
+    const float db = b.z + b.w;
+
+    if (da >= 0.f)
+      output[count++] = a;
+
+    if ((da >= 0.f) != (db >= 0.f))
+      output[count++] = mix(a, b, da / (da - db));
+  }
+
+  if (count < 3)
+    return;
+
+  const vec3 scale(m_width * 0.5f, m_height * 0.5f, 0.5f);
+  vec3 screen[4];
+
+  for (uint i = 0;  i < count;  i++)
+    screen[i] = (vec3(output[i]) / output[i].w + 1.f) * scale;
+
+  for (uint i = 2;  i < count;  i++)
+    rasterize(screen[0], screen[i - 1], screen[i]);
+
+  m_triangleCount++;
+}
+
+void OcclusionBuffer::rasterize(const vec3& P0, const vec3& P1, const vec3& P2)
+{
+  const vec3* v[3] = { &P0, &P1, &P2 };
+
+  float area = (P1.x - P0.x) * (P2.y - P0.y) - (P1.y - P0.y) * (P2.x - P0.x);
+  if (area == 0.f)
+    return;
+
+  // Both windings are occluders, so flip clockwise triangles
+  if (area < 0.f)
+  {
+    std::swap(v[1], v[2]);
+    area = -area;
+  }
+
+  const float minX = std::min(std::min(P0.x, P1.x), P2.x);
+  const float minY = std::min(std::min(P0.y, P1.y), P2.y);
+  const float maxX = std::max(std::max(P0.x, P1.x), P2.x);
+  const float maxY = std::max(std::max(P0.y, P1.y), P2.y);
+
+  // Sample at pixel centers within the screen
+  const int x0 = std::max(int(std::ceil(minX - 0.5f)), 0);
+  const int y0 = std::max(int(std::ceil(minY - 0.5f)), 0);
+  const int x1 = std::min(int(std::floor(maxX - 0.5f)), int(m_width) - 1);
+  const int y1 = std::min(int(std::floor(maxY - 0.5f)), int(m_height) - 1);
+
+  if (x0 > x1 || y0 > y1)
+    return;
+
+  // Edge functions, each positive on the inside and zero on the edge opposite
+  // the vertex with the same index
+  float A[3], B[3], C[3];
+
+  for (uint i = 0;  i < 3;  i++)
+  {
+    const vec3& a = *v[(i + 1) % 3];
+    const vec3& b = *v[(i + 2) % 3];
+
+    A[i] = a.y - b.y;
+    B[i] = b.x - a.x;
+    C[i] = -(A[i] * a.x + B[i] * a.y);
+  }
+
+  // Depth is linear in screen space, so derive its plane from the edges
+  const float dzdx = (A[0] * v[0]->z + A[1] * v[1]->z + A[2] * v[2]->z) / area;
+  const float dzdy = (B[0] * v[0]->z + B[1] * v[1]->z + B[2] * v[2]->z) / area;
+  const float z0 = (C[0] * v[0]->z + C[1] * v[1]->z + C[2] * v[2]->z) / area;
+
+#if defined(__SSE2__)
+  const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 A0 = _mm_set1_ps(A[0]);
+  const __m128 A1 = _mm_set1_ps(A[1]);
+  const __m128 A2 = _mm_set1_ps(A[2]);
+  const __m128 DZ = _mm_set1_ps(dzdx);
+
+  for (int y = y0;  y <= y1;  y++)
+  {
+    const float py = y + 0.5f;
+    const __m128 R0 = _mm_set1_ps(B[0] * py + C[0]);
+    const __m128 R1 = _mm_set1_ps(B[1] * py + C[1]);
+    const __m128 R2 = _mm_set1_ps(B[2] * py + C[2]);
+    const __m128 RZ = _mm_set1_ps(dzdy * py + z0);
+
+    float* row = &m_depths[y * m_width];
+
+    // The width is a multiple of the tile size, so whole groups of four stay
+    // within the row and pixels outside the triangle are masked off
+    for (int x = x0 & ~3;  x <= x1;  x += 4)
+    {
+      const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+      const __m128 e0 = _mm_add_ps(_mm_mul_ps(A0, px), R0);
+      const __m128 e1 = _mm_add_ps(_mm_mul_ps(A1, px), R1);
+      const __m128 e2 = _mm_add_ps(_mm_mul_ps(A2, px), R2);
+
+      const __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                                _mm_cmpge_ps(e1, zero)),
+                                     _mm_cmpge_ps(e2, zero));
+      if (!_mm_movemask_ps(mask))
+        continue;
+
+      const __m128 z = _mm_add_ps(_mm_mul_ps(DZ, px), RZ);
+      const __m128 stored = _mm_loadu_ps(row + x);
+      const __m128 nearest = _mm_min_ps(stored, z);
+
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest),
+                                       _mm_andnot_ps(mask, stored)));
+    }
+  }
+#else
+  for (int y = y0;  y <= y1;  y++)
+  {
+    const float py = y + 0.5f;
+    float* row = &m_depths[y * m_width];
+
+    for (int x = x0;  x <= x1;  x++)
+    {
+      const float px = x + 0.5f;
+
+      if (A[0] * px + B[0] * py + C[0] < 0.f ||
+          A[1] * px + B[1] * py + C[1] < 0.f ||
+          A[2] * px + B[2] * py + C[2] < 0.f)
+      {
+        continue;
+      }
+
+      row[x] = std::min(row[x], dzdx * px + dzdy * py + z0);
+    }
+  }
+#endif
+}
+
+void OcclusionBuffer::updateTiles() const
+{
+  for (uint ty = 0;  ty < m_tileCountY;  ty++)
+  {
+    for (uint tx = 0;  tx < m_tileCountX;  tx++)
+    {
+      float farthest = 0.f;
+
+      for (uint y = 0;  y < TILE_SIZE;  y++)
+      {
+        const float* row = &m_depths[(ty * TILE_SIZE + y) * m_width + tx * TILE_SIZE];
+
+        for (uint x = 0;  x < TILE_SIZE;  x++)
+          farthest = std::max(farthest, row[x]);
+      }
+
+      m_tiles[ty * m_tileCountX + tx] = farthest;
+    }
+  }
+
+  m_dirtyTiles = false;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
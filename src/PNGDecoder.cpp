@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+
+#include <wendy/Core.hpp>
+#include <wendy/Pixel.hpp>
+
+#include <internal/PNGDecoder.hpp>
+
+#include <cstring>
+
+#include <png.h>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+PixelFormat::Semantic convertToSemantic(int colorType)
+{
+  switch (colorType)
+  {
+    case PNG_COLOR_TYPE_GRAY:
+      return PixelFormat::L;
+    case PNG_COLOR_TYPE_GRAY_ALPHA:
+      return PixelFormat::LA;
+    case PNG_COLOR_TYPE_RGB:
+      return PixelFormat::RGB;
+    case PNG_COLOR_TYPE_RGB_ALPHA:
+      return PixelFormat::RGBA;
+  }
+
+  return PixelFormat::NONE;
+}
+
+PixelFormat::Type convertToType(int bitDepth)
+{
+  switch (bitDepth)
+  {
+    case 8:
+      return PixelFormat::UINT8;
+    case 16:
+      return PixelFormat::UINT16;
+  }
+
+  return PixelFormat::DUMMY;
+}
+
+PixelFormat convertToPixelFormat(int colorType, int bitDepth)
+{
+  return PixelFormat(convertToSemantic(colorType), convertToType(bitDepth));
+}
+
+void writeErrorPNG(png_structp context, png_const_charp error)
+{
+  const String* name = static_cast<const String*>(png_get_error_ptr(context));
+  logError("libpng error in image %s: %s", name->c_str(), error);
+  png_longjmp(context, 1);
+}
+
+void writeWarningPNG(png_structp context, png_const_charp warning)
+{
+  const String* name = static_cast<const String*>(png_get_error_ptr(context));
+  logWarning("libpng warning in image %s: %s", name->c_str(), warning);
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+PNGDecoder::PNGDecoder():
+  m_context(nullptr),
+  m_info(nullptr),
+  m_data(nullptr),
+  m_size(0),
+  m_offset(0),
+  m_width(0),
+  m_height(0),
+  m_passes(1)
+{
+}
+
+PNGDecoder::~PNGDecoder()
+{
+  close();
+}
+
+bool PNGDecoder::open(const void* data, size_t size, const String& name)
+{
+  close();
+
+  m_data = static_cast<const uint8*>(data);
+  m_size = size;
+  m_offset = 8;
+  m_name = name;
+
+  if (m_size < 8 || png_sig_cmp(const_cast<uint8*>(m_data), 0, 8))
+  {
+    logError("Invalid PNG signature in image %s", m_name.c_str());
+    return false;
+  }
+
+  m_context = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                     &m_name,
+                                     writeErrorPNG,
+                                     writeWarningPNG);
+  if (!m_context)
+  {
+    logError("Failed to create PNG read struct for image %s", m_name.c_str());
+    return false;
+  }
+
+  m_info = png_create_info_struct(m_context);
+  if (!m_info)
+  {
+    logError("Failed to create PNG info struct for image %s", m_name.c_str());
+    close();
+    return false;
+  }
+
+  if (setjmp(png_jmpbuf(m_context)))
+  {
+    close();
+    return false;
+  }
+
+  png_set_read_fn(m_context, this, readData);
+  png_set_sig_bytes(m_context, 8);
+  png_read_info(m_context, m_info);
+
+  png_set_packing(m_context);
+  png_set_expand(m_context);
+  m_passes = png_set_interlace_handling(m_context);
+  png_read_update_info(m_context, m_info);
+
+  m_format = convertToPixelFormat(png_get_color_type(m_context, m_info),
+                                  png_get_bit_depth(m_context, m_info));
+  if (!m_format.isValid())
+  {
+    logError("Image %s has unsupported pixel format", m_name.c_str());
+    close();
+    return false;
+  }
+
+  m_width = png_get_image_width(m_context, m_info);
+  m_height = png_get_image_height(m_context, m_info);
+
+  if (png_get_rowbytes(m_context, m_info) != m_width * m_format.size())
+  {
+    logError("Image %s has unexpected row size", m_name.c_str());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+bool PNGDecoder::decode(void* target)
+{
+  if (!m_context)
+  {
+    logError("Cannot decode PNG image that has not been opened");
+    return false;
+  }
+
+  uint8* start = static_cast<uint8*>(target);
+  const size_t rowSize = m_width * m_format.size();
+
+  if (setjmp(png_jmpbuf(m_context)))
+  {
+    close();
+    return false;
+  }
+
+  // Each pass of an interlaced image updates the rows written by the previous
+  for (int pass = 0;  pass < m_passes;  pass++)
+  {
+    for (size_t y = 0;  y < m_height;  y++)
+      png_read_row(m_context, start + (m_height - y - 1) * rowSize, nullptr);
+  }
+
+  png_read_end(m_context, nullptr);
+
+  close();
+  return true;
+}
+
+void PNGDecoder::close()
+{
+  if (m_context)
+    png_destroy_read_struct(&m_context, m_info ? &m_info : nullptr, nullptr);
+
+  m_context = nullptr;
+  m_info = nullptr;
+}
+
+void PNGDecoder::readData(png_struct_def* context, uint8* data, size_t size)
+{
+  PNGDecoder* decoder = static_cast<PNGDecoder*>(png_get_io_ptr(context));
+
+  if (size > decoder->m_size - decoder->m_offset)
+    png_error(context, "Unexpected end of file");
+
+  std::memcpy(data, decoder->m_data + decoder->m_offset, size);
+  decoder->m_offset += size;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
@@ -26,11 +26,20 @@
 #include <wendy/Config.hpp>
 #include <wendy/Core.hpp>
 #include <wendy/Pixel.hpp>
+#include <wendy/Thread.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <limits>
 #include <sstream>
 #include <cctype>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define WENDY_PIXEL_SSE2 1
+#include <emmintrin.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -38,6 +47,756 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+/* Pixel counts for splitting conversions into intermediate chunks and across
+ * worker threads.
+ */
+const size_t CONVERSION_CHUNK_SIZE = 256;
+const size_t PARALLEL_CONVERSION_COUNT = 65536;
+const size_t CONVERSION_GRANULARITY = 16384;
+
+typedef void (*PixelKernel)(void* target, const void* source, size_t count);
+
+/* A dedicated conversion between two pixel formats with a set of flags.
+ */
+class PixelKernelEntry
+{
+public:
+  PixelFormat::Semantic targetSemantic;
+  PixelFormat::Type targetType;
+  PixelFormat::Semantic sourceSemantic;
+  PixelFormat::Type sourceType;
+  uint flags;
+  PixelKernel kernel;
+};
+
+float convertToLinear(float value)
+{
+  if (value <= 0.04045f)
+    return value / 12.92f;
+  else
+    return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float convertToSRGB(float value)
+{
+  if (value <= 0.0031308f)
+    return value * 12.92f;
+  else
+    return 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+const uint SRGB_BUCKET_COUNT = 4096;
+
+/* The linear light value of each 8-bit sRGB value, the linear values halfway
+ * between adjacent sRGB values, for rounding, and the rounded sRGB value at
+ * the start of each of a number of equal linear intervals.
+ */
+class SRGBTable
+{
+public:
+  SRGBTable();
+  uint8 encode(float value) const;
+  float linear[256];
+  float thresholds[256];
+  uint8 codes[SRGB_BUCKET_COUNT + 1];
+};
+
+SRGBTable::SRGBTable()
+{
+  for (uint i = 0;  i < 256;  i++)
+    linear[i] = convertToLinear(i / 255.f);
+
+  for (uint i = 0;  i < 255;  i++)
+    thresholds[i] = convertToLinear((i + 0.5f) / 255.f);
+
+  thresholds[255] = std::numeric_limits<float>::infinity();
+
+  for (uint i = 0;  i <= SRGB_BUCKET_COUNT;  i++)
+  {
+    const float value = float(i) / SRGB_BUCKET_COUNT;
+    codes[i] = uint8(std::upper_bound(thresholds, thresholds + 255, value) - thresholds);
+  }
+}
+
+uint8 SRGBTable::encode(float value) const
+{
+  value = clamp(value, 0.f, 1.f);
+
+  // Buckets are narrower than sRGB steps except near black, where they span
+  // at most a step or so
+  uint code = codes[uint(value * SRGB_BUCKET_COUNT)];
+  while (value >= thresholds[code])
+    code++;
+
+  return uint8(code);
+}
+
+const SRGBTable& sRGBTable()
+{
+  static const SRGBTable table;
+  return table;
+}
+
+float convertHalfToFloat(uint16 value)
+{
+  const uint32 sign = uint32(value & 0x8000) << 16;
+  const uint32 exponent = (value >> 10) & 0x1f;
+  const uint32 mantissa = value & 0x3ff;
+
+  uint32 bits;
+
+  if (exponent == 0x1f)
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  else if (exponent)
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  else
+  {
+    // Zero and subnormals are exact multiples of 2^-24
+    const float result = mantissa * (1.f / 16777216.f);
+    return sign ? -result : result;
+  }
+
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+uint16 convertFloatToHalf(float value)
+{
+  uint32 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const uint16 sign = uint16((bits >> 16) & 0x8000);
+  bits &= 0x7fffffff;
+
+  // Infinity and NaN
+  if (bits >= 0x7f800000)
+    return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+
+  // Overflow to infinity
+  if (bits >= 0x477ff000)
+    return sign | 0x7c00;
+
+  // Subnormals, rounded by adding a magic value
+  if (bits < 0x38800000)
+  {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    f += 0.5f;
+
+    uint32 result;
+    std::memcpy(&result, &f, sizeof(result));
+    return sign | uint16(result - 0x3f000000);
+  }
+
+  // Normals, rounded to nearest even
+  const uint32 odd = (bits >> 13) & 1;
+  bits += 0xc8000fff + odd;
+  return sign | uint16(bits >> 13);
+}
+
+void unpackUnorm8(float* target, const uint8* source, size_t count)
+{
+  size_t i = 0;
+
+#if WENDY_PIXEL_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(1.f / 255.f);
+
+  for (;  i + 16 <= count;  i += 16)
+  {
+    const __m128i bytes = _mm_loadu_si128((const __m128i*) (source + i));
+    const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+    const __m128i values[] =
+    {
+      _mm_unpacklo_epi16(lo, zero),
+      _mm_unpackhi_epi16(lo, zero),
+      _mm_unpacklo_epi16(hi, zero),
+      _mm_unpackhi_epi16(hi, zero)
+    };
+
+    for (uint j = 0;  j < 4;  j++)
+      _mm_storeu_ps(target + i + j * 4, _mm_mul_ps(_mm_cvtepi32_ps(values[j]), scale));
+  }
+#endif
+
+  for (;  i < count;  i++)
+    target[i] = source[i] * (1.f / 255.f);
+}
+
+void packUnorm8(uint8* target, const float* source, size_t count)
+{
+  size_t i = 0;
+
+#if WENDY_PIXEL_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 scale = _mm_set1_ps(255.f);
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  for (;  i + 16 <= count;  i += 16)
+  {
+    __m128i values[4];
+
+    for (uint j = 0;  j < 4;  j++)
+    {
+      __m128 v = _mm_loadu_ps(source + i + j * 4);
+      v = _mm_min_ps(_mm_max_ps(v, zero), one);
+      values[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+    }
+
+    const __m128i lo = _mm_packs_epi32(values[0], values[1]);
+    const __m128i hi = _mm_packs_epi32(values[2], values[3]);
+    _mm_storeu_si128((__m128i*) (target + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+
+  for (;  i < count;  i++)
+    target[i] = uint8(clamp(source[i], 0.f, 1.f) * 255.f + 0.5f);
+}
+
+void decodeChannels(float* target,
+                    const void* source,
+                    PixelFormat::Type type,
+                    size_t count)
+{
+  switch (type)
+  {
+    case PixelFormat::UINT8:
+    {
+      unpackUnorm8(target, (const uint8*) source, count);
+      break;
+    }
+
+    case PixelFormat::UINT16:
+    {
+      const uint16* values = (const uint16*) source;
+      for (size_t i = 0;  i < count;  i++)
+        target[i] = values[i] * (1.f / 65535.f);
+      break;
+    }
+
+    case PixelFormat::UINT24:
+    {
+      const uint8* values = (const uint8*) source;
+      for (size_t i = 0;  i < count;  i++)
+      {
+        uint32 value = 0;
+        std::memcpy(&value, values + i * 3, 3);
+        target[i] = float(value / 16777215.0);
+      }
+      break;
+    }
+
+    case PixelFormat::UINT32:
+    {
+      const uint32* values = (const uint32*) source;
+      for (size_t i = 0;  i < count;  i++)
+        target[i] = float(values[i] / 4294967295.0);
+      break;
+    }
+
+    case PixelFormat::FLOAT16:
+    {
+      const uint16* values = (const uint16*) source;
+      for (size_t i = 0;  i < count;  i++)
+        target[i] = convertHalfToFloat(values[i]);
+      break;
+    }
+
+    case PixelFormat::FLOAT32:
+    {
+      std::memcpy(target, source, count * sizeof(float));
+      break;
+    }
+
+    default:
+      panic("Invalid pixel format type %u", type);
+  }
+}
+
+void encodeChannels(void* target,
+                    const float* source,
+                    PixelFormat::Type type,
+                    size_t count)
+{
+  switch (type)
+  {
+    case PixelFormat::UINT8:
+    {
+      packUnorm8((uint8*) target, source, count);
+      break;
+    }
+
+    case PixelFormat::UINT16:
+    {
+      uint16* values = (uint16*) target;
+      for (size_t i = 0;  i < count;  i++)
+        values[i] = uint16(clamp(source[i], 0.f, 1.f) * 65535.f + 0.5f);
+      break;
+    }
+
+    case PixelFormat::UINT24:
+    {
+      uint8* values = (uint8*) target;
+      for (size_t i = 0;  i < count;  i++)
+      {
+        const uint32 value = uint32(clamp(double(source[i]), 0.0, 1.0) * 16777215.0 + 0.5);
+        std::memcpy(values + i * 3, &value, 3);
+      }
+      break;
+    }
+
+    case PixelFormat::UINT32:
+    {
+      uint32* values = (uint32*) target;
+      for (size_t i = 0;  i < count;  i++)
+        values[i] = uint32(clamp(double(source[i]), 0.0, 1.0) * 4294967295.0 + 0.5);
+      break;
+    }
+
+    case PixelFormat::FLOAT16:
+    {
+      uint16* values = (uint16*) target;
+      for (size_t i = 0;  i < count;  i++)
+        values[i] = convertFloatToHalf(source[i]);
+      break;
+    }
+
+    case PixelFormat::FLOAT32:
+    {
+      std::memcpy(target, source, count * sizeof(float));
+      break;
+    }
+
+    default:
+      panic("Invalid pixel format type %u", type);
+  }
+}
+
+void expandToRGBA(float* target,
+                  const float* source,
+                  PixelFormat::Semantic semantic,
+                  size_t count)
+{
+  switch (semantic)
+  {
+    case PixelFormat::L:
+    case PixelFormat::DEPTH:
+    {
+      for (size_t i = 0;  i < count;  i++)
+      {
+        target[i * 4 + 0] = target[i * 4 + 1] = target[i * 4 + 2] = source[i];
+        target[i * 4 + 3] = 1.f;
+      }
+
+      break;
+    }
+
+    case PixelFormat::LA:
+    {
+      for (size_t i = 0;  i < count;  i++)
+      {
+        target[i * 4 + 0] = target[i * 4 + 1] = target[i * 4 + 2] = source[i * 2];
+        target[i * 4 + 3] = source[i * 2 + 1];
+      }
+
+      break;
+    }
+
+    case PixelFormat::RGB:
+    {
+      for (size_t i = 0;  i < count;  i++)
+      {
+        target[i * 4 + 0] = source[i * 3 + 0];
+        target[i * 4 + 1] = source[i * 3 + 1];
+        target[i * 4 + 2] = source[i * 3 + 2];
+        target[i * 4 + 3] = 1.f;
+      }
+
+      break;
+    }
+
+    default:
+    {
+      std::memcpy(target, source, count * 4 * sizeof(float));
+      break;
+    }
+  }
+}
+
+float luminance(const float* rgba)
+{
+  return rgba[0] * 0.2126f + rgba[1] * 0.7152f + rgba[2] * 0.0722f;
+}
+
+void collapseFromRGBA(float* target,
+                      const float* source,
+                      PixelFormat::Semantic targetSemantic,
+                      PixelFormat::Semantic sourceSemantic,
+                      size_t count)
+{
+  // Luminance sources have equal color channels, so skip the weighting
+  const bool gray = sourceSemantic == PixelFormat::L ||
+                    sourceSemantic == PixelFormat::LA ||
+                    sourceSemantic == PixelFormat::DEPTH;
+
+  switch (targetSemantic)
+  {
+    case PixelFormat::L:
+    case PixelFormat::DEPTH:
+    {
+      for (size_t i = 0;  i < count;  i++)
+        target[i] = gray ? source[i * 4] : luminance(source + i * 4);
+
+      break;
+    }
+
+    case PixelFormat::LA:
+    {
+      for (size_t i = 0;  i < count;  i++)
+      {
+        target[i * 2 + 0] = gray ? source[i * 4] : luminance(source + i * 4);
+        target[i * 2 + 1] = source[i * 4 + 3];
+      }
+
+      break;
+    }
+
+    case PixelFormat::RGB:
+    {
+      for (size_t i = 0;  i < count;  i++)
+      {
+        target[i * 3 + 0] = source[i * 4 + 0];
+        target[i * 3 + 1] = source[i * 4 + 1];
+        target[i * 3 + 2] = source[i * 4 + 2];
+      }
+
+      break;
+    }
+
+    default:
+    {
+      std::memcpy(target, source, count * 4 * sizeof(float));
+      break;
+    }
+  }
+}
+
+void applyFlags(float* pixels,
+                size_t count,
+                uint flags,
+                const PixelFormat& targetFormat,
+                const PixelFormat& sourceFormat)
+{
+  const SRGBTable& table = sRGBTable();
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    float* rgba = pixels + i * 4;
+
+    if (flags & PT_SRGB_TO_LINEAR)
+    {
+      for (uint c = 0;  c < 3;  c++)
+      {
+        // 8-bit values decode exactly to multiples of 1/255
+        if (sourceFormat.type() == PixelFormat::UINT8)
+          rgba[c] = table.linear[uint(rgba[c] * 255.f + 0.5f)];
+        else
+          rgba[c] = convertToLinear(rgba[c]);
+      }
+    }
+
+    if ((flags & PT_UNPREMULTIPLY_ALPHA) && rgba[3] > 0.f)
+    {
+      for (uint c = 0;  c < 3;  c++)
+        rgba[c] /= rgba[3];
+    }
+
+    if (flags & PT_PREMULTIPLY_ALPHA)
+    {
+      for (uint c = 0;  c < 3;  c++)
+        rgba[c] *= rgba[3];
+    }
+
+    if (flags & PT_LINEAR_TO_SRGB)
+    {
+      for (uint c = 0;  c < 3;  c++)
+      {
+        // Round to the nearest 8-bit value in sRGB space
+        if (targetFormat.type() == PixelFormat::UINT8)
+          rgba[c] = table.encode(rgba[c]) / 255.f;
+        else
+          rgba[c] = convertToSRGB(clamp(rgba[c], 0.f, 1.f));
+      }
+    }
+
+    if (flags & PT_SWAP_RED_BLUE)
+      std::swap(rgba[0], rgba[2]);
+  }
+}
+
+void convertRange(void* target,
+                  const PixelFormat& targetFormat,
+                  const void* source,
+                  const PixelFormat& sourceFormat,
+                  size_t count,
+                  uint flags)
+{
+  const uint targetChannels = targetFormat.channelCount();
+  const uint sourceChannels = sourceFormat.channelCount();
+  const bool direct = !flags && targetFormat.semantic() == sourceFormat.semantic();
+
+  float values[CONVERSION_CHUNK_SIZE * 4];
+  float rgba[CONVERSION_CHUNK_SIZE * 4];
+
+  for (size_t first = 0;  first < count;  first += CONVERSION_CHUNK_SIZE)
+  {
+    const size_t size = std::min(count - first, CONVERSION_CHUNK_SIZE);
+    const char* s = (const char*) source + first * sourceFormat.size();
+    char* t = (char*) target + first * targetFormat.size();
+
+    decodeChannels(values, s, sourceFormat.type(), size * sourceChannels);
+
+    if (!direct)
+    {
+      expandToRGBA(rgba, values, sourceFormat.semantic(), size);
+      applyFlags(rgba, size, flags, targetFormat, sourceFormat);
+      collapseFromRGBA(values, rgba,
+                       targetFormat.semantic(), sourceFormat.semantic(),
+                       size);
+    }
+
+    encodeChannels(t, values, targetFormat.type(), size * targetChannels);
+  }
+}
+
+void convertRGB8toRGBA8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    t[i * 4 + 0] = s[i * 3 + 0];
+    t[i * 4 + 1] = s[i * 3 + 1];
+    t[i * 4 + 2] = s[i * 3 + 2];
+    t[i * 4 + 3] = 255;
+  }
+}
+
+void convertRGB8toBGRA8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    t[i * 4 + 0] = s[i * 3 + 2];
+    t[i * 4 + 1] = s[i * 3 + 1];
+    t[i * 4 + 2] = s[i * 3 + 0];
+    t[i * 4 + 3] = 255;
+  }
+}
+
+void convertRGBA8toRGB8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    t[i * 3 + 0] = s[i * 4 + 0];
+    t[i * 3 + 1] = s[i * 4 + 1];
+    t[i * 3 + 2] = s[i * 4 + 2];
+  }
+}
+
+void convertL8toRGB8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+    t[i * 3 + 0] = t[i * 3 + 1] = t[i * 3 + 2] = s[i];
+}
+
+void convertL8toRGBA8(void* target, const void* source, size_t count)
+{
+  uint32* t = (uint32*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    const uint8 pixel[] = { s[i], s[i], s[i], 255 };
+    std::memcpy(t + i, pixel, sizeof(pixel));
+  }
+}
+
+void swapRGB8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    const uint8 r = s[i * 3], g = s[i * 3 + 1], b = s[i * 3 + 2];
+    t[i * 3 + 0] = b;
+    t[i * 3 + 1] = g;
+    t[i * 3 + 2] = r;
+  }
+}
+
+void swapRGBA8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+  size_t i = 0;
+
+#if WENDY_PIXEL_SSE2
+  const __m128i greenAlpha = _mm_set1_epi32(0xff00ff00);
+  const __m128i low = _mm_set1_epi32(0x000000ff);
+
+  for (;  i + 4 <= count;  i += 4)
+  {
+    const __m128i p = _mm_loadu_si128((const __m128i*) (s + i * 4));
+    const __m128i red = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+    const __m128i blue = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+    const __m128i result = _mm_or_si128(_mm_and_si128(p, greenAlpha),
+                                        _mm_or_si128(red, blue));
+    _mm_storeu_si128((__m128i*) (t + i * 4), result);
+  }
+#endif
+
+  for (;  i < count;  i++)
+  {
+    const uint8 r = s[i * 4], b = s[i * 4 + 2];
+    t[i * 4 + 0] = b;
+    t[i * 4 + 1] = s[i * 4 + 1];
+    t[i * 4 + 2] = r;
+    t[i * 4 + 3] = s[i * 4 + 3];
+  }
+}
+
+void premultiplyRGBA8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    const uint a = s[i * 4 + 3];
+
+    // Exact rounding of c * a / 255
+    for (uint c = 0;  c < 3;  c++)
+    {
+      const uint v = s[i * 4 + c] * a + 128;
+      t[i * 4 + c] = uint8((v + (v >> 8)) >> 8);
+    }
+
+    t[i * 4 + 3] = uint8(a);
+  }
+}
+
+template <uint N>
+void unpackUnorm8Kernel(void* target, const void* source, size_t count)
+{
+  unpackUnorm8((float*) target, (const uint8*) source, count * N);
+}
+
+template <uint N>
+void packUnorm8Kernel(void* target, const void* source, size_t count)
+{
+  packUnorm8((uint8*) target, (const float*) source, count * N);
+}
+
+template <uint N>
+void convertHalfToFloat(void* target, const void* source, size_t count)
+{
+  decodeChannels((float*) target, source, PixelFormat::FLOAT16, count * N);
+}
+
+template <uint N>
+void convertFloatToHalf(void* target, const void* source, size_t count)
+{
+  encodeChannels(target, (const float*) source, PixelFormat::FLOAT16, count * N);
+}
+
+template <uint N>
+void convertUnorm16toUnorm8(void* target, const void* source, size_t count)
+{
+  uint8* t = (uint8*) target;
+  const uint16* s = (const uint16*) source;
+
+  // Exact rounding of v * 255 / 65535
+  for (size_t i = 0;  i < count * N;  i++)
+    t[i] = uint8((s[i] * 255u + 32895u) >> 16);
+}
+
+template <uint N>
+void convertUnorm8toUnorm16(void* target, const void* source, size_t count)
+{
+  uint16* t = (uint16*) target;
+  const uint8* s = (const uint8*) source;
+
+  for (size_t i = 0;  i < count * N;  i++)
+    t[i] = uint16(s[i] * 257u);
+}
+
+#define WENDY_PIXEL_KERNELS(semantic, N) \
+  { PixelFormat::semantic, PixelFormat::FLOAT32, PixelFormat::semantic, PixelFormat::UINT8, PT_NONE, unpackUnorm8Kernel<N> }, \
+  { PixelFormat::semantic, PixelFormat::UINT8, PixelFormat::semantic, PixelFormat::FLOAT32, PT_NONE, packUnorm8Kernel<N> }, \
+  { PixelFormat::semantic, PixelFormat::FLOAT32, PixelFormat::semantic, PixelFormat::FLOAT16, PT_NONE, convertHalfToFloat<N> }, \
+  { PixelFormat::semantic, PixelFormat::FLOAT16, PixelFormat::semantic, PixelFormat::FLOAT32, PT_NONE, convertFloatToHalf<N> }, \
+  { PixelFormat::semantic, PixelFormat::UINT8, PixelFormat::semantic, PixelFormat::UINT16, PT_NONE, convertUnorm16toUnorm8<N> }, \
+  { PixelFormat::semantic, PixelFormat::UINT16, PixelFormat::semantic, PixelFormat::UINT8, PT_NONE, convertUnorm8toUnorm16<N> }
+
+const PixelKernelEntry PIXEL_KERNELS[] =
+{
+  { PixelFormat::RGBA, PixelFormat::UINT8, PixelFormat::RGB, PixelFormat::UINT8, PT_NONE, convertRGB8toRGBA8 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, PixelFormat::RGB, PixelFormat::UINT8, PT_SWAP_RED_BLUE, convertRGB8toBGRA8 },
+  { PixelFormat::RGB, PixelFormat::UINT8, PixelFormat::RGBA, PixelFormat::UINT8, PT_NONE, convertRGBA8toRGB8 },
+  { PixelFormat::RGB, PixelFormat::UINT8, PixelFormat::L, PixelFormat::UINT8, PT_NONE, convertL8toRGB8 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, PixelFormat::L, PixelFormat::UINT8, PT_NONE, convertL8toRGBA8 },
+  { PixelFormat::RGB, PixelFormat::UINT8, PixelFormat::RGB, PixelFormat::UINT8, PT_SWAP_RED_BLUE, swapRGB8 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, PixelFormat::RGBA, PixelFormat::UINT8, PT_SWAP_RED_BLUE, swapRGBA8 },
+  { PixelFormat::RGBA, PixelFormat::UINT8, PixelFormat::RGBA, PixelFormat::UINT8, PT_PREMULTIPLY_ALPHA, premultiplyRGBA8 },
+  WENDY_PIXEL_KERNELS(L, 1),
+  WENDY_PIXEL_KERNELS(LA, 2),
+  WENDY_PIXEL_KERNELS(RGB, 3),
+  WENDY_PIXEL_KERNELS(RGBA, 4)
+};
+
+#undef WENDY_PIXEL_KERNELS
+
+PixelKernel findKernel(const PixelFormat& targetFormat,
+                       const PixelFormat& sourceFormat,
+                       uint flags)
+{
+  for (const PixelKernelEntry& entry : PIXEL_KERNELS)
+  {
+    if (entry.targetSemantic == targetFormat.semantic() &&
+        entry.targetType == targetFormat.type() &&
+        entry.sourceSemantic == sourceFormat.semantic() &&
+        entry.sourceType == sourceFormat.type() &&
+        entry.flags == flags)
+    {
+      return entry.kernel;
+    }
+  }
+
+  return nullptr;
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
 PixelFormat::PixelFormat(Semantic semantic, Type type):
   m_semantic(semantic),
   m_type(type)
@@ -71,6 +830,10 @@ PixelFormat::PixelFormat(const char* specification):
   else
     throw Exception("Invalid pixel format semantic name");
 
+  // Block-compressed types are separated from the semantic name
+  if (*c == '_')
+    c++;
+
   String typeName;
 
   while (std::isdigit(*c) || std::isalpha(*c))
@@ -88,8 +851,19 @@ PixelFormat::PixelFormat(const char* specification):
     m_type = FLOAT16;
   else if (typeName == "32f")
     m_type = FLOAT32;
+  else if (typeName == "bc1")
+    m_type = BC1;
+  else if (typeName == "bc3")
+    m_type = BC3;
+  else if (typeName == "bc4")
+    m_type = BC4;
+  else if (typeName == "bc5")
+    m_type = BC5;
   else
     throw Exception("Invalid pixel format type name");
+
+  if (!isValid())
+    throw Exception("Invalid pixel format semantic for type");
 }
 
 bool PixelFormat::operator == (const PixelFormat& other) const
@@ -102,11 +876,57 @@ bool PixelFormat::operator != (const PixelFormat& other) const
   return m_semantic != other.m_semantic || m_type != other.m_type;
 }
 
+bool PixelFormat::isValid() const
+{
+  switch (m_type)
+  {
+    case DUMMY:
+      return false;
+    case BC1:
+      return m_semantic == RGB || m_semantic == RGBA;
+    case BC3:
+      return m_semantic == RGBA;
+    case BC4:
+      return m_semantic == L;
+    case BC5:
+      return m_semantic == LA;
+    default:
+      return m_semantic != NONE;
+  }
+}
+
+size_t PixelFormat::blockSize() const
+{
+  switch (m_type)
+  {
+    case BC1:
+    case BC4:
+      return 8;
+    case BC3:
+    case BC5:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t PixelFormat::imageSize(uint width, uint height, uint depth) const
+{
+  if (isCompressed())
+    return ((width + 3) / 4) * ((height + 3) / 4) * depth * blockSize();
+
+  return width * height * depth * size();
+}
+
 size_t PixelFormat::channelSize() const
 {
   switch (m_type)
   {
     case DUMMY:
+    case BC1:
+    case BC3:
+    case BC4:
+    case BC5:
       return 0;
     case UINT8:
       return 1;
@@ -188,6 +1008,18 @@ String PixelFormat::asString() const
     case FLOAT32:
       result << "32f";
       break;
+    case BC1:
+      result << "_bc1";
+      break;
+    case BC3:
+      result << "_bc3";
+      break;
+    case BC4:
+      result << "_bc4";
+      break;
+    case BC5:
+      result << "_bc5";
+      break;
     default:
       panic("Invalid pixel format type %i", m_type);
   }
@@ -221,46 +1053,102 @@ const PixelFormat PixelFormat::DEPTH32(PixelFormat::DEPTH, PixelFormat::UINT32);
 const PixelFormat PixelFormat::DEPTH16F(PixelFormat::DEPTH, PixelFormat::FLOAT16);
 const PixelFormat PixelFormat::DEPTH32F(PixelFormat::DEPTH, PixelFormat::FLOAT32);
 
+const PixelFormat PixelFormat::RGB_BC1(PixelFormat::RGB, PixelFormat::BC1);
+const PixelFormat PixelFormat::RGBA_BC1(PixelFormat::RGBA, PixelFormat::BC1);
+const PixelFormat PixelFormat::RGBA_BC3(PixelFormat::RGBA, PixelFormat::BC3);
+const PixelFormat PixelFormat::L_BC4(PixelFormat::L, PixelFormat::BC4);
+const PixelFormat PixelFormat::LA_BC5(PixelFormat::LA, PixelFormat::BC5);
+
 ///////////////////////////////////////////////////////////////////////
 
 PixelTransform::~PixelTransform()
 {
 }
 
+bool PixelTransform::supportsInPlace(const PixelFormat& targetFormat,
+                                     const PixelFormat& sourceFormat)
+{
+  return false;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
-bool RGBtoRGBA::supports(const PixelFormat& targetFormat,
-                         const PixelFormat& sourceFormat)
+PixelConverter::PixelConverter(uint flags, ThreadPool* pool):
+  m_flags(flags),
+  m_pool(pool)
 {
-  if (targetFormat.type() != sourceFormat.type())
+}
+
+bool PixelConverter::supports(const PixelFormat& targetFormat,
+                              const PixelFormat& sourceFormat)
+{
+  if (!targetFormat.isValid() || !sourceFormat.isValid())
     return false;
 
-  if (targetFormat.semantic() != PixelFormat::RGBA ||
-      sourceFormat.semantic() != PixelFormat::RGB)
-  {
+  if (targetFormat.isCompressed() || sourceFormat.isCompressed())
     return false;
+
+  if (targetFormat.semantic() == PixelFormat::DEPTH)
+  {
+    return sourceFormat.semantic() == PixelFormat::DEPTH ||
+           sourceFormat.semantic() == PixelFormat::L;
   }
 
+  if (sourceFormat.semantic() == PixelFormat::DEPTH)
+    return targetFormat.semantic() == PixelFormat::L;
+
   return true;
 }
 
-void RGBtoRGBA::convert(void* target,
-                        const PixelFormat& targetFormat,
-                        const void* source,
-                        const PixelFormat& sourceFormat,
-                        size_t count)
+bool PixelConverter::supportsInPlace(const PixelFormat& targetFormat,
+                                     const PixelFormat& sourceFormat)
 {
-  size_t channelSize = targetFormat.channelSize();
-  size_t targetSize = targetFormat.size();
-  size_t sourceSize = sourceFormat.size();
+  return supports(targetFormat, sourceFormat) &&
+         targetFormat.size() == sourceFormat.size();
+}
 
-  while (count--)
+void PixelConverter::convert(void* target,
+                             const PixelFormat& targetFormat,
+                             const void* source,
+                             const PixelFormat& sourceFormat,
+                             size_t count)
+{
+  const PixelKernel kernel = findKernel(targetFormat, sourceFormat, m_flags);
+  const size_t targetSize = targetFormat.size();
+  const size_t sourceSize = sourceFormat.size();
+
+  const ThreadPool::RangeTask task = [&](size_t first, size_t last)
   {
-    std::memcpy(target, source, sourceSize);
-    std::memset((char*) target + sourceSize, 0, channelSize);
-    target = (char*) target + targetSize;
-    source = (char*) source + sourceSize;
+    char* t = (char*) target + first * targetSize;
+    const char* s = (const char*) source + first * sourceSize;
+
+    if (kernel)
+      kernel(t, s, last - first);
+    else
+      convertRange(t, targetFormat, s, sourceFormat, last - first, m_flags);
+  };
+
+  if (m_pool && count >= PARALLEL_CONVERSION_COUNT)
+    m_pool->parallelFor(count, task, CONVERSION_GRANULARITY);
+  else
+    task(0, count);
+}
+
+///////////////////////////////////////////////////////////////////////
+
+bool RGBtoRGBA::supports(const PixelFormat& targetFormat,
+                         const PixelFormat& sourceFormat)
+{
+  if (targetFormat.type() != sourceFormat.type())
+    return false;
+
+  if (targetFormat.semantic() != PixelFormat::RGBA ||
+      sourceFormat.semantic() != PixelFormat::RGB)
+  {
+    return false;
   }
+
+  return PixelConverter::supports(targetFormat, sourceFormat);
 }
 
 ///////////////////////////////////////////////////////////////////////
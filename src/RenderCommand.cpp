@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy default renderer
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+
+#include <wendy/Core.hpp>
+#include <wendy/Timer.hpp>
+#include <wendy/Profile.hpp>
+
+#include <wendy/RenderPool.hpp>
+#include <wendy/RenderState.hpp>
+#include <wendy/RenderCommand.hpp>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+  namespace render
+  {
+
+///////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+Command createCommand(CommandType type, size_t index)
+{
+  Command command;
+  command.type = type;
+  command.index = uint32(index);
+  command.transform = 0;
+  command.count = 1;
+  return command;
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+CommandTarget::~CommandTarget()
+{
+}
+
+///////////////////////////////////////////////////////////////////////
+
+void CommandBuffer::clearColor(const vec4& color)
+{
+  m_commands.push_back(createCommand(COMMAND_CLEAR_COLOR, m_colors.size()));
+  m_colors.push_back(color);
+}
+
+void CommandBuffer::clearDepth(float depth)
+{
+  m_commands.push_back(createCommand(COMMAND_CLEAR_DEPTH, m_depths.size()));
+  m_depths.push_back(depth);
+}
+
+void CommandBuffer::setPass(const Pass& pass)
+{
+  m_commands.push_back(createCommand(COMMAND_SET_PASS, m_passes.size()));
+  m_passes.push_back(&pass);
+}
+
+void CommandBuffer::setModelMatrix(const mat4& matrix)
+{
+  m_commands.push_back(createCommand(COMMAND_SET_MODEL_MATRIX, m_transforms.size()));
+  m_transforms.push_back(matrix);
+}
+
+void CommandBuffer::draw(const GL::PrimitiveRange& range)
+{
+  m_commands.push_back(createCommand(COMMAND_DRAW, m_ranges.size()));
+  m_ranges.push_back(range);
+}
+
+void CommandBuffer::drawInstanced(const GL::PrimitiveRange& range,
+                                  const mat4* transforms,
+                                  uint count)
+{
+  Command command = createCommand(COMMAND_DRAW_INSTANCED, m_ranges.size());
+  command.transform = uint32(m_transforms.size());
+  command.count = count;
+  m_commands.push_back(command);
+
+  m_ranges.push_back(range);
+  m_transforms.insert(m_transforms.end(), transforms, transforms + count);
+}
+
+void CommandBuffer::drawMulti(const GL::PrimitiveRange* ranges,
+                              const mat4* transforms,
+                              uint count)
+{
+  Command command = createCommand(COMMAND_DRAW_MULTI, m_ranges.size());
+  command.transform = uint32(m_transforms.size());
+  command.count = count;
+  m_commands.push_back(command);
+
+  m_ranges.insert(m_ranges.end(), ranges, ranges + count);
+  m_transforms.insert(m_transforms.end(), transforms, transforms + count);
+}
+
+void CommandBuffer::execute(CommandTarget& target) const
+{
+  ProfileNodeCall call("render::CommandBuffer::execute");
+
+  for (const Command& command : m_commands)
+  {
+    switch (command.type)
+    {
+      case COMMAND_CLEAR_COLOR:
+        target.clearColor(m_colors[command.index]);
+        break;
+      case COMMAND_CLEAR_DEPTH:
+        target.clearDepth(m_depths[command.index]);
+        break;
+      case COMMAND_SET_PASS:
+        target.setPass(*m_passes[command.index]);
+        break;
+      case COMMAND_SET_MODEL_MATRIX:
+        target.setModelMatrix(m_transforms[command.index]);
+        break;
+      case COMMAND_DRAW:
+        target.draw(m_ranges[command.index]);
+        break;
+      case COMMAND_DRAW_INSTANCED:
+        target.drawInstanced(m_ranges[command.index],
+                             &m_transforms[command.transform],
+                             command.count);
+        break;
+      case COMMAND_DRAW_MULTI:
+        target.drawMulti(&m_ranges[command.index],
+                         &m_transforms[command.transform],
+                         command.count);
+        break;
+      default:
+        panic("Invalid render command type %u", command.type);
+    }
+  }
+}
+
+void CommandBuffer::removeCommands()
+{
+  m_commands.clear();
+  m_passes.clear();
+  m_ranges.clear();
+  m_transforms.clear();
+  m_colors.clear();
+  m_depths.clear();
+}
+
+///////////////////////////////////////////////////////////////////////
+
+ContextTarget::ContextTarget(VertexPool& pool, SharedProgramState& state):
+  m_pool(pool),
+  m_state(state),
+  m_pass(nullptr),
+  m_dirtyPass(false)
+{
+}
+
+void ContextTarget::clearColor(const vec4& color)
+{
+  m_pool.context().clearColorBuffer(color);
+}
+
+void ContextTarget::clearDepth(float depth)
+{
+  m_pool.context().clearDepthBuffer(depth);
+}
+
+void ContextTarget::setPass(const Pass& pass)
+{
+  m_pass = &pass;
+  m_dirtyPass = true;
+}
+
+void ContextTarget::setModelMatrix(const mat4& matrix)
+{
+  m_state.setModelMatrix(matrix);
+  m_dirtyPass = true;
+}
+
+void ContextTarget::draw(const GL::PrimitiveRange& range)
+{
+  if (!applyPass())
+    return;
+
+  m_pool.context().render(range);
+}
+
+void ContextTarget::drawInstanced(const GL::PrimitiveRange& range,
+                                  const mat4* transforms,
+                                  uint count)
+{
+  GL::VertexRange instances;
+
+  InstanceTransform* data = (InstanceTransform*)
+    m_pool.map(instances, count, InstanceTransform::format);
+  if (!data)
+  {
+    logError("Failed to allocate instance transforms");
+    return;
+  }
+
+  for (uint i = 0;  i < count;  i++)
+    data[i].transform = transforms[i];
+
+  m_pool.flush(instances);
+
+  if (!applyPass())
+    return;
+
+  m_pool.context().render(range, instances);
+}
+
+void ContextTarget::drawMulti(const GL::PrimitiveRange* ranges,
+                              const mat4* transforms,
+                              uint count)
+{
+  GL::VertexRange instances;
+
+  InstanceTransform* data = (InstanceTransform*)
+    m_pool.map(instances, count, InstanceTransform::format);
+  if (!data)
+  {
+    logError("Failed to allocate instance transforms");
+    return;
+  }
+
+  for (uint i = 0;  i < count;  i++)
+    data[i].transform = transforms[i];
+
+  m_pool.flush(instances);
+
+  if (!applyPass())
+    return;
+
+  m_pool.context().render(ranges, count, instances);
+}
+
+bool ContextTarget::applyPass()
+{
+  if (!m_pass)
+  {
+    logError("Cannot draw without a render pass");
+    return false;
+  }
+
+  if (m_dirtyPass)
+  {
+    m_pass->apply();
+    m_dirtyPass = false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+NullTarget::NullTarget()
+{
+  reset();
+}
+
+void NullTarget::clearColor(const vec4&)
+{
+  m_clearCount++;
+}
+
+void NullTarget::clearDepth(float)
+{
+  m_clearCount++;
+}
+
+void NullTarget::setPass(const Pass&)
+{
+  m_passCount++;
+}
+
+void NullTarget::setModelMatrix(const mat4&)
+{
+  m_transformCount++;
+}
+
+void NullTarget::draw(const GL::PrimitiveRange& range)
+{
+  m_drawCount++;
+  m_instanceCount++;
+  m_vertexCount += uint(range.count());
+}
+
+void NullTarget::drawInstanced(const GL::PrimitiveRange& range,
+                               const mat4*,
+                               uint count)
+{
+  m_drawCount++;
+  m_instanceCount += count;
+  m_vertexCount += uint(range.count()) * count;
+}
+
+void NullTarget::drawMulti(const GL::PrimitiveRange* ranges,
+                           const mat4*,
+                           uint count)
+{
+  m_drawCount++;
+  m_instanceCount += count;
+
+  for (uint i = 0;  i < count;  i++)
+    m_vertexCount += uint(ranges[i].count());
+}
+
+void NullTarget::reset()
+{
+  m_clearCount = 0;
+  m_passCount = 0;
+  m_transformCount = 0;
+  m_drawCount = 0;
+  m_instanceCount = 0;
+  m_vertexCount = 0;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+  } /*namespace render*/
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
@@ -38,6 +38,7 @@
 #include <wendy/RenderMaterial.hpp>
 
 #include <algorithm>
+#include <cstring>
 
 #include <pugixml.hpp>
 
@@ -356,6 +357,11 @@ bool parsePass(System& system, Pass& pass, pugi::xml_node root)
         if (s.attribute("sRGB").as_bool())
           params.flags |= GL::TF_SRGB;
 
+        if (std::strcmp(s.attribute("mipmapFilter").value(), "kaiser") == 0)
+          params.mipmapFilter = MIPMAP_KAISER;
+
+        params.alphaReference = s.attribute("alphaReference").as_float();
+
         texture = GL::Texture::read(context, params, a.value());
       }
       else if (pugi::xml_attribute a = s.attribute("texture"))
@@ -43,8 +43,18 @@
 #include <wendy/RenderScene.hpp>
 #include <wendy/RenderModel.hpp>
 
+#include <internal/MappedFile.hpp>
+
+#include <glm/gtc/type_ptr.hpp>
+
 #include <pugixml.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -59,6 +69,276 @@ namespace
 
 const uint MODEL_XML_VERSION = 3;
 
+const char MODEL_BINARY_SUFFIX[] = "wmdl";
+const char MODEL_BINARY_MAGIC[4] = { 'W', 'M', 'D', 'L' };
+const uint32 MODEL_BINARY_VERSION = 2;
+const uint32 MODEL_BINARY_NO_STRING = 0xffffffff;
+
+const float LEVEL_HYSTERESIS = 0.1f;
+
+/* Binary model layout, in native byte order:
+ *
+ * - header
+ * - levels
+ * - sections
+ * - string table, padded to a multiple of four bytes
+ * - vertices, in the format named by the header
+ * - indices, relative to the first vertex
+ */
+class BinaryModelHeader
+{
+public:
+  char magic[4];
+  uint32 version;
+  uint32 vertexFormat;
+  uint32 vertexSize;
+  uint32 vertexCount;
+  uint32 indexCount;
+  uint32 indexSize;
+  uint32 levelCount;
+  uint32 sectionCount;
+  uint32 stringsSize;
+  uint32 occluderName;
+  float aabbCenter[3];
+  float aabbSize[3];
+  float sphereCenter[3];
+  float sphereRadius;
+};
+
+class BinaryModelLevel
+{
+public:
+  float screenSize;
+  uint32 firstSection;
+  uint32 sectionCount;
+};
+
+class BinaryModelSection
+{
+public:
+  uint32 start;
+  uint32 count;
+  uint32 materialName;
+};
+
+/* GPU-ready arrays for a mesh and its levels of detail.  The material name
+ * field of each section is an index into materialNames.
+ */
+class ModelLayout
+{
+public:
+  bool build(const String& name,
+             const Mesh& data,
+             const Model::LevelDataList& levels,
+             uint vertexFlags);
+  VertexFormat format;
+  uint32 vertexCount;
+  std::vector<uint8> vertices;
+  std::vector<uint8> indices;
+  uint32 indexCount;
+  GL::IndexBufferType indexType;
+  std::vector<BinaryModelLevel> levels;
+  std::vector<BinaryModelSection> sections;
+  std::vector<String> materialNames;
+};
+
+bool createVertexFormat(VertexFormat& format, const String& name, uint flags)
+{
+  if ((flags & MV_PACKED_NORMALS) && (flags & MV_OCTAHEDRAL_NORMALS))
+  {
+    logError("Model %s cannot have both packed and octahedral normals",
+             name.c_str());
+    return false;
+  }
+
+  format = VertexFormat();
+
+  if (flags & MV_HALF_POSITIONS)
+    format.createComponent("vPosition", 4, VERTEX_HALF);
+  else
+    format.createComponent("vPosition", 3);
+
+  if (flags & MV_PACKED_NORMALS)
+    format.createComponent("vNormal", 4, VERTEX_PACKED);
+  else if (flags & MV_OCTAHEDRAL_NORMALS)
+    format.createComponent("vNormal", 2, VERTEX_OCTAHEDRAL);
+  else
+    format.createComponent("vNormal", 3);
+
+  if (flags & MV_HALF_TEXCOORDS)
+    format.createComponent("vTexCoord", 2, VERTEX_HALF);
+  else
+    format.createComponent("vTexCoord", 2);
+
+  return true;
+}
+
+void storeVertices(uint8* target,
+                   const VertexFormat& format,
+                   const std::vector<MeshVertex>& vertices)
+{
+  const VertexComponent& position = format.components()[0];
+  const VertexComponent& normal = format.components()[1];
+  const VertexComponent& texcoord = format.components()[2];
+
+  for (auto& v : vertices)
+  {
+    // The fourth element is only stored for padded components
+    const vec4 p(v.position, 1.f);
+    const vec4 n(v.normal, 0.f);
+
+    position.store(target + position.offset(), &p.x);
+    normal.store(target + normal.offset(), &n.x);
+    texcoord.store(target + texcoord.offset(), &v.texcoord.x);
+
+    target += format.size();
+  }
+}
+
+template <typename T>
+void copyIndices(T* target, const MeshSection& section, uint32 base)
+{
+  for (auto& t : section.triangles)
+  {
+    *target++ = T(base + t.indices[0]);
+    *target++ = T(base + t.indices[1]);
+    *target++ = T(base + t.indices[2]);
+  }
+}
+
+template <typename T>
+bool checkIndices(const void* data, uint32 count, uint32 vertexCount)
+{
+  const T* indices = static_cast<const T*>(data);
+
+  for (uint32 i = 0;  i < count;  i++)
+  {
+    if (indices[i] >= vertexCount)
+      return false;
+  }
+
+  return true;
+}
+
+bool ModelLayout::build(const String& name,
+                        const Mesh& data,
+                        const Model::LevelDataList& levelData,
+                        uint vertexFlags)
+{
+  if (!createVertexFormat(format, name, vertexFlags))
+    return false;
+
+  std::vector<const Mesh*> meshes;
+  meshes.push_back(&data);
+
+  levels.clear();
+  levels.push_back(BinaryModelLevel());
+  levels.back().screenSize = std::numeric_limits<float>::max();
+
+  for (auto& l : levelData)
+  {
+    if (l.screenSize >= levels.back().screenSize || l.screenSize <= 0.f)
+    {
+      logError("Levels of detail for model %s must have decreasing sizes",
+               name.c_str());
+      return false;
+    }
+
+    meshes.push_back(l.mesh);
+    levels.push_back(BinaryModelLevel());
+    levels.back().screenSize = l.screenSize;
+  }
+
+  size_t totalVertexCount = 0;
+  size_t totalIndexCount = 0;
+
+  for (auto m : meshes)
+  {
+    if (!m->isValid())
+    {
+      logError("Mesh %s for model %s is not valid",
+               m->name().c_str(),
+               name.c_str());
+      return false;
+    }
+
+    totalVertexCount += m->vertices.size();
+    totalIndexCount += m->triangleCount() * 3;
+  }
+
+  // Optimize copies of the meshes, as the originals may be shared resources
+  std::vector<Ref<Mesh>> optimized;
+
+  for (auto& m : meshes)
+  {
+    Ref<Mesh> copy = new Mesh(ResourceInfo(m->cache()));
+    copy->vertices = m->vertices;
+    copy->sections = m->sections;
+    copy->optimize();
+
+    optimized.push_back(copy);
+    m = copy;
+  }
+
+  // Indices are relative to the vertex range, so only its size matters here,
+  // and 8-bit indices are avoided as they would rarely share a block
+  size_t indexSize;
+  if (totalVertexCount <= (1 << 16))
+  {
+    indexType = GL::INDEX_UINT16;
+    indexSize = sizeof(uint16);
+  }
+  else
+  {
+    indexType = GL::INDEX_UINT32;
+    indexSize = sizeof(uint32);
+  }
+
+  vertexCount = uint32(totalVertexCount);
+  indexCount = uint32(totalIndexCount);
+
+  vertices.resize(totalVertexCount * format.size());
+  indices.resize(totalIndexCount * indexSize);
+  sections.clear();
+  materialNames.clear();
+
+  uint32 base = 0;
+  uint32 start = 0;
+
+  for (size_t i = 0;  i < meshes.size();  i++)
+  {
+    const Mesh& mesh = *meshes[i];
+
+    storeVertices(&vertices[base * format.size()], format, mesh.vertices);
+
+    levels[i].firstSection = uint32(sections.size());
+    levels[i].sectionCount = uint32(mesh.sections.size());
+
+    for (auto& s : mesh.sections)
+    {
+      const uint32 count = uint32(s.triangles.size() * 3);
+
+      BinaryModelSection section;
+      section.start = start;
+      section.count = count;
+      section.materialName = uint32(materialNames.size());
+      sections.push_back(section);
+      materialNames.push_back(s.materialName);
+
+      if (indexType == GL::INDEX_UINT16)
+        copyIndices((uint16*) &indices[start * indexSize], s, base);
+      else
+        copyIndices((uint32*) &indices[start * indexSize], s, base);
+
+      start += count;
+    }
+
+    base += uint32(mesh.vertices.size());
+  }
+
+  return true;
+}
+
 } /*namespace*/
 
 ///////////////////////////////////////////////////////////////////////
@@ -77,15 +357,44 @@ void ModelSection::setMaterial(Material* newMaterial)
 
 ///////////////////////////////////////////////////////////////////////
 
+ModelLevel::ModelLevel(float screenSize):
+  m_screenSize(screenSize)
+{
+}
+
+///////////////////////////////////////////////////////////////////////
+
+Model::LevelData::LevelData(const Mesh& initMesh, float initScreenSize):
+  mesh(&initMesh),
+  screenSize(initScreenSize)
+{
+}
+
+///////////////////////////////////////////////////////////////////////
+
 void Model::enqueue(Scene& scene, const Camera& camera, const Transform3& transform) const
 {
-  for (auto& s : m_sections)
+  uint level = 0;
+  enqueue(scene, camera, transform, level);
+}
+
+void Model::enqueue(Scene& scene,
+                    const Camera& camera,
+                    const Transform3& transform,
+                    uint& level) const
+{
+  level = selectLevel(camera, transform, level);
+
+  for (auto& s : m_levels[level].sections())
   {
     Material* material = s.material();
     if (!s.material())
       continue;
 
-    GL::PrimitiveRange range(GL::TRIANGLE_LIST, *m_vertexBuffer, s.indexRange());
+    GL::PrimitiveRange range(GL::TRIANGLE_LIST,
+                             *m_vertices.vertexBuffer(),
+                             s.indexRange(),
+                             m_vertices.start());
 
     float depth = camera.normalizedDepth(transform.position + m_boundingSphere.center);
 
@@ -98,13 +407,78 @@ Sphere Model::bounds() const
   return m_boundingSphere;
 }
 
+const Mesh* Model::occluder() const
+{
+  return m_occluder;
+}
+
+void Model::setOccluder(Mesh* newOccluder)
+{
+  m_occluder = newOccluder;
+}
+
+uint Model::selectLevel(const Camera& camera,
+                        const Transform3& transform,
+                        uint current) const
+{
+  const uint count = uint(m_levels.size());
+  if (count == 1)
+    return 0;
+
+  Sphere bounds = m_boundingSphere;
+  bounds.transformBy(transform);
+
+  float size;
+
+  if (camera.isPerspective())
+  {
+    const float distance = length(bounds.center - camera.transform().position);
+    if (distance <= bounds.radius)
+      return 0;
+
+    size = bounds.radius / (distance * tan(radians(camera.FOV()) / 2.f));
+  }
+  else
+    size = bounds.radius * 2.f / camera.orthoVolume().size.y;
+
+  uint level = std::min(current, count - 1);
+
+  while (level + 1 < count &&
+         size < m_levels[level + 1].screenSize() * (1.f - LEVEL_HYSTERESIS))
+  {
+    level++;
+  }
+
+  while (level > 0 &&
+         size > m_levels[level].screenSize() * (1.f + LEVEL_HYSTERESIS))
+  {
+    level--;
+  }
+
+  return level;
+}
+
 Ref<Model> Model::create(const ResourceInfo& info,
                          System& system,
                          const Mesh& data,
-                         const MaterialMap& materials)
+                         const MaterialMap& materials,
+                         const LevelDataList& levels,
+                         uint vertexFlags)
+{
+  Ref<Model> model(new Model(info));
+  if (!model->init(system, data, materials, levels, vertexFlags))
+    return nullptr;
+
+  return model;
+}
+
+Ref<Model> Model::create(const ResourceInfo& info,
+                         System& system,
+                         const void* data,
+                         size_t size)
 {
   Ref<Model> model(new Model(info));
-  if (!model->init(system, data, materials))
+  if (!model->init(system, data, size))
     return nullptr;
 
   return model;
@@ -115,119 +489,272 @@ Model::Model(const ResourceInfo& info):
 {
 }
 
-bool Model::init(System& system, const Mesh& data, const MaterialMap& materials)
+Model::~Model()
 {
-  if (!data.isValid())
-  {
-    logError("Mesh %s for model %s is not valid",
-             data.name().c_str(),
-             name().c_str());
+  if (m_geometryPool && m_vertices.vertexBuffer())
+    m_geometryPool->release(m_vertices);
+}
+
+bool Model::init(System& system,
+                 const Mesh& data,
+                 const MaterialMap& materials,
+                 const LevelDataList& levels,
+                 uint vertexFlags)
+{
+  ModelLayout layout;
+  if (!layout.build(name(), data, levels, vertexFlags))
     return false;
-  }
 
-  for (auto& s : data.sections)
+  for (auto& materialName : layout.materialNames)
   {
-    if (materials.find(s.materialName) == materials.end())
+    if (materials.find(materialName) == materials.end())
     {
       logError("Missing material %s for model %s",
-               s.materialName.c_str(),
+               materialName.c_str(),
                name().c_str());
       return false;
     }
   }
 
-  GL::Context& context = system.context();
+  GL::IndexRange indices;
 
-  VertexFormat format;
-  if (!format.createComponents("3f:vPosition 3f:vNormal 2f:vTexCoord"))
+  if (!initGeometry(system,
+                    layout.format,
+                    &layout.vertices[0],
+                    layout.vertexCount,
+                    &layout.indices[0],
+                    layout.indexCount,
+                    layout.indexType,
+                    indices))
+  {
     return false;
+  }
+
+  for (auto& l : layout.levels)
+  {
+    m_levels.push_back(ModelLevel(l.screenSize));
+
+    for (uint32 i = 0;  i < l.sectionCount;  i++)
+    {
+      const BinaryModelSection& s = layout.sections[l.firstSection + i];
+      GL::IndexRange range(*indices.indexBuffer(), indices.start() + s.start, s.count);
+      Material* material = materials.find(layout.materialNames[s.materialName])->second;
+
+      m_levels.back().sections().push_back(ModelSection(range, material));
+    }
+  }
+
+  m_boundingAABB = data.generateBoundingAABB();
+  m_boundingSphere = data.generateBoundingSphere();
+  return true;
+}
 
-  m_vertexBuffer = GL::VertexBuffer::create(context,
-                                            data.vertices.size(),
-                                            format,
-                                            GL::USAGE_STATIC);
-  if (!m_vertexBuffer)
+bool Model::init(System& system, const void* data, size_t size)
+{
+  BinaryModelHeader header;
+  if (size < sizeof(header))
+  {
+    logError("Binary model %s is truncated", name().c_str());
     return false;
+  }
 
-  m_vertexBuffer->copyFrom(&data.vertices[0], data.vertices.size());
+  std::memcpy(&header, data, sizeof(header));
 
-  const size_t indexCount = data.triangleCount() * 3;
+  if (std::memcmp(header.magic, MODEL_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != MODEL_BINARY_VERSION)
+  {
+    logError("Model file format mismatch in %s", name().c_str());
+    return false;
+  }
 
   GL::IndexBufferType indexType;
-  if (indexCount <= (1 << 8))
-    indexType = GL::INDEX_UINT8;
-  else if (indexCount <= (1 << 16))
+  if (header.indexSize == sizeof(uint16))
     indexType = GL::INDEX_UINT16;
-  else
+  else if (header.indexSize == sizeof(uint32))
     indexType = GL::INDEX_UINT32;
+  else
+  {
+    logError("Invalid index size in binary model %s", name().c_str());
+    return false;
+  }
 
-  m_indexBuffer = GL::IndexBuffer::create(context,
-                                          indexCount,
-                                          indexType,
-                                          GL::USAGE_STATIC);
-  if (!m_indexBuffer)
+  const size_t levelsOffset = sizeof(BinaryModelHeader);
+  const size_t sectionsOffset = levelsOffset + header.levelCount * sizeof(BinaryModelLevel);
+  const size_t stringsOffset = sectionsOffset + header.sectionCount * sizeof(BinaryModelSection);
+  const size_t verticesOffset = stringsOffset + header.stringsSize;
+  const size_t indicesOffset = verticesOffset + size_t(header.vertexCount) * header.vertexSize;
+
+  if (header.levelCount == 0 ||
+      header.stringsSize % 4 != 0 ||
+      indicesOffset + size_t(header.indexCount) * header.indexSize > size)
+  {
+    logError("Binary model %s is truncated", name().c_str());
     return false;
+  }
+
+  const char* base = static_cast<const char*>(data);
+  const BinaryModelLevel* levels = (const BinaryModelLevel*) (base + levelsOffset);
+  const BinaryModelSection* sections = (const BinaryModelSection*) (base + sectionsOffset);
+  const char* strings = base + stringsOffset;
+
+  auto findString = [&](uint32 offset) -> const char*
+  {
+    if (offset >= header.stringsSize)
+      return nullptr;
+
+    if (!std::memchr(strings + offset, '\0', header.stringsSize - offset))
+      return nullptr;
 
-  size_t start = 0;
+    return strings + offset;
+  };
 
-  for (auto& s : data.sections)
+  const char* formatSpec = findString(header.vertexFormat);
+  if (!formatSpec)
   {
-    const size_t count = s.triangles.size() * 3;
-    GL::IndexRange range(*m_indexBuffer, start, count);
+    logError("Invalid vertex format in binary model %s", name().c_str());
+    return false;
+  }
 
-    m_sections.push_back(ModelSection(range, materials.find(s.materialName)->second));
+  VertexFormat format;
+  if (!format.createComponents(formatSpec) || format.size() != header.vertexSize)
+  {
+    logError("Invalid vertex format %s in binary model %s",
+             formatSpec,
+             name().c_str());
+    return false;
+  }
 
-    if (indexType == GL::INDEX_UINT8)
+  for (uint32 i = 0;  i < header.levelCount;  i++)
+  {
+    const BinaryModelLevel& l = levels[i];
+    if (l.firstSection > header.sectionCount ||
+        l.sectionCount > header.sectionCount - l.firstSection)
     {
-      std::vector<uint8> indices(range.count());
+      logError("Invalid level of detail in binary model %s", name().c_str());
+      return false;
+    }
+  }
 
-      size_t index = 0;
+  // Indices past the vertices of this model would read those of other models
+  // sharing the geometry pool
+  bool validIndices;
+  if (indexType == GL::INDEX_UINT16)
+    validIndices = checkIndices<uint16>(base + indicesOffset, header.indexCount, header.vertexCount);
+  else
+    validIndices = checkIndices<uint32>(base + indicesOffset, header.indexCount, header.vertexCount);
 
-      for (auto& t : s.triangles)
-      {
-        indices[index++] = t.indices[0];
-        indices[index++] = t.indices[1];
-        indices[index++] = t.indices[2];
-      }
+  if (!validIndices)
+  {
+    logError("Index out of range in binary model %s", name().c_str());
+    return false;
+  }
+
+  std::vector<Ref<Material>> materials;
+
+  for (uint32 i = 0;  i < header.sectionCount;  i++)
+  {
+    const BinaryModelSection& s = sections[i];
+    if (s.start > header.indexCount || s.count > header.indexCount - s.start)
+    {
+      logError("Invalid section in binary model %s", name().c_str());
+      return false;
+    }
 
-      range.copyFrom(&indices[0]);
+    const char* materialName = findString(s.materialName);
+    if (!materialName)
+    {
+      logError("Invalid material name in binary model %s", name().c_str());
+      return false;
     }
-    else if (indexType == GL::INDEX_UINT16)
+
+    Ref<Material> material = Material::read(system, materialName);
+    if (!material)
     {
-      std::vector<uint16> indices(range.count());
+      logError("Failed to load material %s for model %s",
+               materialName,
+               name().c_str());
+      return false;
+    }
 
-      size_t index = 0;
+    materials.push_back(material);
+  }
 
-      for (auto& t : s.triangles)
-      {
-        indices[index++] = t.indices[0];
-        indices[index++] = t.indices[1];
-        indices[index++] = t.indices[2];
-      }
+  GL::IndexRange indices;
 
-      range.copyFrom(&indices[0]);
-    }
-    else
+  if (!initGeometry(system,
+                    format,
+                    base + verticesOffset,
+                    header.vertexCount,
+                    base + indicesOffset,
+                    header.indexCount,
+                    indexType,
+                    indices))
+  {
+    return false;
+  }
+
+  for (uint32 i = 0;  i < header.levelCount;  i++)
+  {
+    const BinaryModelLevel& l = levels[i];
+
+    m_levels.push_back(ModelLevel(l.screenSize));
+
+    for (uint32 j = l.firstSection;  j < l.firstSection + l.sectionCount;  j++)
     {
-      std::vector<uint32> indices(range.count());
+      GL::IndexRange range(*indices.indexBuffer(),
+                           indices.start() + sections[j].start,
+                           sections[j].count);
+
+      m_levels.back().sections().push_back(ModelSection(range, materials[j]));
+    }
+  }
 
-      size_t index = 0;
+  m_boundingAABB = AABB(make_vec3(header.aabbCenter), make_vec3(header.aabbSize));
+  m_boundingSphere = Sphere(make_vec3(header.sphereCenter), header.sphereRadius);
 
-      for (auto& t : s.triangles)
-      {
-        indices[index++] = t.indices[0];
-        indices[index++] = t.indices[1];
-        indices[index++] = t.indices[2];
-      }
+  if (header.occluderName != MODEL_BINARY_NO_STRING)
+  {
+    const char* occluderName = findString(header.occluderName);
+    if (!occluderName)
+    {
+      logError("Invalid occluder name in binary model %s", name().c_str());
+      return false;
+    }
 
-      range.copyFrom(&indices[0]);
+    m_occluder = Mesh::read(cache(), occluderName);
+    if (!m_occluder)
+    {
+      logError("Failed to load occluder mesh for model %s", name().c_str());
+      return false;
     }
+  }
+
+  return true;
+}
 
-    start += count;
+bool Model::initGeometry(System& system,
+                         const VertexFormat& format,
+                         const void* vertices,
+                         uint vertexCount,
+                         const void* indices,
+                         uint indexCount,
+                         GL::IndexBufferType indexType,
+                         GL::IndexRange& range)
+{
+  m_geometryPool = &system.geometryPool();
+  if (!m_geometryPool->allocate(m_vertices,
+                                range,
+                                vertexCount,
+                                format,
+                                indexCount,
+                                indexType))
+  {
+    logError("Failed to allocate geometry for model %s", name().c_str());
+    return false;
   }
 
-  m_boundingAABB = data.generateBoundingAABB();
-  m_boundingSphere = data.generateBoundingSphere();
+  m_vertices.copyFrom(vertices);
+  range.copyFrom(indices);
   return true;
 }
 
@@ -239,19 +766,21 @@ Ref<Model> Model::read(System& system, const String& name)
 
 ///////////////////////////////////////////////////////////////////////
 
-ModelReader::ModelReader(System& initSystem):
-  ResourceReader<Model>(initSystem.cache()),
-  system(initSystem)
+ModelData::ModelData():
+  vertexFlags(MV_NONE)
 {
 }
 
-Ref<Model> ModelReader::read(const String& name, const Path& path)
+bool ModelData::read(ResourceCache& cache,
+                     const String& name,
+                     const Path& path,
+                     ThreadPool* pool)
 {
   std::ifstream stream(path.name().c_str());
   if (stream.fail())
   {
     logError("Failed to open model %s", name.c_str());
-    return nullptr;
+    return false;
   }
 
   pugi::xml_document document;
@@ -262,39 +791,37 @@ Ref<Model> ModelReader::read(const String& name, const Path& path)
     logError("Failed to load model %s: %s",
              name.c_str(),
              result.description());
-    return nullptr;
+    return false;
   }
 
   pugi::xml_node root = document.child("model");
   if (!root || root.attribute("version").as_uint() != MODEL_XML_VERSION)
   {
     logError("Model file format mismatch in %s", name.c_str());
-    return nullptr;
+    return false;
   }
 
   const String meshName(root.attribute("mesh").value());
   if (meshName.empty())
   {
     logError("No mesh for model %s", name.c_str());
-    return nullptr;
+    return false;
   }
 
-  Ref<Mesh> mesh = Mesh::read(cache, meshName);
+  mesh = Mesh::read(cache, meshName, pool);
   if (!mesh)
   {
     logError("Failed to load mesh for model %s", name.c_str());
-    return nullptr;
+    return false;
   }
 
-  Model::MaterialMap materials;
-
   for (auto m : root.children("material"))
   {
     const String materialAlias(m.attribute("alias").value());
     if (materialAlias.empty())
     {
       logError("Empty material alias found in model %s", name.c_str());
-      return nullptr;
+      return false;
     }
 
     const String materialName(m.attribute("name").value());
@@ -303,21 +830,256 @@ Ref<Model> ModelReader::read(const String& name, const Path& path)
       logError("Empty material name for alias %s in model %s",
                materialAlias.c_str(),
                name.c_str());
-      return nullptr;
+      return false;
     }
 
-    Ref<Material> material = Material::read(system, materialName);
+    materials[materialAlias] = materialName;
+  }
+
+  for (auto l : root.children("lod"))
+  {
+    const float size = l.attribute("size").as_float();
+    if (size <= 0.f)
+    {
+      logError("Level of detail without size in model %s", name.c_str());
+      return false;
+    }
+
+    Ref<Mesh> levelMesh;
+
+    const String levelMeshName(l.attribute("mesh").value());
+    if (levelMeshName.empty())
+    {
+      // Generate the level by simplifying the full detail mesh
+      const float ratio = l.attribute("ratio").as_float();
+      if (ratio <= 0.f || ratio >= 1.f)
+      {
+        logError("Level of detail in model %s needs a mesh or a ratio between zero and one",
+                 name.c_str());
+        return false;
+      }
+
+      levelMesh = new Mesh(ResourceInfo(cache));
+      levelMesh->vertices = mesh->vertices;
+      levelMesh->sections = mesh->sections;
+      levelMesh->simplify(size_t(mesh->triangleCount() * ratio));
+    }
+    else
+    {
+      levelMesh = Mesh::read(cache, levelMeshName, pool);
+      if (!levelMesh)
+      {
+        logError("Failed to load level of detail mesh for model %s", name.c_str());
+        return false;
+      }
+    }
+
+    levelMeshes.push_back(levelMesh);
+    levels.push_back(Model::LevelData(*levelMesh, size));
+  }
+
+  std::sort(levels.begin(), levels.end(),
+            [](const Model::LevelData& a, const Model::LevelData& b)
+  {
+    return a.screenSize > b.screenSize;
+  });
+
+  occluderName = root.attribute("occluder").value();
+
+  std::istringstream flags(root.attribute("vertices").value());
+  String flag;
+
+  while (flags >> flag)
+  {
+    if (flag == "compact")
+      vertexFlags |= MV_COMPACT;
+    else if (flag == "half-positions")
+      vertexFlags |= MV_HALF_POSITIONS;
+    else if (flag == "packed-normals")
+      vertexFlags |= MV_PACKED_NORMALS;
+    else if (flag == "octahedral-normals")
+      vertexFlags |= MV_OCTAHEDRAL_NORMALS;
+    else if (flag == "half-texcoords")
+      vertexFlags |= MV_HALF_TEXCOORDS;
+    else
+    {
+      logError("Invalid vertex flag %s in model %s",
+               flag.c_str(),
+               name.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////
+
+ModelReader::ModelReader(System& initSystem):
+  ResourceReader<Model>(initSystem.cache()),
+  system(initSystem)
+{
+}
+
+Ref<Model> ModelReader::read(const String& name, const Path& path)
+{
+  if (path.suffix() == MODEL_BINARY_SUFFIX)
+    return readBinary(name, path);
+
+  ModelData data;
+  if (!data.read(cache, name, path))
+    return nullptr;
+
+  Model::MaterialMap materials;
+
+  for (auto& m : data.materials)
+  {
+    Ref<Material> material = Material::read(system, m.second);
     if (!material)
     {
       logError("Failed to load material for alias %s of model %s",
-               materialAlias.c_str(),
-               materialName.c_str());
+               m.first.c_str(),
+               m.second.c_str());
+    }
+
+    materials[m.first] = material;
+  }
+
+  Ref<Model> model = Model::create(ResourceInfo(cache, name, path),
+                                   system, *data.mesh, materials, data.levels,
+                                   data.vertexFlags);
+  if (!model)
+    return nullptr;
+
+  if (!data.occluderName.empty())
+  {
+    Ref<Mesh> occluder = Mesh::read(cache, data.occluderName);
+    if (!occluder)
+    {
+      logError("Failed to load occluder mesh for model %s", name.c_str());
+      return nullptr;
+    }
+
+    model->setOccluder(occluder);
+  }
+
+  return model;
+}
+
+Ref<Model> ModelReader::readBinary(const String& name, const Path& path)
+{
+  MappedFile file;
+  if (!file.open(path))
+  {
+    logError("Failed to open model %s", name.c_str());
+    return nullptr;
+  }
+
+  return Model::create(ResourceInfo(cache, name, path),
+                       system, file.data(), file.size());
+}
+
+///////////////////////////////////////////////////////////////////////
+
+bool ModelWriter::write(const Path& path, const ModelData& data)
+{
+  if (!data.mesh)
+  {
+    logError("No mesh to write to %s", path.name().c_str());
+    return false;
+  }
+
+  ModelLayout layout;
+  if (!layout.build(path.name(), *data.mesh, data.levels, data.vertexFlags))
+    return false;
+
+  std::vector<char> strings;
+  std::map<String, uint32> offsets;
+
+  auto addString = [&](const String& string) -> uint32
+  {
+    auto entry = offsets.find(string);
+    if (entry != offsets.end())
+      return entry->second;
+
+    const uint32 offset = uint32(strings.size());
+    strings.insert(strings.end(), string.begin(), string.end());
+    strings.push_back('\0');
+    offsets[string] = offset;
+    return offset;
+  };
+
+  for (auto& s : layout.sections)
+  {
+    const String& alias = layout.materialNames[s.materialName];
+
+    auto material = data.materials.find(alias);
+    if (material == data.materials.end())
+    {
+      logError("Missing material %s for model %s",
+               alias.c_str(),
+               path.name().c_str());
+      return false;
     }
 
-    materials[materialAlias] = material;
+    s.materialName = addString(material->second);
+  }
+
+  BinaryModelHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MODEL_BINARY_MAGIC, sizeof(header.magic));
+  header.version = MODEL_BINARY_VERSION;
+  header.vertexFormat = addString(layout.format.asString());
+  header.vertexSize = uint32(layout.format.size());
+  header.vertexCount = layout.vertexCount;
+  header.indexCount = layout.indexCount;
+  if (layout.indexType == GL::INDEX_UINT16)
+    header.indexSize = sizeof(uint16);
+  else
+    header.indexSize = sizeof(uint32);
+  header.levelCount = uint32(layout.levels.size());
+  header.sectionCount = uint32(layout.sections.size());
+
+  if (data.occluderName.empty())
+    header.occluderName = MODEL_BINARY_NO_STRING;
+  else
+    header.occluderName = addString(data.occluderName);
+
+  strings.resize((strings.size() + 3) & ~size_t(3), '\0');
+  header.stringsSize = uint32(strings.size());
+
+  const AABB aabb = data.mesh->generateBoundingAABB();
+  std::memcpy(header.aabbCenter, value_ptr(aabb.center), sizeof(header.aabbCenter));
+  std::memcpy(header.aabbSize, value_ptr(aabb.size), sizeof(header.aabbSize));
+
+  const Sphere sphere = data.mesh->generateBoundingSphere();
+  std::memcpy(header.sphereCenter, value_ptr(sphere.center), sizeof(header.sphereCenter));
+  header.sphereRadius = sphere.radius;
+
+  std::ofstream stream(path.name().c_str(), std::ios::out | std::ios::binary);
+  if (!stream.is_open())
+  {
+    logError("Failed to open %s for writing", path.name().c_str());
+    return false;
+  }
+
+  stream.write((const char*) &header, sizeof(header));
+  stream.write((const char*) &layout.levels[0],
+               layout.levels.size() * sizeof(BinaryModelLevel));
+  stream.write((const char*) &layout.sections[0],
+               layout.sections.size() * sizeof(BinaryModelSection));
+  stream.write(strings.data(), strings.size());
+  stream.write((const char*) &layout.vertices[0], layout.vertices.size());
+  stream.write((const char*) &layout.indices[0], layout.indices.size());
+
+  if (stream.fail())
+  {
+    logError("Failed to write model %s", path.name().c_str());
+    return false;
   }
 
-  return Model::create(ResourceInfo(cache, name, path), system, *mesh, materials);
+  stream.close();
+  return true;
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -32,6 +32,8 @@
 
 #include <wendy/RenderPool.hpp>
 
+#include <cstring>
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -41,53 +43,264 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+void extendRange(uint& first, uint& last, uint start, uint end)
+{
+  if (first == last)
+  {
+    first = start;
+    last = end;
+  }
+  else
+  {
+    first = min(first, start);
+    last = max(last, end);
+  }
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
 GL::VertexRange VertexPool::allocate(uint count, const VertexFormat& format)
 {
   if (!count)
     return GL::VertexRange();
 
-  Slot* slot = nullptr;
+  std::lock_guard<std::mutex> lock(m_mutex);
 
-  for (auto& s : m_slots)
+  const bool contextThread = (std::this_thread::get_id() == m_threadID);
+
+  GL::VertexRange range;
+  if (allocateFromRing(range, count, format, contextThread))
+    return range;
+
+  Slot* slot = findSlot(count, format);
+  if (!slot)
   {
-    if (s.buffer->format() == format && s.available >= count)
+    if (!contextThread)
     {
-      slot = &s;
-      break;
+      logError("Cannot create vertex pool buffer outside of context thread");
+      return GL::VertexRange();
     }
+
+    slot = createSlot(count, format, true);
+    if (!slot)
+      return GL::VertexRange();
   }
 
-  if (!slot)
+  // Ranges without data are written through the GL, so they need storage
+  if (!slot->buffer->isRealized())
   {
-    m_slots.push_back(Slot());
-    slot = &(m_slots.back());
+    if (!contextThread)
+    {
+      logError("Cannot create vertex pool buffer outside of context thread");
+      return GL::VertexRange();
+    }
 
-    const uint actualCount = m_granularity * ((count + m_granularity - 1) / m_granularity);
+    if (!slot->buffer->realize())
+      return GL::VertexRange();
+  }
+
+  const uint start = slot->buffer->count() - slot->available;
 
-    slot->buffer = GL::VertexBuffer::create(m_context,
-                                            actualCount,
-                                            format,
-                                            GL::USAGE_DYNAMIC);
-    if (!slot->buffer)
+  slot->available -= count;
+
+  return GL::VertexRange(*(slot->buffer), start, count);
+}
+
+GL::VertexRange VertexPool::allocate(uint count,
+                                     const VertexFormat& format,
+                                     const void* vertices)
+{
+  if (!count)
+    return GL::VertexRange();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const bool contextThread = (std::this_thread::get_id() == m_threadID);
+
+  GL::VertexRange range;
+  if (allocateFromRing(range, count, format, contextThread))
+  {
+    std::memcpy(storageOf(range), vertices, count * format.size());
+
+    if (contextThread)
+      range.vertexBuffer()->flush(count, range.start());
+    else
     {
-      m_slots.pop_back();
-      return GL::VertexRange();
+      Ring* ring = findRing(*range.vertexBuffer());
+      extendRange(ring->flushStart, ring->flushEnd,
+                  range.start(), range.start() + count);
     }
 
-    log("Allocated vertex pool of size %u format %s",
-        actualCount,
-        format.asString().c_str());
+    return range;
+  }
 
-    slot->available = slot->buffer->count();
+  Slot* slot = findSlot(count, format);
+  if (!slot)
+  {
+    slot = createSlot(count, format, contextThread);
+    if (!slot)
+      return GL::VertexRange();
   }
 
+  if (contextThread && !slot->buffer->realize())
+    return GL::VertexRange();
+
   const uint start = slot->buffer->count() - slot->available;
 
   slot->available -= count;
 
+  if (contextThread)
+    slot->buffer->copyFrom(vertices, count, start);
+  else
+  {
+    const size_t size = format.size();
+
+    if (slot->staging.empty())
+      slot->staging.resize(slot->buffer->size());
+
+    std::memcpy(&slot->staging[start * size], vertices, count * size);
+    extendRange(slot->stagedStart, slot->stagedEnd, start, start + count);
+  }
+
   return GL::VertexRange(*(slot->buffer), start, count);
 }
 
+void* VertexPool::map(GL::VertexRange& range, uint count, const VertexFormat& format)
+{
+  if (!count)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const bool contextThread = (std::this_thread::get_id() == m_threadID);
+
+  if (allocateFromRing(range, count, format, contextThread))
+    return storageOf(range);
+
+  Slot* slot = findSlot(count, format);
+  if (!slot)
+  {
+    slot = createSlot(count, format, contextThread);
+    if (!slot)
+      return nullptr;
+  }
+
+  if (contextThread && !slot->buffer->realize())
+    return nullptr;
+
+  const uint start = slot->buffer->count() - slot->available;
+
+  slot->available -= count;
+
+  range = GL::VertexRange(*(slot->buffer), start, count);
+  return storageOf(range);
+}
+
+void VertexPool::flush(const GL::VertexRange& range)
+{
+  if (range.isEmpty())
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const bool contextThread = (std::this_thread::get_id() == m_threadID);
+
+  GL::VertexBuffer& buffer = *range.vertexBuffer();
+  const uint start = range.start();
+  const uint end = range.start() + range.count();
+
+  if (Ring* ring = findRing(buffer))
+  {
+    if (contextThread)
+      buffer.flush(range.count(), range.start());
+    else
+      extendRange(ring->flushStart, ring->flushEnd, start, end);
+  }
+  else if (Slot* slot = findSlot(buffer))
+  {
+    const size_t size = buffer.format().size();
+
+    // Only ranges allocated with map are written to staging memory
+    if (slot->staging.size() < end * size)
+    {
+      logError("Cannot flush vertex range not allocated with map");
+      return;
+    }
+
+    if (contextThread)
+    {
+      if (buffer.realize())
+        buffer.copyFrom(&slot->staging[start * size], range.count(), start);
+    }
+    else
+      extendRange(slot->stagedStart, slot->stagedEnd, start, end);
+  }
+  else
+    logError("Cannot flush vertex range not allocated from this pool");
+}
+
+void VertexPool::flush()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto& r : m_rings)
+  {
+    if (r.flushStart != r.flushEnd)
+    {
+      r.buffer->flush(r.flushEnd - r.flushStart, r.flushStart);
+      r.flushStart = r.flushEnd = 0;
+    }
+  }
+
+  for (auto& s : m_slots)
+  {
+    // Buffers reserved by other threads are created here
+    if (!s.buffer->isRealized())
+    {
+      if (!s.buffer->realize())
+      {
+        logError("Failed to create vertex pool buffer of format %s",
+                 s.buffer->format().asString().c_str());
+        continue;
+      }
+
+      log("Allocated vertex pool of size %u format %s",
+          uint(s.buffer->count()),
+          s.buffer->format().asString().c_str());
+    }
+
+    if (s.stagedStart != s.stagedEnd)
+    {
+      const size_t size = s.buffer->format().size();
+
+      s.buffer->copyFrom(&s.staging[s.stagedStart * size],
+                         s.stagedEnd - s.stagedStart,
+                         s.stagedStart);
+
+      s.stagedStart = s.stagedEnd = 0;
+    }
+  }
+
+  // Create the rings that other threads found missing
+
+  for (auto& s : m_shortfalls)
+  {
+    if (!findRing(s.format))
+    {
+      m_rings.push_back(Ring());
+      if (!initRing(m_rings.back(), s.count, s.format))
+        m_rings.pop_back();
+    }
+  }
+
+  m_shortfalls.clear();
+}
+
 Ref<VertexPool> VertexPool::create(GL::Context& context, size_t granularity)
 {
   Ref<VertexPool> pool(new VertexPool(context));
@@ -99,7 +312,9 @@ Ref<VertexPool> VertexPool::create(GL::Context& context, size_t granularity)
 
 VertexPool::VertexPool(GL::Context& context):
   m_context(context),
-  m_granularity(0)
+  m_granularity(0),
+  m_persistent(false),
+  m_threadID(std::this_thread::get_id())
 {
   context.window().frameSignal().connect(*this, &VertexPool::onFrame);
 }
@@ -107,18 +322,354 @@ VertexPool::VertexPool(GL::Context& context):
 bool VertexPool::init(size_t granularity)
 {
   m_granularity = granularity;
+  m_persistent = m_context.limits().persistentBuffers;
+  return true;
+}
+
+bool VertexPool::allocateFromRing(GL::VertexRange& range,
+                                  uint count,
+                                  const VertexFormat& format,
+                                  bool contextThread)
+{
+  if (!m_persistent)
+    return false;
+
+  Ring* ring = findRing(format);
+  if (!ring)
+  {
+    if (!contextThread)
+    {
+      // Have the next flush create the ring
+      Shortfall shortfall;
+      shortfall.format = format;
+      shortfall.count = count;
+      m_shortfalls.push_back(shortfall);
+      return false;
+    }
+
+    m_rings.push_back(Ring());
+    ring = &(m_rings.back());
+
+    if (!initRing(*ring, count, format))
+    {
+      m_rings.pop_back();
+      return false;
+    }
+  }
+
+  // Overflowing allocations are still counted so the ring can grow
+  ring->requested += count;
+
+  if (ring->used + count > ring->regionSize)
+    return false;
+
+  const uint start = ring->region * ring->regionSize + ring->used;
+
+  ring->used += count;
+
+  range = GL::VertexRange(*(ring->buffer), start, count);
   return true;
 }
 
+void* VertexPool::storageOf(const GL::VertexRange& range)
+{
+  GL::VertexBuffer& buffer = *range.vertexBuffer();
+  const size_t offset = range.start() * buffer.format().size();
+
+  if (buffer.mapping())
+    return (char*) buffer.mapping() + offset;
+
+  Slot* slot = findSlot(buffer);
+  if (slot->staging.empty())
+    slot->staging.resize(buffer.size());
+
+  return &slot->staging[offset];
+}
+
+VertexPool::Ring* VertexPool::findRing(const VertexFormat& format)
+{
+  for (auto& r : m_rings)
+  {
+    if (r.buffer->format() == format)
+      return &r;
+  }
+
+  return nullptr;
+}
+
+VertexPool::Ring* VertexPool::findRing(const GL::VertexBuffer& buffer)
+{
+  for (auto& r : m_rings)
+  {
+    if (r.buffer == &buffer)
+      return &r;
+  }
+
+  return nullptr;
+}
+
+bool VertexPool::initRing(Ring& ring, uint count, const VertexFormat& format)
+{
+  const uint regionSize = m_granularity * ((count + m_granularity - 1) / m_granularity);
+
+  Ref<GL::VertexBuffer> buffer = GL::VertexBuffer::create(m_context,
+                                                          regionSize * REGION_COUNT,
+                                                          format,
+                                                          GL::USAGE_PERSISTENT);
+  if (!buffer)
+    return false;
+
+  log("Allocated persistent vertex pool of size %u format %s",
+      regionSize * REGION_COUNT,
+      format.asString().c_str());
+
+  ring.buffer = buffer;
+  ring.regionSize = regionSize;
+  ring.region = 0;
+  ring.used = 0;
+  ring.requested = 0;
+  ring.flushStart = 0;
+  ring.flushEnd = 0;
+
+  for (uint i = 0;  i < REGION_COUNT;  i++)
+    ring.fences[i] = GL::Fence::create(m_context);
+
+  return true;
+}
+
+VertexPool::Slot* VertexPool::findSlot(uint count, const VertexFormat& format)
+{
+  for (auto& s : m_slots)
+  {
+    if (s.buffer->format() == format && s.available >= count)
+      return &s;
+  }
+
+  return nullptr;
+}
+
+VertexPool::Slot* VertexPool::findSlot(const GL::VertexBuffer& buffer)
+{
+  for (auto& s : m_slots)
+  {
+    if (s.buffer == &buffer)
+      return &s;
+  }
+
+  return nullptr;
+}
+
+VertexPool::Slot* VertexPool::createSlot(uint count,
+                                         const VertexFormat& format,
+                                         bool contextThread)
+{
+  const uint actualCount = m_granularity * ((count + m_granularity - 1) / m_granularity);
+
+  Ref<GL::VertexBuffer> buffer;
+
+  if (contextThread)
+  {
+    buffer = GL::VertexBuffer::create(m_context,
+                                      actualCount,
+                                      format,
+                                      GL::USAGE_DYNAMIC);
+    if (!buffer)
+      return nullptr;
+
+    log("Allocated vertex pool of size %u format %s",
+        actualCount,
+        format.asString().c_str());
+  }
+  else
+  {
+    // The storage is created by the next flush, so until then the vertex data
+    // is kept in staging memory
+    buffer = GL::VertexBuffer::createDeferred(m_context,
+                                              actualCount,
+                                              format,
+                                              GL::USAGE_DYNAMIC);
+  }
+
+  m_slots.push_back(Slot());
+
+  Slot* slot = &(m_slots.back());
+  slot->buffer = buffer;
+  slot->available = buffer->count();
+  slot->stagedStart = 0;
+  slot->stagedEnd = 0;
+
+  if (!contextThread)
+    slot->staging.resize(buffer->size());
+
+  return slot;
+}
+
 void VertexPool::onFrame()
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Retired rings may be released once the GL is done with their last frame
+  auto i = m_retiredRings.begin();
+  while (i != m_retiredRings.end())
+  {
+    if (i->fences[i->region]->isSignaled())
+      i = m_retiredRings.erase(i);
+    else
+      i++;
+  }
+
+  for (auto& r : m_rings)
+  {
+    r.fences[r.region]->set();
+
+    if (r.requested > r.regionSize)
+    {
+      // Replace the ring with one whose regions fit the whole frame
+      Ring ring;
+      if (initRing(ring, r.requested, r.buffer->format()))
+      {
+        m_retiredRings.push_back(r);
+        r = ring;
+        continue;
+      }
+    }
+
+    // Advance to the next region, waiting for the GL if it is still in use
+    r.region = (r.region + 1) % REGION_COUNT;
+    r.fences[r.region]->wait();
+
+    r.used = 0;
+    r.requested = 0;
+    r.flushStart = r.flushEnd = 0;
+  }
+
   for (auto& s : m_slots)
   {
     s.available = s.buffer->count();
-    s.buffer->discard();
+    s.stagedStart = s.stagedEnd = 0;
+
+    if (s.buffer->isRealized())
+      s.buffer->discard();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+bool GeometryPool::allocate(GL::VertexRange& vertices,
+                            GL::IndexRange& indices,
+                            uint vertexCount,
+                            const VertexFormat& format,
+                            uint indexCount,
+                            GL::IndexBufferType indexType)
+{
+  Block* block = nullptr;
+
+  for (auto& b : m_blocks)
+  {
+    if (b.vertexBuffer->format() != format ||
+        b.indexBuffer->type() != indexType)
+    {
+      continue;
+    }
+
+    if (b.vertexBuffer->count() - b.vertexCount < vertexCount ||
+        b.indexBuffer->count() - b.indexCount < indexCount)
+    {
+      continue;
+    }
+
+    block = &b;
+    break;
+  }
+
+  if (!block)
+  {
+    block = createBlock(vertexCount, format, indexCount, indexType);
+    if (!block)
+      return false;
+  }
+
+  vertices = GL::VertexRange(*block->vertexBuffer, block->vertexCount, vertexCount);
+  indices = GL::IndexRange(*block->indexBuffer, block->indexCount, indexCount);
+
+  block->vertexCount += vertexCount;
+  block->indexCount += indexCount;
+  block->allocationCount++;
+
+  return true;
+}
+
+void GeometryPool::release(const GL::VertexRange& vertices)
+{
+  for (auto& b : m_blocks)
+  {
+    if (b.vertexBuffer != vertices.vertexBuffer())
+      continue;
+
+    if (--b.allocationCount == 0)
+    {
+      b.vertexCount = 0;
+      b.indexCount = 0;
+    }
+
+    return;
   }
 }
 
+Ref<GeometryPool> GeometryPool::create(GL::Context& context, uint granularity)
+{
+  return new GeometryPool(context, granularity);
+}
+
+GeometryPool::GeometryPool(GL::Context& context, uint granularity):
+  m_context(context),
+  m_granularity(granularity)
+{
+}
+
+GeometryPool::Block* GeometryPool::createBlock(uint vertexCount,
+                                               const VertexFormat& format,
+                                               uint indexCount,
+                                               GL::IndexBufferType indexType)
+{
+  uint maxVertexCount = m_granularity;
+  if (indexType == GL::INDEX_UINT8)
+    maxVertexCount = min(maxVertexCount, 1u << 8);
+  else if (indexType == GL::INDEX_UINT16)
+    maxVertexCount = min(maxVertexCount, 1u << 16);
+
+  // Triangle meshes tend to have about twice as many triangles as vertices
+  const uint actualVertexCount = max(vertexCount, maxVertexCount);
+  const uint actualIndexCount = max(indexCount, maxVertexCount * 6);
+
+  Block block;
+  block.vertexCount = 0;
+  block.indexCount = 0;
+  block.allocationCount = 0;
+
+  block.vertexBuffer = GL::VertexBuffer::create(m_context,
+                                                actualVertexCount,
+                                                format,
+                                                GL::USAGE_STATIC);
+  if (!block.vertexBuffer)
+    return nullptr;
+
+  block.indexBuffer = GL::IndexBuffer::create(m_context,
+                                              actualIndexCount,
+                                              indexType,
+                                              GL::USAGE_STATIC);
+  if (!block.indexBuffer)
+    return nullptr;
+
+  log("Allocated static geometry block of %u vertices format %s and %u indices",
+      actualVertexCount,
+      format.asString().c_str(),
+      actualIndexCount);
+
+  m_blocks.push_back(block);
+  return &m_blocks.back();
+}
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace render*/
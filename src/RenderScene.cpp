@@ -27,6 +27,7 @@
 
 #include <wendy/Core.hpp>
 #include <wendy/Timer.hpp>
+#include <wendy/Thread.hpp>
 #include <wendy/Profile.hpp>
 #include <wendy/Transform.hpp>
 #include <wendy/Primitive.hpp>
@@ -49,6 +50,143 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+const uint RADIX_BITS = 11;
+const uint RADIX_SIZE = 1 << RADIX_BITS;
+const uint RADIX_PASSES = (128 + RADIX_BITS - 1) / RADIX_BITS;
+
+const size_t PARALLEL_SORT_THRESHOLD = 1 << 16;
+
+void forEachChunk(ThreadPool* pool, uint chunkCount, const std::function<void (uint)>& task)
+{
+  if (chunkCount == 1)
+  {
+    task(0);
+    return;
+  }
+
+  pool->parallelFor(chunkCount, [&](size_t first, size_t last)
+  {
+    for (size_t i = first;  i < last;  i++)
+      task(uint(i));
+  });
+}
+
+// Returns the digit of the sort value at the specified bit offset
+uint digitOf(const SortKey& key, uint shift)
+{
+  uint64 bits;
+
+  if (shift >= 64)
+    bits = key.high >> (shift - 64);
+  else if (shift + RADIX_BITS <= 64)
+    bits = key.low >> shift;
+  else
+    bits = (key.low >> shift) | (key.high << (64 - shift));
+
+  return uint(bits & (RADIX_SIZE - 1));
+}
+
+void radixSort(SortKeyList& keys, SortKeyList& scratch, ThreadPool* pool)
+{
+  const size_t count = keys.size();
+
+  uint chunkCount = 1;
+  if (pool && count >= PARALLEL_SORT_THRESHOLD)
+    chunkCount = pool->workerCount() + 1;
+
+  const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+  scratch.resize(count);
+
+  // Digit counts for each chunk and pass
+  std::vector<size_t> histograms(chunkCount * RADIX_PASSES * RADIX_SIZE, 0);
+
+  forEachChunk(pool, chunkCount, [&](uint c)
+  {
+    size_t* histogram = &histograms[c * RADIX_PASSES * RADIX_SIZE];
+    const size_t last = std::min(count, (c + 1) * chunkSize);
+
+    for (size_t i = c * chunkSize;  i < last;  i++)
+    {
+      for (uint p = 0;  p < RADIX_PASSES;  p++)
+        histogram[p * RADIX_SIZE + digitOf(keys[i], p * RADIX_BITS)]++;
+    }
+  });
+
+  std::vector<size_t> offsets(chunkCount * RADIX_SIZE);
+  bool first = true;
+
+  for (uint p = 0;  p < RADIX_PASSES;  p++)
+  {
+    const uint shift = p * RADIX_BITS;
+
+    // Passes where all keys share the same digit do not change the order
+    bool trivial = false;
+
+    for (uint d = 0;  d < RADIX_SIZE;  d++)
+    {
+      size_t total = 0;
+
+      for (uint c = 0;  c < chunkCount;  c++)
+        total += histograms[(c * RADIX_PASSES + p) * RADIX_SIZE + d];
+
+      if (total == count)
+      {
+        trivial = true;
+        break;
+      }
+    }
+
+    if (trivial)
+      continue;
+
+    // The chunks have been reordered by earlier passes, so count again
+    if (!first)
+    {
+      forEachChunk(pool, chunkCount, [&](uint c)
+      {
+        size_t* histogram = &histograms[(c * RADIX_PASSES + p) * RADIX_SIZE];
+        const size_t last = std::min(count, (c + 1) * chunkSize);
+
+        std::fill(histogram, histogram + RADIX_SIZE, 0);
+
+        for (size_t i = c * chunkSize;  i < last;  i++)
+          histogram[digitOf(keys[i], shift)]++;
+      });
+    }
+
+    size_t start = 0;
+
+    for (uint d = 0;  d < RADIX_SIZE;  d++)
+    {
+      for (uint c = 0;  c < chunkCount;  c++)
+      {
+        offsets[c * RADIX_SIZE + d] = start;
+        start += histograms[(c * RADIX_PASSES + p) * RADIX_SIZE + d];
+      }
+    }
+
+    forEachChunk(pool, chunkCount, [&](uint c)
+    {
+      size_t* offset = &offsets[c * RADIX_SIZE];
+      const size_t last = std::min(count, (c + 1) * chunkSize);
+
+      for (size_t i = c * chunkSize;  i < last;  i++)
+        scratch[offset[digitOf(keys[i], shift)]++] = keys[i];
+    });
+
+    keys.swap(scratch);
+    first = false;
+  }
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
 Light::Light():
   m_type(DIRECTIONAL),
   m_radius(1.f),
@@ -93,12 +231,15 @@ void Light::setColor(const vec3& newColor)
 
 ///////////////////////////////////////////////////////////////////////
 
-SortKey SortKey::makeOpaqueKey(uint8 layer, uint16 state, float depth)
+SortKey SortKey::makeOpaqueKey(uint8 layer,
+                               uint64 state,
+                               uint64 binding,
+                               float depth)
 {
   SortKey key;
-  key.layer = layer;
-  key.state = state;
-  key.depth = (unsigned) (((1 << 24) - 1) * clamp(depth, 0.f, 1.f));
+  key.high = (uint64(layer) << 56) | state;
+  key.low = (binding << 24) |
+            uint64(((1 << 24) - 1) * clamp(depth, 0.f, 1.f));
 
   return key;
 }
@@ -106,8 +247,8 @@ SortKey SortKey::makeOpaqueKey(uint8 layer, uint16 state, float depth)
 SortKey SortKey::makeBlendedKey(uint8 layer, float depth)
 {
   SortKey key;
-  key.layer = layer;
-  key.depth = (unsigned) (((1 << 24) - 1) * (1.f - clamp(depth, 0.f, 1.f)));
+  key.high = uint64(layer) << 56;
+  key.low = uint64(((1 << 24) - 1) * (1.f - clamp(depth, 0.f, 1.f)));
 
   return key;
 }
@@ -115,41 +256,122 @@ SortKey SortKey::makeBlendedKey(uint8 layer, float depth)
 ///////////////////////////////////////////////////////////////////////
 
 Operation::Operation():
-  state(nullptr)
+  state(nullptr),
+  range(0),
+  transform(0)
 {
 }
 
 ///////////////////////////////////////////////////////////////////////
 
 Queue::Queue():
-  m_sorted(true)
+  m_sorted(true),
+  m_insertionOrder(true)
 {
 }
 
 void Queue::addOperation(const Operation& operation, SortKey key)
 {
-  key.index = (uint16) m_operations.size();
+  key.index = uint32(m_operations.size());
   m_keys.push_back(key);
   m_operations.push_back(operation);
   m_sorted = false;
 }
 
+void Queue::merge(const Queue& other, uint32 rangeOffset, uint32 transformOffset)
+{
+  const SortKeyList& otherKeys = other.keys();
+  if (otherKeys.empty())
+    return;
+
+  // Both key lists are sorted, so a linear merge suffices
+  keys();
+
+  const size_t offset = m_operations.size();
+  const size_t middle = m_keys.size();
+
+  m_operations.reserve(offset + other.m_operations.size());
+
+  for (Operation operation : other.m_operations)
+  {
+    operation.range += rangeOffset;
+    operation.transform += transformOffset;
+    m_operations.push_back(operation);
+  }
+
+  for (SortKey key : otherKeys)
+  {
+    key.index += offset;
+    m_keys.push_back(key);
+  }
+
+  std::inplace_merge(m_keys.begin(), m_keys.begin() + middle, m_keys.end());
+  m_insertionOrder = false;
+}
+
 void Queue::removeOperations()
 {
   m_operations.clear();
   m_keys.clear();
   m_sorted = true;
+  m_insertionOrder = true;
 }
 
 const SortKeyList& Queue::keys() const
 {
   if (!m_sorted)
+    sort(nullptr);
+
+  return m_keys;
+}
+
+const SortKeyList& Queue::keys(ThreadPool& pool) const
+{
+  if (!m_sorted)
+    sort(&pool);
+
+  return m_keys;
+}
+
+void Queue::sort(ThreadPool* pool) const
+{
+  const size_t count = m_keys.size();
+
+  if (m_insertionOrder && m_order.size() == count)
   {
-    std::sort(m_keys.begin(), m_keys.end());
-    m_sorted = true;
+    // Try the order of the previous frame, as the keys of most operations
+    // change little between frames
+    m_scratch.resize(count);
+
+    size_t i = 0;
+
+    for (;  i < count;  i++)
+    {
+      m_scratch[i] = m_keys[m_order[i]];
+      if (i > 0 && m_scratch[i] < m_scratch[i - 1])
+        break;
+    }
+
+    if (i == count)
+    {
+      m_keys.swap(m_scratch);
+      m_sorted = true;
+      m_insertionOrder = false;
+      return;
+    }
   }
 
-  return m_keys;
+  radixSort(m_keys, m_scratch, pool);
+
+  if (m_insertionOrder)
+  {
+    m_order.resize(count);
+    for (size_t i = 0;  i < count;  i++)
+      m_order[i] = m_keys[i].index;
+  }
+
+  m_sorted = true;
+  m_insertionOrder = false;
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -169,7 +391,11 @@ void Scene::addOperation(const Operation& operation, float depth, uint8 layer)
   }
   else
   {
-    SortKey key = SortKey::makeOpaqueKey(layer, operation.state->ID(), depth);
+    const Pass& pass = *operation.state;
+    SortKey key = SortKey::makeOpaqueKey(layer,
+                                         pass.sortState(),
+                                         pass.sortBinding(),
+                                         depth);
     m_opaqueQueue.addOperation(operation, key);
   }
 }
@@ -180,8 +406,8 @@ void Scene::createOperations(const mat4& transform,
                              float depth)
 {
   Operation operation;
-  operation.range = range;
-  operation.transform = transform;
+  operation.range = addRange(range);
+  operation.transform = addTransform(transform);
 
   uint8 layer = 0;
 
@@ -192,10 +418,39 @@ void Scene::createOperations(const mat4& transform,
   }
 }
 
+uint32 Scene::addRange(const GL::PrimitiveRange& range)
+{
+  m_ranges.push_back(range);
+  return uint32(m_ranges.size() - 1);
+}
+
+uint32 Scene::addTransform(const mat4& transform)
+{
+  m_transforms.push_back(transform);
+  return uint32(m_transforms.size() - 1);
+}
+
+void Scene::merge(const Scene& other)
+{
+  const uint32 rangeOffset = uint32(m_ranges.size());
+  const uint32 transformOffset = uint32(m_transforms.size());
+
+  m_ranges.insert(m_ranges.end(), other.m_ranges.begin(), other.m_ranges.end());
+  m_transforms.insert(m_transforms.end(),
+                      other.m_transforms.begin(),
+                      other.m_transforms.end());
+
+  m_opaqueQueue.merge(other.m_opaqueQueue, rangeOffset, transformOffset);
+  m_blendedQueue.merge(other.m_blendedQueue, rangeOffset, transformOffset);
+  m_lights.insert(m_lights.end(), other.m_lights.begin(), other.m_lights.end());
+}
+
 void Scene::removeOperations()
 {
   m_opaqueQueue.removeOperations();
   m_blendedQueue.removeOperations();
+  m_ranges.clear();
+  m_transforms.clear();
 }
 
 void Scene::addLight(const LightData& light)
@@ -224,6 +479,19 @@ Renderable::~Renderable()
 {
 }
 
+void Renderable::enqueue(Scene& scene,
+                         const Camera& camera,
+                         const Transform3& transform,
+                         uint& level) const
+{
+  enqueue(scene, camera, transform);
+}
+
+const Mesh* Renderable::occluder() const
+{
+  return nullptr;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace render*/
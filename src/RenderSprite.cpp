@@ -181,16 +181,15 @@ void Sprite3::enqueue(Scene& scene,
     return;
   }
 
-  GL::VertexRange range = scene.vertexPool().allocate(4, Vertex2ft3fv::format);
-  if (range.isEmpty())
-    return;
-
   const vec3 cameraPos = camera.transform().position;
   const vec3 spritePos = transform.position;
 
   Vertex2ft3fv vertices[4];
   realizeSpriteVertices(vertices, cameraPos, spritePos, size, angle, type);
-  range.copyFrom(vertices);
+
+  GL::VertexRange range = scene.vertexPool().allocate(4, Vertex2ft3fv::format, vertices);
+  if (range.isEmpty())
+    return;
 
   scene.createOperations(Transform3::IDENTITY,
                          GL::PrimitiveRange(GL::TRIANGLE_FAN, range),
@@ -33,6 +33,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <mutex>
+#include <unordered_map>
+
 ///////////////////////////////////////////////////////////////////////
 
 namespace wendy
@@ -51,6 +54,17 @@ bool samplerTypeMatchesTextureType(GL::SamplerType samplerType,
   return (int) samplerType == (int) textureType;
 }
 
+// Maps each distinct render state descriptor to a small index, in order of
+// first use
+uint32 internDescriptor(uint64 descriptor)
+{
+  static std::mutex mutex;
+  static std::unordered_map<uint64, uint32> indices;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return indices.insert(std::make_pair(descriptor, uint32(indices.size()))).first->second;
+}
+
 } /*namespace*/
 
 ///////////////////////////////////////////////////////////////////////
@@ -442,12 +456,14 @@ SamplerStateIndex::SamplerStateIndex(uint16 initIndex, uint16 initUnit):
 ///////////////////////////////////////////////////////////////////////
 
 ProgramState::ProgramState():
-  m_ID(allocateID())
+  m_ID(allocateID()),
+  m_revision(m_nextRevision++)
 {
 }
 
 ProgramState::ProgramState(const ProgramState& source):
   m_ID(allocateID()),
+  m_revision(m_nextRevision++),
   m_program(source.m_program),
   m_floats(source.m_floats),
   m_textures(source.m_textures)
@@ -472,6 +488,10 @@ void ProgramState::apply() const
 
   GL::SharedProgramState* state = context.currentSharedProgramState();
 
+  // If this state was the last one applied to the program and has not been
+  // modified since, its uniform values are already in the program object
+  const bool current = m_program->stateTag() == m_revision;
+
   uint textureIndex = 0, textureUnit = 0;
 
   for (uint i = 0;  i < m_program->samplerCount();  i++)
@@ -514,10 +534,16 @@ void ProgramState::apply() const
     }
     else
     {
-      uniform.copyFrom(&m_floats[0] + offset);
+      if (!current)
+        uniform.copyFrom(&m_floats[0] + offset);
+      else if (GL::Stats* stats = context.stats())
+        stats->addUniformUpload(true);
+
       offset += uniform.elementCount();
     }
   }
+
+  m_program->setStateTag(m_revision);
 }
 
 bool ProgramState::hasUniformState(const char* name) const
@@ -552,6 +578,7 @@ GL::Texture* ProgramState::samplerState(const char* name) const
     return nullptr;
   }
 
+  const NameID nameID = findName(name);
   uint textureIndex = 0;
 
   for (uint i = 0;  i < m_program->samplerCount();  i++)
@@ -560,7 +587,7 @@ GL::Texture* ProgramState::samplerState(const char* name) const
     if (sampler.isShared())
       continue;
 
-    if (sampler.name() == name)
+    if (sampler.nameID() == nameID)
       return m_textures[textureIndex];
 
     textureIndex++;
@@ -585,12 +612,15 @@ GL::Texture* ProgramState::samplerState(SamplerStateIndex index) const
 
 void ProgramState::setSamplerState(const char* name, GL::Texture* newTexture)
 {
+  m_revision = m_nextRevision++;
+
   if (!m_program)
   {
     logError("Cannot set sampler state on program state with no program");
     return;
   }
 
+  const NameID nameID = findName(name);
   uint textureIndex = 0;
 
   for (uint i = 0;  i < m_program->samplerCount();  i++)
@@ -599,7 +629,7 @@ void ProgramState::setSamplerState(const char* name, GL::Texture* newTexture)
     if (sampler.isShared())
       continue;
 
-    if (sampler.name() == name)
+    if (sampler.nameID() == nameID)
     {
       if (newTexture)
       {
@@ -622,6 +652,8 @@ void ProgramState::setSamplerState(const char* name, GL::Texture* newTexture)
 
 void ProgramState::setSamplerState(SamplerStateIndex index, GL::Texture* newTexture)
 {
+  m_revision = m_nextRevision++;
+
   if (!m_program)
   {
     logError("Cannot set sampler state on program state with no program");
@@ -651,6 +683,7 @@ UniformStateIndex ProgramState::uniformStateIndex(const char* name) const
     return UniformStateIndex();
   }
 
+  const NameID nameID = findName(name);
   uint offset = 0;
 
   for (uint i = 0;  i < m_program->uniformCount();  i++)
@@ -659,7 +692,7 @@ UniformStateIndex ProgramState::uniformStateIndex(const char* name) const
     if (uniform.isShared())
       continue;
 
-    if (uniform.name() == name)
+    if (uniform.nameID() == nameID)
       return UniformStateIndex(i, offset);
 
     offset += uniform.elementCount();
@@ -676,6 +709,7 @@ SamplerStateIndex ProgramState::samplerStateIndex(const char* name) const
     return SamplerStateIndex();
   }
 
+  const NameID nameID = findName(name);
   uint textureIndex = 0;
 
   for (uint i = 0;  i < m_program->samplerCount();  i++)
@@ -684,7 +718,7 @@ SamplerStateIndex ProgramState::samplerStateIndex(const char* name) const
     if (sampler.isShared())
       continue;
 
-    if (sampler.name() == name)
+    if (sampler.nameID() == nameID)
       return SamplerStateIndex(i, textureIndex);
 
     textureIndex++;
@@ -695,6 +729,8 @@ SamplerStateIndex ProgramState::samplerStateIndex(const char* name) const
 
 void ProgramState::setProgram(GL::Program* newProgram)
 {
+  m_revision = m_nextRevision++;
+
   m_floats.clear();
   m_textures.clear();
 
@@ -740,12 +776,15 @@ void ProgramState::releaseID(StateID ID)
 
 void* ProgramState::data(const char* name, GL::UniformType type)
 {
+  m_revision = m_nextRevision++;
+
   if (!m_program)
   {
     logError("Cannot set uniform state on program state with no program");
     return nullptr;
   }
 
+  const NameID nameID = findName(name);
   uint offset = 0;
 
   for (uint i = 0;  i < m_program->uniformCount();  i++)
@@ -754,7 +793,7 @@ void* ProgramState::data(const char* name, GL::UniformType type)
     if (uniform.isShared())
       continue;
 
-    if (uniform.name() == name)
+    if (uniform.nameID() == nameID)
     {
       if (uniform.type() == type)
         return &m_floats[0] + offset;
@@ -783,6 +822,7 @@ const void* ProgramState::data(const char* name, GL::UniformType type) const
     return nullptr;
   }
 
+  const NameID nameID = findName(name);
   uint offset = 0;
 
   for (uint i = 0;  i < m_program->uniformCount();  i++)
@@ -791,7 +831,7 @@ const void* ProgramState::data(const char* name, GL::UniformType type) const
     if (uniform.isShared())
       continue;
 
-    if (uniform.name() == name)
+    if (uniform.nameID() == nameID)
     {
       if (uniform.type() == type)
         return &m_floats[0] + offset;
@@ -814,6 +854,8 @@ const void* ProgramState::data(const char* name, GL::UniformType type) const
 
 void* ProgramState::data(UniformStateIndex index, GL::UniformType type)
 {
+  m_revision = m_nextRevision++;
+
   if (!m_program)
   {
     logError("Cannot set uniform state on program state with no program");
@@ -902,8 +944,16 @@ ProgramState::IDQueue ProgramState::m_usedIDs;
 
 StateID ProgramState::m_nextID = 0;
 
+uint64 ProgramState::m_nextRevision = 1;
+
 ///////////////////////////////////////////////////////////////////////
 
+Pass::Pass():
+  m_descriptor(m_data.descriptor()),
+  m_descriptorIndex(internDescriptor(m_descriptor))
+{
+}
+
 void Pass::apply() const
 {
   if (!program())
@@ -913,11 +963,29 @@ void Pass::apply() const
   }
 
   GL::Context& context = program()->context();
-  context.setCurrentRenderState(m_data);
+  context.setCurrentRenderState(m_data, m_descriptor);
 
   ProgramState::apply();
 }
 
+uint64 Pass::sortState() const
+{
+  uint64 programID = 0;
+  if (GL::Program* program = this->program())
+    programID = program->ID();
+
+  return (programID << 32) | m_descriptorIndex;
+}
+
+uint64 Pass::sortBinding() const
+{
+  uint64 textureID = 0;
+  if (!textures().empty() && textures().front())
+    textureID = textures().front()->ID() + 1;
+
+  return (textureID << 16) | ID();
+}
+
 bool Pass::isCulling() const
 {
   return m_data.cullMode != GL::CULL_NONE;
@@ -1021,87 +1089,110 @@ uint Pass::stencilWriteMask() const
 void Pass::setDepthTesting(bool enable)
 {
   m_data.depthTesting = enable;
+  updateDescriptor();
 }
 
 void Pass::setDepthWriting(bool enable)
 {
   m_data.depthWriting = enable;
+  updateDescriptor();
 }
 
 void Pass::setStencilTesting(bool enable)
 {
   m_data.stencilTesting = enable;
+  updateDescriptor();
 }
 
 void Pass::setCullMode(GL::CullMode mode)
 {
   m_data.cullMode = mode;
+  updateDescriptor();
 }
 
 void Pass::setBlendFactors(GL::BlendFactor src, GL::BlendFactor dst)
 {
   m_data.srcFactor = src;
   m_data.dstFactor = dst;
+  updateDescriptor();
 }
 
 void Pass::setDepthFunction(GL::Function function)
 {
   m_data.depthFunction = function;
+  updateDescriptor();
 }
 
 void Pass::setStencilFunction(GL::Function newFunction)
 {
   m_data.stencilFunction = newFunction;
+  updateDescriptor();
 }
 
 void Pass::setStencilReference(uint newReference)
 {
   m_data.stencilRef = newReference;
+  updateDescriptor();
 }
 
 void Pass::setStencilWriteMask(uint newMask)
 {
   m_data.stencilMask = newMask;
+  updateDescriptor();
 }
 
 void Pass::setStencilFailOperation(GL::StencilOp newOperation)
 {
   m_data.stencilFailOp = newOperation;
+  updateDescriptor();
 }
 
 void Pass::setDepthFailOperation(GL::StencilOp newOperation)
 {
   m_data.depthFailOp = newOperation;
+  updateDescriptor();
 }
 
 void Pass::setDepthPassOperation(GL::StencilOp newOperation)
 {
   m_data.depthPassOp = newOperation;
+  updateDescriptor();
 }
 
 void Pass::setColorWriting(bool enabled)
 {
   m_data.colorWriting = enabled;
+  updateDescriptor();
 }
 
 void Pass::setWireframe(bool enabled)
 {
   m_data.wireframe = enabled;
+  updateDescriptor();
 }
 
 void Pass::setLineSmoothing(bool enabled)
 {
   m_data.lineSmoothing = enabled;
+  updateDescriptor();
 }
 
 void Pass::setMultisampling(bool enabled)
 {
   m_data.multisampling = enabled;
+  updateDescriptor();
 }
 
 void Pass::setLineWidth(float newWidth)
 {
   m_data.lineWidth = newWidth;
+  updateDescriptor();
+}
+
+void Pass::updateDescriptor()
+{
+  m_descriptor = m_data.descriptor();
+  m_descriptorIndex = internDescriptor(m_descriptor);
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -57,6 +57,11 @@ VertexPool& System::vertexPool() const
   return *m_pool;
 }
 
+GeometryPool& System::geometryPool() const
+{
+  return *m_geometryPool;
+}
+
 System::Type System::type() const
 {
   return m_type;
@@ -64,6 +69,7 @@ System::Type System::type() const
 
 System::System(VertexPool& pool, Type type):
   m_pool(&pool),
+  m_geometryPool(GeometryPool::create(pool.context())),
   m_type(type)
 {
 }
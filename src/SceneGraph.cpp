@@ -27,11 +27,13 @@
 
 #include <wendy/Core.hpp>
 #include <wendy/Timer.hpp>
+#include <wendy/Thread.hpp>
 #include <wendy/Profile.hpp>
 #include <wendy/Transform.hpp>
 #include <wendy/Primitive.hpp>
 #include <wendy/Frustum.hpp>
 #include <wendy/Camera.hpp>
+#include <wendy/Occlusion.hpp>
 
 #include <wendy/GLTexture.hpp>
 #include <wendy/GLBuffer.hpp>
@@ -47,6 +49,10 @@
 #include <wendy/SceneGraph.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <queue>
+
+#include <glm/gtx/norm.hpp>
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -57,11 +63,638 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
+namespace
+{
+
+// Absolute and relative enlargement of the loose boxes stored in the index
+const float INDEX_MARGIN = 0.1f;
+const float INDEX_MARGIN_SCALE = 0.2f;
+
+float surfaceArea(const vec3& minimum, const vec3& maximum)
+{
+  const vec3 size = maximum - minimum;
+  return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+float distance2(const vec3& minimum, const vec3& maximum, const vec3& point)
+{
+  return length2(point - clamp(point, minimum, maximum));
+}
+
+bool intersects(const vec3& minimum, const vec3& maximum, const Sphere& sphere)
+{
+  return distance2(minimum, maximum, sphere.center) <=
+         sphere.radius * sphere.radius;
+}
+
+bool intersects(const vec3& minimum, const vec3& maximum, const Frustum& frustum)
+{
+  for (size_t i = 0;  i < 6;  i++)
+  {
+    const Plane& plane = frustum.planes[i];
+
+    const vec3 negative(plane.normal.x < 0.f ? maximum.x : minimum.x,
+                        plane.normal.y < 0.f ? maximum.y : minimum.y,
+                        plane.normal.z < 0.f ? maximum.z : minimum.z);
+
+    if (dot(plane.normal, negative) > plane.distance)
+      return false;
+  }
+
+  return true;
+}
+
+bool intersects(const vec3& minimum, const vec3& maximum, const Ray3& ray)
+{
+  float near = 0.f, far = std::numeric_limits<float>::max();
+
+  for (int i = 0;  i < 3;  i++)
+  {
+    if (ray.direction[i] == 0.f)
+    {
+      if (ray.origin[i] < minimum[i] || ray.origin[i] > maximum[i])
+        return false;
+    }
+    else
+    {
+      float t0 = (minimum[i] - ray.origin[i]) / ray.direction[i];
+      float t1 = (maximum[i] - ray.origin[i]) / ray.direction[i];
+      if (t0 > t1)
+        std::swap(t0, t1);
+
+      near = max(near, t0);
+      far = min(far, t1);
+      if (near > far)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+float distanceToSurface(const Sphere& sphere, const vec3& point)
+{
+  return max(length(sphere.center - point) - sphere.radius, 0.f);
+}
+
+class RayHit
+{
+public:
+  RayHit(Node* node, float distance): node(node), distance(distance) { }
+  bool operator < (const RayHit& other) const { return distance < other.distance; }
+  Node* node;
+  float distance;
+};
+
+class Candidate
+{
+public:
+  Candidate(int entryID, float distance, bool exact):
+    entryID(entryID),
+    distance(distance),
+    exact(exact)
+  {
+  }
+  bool operator < (const Candidate& other) const { return distance > other.distance; }
+  int entryID;
+  float distance;
+  bool exact;
+};
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+BoundsTree::BoundsTree():
+  m_root(-1),
+  m_free(-1),
+  m_proxyCount(0)
+{
+}
+
+int BoundsTree::createProxy(const Sphere& bounds, Node* node)
+{
+  const int proxyID = allocateEntry();
+
+  Entry& entry = m_entries[proxyID];
+  entry.node = node;
+  setLooseBox(entry, bounds);
+
+  insertLeaf(proxyID);
+  m_proxyCount++;
+
+  return proxyID;
+}
+
+void BoundsTree::destroyProxy(int proxyID)
+{
+  assert(m_entries[proxyID].isLeaf());
+
+  removeLeaf(proxyID);
+  freeEntry(proxyID);
+  m_proxyCount--;
+}
+
+bool BoundsTree::moveProxy(int proxyID, const Sphere& bounds)
+{
+  Entry& entry = m_entries[proxyID];
+  assert(entry.isLeaf());
+
+  entry.bounds = bounds;
+
+  const vec3 radius(bounds.radius);
+
+  if (all(greaterThanEqual(bounds.center - radius, entry.minimum)) &&
+      all(lessThanEqual(bounds.center + radius, entry.maximum)))
+  {
+    return false;
+  }
+
+  removeLeaf(proxyID);
+  setLooseBox(m_entries[proxyID], bounds);
+  insertLeaf(proxyID);
+  return true;
+}
+
+void BoundsTree::query(const Sphere& sphere, std::vector<Node*>& nodes) const
+{
+  if (m_root == -1)
+    return;
+
+  std::vector<int> stack;
+  stack.push_back(m_root);
+
+  while (!stack.empty())
+  {
+    const Entry& entry = m_entries[stack.back()];
+    stack.pop_back();
+
+    if (!intersects(entry.minimum, entry.maximum, sphere))
+      continue;
+
+    if (entry.isLeaf())
+    {
+      if (sphere.intersects(entry.bounds))
+        nodes.push_back(entry.node);
+    }
+    else
+    {
+      stack.push_back(entry.children[0]);
+      stack.push_back(entry.children[1]);
+    }
+  }
+}
+
+void BoundsTree::query(const Frustum& frustum, std::vector<Node*>& nodes) const
+{
+  if (m_root == -1)
+    return;
+
+  std::vector<int> stack;
+  stack.push_back(m_root);
+
+  while (!stack.empty())
+  {
+    const Entry& entry = m_entries[stack.back()];
+    stack.pop_back();
+
+    if (!intersects(entry.minimum, entry.maximum, frustum))
+      continue;
+
+    if (entry.isLeaf())
+    {
+      if (frustum.intersects(entry.bounds))
+        nodes.push_back(entry.node);
+    }
+    else
+    {
+      stack.push_back(entry.children[0]);
+      stack.push_back(entry.children[1]);
+    }
+  }
+}
+
+void BoundsTree::query(const Ray3& ray, std::vector<Node*>& nodes) const
+{
+  if (m_root == -1)
+    return;
+
+  std::vector<RayHit> hits;
+  std::vector<int> stack;
+  stack.push_back(m_root);
+
+  while (!stack.empty())
+  {
+    const Entry& entry = m_entries[stack.back()];
+    stack.pop_back();
+
+    if (!intersects(entry.minimum, entry.maximum, ray))
+      continue;
+
+    if (entry.isLeaf())
+    {
+      float distance;
+
+      if (entry.bounds.contains(ray.origin))
+        hits.push_back(RayHit(entry.node, 0.f));
+      else if (entry.bounds.intersects(ray, distance))
+        hits.push_back(RayHit(entry.node, distance));
+    }
+    else
+    {
+      stack.push_back(entry.children[0]);
+      stack.push_back(entry.children[1]);
+    }
+  }
+
+  std::stable_sort(hits.begin(), hits.end());
+
+  for (const RayHit& h : hits)
+    nodes.push_back(h.node);
+}
+
+void BoundsTree::queryNearest(const vec3& point,
+                              uint count,
+                              std::vector<Node*>& nodes) const
+{
+  if (m_root == -1 || !count)
+    return;
+
+  // Best-first traversal; box distances are lower bounds for the exact
+  // distances of the leaves below them, so leaves pop out in order
+
+  std::priority_queue<Candidate> queue;
+  queue.push(Candidate(m_root, 0.f, false));
+
+  while (!queue.empty() && count)
+  {
+    const Candidate candidate = queue.top();
+    queue.pop();
+
+    const Entry& entry = m_entries[candidate.entryID];
+
+    if (entry.isLeaf())
+    {
+      if (candidate.exact)
+      {
+        nodes.push_back(entry.node);
+        count--;
+      }
+      else
+      {
+        const float distance = distanceToSurface(entry.bounds, point);
+        queue.push(Candidate(candidate.entryID, distance, true));
+      }
+    }
+    else
+    {
+      for (int i = 0;  i < 2;  i++)
+      {
+        const Entry& child = m_entries[entry.children[i]];
+        const float distance = sqrt(distance2(child.minimum, child.maximum, point));
+        queue.push(Candidate(entry.children[i], distance, false));
+      }
+    }
+  }
+}
+
+uint BoundsTree::height() const
+{
+  if (m_root == -1)
+    return 0;
+
+  return m_entries[m_root].height + 1;
+}
+
+int BoundsTree::allocateEntry()
+{
+  int entryID;
+
+  if (m_free == -1)
+  {
+    entryID = (int) m_entries.size();
+    m_entries.push_back(Entry());
+  }
+  else
+  {
+    entryID = m_free;
+    m_free = m_entries[entryID].parent;
+  }
+
+  Entry& entry = m_entries[entryID];
+  entry.parent = -1;
+  entry.children[0] = -1;
+  entry.children[1] = -1;
+  entry.height = 0;
+  entry.node = nullptr;
+
+  return entryID;
+}
+
+void BoundsTree::freeEntry(int entryID)
+{
+  Entry& entry = m_entries[entryID];
+  entry.parent = m_free;
+  entry.height = -1;
+  entry.node = nullptr;
+  m_free = entryID;
+}
+
+void BoundsTree::insertLeaf(int leafID)
+{
+  if (m_root == -1)
+  {
+    m_root = leafID;
+    m_entries[m_root].parent = -1;
+    return;
+  }
+
+  const vec3 leafMinimum = m_entries[leafID].minimum;
+  const vec3 leafMaximum = m_entries[leafID].maximum;
+
+  // Find the best sibling using the surface area heuristic
+
+  int siblingID = m_root;
+
+  while (!m_entries[siblingID].isLeaf())
+  {
+    const Entry& entry = m_entries[siblingID];
+
+    const float area = surfaceArea(entry.minimum, entry.maximum);
+    const float combinedArea = surfaceArea(min(entry.minimum, leafMinimum),
+                                           max(entry.maximum, leafMaximum));
+
+    // Cost of creating a new parent for this entry and the leaf
+    const float cost = 2.f * combinedArea;
+    // Minimum cost of pushing the leaf further down the tree
+    const float inheritanceCost = 2.f * (combinedArea - area);
+
+    float childCosts[2];
+
+    for (int i = 0;  i < 2;  i++)
+    {
+      const Entry& child = m_entries[entry.children[i]];
+      const float enlarged = surfaceArea(min(child.minimum, leafMinimum),
+                                         max(child.maximum, leafMaximum));
+
+      if (child.isLeaf())
+        childCosts[i] = enlarged + inheritanceCost;
+      else
+      {
+        const float childArea = surfaceArea(child.minimum, child.maximum);
+        childCosts[i] = enlarged - childArea + inheritanceCost;
+      }
+    }
+
+    if (cost < childCosts[0] && cost < childCosts[1])
+      break;
+
+    if (childCosts[0] < childCosts[1])
+      siblingID = entry.children[0];
+    else
+      siblingID = entry.children[1];
+  }
+
+  // Create a new parent for the sibling and the leaf
+
+  const int oldParentID = m_entries[siblingID].parent;
+  const int newParentID = allocateEntry();
+
+  Entry& newParent = m_entries[newParentID];
+  newParent.parent = oldParentID;
+  newParent.minimum = min(m_entries[siblingID].minimum, leafMinimum);
+  newParent.maximum = max(m_entries[siblingID].maximum, leafMaximum);
+  newParent.height = m_entries[siblingID].height + 1;
+  newParent.children[0] = siblingID;
+  newParent.children[1] = leafID;
+
+  if (oldParentID == -1)
+    m_root = newParentID;
+  else
+  {
+    Entry& oldParent = m_entries[oldParentID];
+    if (oldParent.children[0] == siblingID)
+      oldParent.children[0] = newParentID;
+    else
+      oldParent.children[1] = newParentID;
+  }
+
+  m_entries[siblingID].parent = newParentID;
+  m_entries[leafID].parent = newParentID;
+
+  // Walk back up the tree, refitting and rebalancing
+
+  for (int entryID = newParentID;  entryID != -1; )
+  {
+    entryID = balance(entryID);
+
+    Entry& entry = m_entries[entryID];
+    const Entry& first = m_entries[entry.children[0]];
+    const Entry& second = m_entries[entry.children[1]];
+
+    entry.height = 1 + max(first.height, second.height);
+    entry.minimum = min(first.minimum, second.minimum);
+    entry.maximum = max(first.maximum, second.maximum);
+
+    entryID = entry.parent;
+  }
+}
+
+void BoundsTree::removeLeaf(int leafID)
+{
+  if (leafID == m_root)
+  {
+    m_root = -1;
+    return;
+  }
+
+  const int parentID = m_entries[leafID].parent;
+  const int grandParentID = m_entries[parentID].parent;
+
+  int siblingID;
+  if (m_entries[parentID].children[0] == leafID)
+    siblingID = m_entries[parentID].children[1];
+  else
+    siblingID = m_entries[parentID].children[0];
+
+  if (grandParentID == -1)
+  {
+    m_root = siblingID;
+    m_entries[siblingID].parent = -1;
+    freeEntry(parentID);
+    return;
+  }
+
+  // Replace the parent with the sibling
+
+  Entry& grandParent = m_entries[grandParentID];
+  if (grandParent.children[0] == parentID)
+    grandParent.children[0] = siblingID;
+  else
+    grandParent.children[1] = siblingID;
+
+  m_entries[siblingID].parent = grandParentID;
+  freeEntry(parentID);
+
+  for (int entryID = grandParentID;  entryID != -1; )
+  {
+    entryID = balance(entryID);
+
+    Entry& entry = m_entries[entryID];
+    const Entry& first = m_entries[entry.children[0]];
+    const Entry& second = m_entries[entry.children[1]];
+
+    entry.height = 1 + max(first.height, second.height);
+    entry.minimum = min(first.minimum, second.minimum);
+    entry.maximum = max(first.maximum, second.maximum);
+
+    entryID = entry.parent;
+  }
+}
+
+int BoundsTree::balance(int aID)
+{
+  // Performs a left or right rotation if the subtree rooted at A is imbalanced
+  // and returns the ID of the new root of that subtree
+
+  Entry& a = m_entries[aID];
+  if (a.isLeaf() || a.height < 2)
+    return aID;
+
+  const int bID = a.children[0];
+  const int cID = a.children[1];
+  Entry& b = m_entries[bID];
+  Entry& c = m_entries[cID];
+
+  const int difference = c.height - b.height;
+
+  if (difference > 1)
+  {
+    // Rotate C up
+
+    const int fID = c.children[0];
+    const int gID = c.children[1];
+    Entry& f = m_entries[fID];
+    Entry& g = m_entries[gID];
+
+    c.children[0] = aID;
+    c.parent = a.parent;
+    a.parent = cID;
+
+    if (c.parent == -1)
+      m_root = cID;
+    else if (m_entries[c.parent].children[0] == aID)
+      m_entries[c.parent].children[0] = cID;
+    else
+      m_entries[c.parent].children[1] = cID;
+
+    if (f.height > g.height)
+    {
+      c.children[1] = fID;
+      a.children[1] = gID;
+      g.parent = aID;
+
+      a.minimum = min(b.minimum, g.minimum);
+      a.maximum = max(b.maximum, g.maximum);
+      c.minimum = min(a.minimum, f.minimum);
+      c.maximum = max(a.maximum, f.maximum);
+
+      a.height = 1 + max(b.height, g.height);
+      c.height = 1 + max(a.height, f.height);
+    }
+    else
+    {
+      c.children[1] = gID;
+      a.children[1] = fID;
+      f.parent = aID;
+
+      a.minimum = min(b.minimum, f.minimum);
+      a.maximum = max(b.maximum, f.maximum);
+      c.minimum = min(a.minimum, g.minimum);
+      c.maximum = max(a.maximum, g.maximum);
+
+      a.height = 1 + max(b.height, f.height);
+      c.height = 1 + max(a.height, g.height);
+    }
+
+    return cID;
+  }
+
+  if (difference < -1)
+  {
+    // Rotate B up
+
+    const int dID = b.children[0];
+    const int eID = b.children[1];
+    Entry& d = m_entries[dID];
+    Entry& e = m_entries[eID];
+
+    b.children[0] = aID;
+    b.parent = a.parent;
+    a.parent = bID;
+
+    if (b.parent == -1)
+      m_root = bID;
+    else if (m_entries[b.parent].children[0] == aID)
+      m_entries[b.parent].children[0] = bID;
+    else
+      m_entries[b.parent].children[1] = bID;
+
+    if (d.height > e.height)
+    {
+      b.children[1] = dID;
+      a.children[0] = eID;
+      e.parent = aID;
+
+      a.minimum = min(c.minimum, e.minimum);
+      a.maximum = max(c.maximum, e.maximum);
+      b.minimum = min(a.minimum, d.minimum);
+      b.maximum = max(a.maximum, d.maximum);
+
+      a.height = 1 + max(c.height, e.height);
+      b.height = 1 + max(a.height, d.height);
+    }
+    else
+    {
+      b.children[1] = eID;
+      a.children[0] = dID;
+      d.parent = aID;
+
+      a.minimum = min(c.minimum, d.minimum);
+      a.maximum = max(c.maximum, d.maximum);
+      b.minimum = min(a.minimum, e.minimum);
+      b.maximum = max(a.maximum, e.maximum);
+
+      a.height = 1 + max(c.height, d.height);
+      b.height = 1 + max(a.height, e.height);
+    }
+
+    return bID;
+  }
+
+  return aID;
+}
+
+void BoundsTree::setLooseBox(Entry& entry, const Sphere& bounds)
+{
+  const vec3 extent(bounds.radius * (1.f + INDEX_MARGIN_SCALE) + INDEX_MARGIN);
+
+  entry.bounds = bounds;
+  entry.minimum = bounds.center - extent;
+  entry.maximum = bounds.center + extent;
+}
+
+///////////////////////////////////////////////////////////////////////
+
 Node::Node():
   m_parent(nullptr),
   m_graph(nullptr),
   m_dirtyWorld(false),
-  m_dirtyBounds(false)
+  m_dirtyBounds(false),
+  m_proxyID(-1),
+  m_dirtyIndex(false),
+  m_slot(-1),
+  m_level(0)
 {
 }
 
@@ -132,7 +765,7 @@ bool Node::isChildOf(const Node& node) const
 
 void Node::setLocalTransform(const Transform3& newTransform)
 {
-  m_local = newTransform;
+  local() = newTransform;
 
   if (m_parent)
     m_parent->invalidateBounds();
@@ -142,7 +775,7 @@ void Node::setLocalTransform(const Transform3& newTransform)
 
 void Node::setLocalPosition(const vec3& newPosition)
 {
-  m_local.position = newPosition;
+  local().position = newPosition;
 
   if (m_parent)
     m_parent->invalidateBounds();
@@ -152,7 +785,7 @@ void Node::setLocalPosition(const vec3& newPosition)
 
 void Node::setLocalRotation(const quat& newRotation)
 {
-  m_local.rotation = newRotation;
+  local().rotation = newRotation;
 
   if (m_parent)
     m_parent->invalidateBounds();
@@ -162,7 +795,7 @@ void Node::setLocalRotation(const quat& newRotation)
 
 void Node::setLocalScale(float newScale)
 {
-  m_local.scale = newScale;
+  local().scale = newScale;
 
   if (m_parent)
     m_parent->invalidateBounds();
@@ -170,8 +803,19 @@ void Node::setLocalScale(float newScale)
   invalidateWorldTransform();
 }
 
+const Transform3& Node::localTransform() const
+{
+  if (m_graph)
+    return m_graph->m_locals[m_slot];
+
+  return m_local;
+}
+
 const Transform3& Node::worldTransform() const
 {
+  if (m_graph)
+    return m_graph->worldTransform(*this);
+
   if (m_dirtyWorld)
   {
     if (m_parent)
@@ -187,17 +831,28 @@ const Transform3& Node::worldTransform() const
 
 const Sphere& Node::localBounds() const
 {
+  if (m_graph)
+    return m_graph->m_localBounds[m_slot];
+
   return m_localBounds;
 }
 
 void Node::setLocalBounds(const Sphere& newBounds)
 {
-  m_localBounds = newBounds;
+  if (m_graph)
+    m_graph->m_localBounds[m_slot] = newBounds;
+  else
+    m_localBounds = newBounds;
+
   invalidateBounds();
+  invalidateIndex();
 }
 
 const Sphere& Node::totalBounds() const
 {
+  if (m_graph)
+    return m_graph->totalBounds(*this);
+
   if (m_dirtyBounds)
   {
     m_totalBounds = m_localBounds;
@@ -218,6 +873,7 @@ const Sphere& Node::totalBounds() const
 void Node::setRenderable(render::Renderable* newRenderable)
 {
   m_renderable = newRenderable;
+  m_level = 0;
 
   if (m_renderable)
     setLocalBounds(m_renderable->bounds());
@@ -250,24 +906,69 @@ void Node::update()
 void Node::enqueue(render::Scene& scene, const Camera& camera) const
 {
   if (m_renderable)
-    m_renderable->enqueue(scene, camera, worldTransform());
+    m_renderable->enqueue(scene, camera, worldTransform(), m_level);
+}
 
-  for (auto c : m_children)
-    c->enqueue(scene, camera);
+Transform3& Node::local()
+{
+  if (m_graph)
+    return m_graph->m_locals[m_slot];
+
+  return m_local;
 }
 
 void Node::invalidateBounds()
 {
-  for (Node* node = this;  node;  node = node->parent())
-    node->m_dirtyBounds = true;
+  if (m_graph)
+  {
+    for (Node* node = this;  node;  node = node->parent())
+    {
+      if (m_graph->m_dirtyBounds[node->m_slot])
+        break;
+
+      m_graph->m_dirtyBounds[node->m_slot] = true;
+    }
+
+    m_graph->m_dirtyTransforms = true;
+  }
+  else
+  {
+    for (Node* node = this;  node;  node = node->parent())
+      node->m_dirtyBounds = true;
+  }
 }
 
 void Node::invalidateWorldTransform()
 {
-  m_dirtyWorld = true;
+  if (m_graph)
+  {
+    // Descendants are picked up by the next update pass
+    m_graph->m_dirtyWorlds[m_slot] = true;
+    m_graph->m_dirtyTransforms = true;
+  }
+  else
+  {
+    m_dirtyWorld = true;
 
-  for (auto c : m_children)
-    c->invalidateWorldTransform();
+    for (auto c : m_children)
+      c->invalidateWorldTransform();
+  }
+}
+
+void Node::invalidateIndex()
+{
+  if (m_graph && !m_dirtyIndex)
+  {
+    m_dirtyIndex = true;
+    m_graph->m_dirty.push_back(this);
+  }
+}
+
+Sphere Node::worldBounds() const
+{
+  Sphere bounds = localBounds();
+  bounds.transformBy(worldTransform());
+  return bounds;
 }
 
 void Node::setGraph(Graph* newGraph)
@@ -278,11 +979,34 @@ void Node::setGraph(Graph* newGraph)
     updated.erase(std::find(updated.begin(), updated.end(), this));
   }
 
+  if (m_graph)
+  {
+    if (m_dirtyIndex)
+    {
+      auto& dirty = m_graph->m_dirty;
+      dirty.erase(std::find(dirty.begin(), dirty.end(), this));
+      m_dirtyIndex = false;
+    }
+
+    if (m_proxyID != -1)
+    {
+      m_graph->m_index.destroyProxy(m_proxyID);
+      m_proxyID = -1;
+    }
+
+    m_graph->detachNode(*this);
+  }
+
   m_graph = newGraph;
 
+  if (m_graph)
+    m_graph->attachNode(*this);
+
   if (m_graph && m_camera)
     m_graph->m_updated.push_back(this);
 
+  invalidateIndex();
+
   for (auto c : m_children)
     c->setGraph(m_graph);
 }
@@ -294,50 +1018,99 @@ Graph::~Graph()
   destroyRootNodes();
 }
 
+Graph::Graph():
+  m_dirtyOrder(false),
+  m_dirtyTransforms(false)
+{
+}
+
 void Graph::update()
 {
+  updateTransforms();
+
   for (auto n : m_updated)
     n->update();
+
+  updateIndex();
 }
 
 void Graph::enqueue(render::Scene& scene, const Camera& camera) const
 {
   ProfileNodeCall call("scene::Graph::enqueue");
 
-  const Frustum& frustum = camera.frustum();
+  std::vector<Node*> visible;
+  query(camera.frustum(), visible);
+  cullOccluded(scene, camera, visible);
+
+  for (auto n : visible)
+    n->enqueue(scene, camera);
+}
+
+void Graph::enqueue(render::Scene& scene,
+                    const Camera& camera,
+                    ThreadPool& pool) const
+{
+  ProfileNodeCall call("scene::Graph::enqueue");
+
+  std::vector<Node*> visible;
+  query(camera.frustum(), visible);
+  cullOccluded(scene, camera, visible);
 
-  for (auto r : m_roots)
+  // Resolve the lazily computed camera state before it is shared
+  camera.viewTransform();
+
+  // Scenes filled on worker threads, one per range
+  std::vector<render::Scene> shards(pool.workerCount() + 1,
+                                    render::Scene(scene.vertexPool(), scene.phase()));
+  std::atomic<uint> shardCount(0);
+
+  pool.parallelFor(visible.size(), [&](size_t first, size_t last)
   {
-    Sphere worldBounds = r->totalBounds();
-    worldBounds.transformBy(r->worldTransform());
+    render::Scene& shard = shards[shardCount++];
 
-    if (frustum.intersects(worldBounds))
-      r->enqueue(scene, camera);
-  }
+    for (size_t i = first;  i < last;  i++)
+      visible[i]->enqueue(shard, camera);
+
+    // Sort on this thread so the merge below is linear
+    shard.opaqueQueue().keys();
+    shard.blendedQueue().keys();
+  }, 64);
+
+  for (uint i = 0;  i < shardCount;  i++)
+    scene.merge(shards[i]);
+
+  scene.vertexPool().flush();
 }
 
 void Graph::query(const Sphere& sphere, std::vector<Node*>& nodes) const
 {
-  for (auto r : m_roots)
-  {
-    Sphere worldBounds = r->totalBounds();
-    worldBounds.transformBy(r->worldTransform());
-
-    if (sphere.intersects(worldBounds))
-      nodes.push_back(r);
-  }
+  updateIndex();
+  m_index.query(sphere, nodes);
 }
 
 void Graph::query(const Frustum& frustum, std::vector<Node*>& nodes) const
 {
-  for (auto r : m_roots)
-  {
-    Sphere worldBounds = r->totalBounds();
-    worldBounds.transformBy(r->worldTransform());
+  updateIndex();
+  m_index.query(frustum, nodes);
+}
 
-    if (frustum.intersects(worldBounds))
-      nodes.push_back(r);
-  }
+void Graph::query(const Ray3& ray, std::vector<Node*>& nodes) const
+{
+  updateIndex();
+  m_index.query(ray, nodes);
+}
+
+void Graph::queryNearest(const vec3& point,
+                         uint count,
+                         std::vector<Node*>& nodes) const
+{
+  updateIndex();
+  m_index.queryNearest(point, count, nodes);
+}
+
+void Graph::setOcclusionBuffer(OcclusionBuffer* newBuffer)
+{
+  m_occlusionBuffer = newBuffer;
 }
 
 void Graph::addRootNode(Node& node)
@@ -353,6 +1126,263 @@ void Graph::destroyRootNodes()
     delete m_roots.back();
 }
 
+const BoundsTree& Graph::index() const
+{
+  updateIndex();
+  return m_index;
+}
+
+void Graph::attachNode(Node& node)
+{
+  node.m_slot = (int) m_nodes.size();
+
+  m_nodes.push_back(&node);
+  m_parents.push_back(-1);
+  m_locals.push_back(node.m_local);
+  m_worlds.push_back(node.m_local);
+  m_localBounds.push_back(node.m_localBounds);
+  m_totalBounds.push_back(node.m_localBounds);
+  m_dirtyWorlds.push_back(true);
+  m_dirtyBounds.push_back(true);
+
+  // The new slot is not yet in parent-before-child order
+  m_dirtyOrder = true;
+  m_dirtyTransforms = true;
+}
+
+void Graph::detachNode(Node& node)
+{
+  node.m_local = m_locals[node.m_slot];
+  node.m_localBounds = m_localBounds[node.m_slot];
+  node.m_dirtyWorld = true;
+  node.m_dirtyBounds = true;
+
+  m_nodes[node.m_slot] = nullptr;
+  node.m_slot = -1;
+
+  m_dirtyOrder = true;
+}
+
+const Transform3& Graph::worldTransform(const Node& node) const
+{
+  if (m_dirtyOrder)
+    updateTransforms();
+
+  if (m_dirtyTransforms)
+  {
+    // Resolve only the chain above this node instead of running the full pass,
+    // to keep interleaved modifications and reads cheap
+
+    const Node* dirty = nullptr;
+
+    for (const Node* n = &node;  n;  n = n->m_parent)
+    {
+      if (m_dirtyWorlds[n->m_slot])
+        dirty = n;
+    }
+
+    if (dirty)
+    {
+      Transform3 world;
+      if (dirty->m_parent)
+        world = m_worlds[dirty->m_parent->m_slot];
+
+      std::vector<const Node*> chain;
+
+      for (const Node* n = &node;  n != dirty->m_parent;  n = n->m_parent)
+        chain.push_back(n);
+
+      for (auto n = chain.rbegin();  n != chain.rend();  n++)
+        world = world * m_locals[(*n)->m_slot];
+
+      node.m_world = world;
+      return node.m_world;
+    }
+  }
+
+  return m_worlds[node.m_slot];
+}
+
+const Sphere& Graph::totalBounds(const Node& node) const
+{
+  if (m_dirtyOrder || m_dirtyBounds[node.m_slot])
+    updateTransforms();
+
+  return m_totalBounds[node.m_slot];
+}
+
+void Graph::updateOrder() const
+{
+  ProfileNodeCall call("scene::Graph::updateOrder");
+
+  std::vector<Node*> nodes;
+  nodes.reserve(m_nodes.size());
+
+  std::vector<Node*> stack(m_roots.rbegin(), m_roots.rend());
+
+  while (!stack.empty())
+  {
+    Node* node = stack.back();
+    stack.pop_back();
+
+    nodes.push_back(node);
+    stack.insert(stack.end(), node->m_children.rbegin(), node->m_children.rend());
+  }
+
+  const size_t count = nodes.size();
+
+  std::vector<int> parents(count);
+  std::vector<Transform3> locals(count);
+  std::vector<Sphere> localBounds(count);
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    Node* node = nodes[i];
+
+    locals[i] = m_locals[node->m_slot];
+    localBounds[i] = m_localBounds[node->m_slot];
+
+    // Parents precede their children, so they already have their new slot
+    node->m_slot = (int) i;
+
+    if (node->m_parent)
+      parents[i] = node->m_parent->m_slot;
+    else
+      parents[i] = -1;
+  }
+
+  std::swap(m_nodes, nodes);
+  std::swap(m_parents, parents);
+  std::swap(m_locals, locals);
+  std::swap(m_localBounds, localBounds);
+
+  m_worlds.resize(count);
+  m_totalBounds.resize(count);
+  m_dirtyWorlds.assign(count, true);
+  m_dirtyBounds.assign(count, true);
+
+  m_dirtyOrder = false;
+  m_dirtyTransforms = true;
+}
+
+void Graph::updateTransforms() const
+{
+  if (m_dirtyOrder)
+    updateOrder();
+
+  if (!m_dirtyTransforms)
+    return;
+
+  ProfileNodeCall call("scene::Graph::updateTransforms");
+
+  const size_t count = m_nodes.size();
+
+  // World transforms, parents first
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    const int parent = m_parents[i];
+
+    if (parent == -1)
+    {
+      if (m_dirtyWorlds[i])
+        m_worlds[i] = m_locals[i];
+      else
+        continue;
+    }
+    else
+    {
+      if (m_dirtyWorlds[parent])
+        m_dirtyWorlds[i] = true;
+      else if (!m_dirtyWorlds[i])
+        continue;
+
+      m_worlds[i] = m_worlds[parent] * m_locals[i];
+    }
+
+    m_nodes[i]->invalidateIndex();
+  }
+
+  // Total bounds, children first
+
+  for (size_t i = 0;  i < count;  i++)
+  {
+    if (m_dirtyBounds[i])
+      m_totalBounds[i] = m_localBounds[i];
+  }
+
+  for (size_t i = count;  i-- > 0; )
+  {
+    const int parent = m_parents[i];
+
+    if (parent != -1 && m_dirtyBounds[parent])
+    {
+      Sphere childBounds = m_totalBounds[i];
+      childBounds.transformBy(m_locals[i]);
+      m_totalBounds[parent].envelop(childBounds);
+    }
+  }
+
+  m_dirtyWorlds.assign(count, false);
+  m_dirtyBounds.assign(count, false);
+  m_dirtyTransforms = false;
+}
+
+void Graph::updateIndex() const
+{
+  updateTransforms();
+
+  for (auto n : m_dirty)
+  {
+    if (n->m_proxyID == -1)
+      n->m_proxyID = m_index.createProxy(n->worldBounds(), n);
+    else
+      m_index.moveProxy(n->m_proxyID, n->worldBounds());
+
+    n->m_dirtyIndex = false;
+  }
+
+  m_dirty.clear();
+}
+
+void Graph::cullOccluded(render::Scene& scene,
+                         const Camera& camera,
+                         std::vector<Node*>& nodes) const
+{
+  if (!m_occlusionBuffer)
+    return;
+
+  ProfileNodeCall call("scene::Graph::cullOccluded");
+
+  OcclusionBuffer& buffer = *m_occlusionBuffer;
+  buffer.clear(camera);
+
+  for (auto n : nodes)
+  {
+    if (const render::Renderable* renderable = n->renderable())
+    {
+      if (const Mesh* occluder = renderable->occluder())
+        buffer.addOccluder(*occluder, n->worldTransform());
+    }
+  }
+
+  if (!buffer.hasOccluders())
+    return;
+
+  const size_t count = nodes.size();
+
+  // Only renderables are culled, as other nodes may affect what is visible
+  // even when hidden.  An occluder lies within the bounds of its own node, so
+  // it can never occlude that node
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](Node* n)
+  {
+    return n->renderable() && buffer.isOccluded(n->worldBounds());
+  }), nodes.end());
+
+  if (GL::Stats* stats = scene.vertexPool().context().stats())
+    stats->addOcclusionTests(uint(count), uint(count - nodes.size()));
+}
+
 ///////////////////////////////////////////////////////////////////////
 
   } /*namespace scene*/
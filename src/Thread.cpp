@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy core library
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Config.hpp>
+
+#include <wendy/Core.hpp>
+#include <wendy/Thread.hpp>
+
+///////////////////////////////////////////////////////////////////////
+
+namespace wendy
+{
+
+///////////////////////////////////////////////////////////////////////
+
+ThreadPool::~ThreadPool()
+{
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+
+  m_taskCondition.notify_all();
+
+  for (auto& t : m_threads)
+    t.join();
+}
+
+void ThreadPool::submit(const Task& task)
+{
+  if (m_threads.empty())
+  {
+    task();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(task);
+  }
+
+  m_taskCondition.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (!m_tasks.empty() || m_running)
+    m_idleCondition.wait(lock);
+}
+
+void ThreadPool::parallelFor(size_t count, const RangeTask& task, size_t granularity)
+{
+  if (!count)
+    return;
+
+  granularity = max(granularity, size_t(1));
+
+  const size_t rangeCount = min((count + granularity - 1) / granularity,
+                                m_threads.size() + 1);
+
+  if (rangeCount < 2)
+  {
+    task(0, count);
+    return;
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t remaining = rangeCount - 1;
+
+  // The first range is processed by the calling thread
+
+  const size_t rangeSize = count / rangeCount;
+
+  for (size_t i = 1;  i < rangeCount;  i++)
+  {
+    const size_t first = i * rangeSize;
+    const size_t last = (i + 1 == rangeCount) ? count : first + rangeSize;
+
+    submit([&, first, last]
+    {
+      task(first, last);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--remaining == 0)
+        condition.notify_one();
+    });
+  }
+
+  task(0, rangeSize);
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (remaining)
+    condition.wait(lock);
+}
+
+Ref<ThreadPool> ThreadPool::create(uint workerCount)
+{
+  Ref<ThreadPool> pool(new ThreadPool());
+  if (!pool->init(workerCount))
+    return nullptr;
+
+  return pool;
+}
+
+ThreadPool::ThreadPool():
+  m_running(0),
+  m_stopping(false)
+{
+}
+
+bool ThreadPool::init(uint workerCount)
+{
+  if (!workerCount)
+  {
+    const uint hardwareCount = std::thread::hardware_concurrency();
+    if (hardwareCount > 1)
+      workerCount = hardwareCount - 1;
+  }
+
+  try
+  {
+    for (uint i = 0;  i < workerCount;  i++)
+      m_threads.push_back(std::thread(&ThreadPool::run, this));
+  }
+  catch (const std::system_error& error)
+  {
+    logWarning("Failed to create worker thread: %s", error.what());
+
+    if (m_threads.empty())
+    {
+      logError("Failed to create any worker threads");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ThreadPool::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    while (m_tasks.empty() && !m_stopping)
+      m_taskCondition.wait(lock);
+
+    if (m_tasks.empty())
+      break;
+
+    Task task = m_tasks.front();
+    m_tasks.pop_front();
+    m_running++;
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    m_running--;
+
+    if (m_tasks.empty() && !m_running)
+      m_idleCondition.notify_all();
+  }
+}
+
+///////////////////////////////////////////////////////////////////////
+
+} /*namespace wendy*/
+
+///////////////////////////////////////////////////////////////////////
@@ -58,10 +58,19 @@ public:
   vec2 sizeScale;
   vec2 offsetScale;
   vec2 texScale;
+  static constexpr VertexLayout<3> layout()
+  {
+    return {{ WENDY_VERTEX_COMPONENT(ElementVertex, sizeScale, "vSizeScale", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(ElementVertex, offsetScale, "vOffsetScale", 2, VERTEX_FLOAT),
+              WENDY_VERTEX_COMPONENT(ElementVertex, texScale, "vTexScale", 2, VERTEX_FLOAT) },
+            sizeof(ElementVertex)};
+  }
   static VertexFormat format;
 };
 
-VertexFormat ElementVertex::format("2f:vSizeScale 2f:vOffsetScale 2f:vTexScale");
+static_assert(ElementVertex::layout().isValid(), "Invalid ElementVertex vertex layout");
+
+VertexFormat ElementVertex::format(ElementVertex::layout());
 
 const uint THEME_XML_VERSION = 3;
 
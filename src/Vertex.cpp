@@ -27,7 +27,11 @@
 #include <wendy/Core.hpp>
 #include <wendy/Vertex.hpp>
 
+#include <glm/gtc/half_float.hpp>
+
 #include <cctype>
+#include <cmath>
+#include <cstring>
 #include <sstream>
 
 ///////////////////////////////////////////////////////////////////////
@@ -37,25 +41,198 @@ namespace wendy
 
 ///////////////////////////////////////////////////////////////////////
 
-VertexComponent::VertexComponent(const char* name, size_t count):
+namespace
+{
+
+int32 normalize(float value, float scale)
+{
+  return int32(std::floor(clamp(value, -1.f, 1.f) * scale + 0.5f));
+}
+
+uint32 normalizeUnsigned(float value, float scale)
+{
+  return uint32(std::floor(clamp(value, 0.f, 1.f) * scale + 0.5f));
+}
+
+vec2 encodeOctahedral(vec3 vector)
+{
+  const float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+
+  // Zero-length vectors have no direction, so encode them as +Z
+  if (length == 0.f)
+    return vec2(0.f);
+
+  vector /= length;
+
+  vec2 result(vector.x, vector.y);
+
+  // Fold the lower hemisphere over the diagonals
+  if (vector.z < 0.f)
+  {
+    result.x = (1.f - std::abs(vector.y)) * (vector.x >= 0.f ? 1.f : -1.f);
+    result.y = (1.f - std::abs(vector.x)) * (vector.y >= 0.f ? 1.f : -1.f);
+  }
+
+  return result;
+}
+
+} /*namespace*/
+
+///////////////////////////////////////////////////////////////////////
+
+VertexComponent::VertexComponent(const char* name,
+                                 size_t count,
+                                 VertexComponentType type):
   m_name(name),
-  m_count(count)
+  m_nameID(internName(name)),
+  m_count(count),
+  m_type(type)
+{
+}
+
+void VertexComponent::store(void* target, const float* source) const
+{
+  switch (m_type)
+  {
+    case VERTEX_FLOAT:
+    {
+      std::memcpy(target, source, m_count * sizeof(float));
+      break;
+    }
+
+    case VERTEX_HALF:
+    {
+      int16* values = static_cast<int16*>(target);
+      for (size_t i = 0;  i < m_count;  i++)
+        values[i] = int16(detail::toFloat16(source[i]));
+      break;
+    }
+
+    case VERTEX_BYTE_NORM:
+    {
+      int8* values = static_cast<int8*>(target);
+      for (size_t i = 0;  i < m_count;  i++)
+        values[i] = int8(normalize(source[i], 127.f));
+      break;
+    }
+
+    case VERTEX_UBYTE_NORM:
+    {
+      uint8* values = static_cast<uint8*>(target);
+      for (size_t i = 0;  i < m_count;  i++)
+        values[i] = uint8(normalizeUnsigned(source[i], 255.f));
+      break;
+    }
+
+    case VERTEX_SHORT_NORM:
+    {
+      int16* values = static_cast<int16*>(target);
+      for (size_t i = 0;  i < m_count;  i++)
+        values[i] = int16(normalize(source[i], 32767.f));
+      break;
+    }
+
+    case VERTEX_USHORT_NORM:
+    {
+      uint16* values = static_cast<uint16*>(target);
+      for (size_t i = 0;  i < m_count;  i++)
+        values[i] = uint16(normalizeUnsigned(source[i], 65535.f));
+      break;
+    }
+
+    case VERTEX_PACKED:
+    {
+      const uint32 value = (uint32(normalize(source[0], 511.f)) & 0x3ff) |
+                           ((uint32(normalize(source[1], 511.f)) & 0x3ff) << 10) |
+                           ((uint32(normalize(source[2], 511.f)) & 0x3ff) << 20) |
+                           ((uint32(normalize(source[3], 1.f)) & 0x3) << 30);
+
+      std::memcpy(target, &value, sizeof(value));
+      break;
+    }
+
+    case VERTEX_OCTAHEDRAL:
+    {
+      const vec2 encoded = encodeOctahedral(vec3(source[0], source[1], source[2]));
+
+      int16* values = static_cast<int16*>(target);
+      values[0] = int16(normalize(encoded.x, 32767.f));
+      values[1] = int16(normalize(encoded.y, 32767.f));
+      break;
+    }
+  }
+}
+
+size_t VertexComponent::size() const
 {
+  switch (m_type)
+  {
+    case VERTEX_FLOAT:
+      return m_count * sizeof(float);
+    case VERTEX_HALF:
+    case VERTEX_SHORT_NORM:
+    case VERTEX_USHORT_NORM:
+    case VERTEX_OCTAHEDRAL:
+      return m_count * sizeof(int16);
+    case VERTEX_BYTE_NORM:
+    case VERTEX_UBYTE_NORM:
+      return m_count * sizeof(int8);
+    case VERTEX_PACKED:
+      return sizeof(uint32);
+  }
+
+  panic("Invalid vertex component type %u", m_type);
+}
+
+bool VertexComponent::isNormalized() const
+{
+  return m_type != VERTEX_FLOAT && m_type != VERTEX_HALF;
+}
+
+char VertexComponent::typeCharacter(VertexComponentType type)
+{
+  switch (type)
+  {
+    case VERTEX_FLOAT:
+      return 'f';
+    case VERTEX_HALF:
+      return 'h';
+    case VERTEX_BYTE_NORM:
+      return 'b';
+    case VERTEX_UBYTE_NORM:
+      return 'B';
+    case VERTEX_SHORT_NORM:
+      return 's';
+    case VERTEX_USHORT_NORM:
+      return 'S';
+    case VERTEX_PACKED:
+      return 'p';
+    case VERTEX_OCTAHEDRAL:
+      return 'o';
+  }
+
+  panic("Invalid vertex component type %u", type);
 }
 
 ///////////////////////////////////////////////////////////////////////
 
-VertexFormat::VertexFormat()
+VertexFormat::VertexFormat():
+  m_size(0),
+  m_hash(VERTEX_HASH_BASIS)
 {
 }
 
-VertexFormat::VertexFormat(const char* specification)
+VertexFormat::VertexFormat(const char* specification):
+  m_size(0),
+  m_hash(VERTEX_HASH_BASIS)
 {
   if (!createComponents(specification))
     throw Exception("Invalid vertex format specification");
 }
 
-bool VertexFormat::createComponent(const char* name, size_t count)
+bool VertexFormat::createComponent(const char* name,
+                                   size_t count,
+                                   VertexComponentType type)
 {
   if (count < 1 || count > 4)
   {
@@ -63,6 +240,18 @@ bool VertexFormat::createComponent(const char* name, size_t count)
     return false;
   }
 
+  if (type == VERTEX_PACKED && count != 4)
+  {
+    logError("Packed vertex component %s must have 4 elements", name);
+    return false;
+  }
+
+  if (type == VERTEX_OCTAHEDRAL && count != 2)
+  {
+    logError("Octahedral vertex component %s must have 2 elements", name);
+    return false;
+  }
+
   if (findComponent(name))
   {
     logError("Duplicate vertex component name %s detected; vertex "
@@ -71,11 +260,12 @@ bool VertexFormat::createComponent(const char* name, size_t count)
     return false;
   }
 
-  const size_t offset = size();
-
-  m_components.push_back(VertexComponent(name, count));
+  m_components.push_back(VertexComponent(name, count, type));
   VertexComponent& component = m_components.back();
-  component.m_offset = offset;
+  component.m_offset = m_size;
+
+  m_size += component.size();
+  m_hash = vertexHashComponent(name, count, type, m_hash);
   return true;
 }
 
@@ -98,14 +288,44 @@ bool VertexFormat::createComponents(const char* specification)
       return false;
     }
 
-    if (std::tolower(*c) != 'f')
-    {
-      if (std::isgraph(*c))
-        logError("Invalid vertex component type %c", *c);
-      else
-        logError("Invalid vertex component type 0x%02x", *c);
+    VertexComponentType type;
 
-      return false;
+    switch (*c)
+    {
+      case 'f':
+      case 'F':
+        type = VERTEX_FLOAT;
+        break;
+      case 'h':
+        type = VERTEX_HALF;
+        break;
+      case 'b':
+        type = VERTEX_BYTE_NORM;
+        break;
+      case 'B':
+        type = VERTEX_UBYTE_NORM;
+        break;
+      case 's':
+        type = VERTEX_SHORT_NORM;
+        break;
+      case 'S':
+        type = VERTEX_USHORT_NORM;
+        break;
+      case 'p':
+        type = VERTEX_PACKED;
+        break;
+      case 'o':
+        type = VERTEX_OCTAHEDRAL;
+        break;
+      default:
+      {
+        if (std::isgraph(*c))
+          logError("Invalid vertex component type %c", *c);
+        else
+          logError("Invalid vertex component type 0x%02x", *c);
+
+        return false;
+      }
     }
 
     if (*(++c) == '\0')
@@ -125,7 +345,7 @@ bool VertexFormat::createComponents(const char* specification)
     while (*c != '\0' && *c != ' ')
       name += *c++;
 
-    if (!createComponent(name.c_str(), count))
+    if (!createComponent(name.c_str(), count, type))
       return false;
 
     while (*c != '\0' && *c == ' ')
@@ -138,76 +358,74 @@ bool VertexFormat::createComponents(const char* specification)
 void VertexFormat::destroyComponents()
 {
   m_components.clear();
+  m_size = 0;
+  m_hash = VERTEX_HASH_BASIS;
 }
 
 const VertexComponent* VertexFormat::findComponent(const char* name) const
+{
+  const NameID nameID = findName(name);
+  if (nameID == INVALID_NAME_ID)
+    return nullptr;
+
+  return findComponent(nameID);
+}
+
+const VertexComponent* VertexFormat::findComponent(NameID nameID) const
 {
   for (auto& c : m_components)
   {
-    if (c.name() == name)
+    if (c.nameID() == nameID)
       return &c;
   }
 
   return nullptr;
 }
 
-bool VertexFormat::operator == (const VertexFormat& other) const
-{
-  return m_components == other.m_components;
-}
-
-bool VertexFormat::operator != (const VertexFormat& other) const
-{
-  return !(m_components == other.m_components);
-}
-
-size_t VertexFormat::size() const
-{
-  size_t size = 0;
-
-  for (const VertexComponent& c : m_components)
-    size += c.size();
-
-  return size;
-}
-
 String VertexFormat::asString() const
 {
   std::ostringstream result;
 
   for (auto& c : m_components)
-    result << c.elementCount() << 'f' << ':' << c.name() << ' ';
+  {
+    result << c.elementCount() << VertexComponent::typeCharacter(c.type())
+           << ':' << c.name() << ' ';
+  }
 
   return result.str();
 }
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex3fv::format("3f:vPosition");
+const VertexFormat Vertex3fv::format(Vertex3fv::layout());
+
+///////////////////////////////////////////////////////////////////////
+
+const VertexFormat Vertex3fn3fv::format(Vertex3fn3fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex3fn3fv::format("3f:vNormal 3f:vPosition");
+const VertexFormat Vertex2fv::format(Vertex2fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex2fv::format("2f:vPosition");
+const VertexFormat Vertex2ft2fv::format(Vertex2ft2fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex2ft2fv::format("2f:vTexCoord 2f:vPosition");
+const VertexFormat Vertex2ft3fv::format(Vertex2ft3fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex2ft3fv::format("2f:vTexCoord 3f:vPosition");
+const VertexFormat Vertex4fc2ft3fv::format(Vertex4fc2ft3fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex4fc2ft3fv::format("4f:vColor 2f:vTexCoord 3f:vPosition");
+const VertexFormat Vertex3fn2ft3fv::format(Vertex3fn2ft3fv::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
-const VertexFormat Vertex3fn2ft3fv::format("3f:vNormal 2f:vTexCoord 3f:vPosition");
+const VertexFormat InstanceTransform::format(InstanceTransform::layout());
 
 ///////////////////////////////////////////////////////////////////////
 
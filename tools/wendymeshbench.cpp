@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy mesh reader benchmark
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Wendy.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace wendy;
+
+namespace
+{
+
+bool isIdentical(const Mesh& a, const Mesh& b)
+{
+  if (a.vertices.size() != b.vertices.size() ||
+      a.sections.size() != b.sections.size())
+  {
+    return false;
+  }
+
+  if (!a.vertices.empty() &&
+      std::memcmp(&a.vertices[0], &b.vertices[0],
+                  a.vertices.size() * sizeof(MeshVertex)) != 0)
+  {
+    return false;
+  }
+
+  for (size_t i = 0;  i < a.sections.size();  i++)
+  {
+    const MeshSection& sa = a.sections[i];
+    const MeshSection& sb = b.sections[i];
+
+    if (sa.materialName != sb.materialName ||
+        sa.triangles.size() != sb.triangles.size())
+    {
+      return false;
+    }
+
+    for (size_t j = 0;  j < sa.triangles.size();  j++)
+    {
+      if (std::memcmp(sa.triangles[j].indices,
+                      sb.triangles[j].indices,
+                      sizeof(sa.triangles[j].indices)) != 0)
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+Ref<Mesh> measure(ResourceCache& cache,
+                  ThreadPool* pool,
+                  const char* label,
+                  const Path& path,
+                  size_t size,
+                  uint iterations)
+{
+  MeshReader reader(cache, pool);
+  Ref<Mesh> mesh;
+
+  Time best = 0.0;
+
+  for (uint i = 0;  i < iterations;  i++)
+  {
+    mesh = nullptr;
+
+    const Time start = Timer::currentTime();
+    mesh = reader.read(label, path);
+    const Time elapsed = Timer::currentTime() - start;
+
+    if (!mesh)
+      return nullptr;
+
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  std::printf("%-10s %8.3f s %10.1f MB/s\n",
+              label, best, size / best / (1024.0 * 1024.0));
+
+  return mesh;
+}
+
+} /*namespace*/
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3)
+  {
+    std::fprintf(stderr, "usage: %s <file.obj> [iterations]\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  const Path path(argv[1]);
+  const uint iterations = (argc == 3) ? max(std::atoi(argv[2]), 1) : 3;
+
+  std::ifstream stream(path.name().c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+  if (stream.fail())
+  {
+    logError("Failed to open %s", path.name().c_str());
+    std::exit(EXIT_FAILURE);
+  }
+
+  const size_t size = size_t(stream.tellg());
+  stream.close();
+
+  ResourceCache cache;
+  Ref<ThreadPool> pool = ThreadPool::create();
+
+  Ref<Mesh> serial = measure(cache, nullptr, "serial", path, size, iterations);
+  if (!serial)
+    std::exit(EXIT_FAILURE);
+
+  Ref<Mesh> parallel = measure(cache, pool, "parallel", path, size, iterations);
+  if (!parallel)
+    std::exit(EXIT_FAILURE);
+
+  std::printf("%u threads, %u vertices, %u sections\n",
+              pool->workerCount() + 1,
+              uint(serial->vertices.size()),
+              uint(serial->sections.size()));
+
+  if (!isIdentical(*serial, *parallel))
+  {
+    logError("Meshes from serial and parallel parsing differ");
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::exit(EXIT_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy model converter
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Wendy.hpp>
+
+#include <cstdlib>
+
+using namespace wendy;
+
+int main(int argc, char** argv)
+{
+  if (argc != 4)
+  {
+    std::fprintf(stderr, "usage: %s <search path> <model> <output.wmdl>\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  ResourceCache cache;
+  if (!cache.addSearchPath(Path(argv[1])))
+    std::exit(EXIT_FAILURE);
+
+  const String name(argv[2]);
+
+  const Path path = cache.findFile(name);
+  if (path.isEmpty())
+  {
+    logError("Failed to find model %s", name.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+
+  Ref<ThreadPool> pool = ThreadPool::create();
+
+  render::ModelData data;
+  if (!data.read(cache, name, path, pool))
+    std::exit(EXIT_FAILURE);
+
+  render::ModelWriter writer;
+  if (!writer.write(Path(argv[3]), data))
+    std::exit(EXIT_FAILURE);
+
+  std::exit(EXIT_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////
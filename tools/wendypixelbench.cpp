@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy pixel conversion benchmark
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Wendy.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace wendy;
+
+namespace
+{
+
+Time measure(PixelConverter& converter,
+             void* target,
+             const PixelFormat& targetFormat,
+             const void* source,
+             const PixelFormat& sourceFormat,
+             size_t count,
+             uint iterations)
+{
+  Time best = 0.0;
+
+  for (uint i = 0;  i < iterations;  i++)
+  {
+    const Time start = Timer::currentTime();
+    converter.convert(target, targetFormat, source, sourceFormat, count);
+    const Time elapsed = Timer::currentTime() - start;
+
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  return best;
+}
+
+const char* flagsName(uint flags)
+{
+  switch (flags)
+  {
+    case PT_SWAP_RED_BLUE:
+      return "swap";
+    case PT_PREMULTIPLY_ALPHA:
+      return "premul";
+    case PT_UNPREMULTIPLY_ALPHA:
+      return "unpremul";
+    case PT_SRGB_TO_LINEAR:
+      return "linear";
+    case PT_LINEAR_TO_SRGB:
+      return "sRGB";
+    default:
+      return "";
+  }
+}
+
+bool run(ThreadPool& pool,
+         const PixelFormat& targetFormat,
+         const PixelFormat& sourceFormat,
+         uint flags,
+         const std::vector<char>& source,
+         size_t count,
+         uint iterations)
+{
+  PixelConverter serial(flags);
+  PixelConverter parallel(flags, &pool);
+
+  if (!serial.supports(targetFormat, sourceFormat))
+    return true;
+
+  std::vector<char> a(count * targetFormat.size());
+  std::vector<char> b(count * targetFormat.size());
+
+  const Time serialTime = measure(serial,
+                                  &a[0], targetFormat,
+                                  &source[0], sourceFormat,
+                                  count, iterations);
+  const Time parallelTime = measure(parallel,
+                                    &b[0], targetFormat,
+                                    &source[0], sourceFormat,
+                                    count, iterations);
+
+  const double size = double(count * sourceFormat.size()) / (1024.0 * 1024.0);
+
+  std::printf("%-8s %-8s %-8s %10.1f MB/s %10.1f MB/s\n",
+              sourceFormat.asString().c_str(),
+              targetFormat.asString().c_str(),
+              flagsName(flags),
+              size / serialTime,
+              size / parallelTime);
+
+  if (a != b)
+  {
+    logError("Serial and parallel conversion from %s to %s differ",
+             sourceFormat.asString().c_str(),
+             targetFormat.asString().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+} /*namespace*/
+
+int main(int argc, char** argv)
+{
+  if (argc > 3)
+  {
+    std::fprintf(stderr, "usage: %s [pixels] [iterations]\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  const size_t count = (argc > 1) ? max(std::atoi(argv[1]), 1) : 2048 * 2048;
+  const uint iterations = (argc > 2) ? max(std::atoi(argv[2]), 1) : 3;
+
+  const PixelFormat formats[] =
+  {
+    PixelFormat::L8, PixelFormat::LA8, PixelFormat::RGB8, PixelFormat::RGBA8,
+    PixelFormat::RGB16, PixelFormat::RGBA16, PixelFormat::RGBA16F,
+    PixelFormat::L32F, PixelFormat::RGB32F, PixelFormat::RGBA32F
+  };
+
+  // Each source is converted from random RGBA8 pixels, so that floating
+  // point formats hold valid values
+  std::vector<char> random(count * PixelFormat::RGBA8.size());
+  for (size_t i = 0;  i < random.size();  i++)
+    random[i] = char(std::rand());
+
+  Ref<ThreadPool> pool = ThreadPool::create();
+
+  std::printf("%u pixels, %u threads\n", uint(count), pool->workerCount() + 1);
+  std::printf("%-8s %-8s %-8s %15s %15s\n", "source", "target", "flags", "serial", "parallel");
+
+  for (const PixelFormat& sourceFormat : formats)
+  {
+    std::vector<char> source(count * sourceFormat.size());
+
+    PixelConverter converter;
+    converter.convert(&source[0], sourceFormat,
+                      &random[0], PixelFormat::RGBA8,
+                      count);
+
+    for (const PixelFormat& targetFormat : formats)
+    {
+      if (targetFormat == sourceFormat)
+        continue;
+
+      if (!run(*pool, targetFormat, sourceFormat, PT_NONE, source, count, iterations))
+        std::exit(EXIT_FAILURE);
+    }
+  }
+
+  const uint flags[] =
+  {
+    PT_SWAP_RED_BLUE,
+    PT_PREMULTIPLY_ALPHA,
+    PT_UNPREMULTIPLY_ALPHA,
+    PT_SRGB_TO_LINEAR,
+    PT_LINEAR_TO_SRGB
+  };
+
+  for (uint f : flags)
+  {
+    if (!run(*pool, PixelFormat::RGBA8, PixelFormat::RGBA8, f, random, count, iterations))
+      std::exit(EXIT_FAILURE);
+
+    if (!run(*pool, PixelFormat::RGBA32F, PixelFormat::RGBA8, f, random, count, iterations))
+      std::exit(EXIT_FAILURE);
+  }
+
+  std::exit(EXIT_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////
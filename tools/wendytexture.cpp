@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy texture compressor
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Wendy.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace wendy;
+
+namespace
+{
+
+void usage(const char* program)
+{
+  std::fprintf(stderr,
+               "usage: %s [-q fastest|normal|best] [-m box|kaiser] [-s] [-a <alpha reference>]\n"
+               "       <search path> <image> <output.ktx> <format>\n",
+               program);
+  std::exit(EXIT_FAILURE);
+}
+
+} /*namespace*/
+
+int main(int argc, char** argv)
+{
+  CompressionQuality quality = COMPRESS_NORMAL;
+  bool mipmapped = false, sRGB = false;
+  MipmapFilter filter = MIPMAP_BOX;
+  float alphaReference = 0.f;
+  int first = 1;
+
+  while (first < argc && argv[first][0] == '-')
+  {
+    const char* option = argv[first++];
+
+    if (std::strcmp(option, "-s") == 0)
+    {
+      sRGB = true;
+      continue;
+    }
+
+    if (first == argc)
+      usage(argv[0]);
+
+    const char* value = argv[first++];
+
+    if (std::strcmp(option, "-q") == 0)
+    {
+      if (std::strcmp(value, "fastest") == 0)
+        quality = COMPRESS_FASTEST;
+      else if (std::strcmp(value, "normal") == 0)
+        quality = COMPRESS_NORMAL;
+      else if (std::strcmp(value, "best") == 0)
+        quality = COMPRESS_BEST;
+      else
+        usage(argv[0]);
+    }
+    else if (std::strcmp(option, "-m") == 0)
+    {
+      mipmapped = true;
+
+      if (std::strcmp(value, "box") == 0)
+        filter = MIPMAP_BOX;
+      else if (std::strcmp(value, "kaiser") == 0)
+        filter = MIPMAP_KAISER;
+      else
+        usage(argv[0]);
+    }
+    else if (std::strcmp(option, "-a") == 0)
+      alphaReference = float(std::atof(value));
+    else
+      usage(argv[0]);
+  }
+
+  if (argc - first != 4)
+    usage(argv[0]);
+
+  ResourceCache cache;
+  if (!cache.addSearchPath(Path(argv[first])))
+    std::exit(EXIT_FAILURE);
+
+  const String name(argv[first + 1]);
+
+  const Path path = cache.findFile(name);
+  if (path.isEmpty())
+  {
+    logError("Failed to find image %s", name.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+
+  PixelFormat format;
+
+  try
+  {
+    format = PixelFormat(argv[first + 3]);
+  }
+  catch (const Exception& e)
+  {
+    logError("Invalid pixel format %s: %s", argv[first + 3], e.what());
+    std::exit(EXIT_FAILURE);
+  }
+
+  ImageReader reader(cache);
+
+  Ref<Image> image = reader.read(name, path);
+  if (!image)
+    std::exit(EXIT_FAILURE);
+
+  Ref<ThreadPool> pool = ThreadPool::create();
+
+  if (mipmapped)
+  {
+    const Time start = Timer::currentTime();
+
+    if (!image->generateMipmaps(filter, sRGB, alphaReference, pool))
+      std::exit(EXIT_FAILURE);
+
+    log("Generated %u mipmaps for %s in %.3f seconds",
+        uint(image->mipmaps().size()),
+        name.c_str(),
+        Timer::currentTime() - start);
+  }
+
+  if (format.isCompressed())
+  {
+    const Time start = Timer::currentTime();
+
+    image = image->compress(format, quality, pool);
+    if (!image)
+      std::exit(EXIT_FAILURE);
+
+    log("Compressed %s to %s in %.3f seconds",
+        name.c_str(),
+        format.asString().c_str(),
+        Timer::currentTime() - start);
+  }
+  else if (image->format() != format)
+  {
+    logError("Image %s has pixel format %s",
+             name.c_str(),
+             image->format().asString().c_str());
+    std::exit(EXIT_FAILURE);
+  }
+
+  ImageWriter writer;
+  if (!writer.write(Path(argv[first + 2]), *image))
+    std::exit(EXIT_FAILURE);
+
+  std::exit(EXIT_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////
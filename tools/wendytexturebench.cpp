@@ -0,0 +1,149 @@
+///////////////////////////////////////////////////////////////////////
+// Wendy pixel conversion benchmark
+// Copyright (c) 2013 Camilla Berglund <elmindreda@elmindreda.org>
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any
+// damages arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any
+// purpose, including commercial applications, and to alter it and
+// redistribute it freely, subject to the following restrictions:
+//
+//  1. The origin of this software must not be misrepresented; you
+//     must not claim that you wrote the original software. If you use
+//     this software in a product, an acknowledgment in the product
+//     documentation would be appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and
+//     must not be misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//     distribution.
+//
+///////////////////////////////////////////////////////////////////////
+
+#include <wendy/Wendy.hpp>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace wendy;
+
+namespace
+{
+
+Time readSynchronous(GL::Context& context,
+                     const GL::TextureParams& params,
+                     const std::vector<String>& names,
+                     uint rounds)
+{
+  const Time start = Timer::currentTime();
+
+  for (uint i = 0;  i < rounds;  i++)
+  {
+    GL::TextureList textures;
+
+    for (auto& n : names)
+    {
+      Ref<GL::Texture> texture = GL::Texture::read(context, params, n);
+      if (!texture)
+        std::exit(EXIT_FAILURE);
+
+      textures.push_back(texture);
+    }
+  }
+
+  return Timer::currentTime() - start;
+}
+
+Time readPipelined(GL::TextureLoader& loader,
+                   const GL::TextureParams& params,
+                   const std::vector<String>& names,
+                   uint rounds)
+{
+  const Time start = Timer::currentTime();
+
+  for (uint i = 0;  i < rounds;  i++)
+  {
+    GL::TextureList textures;
+    bool failed = false;
+
+    for (auto& n : names)
+    {
+      loader.request(params, n, [&](GL::Texture* texture)
+      {
+        if (texture)
+          textures.push_back(texture);
+        else
+          failed = true;
+      });
+    }
+
+    loader.finish();
+
+    if (failed)
+      std::exit(EXIT_FAILURE);
+  }
+
+  return Timer::currentTime() - start;
+}
+
+} /*namespace*/
+
+int main(int argc, char** argv)
+{
+  uint flags = GL::TF_NONE;
+  uint rounds = 3;
+  int first = 1;
+
+  for (;  first < argc && argv[first][0] == '-';  first++)
+  {
+    if (std::strcmp(argv[first], "-m") == 0)
+      flags |= GL::TF_MIPMAPPED;
+    else if (std::strcmp(argv[first], "-s") == 0)
+      flags |= GL::TF_SRGB;
+    else if (std::strcmp(argv[first], "-n") == 0 && first + 1 < argc)
+      rounds = max(std::atoi(argv[++first]), 1);
+    else
+      break;
+  }
+
+  if (first == argc)
+  {
+    std::fprintf(stderr, "usage: %s [-m] [-s] [-n rounds] <image>...\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  // Textures are released at the end of each round, so every round reads
+  // and decodes all of the images again
+  std::vector<String> names(argv + first, argv + argc);
+
+  ResourceCache cache;
+
+  GL::Context* context = GL::Context::create(cache, WindowConfig("wendytexturebench"));
+  if (!context)
+    std::exit(EXIT_FAILURE);
+
+  Ref<ThreadPool> pool = ThreadPool::create();
+
+  Ref<GL::TextureLoader> loader = GL::TextureLoader::create(*context, *pool);
+  if (!loader)
+    std::exit(EXIT_FAILURE);
+
+  const GL::TextureParams params(GL::TEXTURE_2D, flags);
+  const double count = double(names.size() * rounds);
+
+  std::printf("%u images, %u rounds, %u threads\n",
+              uint(names.size()), rounds, pool->workerCount() + 1);
+
+  const Time synchronousTime = readSynchronous(*context, params, names, rounds);
+  std::printf("%-12s %10.1f textures/s\n", "synchronous", count / synchronousTime);
+
+  const Time pipelinedTime = readPipelined(*loader, params, names, rounds);
+  std::printf("%-12s %10.1f textures/s\n", "pipelined", count / pipelinedTime);
+
+  std::exit(EXIT_SUCCESS);
+}
+
+///////////////////////////////////////////////////////////////////////